@@ -0,0 +1,101 @@
+#!/bin/sh
+# Compares the interpreter (--interp) with the code run in memory (--run) and the linked executable (-gcc)
+# on examples/fibonacci.bf and on generated workloads: loops, calls, branches and 64-bit arithmetic.
+# Usage: benchmarks/interp.sh <bonfirec> [x86|x86_64]
+# Build bonfirec with -DCMAKE_BUILD_TYPE=Release, the interpreter loop is slow without optimizations. Add
+# -DCMAKE_CXX_FLAGS=-DBONFIRE_SWITCH_DISPATCH to measure the switch instead of the computed goto dispatch
+
+BONFIREC=$(realpath "${1:?Usage: $0 <bonfirec> [x86|x86_64]}")
+TARGET=${2:-x86_64}
+ROOT=$(dirname "$(realpath "$0")")/..
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+cp "$ROOT/examples/fibonacci.bf" "$WORK/fibonacci.bf"
+
+# Counting loop with arithmetic on constants
+cat > "$WORK/loop.bf" <<EOF
+main() -> i32 {
+  n: i32 = 0
+  h: i32 = 0
+  |(n < 30000000) {
+    h = h * 31 + n
+    h = h - (n * 7)
+    n = n + 1
+  }
+  <- h
+}
+EOF
+
+# Recursive calls
+cat > "$WORK/calls.bf" <<EOF
+fib(n: i32) -> i32 {
+  ?(n < 2) { <- n }
+  <- fib(n - 1) + fib(n - 2)
+}
+main() -> i32 {
+  <- fib(30)
+}
+EOF
+
+# Branches that depend on the data
+cat > "$WORK/branches.bf" <<EOF
+main() -> i32 {
+  n: i32 = 0
+  h: i32 = 0
+  |(n < 5000000) {
+    d: i32 = (n * n + 3 * n) % 97
+    e: i32 = (n * n + 3 * n) % 89
+    ?(d > e) {
+      h = h + (d - e) * (d - e)
+    } : {
+      h = h - (e - d)
+    }
+    n = n + 1
+  }
+  <- h
+}
+EOF
+
+# 64-bit arithmetic, only on x86_64
+cat > "$WORK/wide.bf" <<EOF
+main() -> i64 {
+  n: i64 = 0
+  h: i64 = 1
+  |(n < 20000000) {
+    h = h * 6364136223846793005 + 1442695040888963407
+    n = n + 1
+  }
+  <- h
+}
+EOF
+
+# Seconds since the epoch, with nanoseconds
+now() {
+	date +%s.%N
+}
+
+elapsed() {
+	awk "BEGIN { print $2 - $1 }"
+}
+
+printf "%-12s %12s %12s %12s %10s\n" workload native run interp interp/native
+for workload in fibonacci loop calls branches wide; do
+	[ "$workload" = wide ] && [ "$TARGET" != x86_64 ] && continue
+	source="$WORK/$workload.bf"
+	"$BONFIREC" -gcc --target="$TARGET" "$source" > /dev/null 2>&1 || exit 1
+	exe="$WORK/$workload.exe"
+
+	start=$(now); "$exe"; native_code=$?; end=$(now)
+	native=$(elapsed "$start" "$end")
+	start=$(now); "$BONFIREC" --run "$source" > /dev/null; run_code=$?; end=$(now)
+	run=$(elapsed "$start" "$end")
+	start=$(now); "$BONFIREC" --interp "$source" > /dev/null; interp_code=$?; end=$(now)
+	interp=$(elapsed "$start" "$end")
+
+	if [ "$native_code" != "$interp_code" ] || [ "$run_code" != "$interp_code" ]; then
+		echo "$workload: exit codes differ (native $native_code, run $run_code, interp $interp_code)"
+		exit 1
+	fi
+	printf "%-12s %11.3fs %11.3fs %11.3fs %9.1fx\n" "$workload" "$native" "$run" "$interp" "$(awk "BEGIN { print $interp / ($native + 0.0001) }")"
+done
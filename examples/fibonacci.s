@@ -0,0 +1,75 @@
+	.intel_syntax noprefix
+	.global main
+	.text
+fib:
+	.cfi_startproc
+	push rbp
+	.cfi_def_cfa_offset 16
+	.cfi_offset rbp, -16
+	mov rbp, rsp
+	.cfi_def_cfa_register rbp
+	sub rsp, 32
+	mov DWORD PTR [rbp-4], edi
+	mov DWORD PTR [rbp-8], esi
+	mov DWORD PTR [rbp-12], edx
+	mov eax, DWORD PTR [rbp-4]
+	mov DWORD PTR [rbp-16], eax
+	mov eax, DWORD PTR [rbp-8]
+	mov DWORD PTR [rbp-20], eax
+	mov DWORD PTR [rbp-24], 0
+	.p2align 4
+__w_begin0:
+	mov eax, DWORD PTR [rbp-16]
+	add eax, DWORD PTR [rbp-20]
+	mov DWORD PTR [rbp-24], eax
+	mov eax, DWORD PTR [rbp-24]
+	cmp eax, DWORD PTR [rbp-12]
+	jg __then1
+__continue1:
+	mov eax, DWORD PTR [rbp-20]
+	mov DWORD PTR [rbp-16], eax
+	mov eax, DWORD PTR [rbp-24]
+	mov DWORD PTR [rbp-20], eax
+__block0_end:
+	jmp __w_begin0
+__w_continue0:
+	.cfi_remember_state
+	mov rsp, rbp
+	pop rbp
+	.cfi_def_cfa rsp, 8
+	ret
+	.cfi_restore_state
+	.cfi_endproc
+	.section .text.unlikely,"ax",@progbits
+fib.cold:
+	.cfi_startproc
+	.cfi_def_cfa rbp, 16
+	.cfi_offset rbp, -16
+__then1:
+	mov eax, DWORD PTR [rbp-20]
+	.cfi_remember_state
+	mov rsp, rbp
+	pop rbp
+	.cfi_def_cfa rsp, 8
+	ret
+	.cfi_restore_state
+__block1_end:
+	.cfi_endproc
+	.section .text,"ax",@progbits
+main:
+	.cfi_startproc
+	push rbp
+	.cfi_def_cfa_offset 16
+	.cfi_offset rbp, -16
+	mov rbp, rsp
+	.cfi_def_cfa_register rbp
+	mov edi, 0
+	mov esi, 1
+	mov edx, 1000
+	.cfi_remember_state
+	mov rsp, rbp
+	pop rbp
+	.cfi_def_cfa rsp, 8
+	jmp fib
+	.cfi_restore_state
+	.cfi_endproc
@@ -0,0 +1,11 @@
+// A loop bound that doesn't fit into 8 bits doesn't remove the check of a shorter array
+// Expect: trap
+main() -> i32 {
+  a: [i32; 44]
+  i: i32 = 0
+  |(i < 300) {
+    a[i] = 1
+    i = i + 1
+  }
+  <- 5
+}
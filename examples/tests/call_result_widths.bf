@@ -0,0 +1,15 @@
+// Call results of other integer types are extended or cut when they initialise a variable, like variables are
+// Expect: 139
+g(a: i16, b: i16) -> i16 {
+  <- a + b
+}
+h() -> u8 {
+  x: u8 = 200
+  <- x + x
+}
+main() -> i32 {
+  r: i32 = 0
+  r = g(30000, 30000)
+  s: i32 = h()
+  <- r / 1000 + s
+}
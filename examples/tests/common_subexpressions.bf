@@ -0,0 +1,18 @@
+// Expressions reused across the arms of an if
+// Expect: 64
+main() -> i32 {
+  x: i32 = 7
+  y: i32 = 5
+  s: i32 = 0
+  i: i32 = 0
+  |(i < 1000) {
+    a: i32 = (x + i) * (y + i) / 3
+    ?(a % 2 == 0) {
+      s = s + (x + i) * (y + i) / 3 + i * y - 1
+    } : {
+      s = s - (x + i) * (y + i) / 3 + (i * y - 1) * 2
+    }
+    i = i + 1
+  }
+  <- s % 256
+}
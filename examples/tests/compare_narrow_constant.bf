@@ -0,0 +1,10 @@
+// Narrow variables compared with constants their type can't hold
+// Expect: 11
+main() -> i32 {
+  x: i8 = 200
+  r: i32 = 1
+  ?(x == 200) { r = 2 }
+  y: u8 = 300
+  ?(y < 100) { r = r + 10 }
+  <- r
+}
@@ -0,0 +1,19 @@
+// Constants in conditions keep their value, even if it doesn't fit into 8 bits
+// Expect: 13
+main() -> i32 {
+  x: i32 = ?(200 > 100) 1 : 2
+  r: i32 = 0
+  ?(300 == 44) {
+    r = 7
+  }
+  n: i32 = 0
+  i: i32 = 0
+  |(i < 300) {
+    n = n + 1
+    i = i + 1
+  }
+  ?(1000 < 200 || n != 300) {
+    r = r + 50
+  }
+  <- x * 10 + r + n / 100
+}
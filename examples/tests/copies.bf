@@ -0,0 +1,11 @@
+// Chains of copies
+// Expect: 42
+main() -> i32 {
+  x: i32 = 41
+  ?(x > 40) { x = x + 1 }
+  y: i32 = x
+  z: i32 = y
+  w: i32 = z
+  y = z
+  <- w
+}
@@ -0,0 +1,14 @@
+// Stores of call results that are never read: the calls stay, the variables go
+// Expect: 3
+// Flags: --inline-budget=0
+g(n: i32) -> i32 {
+  <- n * 2
+}
+main() -> i32 {
+  x: i32 = 0
+  x = g(4)
+  y: i32 = 0
+  y = g(5) + 1
+  z: i32 = g(6)
+  <- 3
+}
@@ -0,0 +1,7 @@
+// Chains that can't be regrouped calculate every operation in the register of the result
+// Expect: 100
+main() -> i32 {
+  b: i32 = 1
+  x: i32 = 100 / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b / b 
+  <- x
+}
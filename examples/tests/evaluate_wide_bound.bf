@@ -0,0 +1,23 @@
+// Loops in values that are evaluated at compile time compare with bounds that don't fit into 8 bits
+// Expect: 179
+main() -> i32 {
+  x: i32 = -> i32 {
+    i: i32 = 0
+    s: i32 = 0
+    |(i < 1000) {
+      s = s + i
+      i = i + 1
+    }
+    <- s
+  }
+  y: i32 = -> i32 {
+    i: u32 = 0
+    s: i32 = 0
+    |(i < 300) {
+      s = s + i
+      i = i + 1
+    }
+    <- s
+  }
+  <- x / 1000 + y / 100
+}
@@ -0,0 +1,26 @@
+// The example with the call kept, through every backend
+// Expect: 219
+// Flags: --inline-budget=0
+// Finds the biggest number smaller than max in the fibonacci sequence
+fib(a: i32, b: i32, max: i32) -> i32 {
+  // Declare x, y and z
+  x: i32 = a
+  y: i32 = b
+  z: i32 = 0
+  
+  // While loop
+  | {
+    z = x + y
+    ?(z > max) {
+      // Return y
+      <- y
+    }
+    x = y
+    y = z
+  }
+}
+
+main() -> i32 {
+  // There is no library to print with yet, so the result is the exit code (987 % 256)
+  <- fib(0, 1, 1000)
+}
@@ -0,0 +1,11 @@
+// Conditions of ifs compare at the size of their operands
+// Expect: 4
+main() -> i32 {
+  x: i32 = 0
+  n: i32 = 0
+  |(x < 10) {
+    ?(x > 5) n = n + 1
+    x = x + 1
+  }
+  <- n
+}
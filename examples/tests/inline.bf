@@ -0,0 +1,37 @@
+// Small, recursive and single-use functions
+// Expect: 138
+sq(x: i32) -> i32 {
+  <- x * x
+}
+
+clamp(v: i32, lo: i32, hi: i32) -> i32 {
+  ?(v < lo) {
+    <- lo
+  }
+  ?(v > hi) {
+    <- hi
+  }
+  <- v
+}
+
+once(a: i32) -> i32 {
+  t: i32 = a + sq(a)
+  <- t + 1
+}
+
+fact(n: i32) -> i32 {
+  ?(n <= 1) {
+    <- 1
+  }
+  <- n * fact(n - 1)
+}
+
+main() -> i32 {
+  s: i32 = 0
+  i: i32 = 0
+  |(i < 10) {
+    s = s + clamp(sq(i), 5, 50)
+    i = i + 1
+  }
+  <- s + sq(3) + once(i) + fact(4)
+}
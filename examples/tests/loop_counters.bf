@@ -0,0 +1,24 @@
+// Loops that count down and induction variables that replace counters
+// Expect: 134
+main() -> i32 {
+  k: i32 = 3
+  n: i32 = 40
+  s: i32 = 0
+  o: i32 = 0
+  c: i32 = 0
+  |(o < 5) {
+    i: i32 = n
+    |(i > 0) {
+      s = s + i * k + k * 7
+      i = i - 2
+    }
+    m: i32 = 0
+    |(m < 4) {
+      s = s + c * 5
+      c = c + 1
+      m = m + 1
+    }
+    o = o + 1
+  }
+  <- s % 256
+}
@@ -0,0 +1,27 @@
+// Hoisted invariants and strength-reduced multiplications in nested loops
+// Expect: 194
+main() -> i32 {
+  a: i32 = 7
+  b: i32 = 5
+  s: i32 = 0
+  i: i32 = 0
+  |(i < 100) {
+    j: i32 = 0
+    t: i32 = 0
+    |(j < 10) {
+      t = t + j * 6 + a * b + i * a
+      j = j + 1
+    }
+    s = s + t + i * 4
+    i = i + 1
+  }
+  c: i32 = 0
+  k: i32 = 0
+  x: i32 = 0
+  |(k < 50) {
+    x = x + c * 3
+    c = c + 2
+    k = k + 1
+  }
+  <- (s + x) % 256
+}
@@ -0,0 +1,10 @@
+// i8 + u8 in a block that constant folding evaluates
+// Expect: 65
+main() -> i32 {
+  x: i32 = -> i32 {
+    a: i8 = 0 - 5
+    b: u8 = 200
+    <- a + b
+  }
+  <- x / 3
+}
@@ -0,0 +1,12 @@
+// Chains are only regrouped if all of their operands are calculated in the same size: a + b and - a - b would
+// overflow 32 bits
+// Expect: 8
+main() -> i32 {
+  x: i64 = 0
+  y: i64 = 0
+  a: i32 = 2000000000
+  b: i32 = 2000000000
+  p: i64 = x + y + a + b
+  n: i64 = x - y - a - b
+  <- p / 1000000000 - n / 1000000000
+}
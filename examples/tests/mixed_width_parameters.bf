@@ -0,0 +1,9 @@
+// i8 + u8 is calculated in 32 bits, also after the call is inlined and folded
+// Expect: 65
+add(a: i8, b: u8) -> i32 {
+  x: i32 = a + b
+  <- x
+}
+main() -> i32 {
+  <- add(0 - 5, 200) / 3
+}
@@ -0,0 +1,18 @@
+// Functions named like registers and operators of the assembler
+// Expect: 42
+// Flags: --inline-budget=0
+ax(x: i32) -> i32 {
+  <- x + 1
+}
+
+r8d(x: i32) -> i32 {
+  <- ax(x) * 2
+}
+
+byte(x: i32) -> i32 {
+  <- r8d(x)
+}
+
+main() -> i32 {
+  <- byte(20)
+}
@@ -0,0 +1,73 @@
+#!/bin/sh
+# Regression tests: compiles every program in examples/tests with the .s file and gcc (-gcc), with the built-in
+# encoder (-obj -gcc), runs it in memory (--run) and in the interpreter (--interp), and compares the exit code with
+# the "// Expect: <code>" line of the program, or "// Expect: trap" for an index out of bounds (SIGILL in native code).
+# "// Flags: <flags>" adds flags to every bonfirec call.
+# Usage: examples/tests/run.sh <bonfirec> [x86|x86_64]
+# --run always runs on the machine bonfirec runs on, the target only changes -gcc and -obj. x86 needs gcc -m32
+
+BONFIREC=$(realpath "${1:?Usage: $0 <bonfirec> [x86|x86_64]}")
+TARGET=${2:-x86_64}
+TESTS=$(dirname "$(realpath "$0")")
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+passed=0
+failed=0
+
+# check <test> <mode> <expected> <exit code>
+check() {
+	if [ "$4" = "$3" ]; then
+		passed=$((passed + 1))
+	else
+		failed=$((failed + 1))
+		echo "FAIL $1 ($2): expected $3, got $4"
+	fi
+}
+
+# Exit code of native code, "trap" if it stopped at ud2
+exited() {
+	if [ $1 -eq 132 ]; then echo trap; else echo $1; fi
+}
+
+# Exit code of main from the output of --run or --interp (given the exit code of bonfirec), "trap" if it stopped at
+# a bounds check or "no result" if it didn't return
+returned() {
+	value=$(sed -n 's/^main returned \(-\{0,1\}[0-9]*\)$/\1/p' "$WORK/out")
+	if [ -n "$value" ]; then echo $((value & 255))
+	elif [ $1 -eq 132 ] || grep -q "out of bounds" "$WORK/out"; then echo trap
+	else echo "no result"; fi
+}
+
+for source in "$TESTS"/*.bf; do
+	name=$(basename "$source" .bf)
+	expected=$(sed -n 's|^// Expect: *||p' "$source")
+	flags=$(sed -n 's|^// Flags: *||p' "$source")
+	cp "$source" "$WORK/$name.bf"
+
+	# Assembly, assembled and linked by gcc
+	if "$BONFIREC" -gcc --target=$TARGET $flags "$WORK/$name.bf" > "$WORK/out" 2>&1; then
+		"$WORK/$name.exe" 2> /dev/null
+		check $name gcc $expected "$(exited $?)"
+	else
+		check $name gcc $expected "compile error"
+	fi
+	rm -f "$WORK/$name.exe"
+
+	# Built-in encoder
+	if "$BONFIREC" -obj -gcc --target=$TARGET $flags "$WORK/$name.bf" > "$WORK/out" 2>&1; then
+		"$WORK/$name.exe" 2> /dev/null
+		check $name obj $expected "$(exited $?)"
+	else
+		check $name obj $expected "compile error"
+	fi
+
+	"$BONFIREC" --run $flags "$WORK/$name.bf" > "$WORK/out" 2>&1
+	check $name run $expected "$(returned $?)"
+
+	"$BONFIREC" --interp $flags "$WORK/$name.bf" > "$WORK/out" 2>&1
+	check $name interp $expected "$(returned $?)"
+done
+
+echo "$passed passed, $failed failed"
+[ $failed -eq 0 ]
@@ -0,0 +1,14 @@
+// Left operands wait in r8 to r11 on x86_64, deeper ones and ones around calls on the stack
+// Expect: 209
+// Flags: --inline-budget=0
+f(x: i32) -> i32 {
+  <- x * 3
+}
+main() -> i32 {
+  a: i32 = 7
+  b: i32 = 5
+  c: i64 = 90000000000
+  r: i32 = a * 100 - (b * 10 - (a * (b + (a - (b * (a + f(b)))))))
+  s: i64 = c / (a - (b * (a - (b - (a - (b + (a / b)))))))
+  <- r + (s / 1000000000)
+}
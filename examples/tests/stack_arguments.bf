@@ -0,0 +1,10 @@
+// More arguments than registers, the rest go on the stack
+// Expect: 140
+// Flags: --inline-budget=0
+f(a: i32, b: i32, c: i32, d: i32, e: i32, g: i32, h: i32) -> i32 {
+  <- a + b * 2 + c * 3 + d * 4 + e * 5 + g * 6 + h * 7
+}
+
+main() -> i32 {
+  <- f(1, 2, 3, 4, 5, 6, 7)
+}
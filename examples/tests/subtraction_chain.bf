@@ -0,0 +1,8 @@
+// A long chain of subtractions is regrouped, so the compiler doesn't run out of stack on it
+// Expect: 157
+main() -> i32 {
+  b: i32 = 3
+  c: i32 = 1
+  x: i32 = 10000 - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b + c - b
+  <- x
+}
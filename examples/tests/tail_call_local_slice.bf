@@ -0,0 +1,11 @@
+// A call in tail position that passes a slice of a local array must stay a call
+// Expect: 29
+// Flags: --inline-budget=0
+f(a: [i32], k: i32) -> i32 {
+  <- a[1] * 10 + k
+}
+main() -> i32 {
+  a: [i32; 4]
+  a[1] = 2
+  <- f(a, 9)
+}
@@ -0,0 +1,24 @@
+// Sibling and self calls that pass slices of a local array of the caller
+// Expect: 103
+// Flags: --inline-budget=0
+g(a: [i32], n: i32) -> i32 {
+  b: [i32; 4]
+  b[0] = n
+  ?(n > 0) {
+    <- g(b, n - 1) + a[0]
+  }
+  <- a[0]
+}
+h(a: [i32], n: i32) -> i32 {
+  b: [i32; 4]
+  b[0] = n * 3
+  ?(n > 0) {
+    <- h(b, n - 1)
+  }
+  <- a[0] + 100
+}
+main() -> i32 {
+  a: [i32; 4]
+  a[0] = 7
+  <- h(a, 3) + g(a, 2) * 0
+}
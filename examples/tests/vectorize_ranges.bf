@@ -0,0 +1,21 @@
+// Loops from and to parameters, also empty ones
+// Expect: 53
+total(xs: [i32], from: i32, to: i32) -> i32 {
+  s: i32 = 0
+  i: i32 = from
+  |(i < to) {
+    s = s + xs[i]
+    i = i + 1
+  }
+  <- s
+}
+main() -> i32 {
+  a: [i32; 40]
+  i: i32 = 0
+  |(i < 40) {
+    a[i] = i + 1
+    i = i + 1
+  }
+  r: i32 = total(a, 0, 40) + total(a, 5, 7) * 3 + total(a, 30, 29) * 5 + total(a, 3, 39) * 7 + total(a, 8, 40) * 11
+  <- r % 256
+}
@@ -0,0 +1,95 @@
+// Sums, minimums, maximums and element wise stores over slices, also overlapping ones
+// Expect: 40
+sum(xs: [i32]) -> i32 {
+  total: i32 = 0
+  i: u32 = 0
+  |(i < len(xs)) {
+    total = total + xs[i]
+    i = i + 1
+  }
+  <- total
+}
+least(xs: [i32]) -> i32 {
+  m: i32 = 1000000
+  i: u32 = 0
+  |(i < len(xs)) {
+    ?(xs[i] < m) { m = xs[i] }
+    i = i + 1
+  }
+  <- m
+}
+biggest(xs: [i16]) -> i32 {
+  low: i32 = 0 - 30000
+  m: i16 = low
+  i: u32 = 0
+  |(i < len(xs)) {
+    ?(xs[i] > m) { m = xs[i] }
+    i = i + 1
+  }
+  <- m
+}
+bytemax(xs: [u8]) -> i32 {
+  m: u8 = 0
+  i: u32 = 0
+  |(i < len(xs)) {
+    ?(m < xs[i]) m = xs[i]
+    i = i + 1
+  }
+  <- m
+}
+axpy(k: i32, x: [i32], y: [i32]) -> i32 {
+  i: u32 = 0
+  |(i < len(x)) {
+    y[i] = k * x[i] + y[i]
+    i = i + 1
+  }
+  <- 0
+}
+axpy16(k: i16, x: [i16], y: [i16]) -> i32 {
+  i: u32 = 0
+  |(i < len(x)) {
+    y[i] = k * x[i] + y[i]
+    i = i + 1
+  }
+  <- 0
+}
+main() -> i32 {
+  a: [i32; 37]
+  b: [i32; 37]
+  h: [i16; 50]
+  c: [u8; 70]
+  i: i32 = 0
+  |(i < 37) {
+    a[i] = (i * 7919) % 101 - 50
+    b[i] = i
+    i = i + 1
+  }
+  i = 0
+  |(i < 50) {
+    h[i] = (i * 31) % 97 - 40
+    i = i + 1
+  }
+  i = 0
+  |(i < 70) {
+    c[i] = (i * 13) % 251
+    i = i + 1
+  }
+  s: i32 = sum(a)
+  m: i32 = least(a)
+  l: i32 = biggest(h)
+  bm: i32 = bytemax(c)
+  axpy(3, a, b)
+  t: i32 = sum(b)
+  axpy(2, b[1..37], b[0..36])
+  t2: i32 = sum(b)
+  axpy(2, b[0..36], b[1..37])
+  t3: i32 = sum(b[2..30])
+  axpy16(5, h[0..20], h[20..40])
+  hs: i32 = 0
+  i = 0
+  |(i < 50) {
+    hs = hs + h[i]
+    i = i + 1
+  }
+  <- (s * 3 + m * 5 + l * 7 + bm * 11 + t * 13 + t2 + t3 * 17 + hs * 19) % 256
+}
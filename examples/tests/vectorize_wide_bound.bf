@@ -0,0 +1,12 @@
+// A vectorized loop whose constant bound doesn't fit into 8 bits checks the length of a shorter array
+// Expect: trap
+main() -> i32 {
+  a: [i32; 44]
+  s: i32 = 0
+  i: u32 = 0
+  |(i < 300) {
+    s = s + a[i]
+    i = i + 1
+  }
+  <- s
+}
@@ -0,0 +1,75 @@
+// Vectorized loops over 8, 16, 32 and 64-bit elements
+// Expect: 249
+main() -> i32 {
+  a: [i32; 45]
+  b: [i8; 100]
+  c: [i64; 21]
+  d: [u16; 40]
+  i: i32 = 0
+  |(i < 45) {
+    a[i] = (i * 7919) % 101 - 50
+    i = i + 1
+  }
+  i = 0
+  |(i < 100) {
+    b[i] = (i * 37) % 200 - 100
+    i = i + 1
+  }
+  i = 0
+  |(i < 21) {
+    c[i] = i * 1000000007
+    i = i + 1
+  }
+  i = 0
+  |(i < 40) {
+    d[i] = i * 1601
+    i = i + 1
+  }
+  lo: i32 = 1000
+  hi: i32 = 0 - 1000
+  s: i32 = 0
+  n: i32 = 43
+  j: i32 = 1
+  |(j < n) {
+    ?(a[j] < lo) lo = a[j]
+    ?(hi < a[j]) hi = a[j]
+    s = s - a[j]
+    j = j + 1
+  }
+  bl: i8 = 100
+  bh: i8 = 0
+  k: u32 = 3
+  |(k < 100) {
+    ?(b[k] < bl) bl = b[k]
+    ?(b[k] > bh) bh = b[k]
+    k = k + 1
+  }
+  cs: i64 = 0
+  k = 0
+  |(k < 21) {
+    cs = cs + c[k]
+    k = k + 1
+  }
+  ds: u16 = 0
+  dm: u16 = 0
+  k = 0
+  |(k < 40) {
+    ds = ds + d[k]
+    ?(d[k] > dm) dm = d[k]
+    k = k + 1
+  }
+  e: [i32; 45]
+  k = 0
+  |(k < 45) {
+    e[k] = a[k] + 7 - a[k] * 0 + a[k]
+    a[k] = a[k] - 1
+    k = k + 1
+  }
+  es: i32 = 0
+  k = 0
+  |(k < 45) {
+    es = es + e[k] + a[k]
+    k = k + 1
+  }
+  <- (lo * 3 + hi * 5 + s * 7 + bl * 11 + bh * 13 + (cs % 1000) + ds * 3 + dm + es * 17) % 256
+}
@@ -0,0 +1,11 @@
+// A return in a void block inside a value returns for the function
+// Expect: 209
+// Flags: --inline-budget=0
+f(c: i32) -> i32 {
+  a: i32 = 0
+  a = ?(c > 0) { <- 1 } : { <- 2 }
+  <- 50 + a
+}
+main() -> i32 {
+  <- f(3) + f(0 - 1) * 1000
+}
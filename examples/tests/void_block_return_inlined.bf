@@ -0,0 +1,11 @@
+// The same after the function is inlined into a value
+// Expect: 9
+f(c: i32) -> i32 {
+  a: i32 = 0
+  a = ?(c > 0) { <- 1 } : { <- 2 }
+  <- 50 + a
+}
+main() -> i32 {
+  x: i32 = f(0 - 1)
+  <- x + 7
+}
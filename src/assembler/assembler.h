@@ -1,11 +1,23 @@
 #pragma once
 #include <string>
 #include <sstream>
+#include <algorithm>
+#include <set>
+#include <stdexcept>
 
 #include "assembler/format.h"
+#include "assembler/target.h"
 #include "assembler/instructions.h"
 #include "assembler/optimizations.h"
 #include "assembler/final.h"
+#include "assembler/vector.h"
+#include "assembler/encoder.h"
+#include "assembler/elf.h"
+#include "profile/profile.h"
+#include "profile/instrument.h"
+#include "optimizer/constants.h"
+#include "optimizer/inliner.h"
+#include "utils/report.h"
 #include "ast.h"
 
 #define ASM_ERR "err"
@@ -26,9 +38,43 @@ namespace Bonfire {
 			}
 		};
 
+		// Where the elements of an array are: on the stack, in .bss, or behind the pointer of a slice
+		enum class ArrayKind { STACK, STATIC, SLICE };
+
+		struct ArrayVariable {
+			std::string name;
+			Type element_type;
+			ArrayKind kind;
+			uint32_t length;		// Slices have their length in a variable
+			uint32_t stack_offset;	// The first element of an array on the stack, the pointer of a slice
+			uint32_t length_offset;	// The length of a slice
+			std::string symbol;		// Static arrays
+			bool in_frame = false;	// The elements are (or, for a slice, may be) in the frame of the current function
+		};
+
 		std::vector<Variable> glob_vars;
+		std::vector<ArrayVariable> glob_arrays;
+		// Static arrays of the whole program, with their size in bytes
+		std::vector<std::pair<std::string, uint32_t>> static_arrays;
+		uint32_t static_counter; // To name the static arrays of the current function
+		bool has_bounds_check; // If the current function needs its trap (see get_bounds_label)
 		uint32_t num_labels;
 		uint32_t name_counter; // To generate unique names
+		uint32_t frame_size; // Stack space the variables of the current function need
+		uint32_t pushed_bytes; // Bytes pushed since the stack frame was set up, to keep the stack aligned at calls
+		uint32_t scratch_depth; // Scratch registers of the target that hold left operands (see assemble_rhs_into_ecx)
+		FunctionDefST* current_function;
+		bool has_tail_loop; // If the current function calls itself in tail position (see assemble_tail_call)
+		// Where a return in a void block inside of a value (like the arms of ?(c) { <- 1 } : { <- 2 }) goes: out of the
+		// function, or to the end of the closest block with a type. Set by assemble_code_block for what it contains
+		bool value_can_return = true;
+		const char* value_return_label = NULL;
+		bool dry_run; // Set while only counting instructions, so nothing is reported twice
+		// Arms that hardly run are assembled into cold_blocks, which go behind the function into .text.unlikely
+		std::vector<AssemblyInstruction*> cold_blocks;
+		uint32_t cold_depth; // Inside of a cold block, everything is cold
+		uint32_t loop_depth; // Inside of a loop body, branch targets are hot
+		std::set<std::string> hot_targets; // Labels worth aligning if they are only reached by jumps
 
 		uint32_t get_stack_offset_by_var_name(std::string name) {
 			for (Variable v : glob_vars) {
@@ -52,6 +98,43 @@ namespace Bonfire {
 			return get_type_size(get_type_by_var_name(name));
 		}
 
+		// The latest array with the name. An array declared again (in a loop or another block) can have another length
+		const ArrayVariable& get_array(const std::string& name) {
+			for (size_t i = glob_arrays.size(); i > 0; i--) {
+				if (!glob_arrays[i - 1].name.compare(name)) return glob_arrays[i - 1];
+			}
+			throw std::out_of_range("Unknown array " + name);
+		}
+
+		// Pointers and the lengths of slices are kept in variables of the size of a pointer
+		Type get_pointer_type() {
+			return target->pointer_size == 8 ? Type::UINT64 : Type::UINT32;
+		}
+
+		// Symbol of a function. The assembler reads some names as a register or an operator in Intel syntax ("call ax"
+		// would call through ax), those get an underscore in front. Identifiers can't start with one
+		std::string get_function_symbol(const std::string& name) {
+			static const std::set<std::string> reserved = {
+				"al", "ah", "ax", "eax", "rax", "bl", "bh", "bx", "ebx", "rbx", "cl", "ch", "cx", "ecx", "rcx", "dl", "dh", "dx", "edx", "rdx",
+				"sil", "si", "esi", "rsi", "dil", "di", "edi", "rdi", "spl", "sp", "esp", "rsp", "bpl", "bp", "ebp", "rbp", "ip", "eip", "rip",
+				"cs", "ds", "es", "fs", "gs", "ss", "st",
+				"byte", "word", "dword", "fword", "qword", "tbyte", "oword", "xmmword", "ymmword", "zmmword", "ptr", "offset", "flat",
+				"short", "near", "far", "and", "or", "xor", "not", "mod", "shl", "shr", "eq", "ne", "lt", "le", "gt", "ge"
+			};
+			std::string lower = name;
+			for (char& c : lower) c = tolower(c);
+			if (reserved.count(lower)) return "_" + name;
+			// Numbered registers: r8 to r15 (also with b, w, d or l), st0, mm0, xmm0, ymm0, zmm0, k0, cr0, dr0, tr0 and bnd0
+			static const std::string numbered[] = { "r", "st", "mm", "xmm", "ymm", "zmm", "k", "cr", "dr", "tr", "bnd" };
+			for (const std::string& prefix : numbered) {
+				if (lower.compare(0, prefix.size(), prefix) || lower.size() == prefix.size() || !isdigit(lower[prefix.size()])) continue;
+				size_t end = prefix.size();
+				while (end < lower.size() && isdigit(lower[end])) end++;
+				if (end == lower.size() || (prefix == "r" && end + 1 == lower.size() && strchr("bwdl", lower[end]))) return "_" + name;
+			}
+			return name;
+		}
+
 		std::string get_asm_size(Type t) {
 			switch (t) {
 			case Type::UINT8: case Type::INT8: return ASM_SIZE_8;
@@ -72,162 +155,1370 @@ namespace Bonfire {
 			return "ERR";
 		}
 
+		// Name of the accumulator register for a value of the given size
+		std::string get_acc_register(uint8_t size) {
+			return get_register_name(Register::A, size);
+		}
+
+		// Size of the registers a value of the given type is calculated in
+		uint8_t get_register_size(Type t) {
+			return Bonfire::get_register_size(get_type_size(t));
+		}
+
+		// Reserves stack space for a variable and returns its offset from the frame pointer
+		// The offset is a multiple of the size, so the variable is aligned
+		uint32_t reserve_stack(uint32_t& stack_offset, uint8_t size) {
+			stack_offset = (stack_offset + size + size - 1) / size * size;
+			if (stack_offset > frame_size) frame_size = stack_offset;
+			return stack_offset;
+		}
+
+		// Type of the value an expression produces. Variables have the type they were declared with
+		Type get_value_type(ExpressionST* expression) {
+			switch (expression->type) {
+			case AstType::VAR_VALUE:
+				return get_type_by_var_name(static_cast<VariableValST*>(expression)->identifier);
+			case AstType::OPERATION:
+			{
+				OperationST* op_st = static_cast<OperationST*>(expression);
+				return get_op_result_type(op_st->op, get_value_type(op_st->lhs), get_value_type(op_st->rhs));
+			}
+			case AstType::INDEX:
+				return static_cast<IndexST*>(expression)->element_type;
+			case AstType::LENGTH:
+				return Type::UINT32;
+			default:
+				return expression->return_type;
+			}
+		}
+
+		// Type two values are compared in. Constants take the type of the other side
+		Type get_compare_type(ExpressionST* lhs, ExpressionST* rhs) {
+			if (lhs->type == AstType::CONSTANT) return get_value_type(rhs);
+			if (rhs->type == AstType::CONSTANT) return get_value_type(lhs);
+			return get_type_for_op(get_value_type(lhs), get_value_type(rhs));
+		}
+
+		// Instructions only take 32-bit constants, even with 64-bit registers (except mov reg, const)
+		bool fits_immediate(const std::string& constant, uint8_t size) {
+			if (size != 8) return true;
+			int64_t value = strtoll(constant.c_str(), NULL, 10);
+			return value >= INT32_MIN && value <= INT32_MAX;
+		}
+
+		// If a constant is a value of the given type, e.g. 200 isn't an i8
+		bool fits_type(const std::string& constant, Type t) {
+			int64_t value = strtoll(constant.c_str(), NULL, 10);
+			if (get_type_size(t) == 8) return fits_immediate(constant, 8);
+			return Optimizer::wrap_to_type(value, t) == value;
+		}
+
+		// Operands that can be used by an instruction on registers of the given size directly, without loading them into a register first
+		bool is_simple_operand(ExpressionST* expression, uint8_t size) {
+			if (expression->type == AstType::CONSTANT) return fits_immediate(static_cast<ConstantST*>(expression)->constant, size);
+			return expression->type == AstType::VAR_VALUE && get_size_by_var_name(static_cast<VariableValST*>(expression)->identifier) == size;
+		}
+
+		// The instructions from first on that don't have a line yet were generated for a statement on the given line.
+		// Statements inside of it are done first, so they keep their own lines
+		void set_line(std::vector<AssemblyInstruction*>& instructions, size_t first, uint32_t line) {
+			for (size_t i = first; i < instructions.size(); i++) {
+				if (!instructions[i]->line) instructions[i]->line = line;
+			}
+		}
+
 		void assemble_expression(std::vector<AssemblyInstruction*>& instructions, ExpressionST* expression, uint32_t& stack_offset, bool can_return, const char* code_block_label);
 		void assemble_expression(std::vector<AssemblyInstruction*>& instructions, ExpressionST* expression, uint32_t& stack_offset) {
 			assemble_expression(instructions, expression, stack_offset, false, NULL);
 		}
 		void assemble_expression_stres(std::vector<AssemblyInstruction*>& instructions, ExpressionST* expression, uint32_t& stack_offset);
+		void assemble_store_constant(std::vector<AssemblyInstruction*>& instructions, uint8_t size, uint32_t var_stack_offset, const std::string& constant);
+
+		AsmType get_jump_type(Operation op, bool is_unsigned) {
+			switch (op) {
+			case Operation::EQ:		return AsmType::JUMP_EQ;
+			case Operation::NEQ:	return AsmType::JUMP_NEQ;
+			case Operation::LT:		return is_unsigned ? AsmType::JUMP_B : AsmType::JUMP_LT;
+			case Operation::LTE:	return is_unsigned ? AsmType::JUMP_BE : AsmType::JUMP_LTE;
+			case Operation::GT:		return is_unsigned ? AsmType::JUMP_A : AsmType::JUMP_GT;
+			case Operation::GTE:	return is_unsigned ? AsmType::JUMP_AE : AsmType::JUMP_GTE;
+			default: return AsmType::JUMP;
+			}
+		}
 
-		// Assemble a simple comparison
-		void assemble_compare_by_op(std::vector<AssemblyInstruction*>& instructions, OperationST* op_st, uint32_t& stack_offset) {
-			if (op_st->lhs->type == AstType::VAR_VALUE && op_st->rhs->type == AstType::VAR_VALUE) {
-				// Compare two variables
-				VariableValST* lhs = static_cast<VariableValST*>(op_st->lhs);
-				VariableValST* rhs = static_cast<VariableValST*>(op_st->rhs);
+		// Loads a variable into a whole register (reg_size is 4 or 8). Smaller variables are zero or sign extended by their type,
+		// so no part of the register keeps an older value. Calculations are done on the whole register, values are only cut at stores
+		void assemble_load_memory(std::vector<AssemblyInstruction*>& instructions, Register reg, uint8_t reg_size, Type t, uint32_t offset) {
+			uint8_t size = get_type_size(t);
+			if (size >= reg_size) {
+				// A bigger variable is cut to its lower bytes
+				instructions.push_back(new Asm3<std::string, std::string, uint32_t>(AsmType::MOVE_REG_MEM, get_register_name(reg, reg_size), get_asm_size(reg_size), offset));
+			}
+			else if (size == 4 && !is_signed_integer_type(t)) {
+				// Writing the 32-bit register clears the upper half
+				instructions.push_back(new Asm3<std::string, std::string, uint32_t>(AsmType::MOVE_REG_MEM, get_register_name(reg, 4), get_asm_size(size), offset));
+			}
+			else {
+				AsmType load = is_signed_integer_type(t) ? AsmType::MOVESX_REG_MEM : AsmType::MOVEZX_REG_MEM;
+				instructions.push_back(new Asm3<std::string, std::string, uint32_t>(load, get_register_name(reg, reg_size), get_asm_size(size), offset));
+			}
+		}
 
-				uint32_t lhs_stack_offset = get_stack_offset_by_var_name(lhs->identifier);
-				std::string lhs_asm_size = get_asm_size(lhs->return_type);
-				uint32_t rhs_stack_offset = get_stack_offset_by_var_name(rhs->identifier);
-				std::string rhs_asm_size = get_asm_size(lhs->return_type);
+		void assemble_load_variable(std::vector<AssemblyInstruction*>& instructions, Register reg, uint8_t reg_size, const std::string& name) {
+			assemble_load_memory(instructions, reg, reg_size, get_type_by_var_name(name), get_stack_offset_by_var_name(name));
+		}
 
-				// Compare lhs and rhs (Stores lhs in ebx)
-				//stream << string_format(ASM_FORMAT_CMP_MEM_MEM, lhs_asm_size.c_str(), lhs_stack_offset, rhs_asm_size.c_str(), rhs_stack_offset);
-				instructions.push_back(new Asm4<std::string, uint32_t, std::string, uint32_t>(AsmType::COMP_MEM_MEM, lhs_asm_size, lhs_stack_offset, rhs_asm_size, rhs_stack_offset));
+		// Loads a simple operand (see is_simple_operand) into a register of the given size (4 or 8)
+		void assemble_load_operand(std::vector<AssemblyInstruction*>& instructions, ExpressionST* operand, Register reg, uint8_t size) {
+			if (operand->type == AstType::CONSTANT) {
+				instructions.push_back(new Asm2<std::string, std::string>(AsmType::MOVE_REG_CONST, get_register_name(reg, size), static_cast<ConstantST*>(operand)->constant));
+			}
+			else {
+				assemble_load_variable(instructions, reg, size, static_cast<VariableValST*>(operand)->identifier);
 			}
-			else if (op_st->lhs->type == AstType::VAR_VALUE && op_st->rhs->type == AstType::CONSTANT) {
-				// Compare a variable and a constant
-				VariableValST* lhs = static_cast<VariableValST*>(op_st->lhs);
-				ConstantST* rhs = static_cast<ConstantST*>(op_st->rhs);
+		}
 
-				uint32_t lhs_stack_offset = get_stack_offset_by_var_name(lhs->identifier);
-				std::string lhs_asm_size = get_asm_size(lhs->return_type);
+		// Calculates an operand of an operation that is done in registers of the given size into eax (rax).
+		// A signed 32-bit value in a 64-bit operation has to be sign extended, 32-bit results already clear the upper half
+		void assemble_operand_stres(std::vector<AssemblyInstruction*>& instructions, ExpressionST* operand, uint32_t& stack_offset, uint8_t size) {
+			if (operand->type == AstType::VAR_VALUE) {
+				assemble_load_variable(instructions, Register::A, size, static_cast<VariableValST*>(operand)->identifier);
+				return;
+			}
+			assemble_expression_stres(instructions, operand, stack_offset);
+			Type t = get_value_type(operand);
+			if (size == 8 && get_register_size(t) == 4 && !is_unsigned_integer_type(t)) {
+				instructions.push_back(new Asm2<std::string, std::string>(AsmType::MOVESXD_REG_REG, "rax", "eax"));
+			}
+		}
+
+		void assemble_push(std::vector<AssemblyInstruction*>& instructions, Register reg) {
+			instructions.push_back(new Asm1<std::string>(AsmType::PUSH_REG, get_register_name(reg)));
+			pushed_bytes += target->pointer_size;
+		}
+
+		void assemble_pop(std::vector<AssemblyInstruction*>& instructions, Register reg) {
+			instructions.push_back(new Asm1<std::string>(AsmType::POP_REG, get_register_name(reg)));
+			pushed_bytes -= target->pointer_size;
+		}
+
+		// Puts the value of rhs into ecx (rcx for 64-bit values), keeping the value in eax
+		void assemble_rhs_into_ecx(std::vector<AssemblyInstruction*>& instructions, ExpressionST* rhs, uint32_t& stack_offset, uint8_t size) {
+			if (rhs->type == AstType::CONSTANT || rhs->type == AstType::VAR_VALUE) {
+				assemble_load_operand(instructions, rhs, Register::C, size);
+				return;
+			}
+			// eax waits in a scratch register while rhs is calculated, unless they are all taken or rhs calls a function
+			bool calls = false;
+			if (scratch_depth < target->scratch_registers.size()) Optimizer::for_each_call(rhs, [&](FunctionCallST*) { calls = true; });
+			if (scratch_depth < target->scratch_registers.size() && !calls) {
+				Register scratch = target->scratch_registers[scratch_depth];
+				instructions.push_back(new Asm2<std::string, std::string>(AsmType::MOVE_REG_REG, get_register_name(scratch, size), get_register_name(Register::A, size)));
+				++scratch_depth;
+				assemble_operand_stres(instructions, rhs, stack_offset, size);
+				--scratch_depth;
+				instructions.push_back(new Asm2<std::string, std::string>(AsmType::MOVE_REG_REG, get_register_name(Register::C, size), get_register_name(Register::A, size)));
+				instructions.push_back(new Asm2<std::string, std::string>(AsmType::MOVE_REG_REG, get_register_name(Register::A, size), get_register_name(scratch, size)));
+				return;
+			}
+			assemble_push(instructions, Register::A);
+			assemble_operand_stres(instructions, rhs, stack_offset, size);
+			instructions.push_back(new Asm2<std::string, std::string>(AsmType::MOVE_REG_REG, get_register_name(Register::C, size), get_register_name(Register::A, size)));
+			assemble_pop(instructions, Register::A);
+		}
 
-				//stream << string_format(ASM_FORMAT_CMP_MEM_CONST, lhs_asm_size.c_str(), lhs_stack_offset, rhs->constant.c_str());
-				instructions.push_back(new Asm3<std::string, uint32_t, std::string>(AsmType::COMP_MEM_CONST, lhs_asm_size, lhs_stack_offset, rhs->constant));
+		// Compares lhs and rhs of a comparison. Returns the comparison the flags have to be checked for,
+		// which is mirrored if the operands had to be swapped
+		Operation assemble_compare(std::vector<AssemblyInstruction*>& instructions, OperationST* op_st, uint32_t& stack_offset) {
+			ExpressionST* lhs = op_st->lhs;
+			ExpressionST* rhs = op_st->rhs;
+			if (lhs->type == AstType::CONSTANT && rhs->type == AstType::VAR_VALUE) {
+				// There is no cmp const, mem: swap the operands
+				std::swap(lhs, rhs);
 			}
-			else if (op_st->lhs->type == AstType::CONSTANT && op_st->rhs->type == AstType::VAR_VALUE) {
-				// Compare a variable and a constant
-				ConstantST* lhs = static_cast<ConstantST*>(op_st->lhs);
-				VariableValST* rhs = static_cast<VariableValST*>(op_st->rhs);
-				std::string rhs_asm_size = get_asm_size(rhs->return_type);
+			Operation op = lhs == op_st->lhs ? op_st->op : mirror_comparison(op_st->op);
+			uint8_t size = get_register_size(get_compare_type(lhs, rhs));
+			std::string reg = get_register_name(Register::A, size);
 
-				uint32_t rhs_stack_offset = get_stack_offset_by_var_name(rhs->identifier);
+			// The variable is compared at its own size, so only with constants its type can hold
+			if (lhs->type == AstType::VAR_VALUE && rhs->type == AstType::CONSTANT && fits_type(static_cast<ConstantST*>(rhs)->constant, get_type_by_var_name(static_cast<VariableValST*>(lhs)->identifier))) {
+				VariableValST* var_st = static_cast<VariableValST*>(lhs);
+				instructions.push_back(new Asm3<std::string, uint32_t, std::string>(AsmType::COMP_MEM_CONST, get_asm_size(get_type_by_var_name(var_st->identifier)),
+					get_stack_offset_by_var_name(var_st->identifier), static_cast<ConstantST*>(rhs)->constant));
+				return op;
+			}
 
-				//stream << string_format(ASM_FORMAT_CMP_CONST_MEM, lhs->constant.c_str(), rhs_asm_size.c_str(), rhs_stack_offset);
-				instructions.push_back(new Asm3<std::string, std::string, uint32_t>(AsmType::COMP_CONST_MEM, lhs->constant, rhs_asm_size, rhs_stack_offset));
+			assemble_operand_stres(instructions, lhs, stack_offset, size);
+			if (is_simple_operand(rhs, size) && rhs->type == AstType::CONSTANT) {
+				instructions.push_back(new Asm2<std::string, std::string>(AsmType::COMP_REG_CONST, reg, static_cast<ConstantST*>(rhs)->constant));
+			}
+			else if (is_simple_operand(rhs, size)) {
+				VariableValST* var_st = static_cast<VariableValST*>(rhs);
+				instructions.push_back(new Asm3<std::string, std::string, uint32_t>(AsmType::COMP_REG_MEM, reg, get_asm_size(size), get_stack_offset_by_var_name(var_st->identifier)));
 			}
 			else {
-				assemble_expression_stres(instructions, op_st->lhs, stack_offset);
-				// Return value of expression is stored in eax, move it to ebx
-				//stream << string_format(ASM_FORMAT_MOVE_REG_REG, "ebx", "eax");
-				instructions.push_back(new Asm2<std::string, std::string>(AsmType::MOVE_REG_REG, "ebx", "eax"));
-				assemble_expression_stres(instructions, op_st->rhs, stack_offset);
-				// Compare the result of the lhs (now in ebx) and the result of rhs (in eax)
-				//stream << string_format(ASM_FORMAT_CMP_REG_REG, "ebx", "eax");
-				instructions.push_back(new Asm2<std::string, std::string>(AsmType::COMP_REG_REG, "ebx", "eax"));
+				assemble_rhs_into_ecx(instructions, rhs, stack_offset, size);
+				instructions.push_back(new Asm2<std::string, std::string>(AsmType::COMP_REG_REG, reg, get_register_name(Register::C, size)));
+			}
+			return op;
+		}
+
+		// Comparisons and lazy operations produce 1 or 0
+		bool is_boolean_operation(ExpressionST* expression) {
+			if (expression->type != AstType::OPERATION) return false;
+			Operation op = static_cast<OperationST*>(expression)->op;
+			return is_comparison(op) || op == Operation::ANDL || op == Operation::ORL;
+		}
+
+		// Only a boolean operation compared with 0 or 1 can be turned into a jump on the operation itself
+		bool is_boolean_constant(ExpressionST* expression) {
+			if (expression->type != AstType::CONSTANT) return false;
+			const std::string& constant = static_cast<ConstantST*>(expression)->constant;
+			return !constant.compare("0") || !constant.compare("1");
+		}
+
+		// Conditions that can be checked with a single compare: variables and comparisons
+		bool is_flag_condition(ExpressionST* condition) {
+			return condition->type == AstType::VAR_VALUE || (condition->type == AstType::OPERATION && is_comparison(static_cast<OperationST*>(condition)->op));
+		}
+
+		// Sets the flags for a condition (see is_flag_condition). Returns the conditional jump that is taken if the condition is true
+		AsmType assemble_condition_flags(std::vector<AssemblyInstruction*>& instructions, ExpressionST* condition, uint32_t& stack_offset) {
+			if (condition->type == AstType::VAR_VALUE) {
+				// Compare with 0 (false)
+				VariableValST* var_st = static_cast<VariableValST*>(condition);
+				instructions.push_back(new Asm3<std::string, uint32_t, std::string>(AsmType::COMP_MEM_CONST, get_asm_size(get_type_by_var_name(var_st->identifier)),
+					get_stack_offset_by_var_name(var_st->identifier), "0"));
+				return AsmType::JUMP_NEQ;
+			}
+			OperationST* op_st = static_cast<OperationST*>(condition);
+			bool is_unsigned = is_unsigned_integer_type(get_compare_type(op_st->lhs, op_st->rhs));
+			return get_jump_type(assemble_compare(instructions, op_st, stack_offset), is_unsigned);
+		}
+
+		// Emits a jump to label that is taken if the condition is true (jump_if_true) or false (!jump_if_true)
+		// Otherwise the code falls through
+		void assemble_condition_jump(std::vector<AssemblyInstruction*>& instructions, ExpressionST* condition, uint32_t& stack_offset, const std::string& label, bool jump_if_true) {
+			if (condition->type == AstType::CONSTANT) {
+				bool value = strtoll(static_cast<ConstantST*>(condition)->constant.c_str(), NULL, 10) != 0;
+				if (value == jump_if_true) instructions.push_back(new Asm1<std::string>(AsmType::JUMP, label));
+				return;
+			}
+			if (condition->type == AstType::OPERATION) {
+				OperationST* op_st = static_cast<OperationST*>(condition);
+				if (op_st->op == Operation::ANDL || op_st->op == Operation::ORL) {
+					// The value of lhs that decides the result on its own (false for &&, true for ||)
+					bool lhs_decides = op_st->op == Operation::ORL;
+					if (lhs_decides == jump_if_true) {
+						// If lhs decides, we jump. Otherwise rhs decides
+						assemble_condition_jump(instructions, op_st->lhs, stack_offset, label, jump_if_true);
+						assemble_condition_jump(instructions, op_st->rhs, stack_offset, label, jump_if_true);
+					}
+					else {
+						// If lhs decides, we don't jump, so rhs has to be skipped
+						std::string skip_label_name = "__skip" + std::to_string(name_counter);
+						++name_counter;
+						assemble_condition_jump(instructions, op_st->lhs, stack_offset, skip_label_name, lhs_decides);
+						assemble_condition_jump(instructions, op_st->rhs, stack_offset, label, jump_if_true);
+						instructions.push_back(new Asm1<std::string>(AsmType::LABEL, skip_label_name));
+					}
+					return;
+				}
+				bool boolean_lhs = is_boolean_constant(op_st->lhs) && is_boolean_operation(op_st->rhs);
+				bool boolean_rhs = is_boolean_operation(op_st->lhs) && is_boolean_constant(op_st->rhs);
+				if ((op_st->op == Operation::EQ || op_st->op == Operation::NEQ) && (boolean_lhs || boolean_rhs)) {
+					// (a < b) == 0 and the like: Jump on the inner condition directly instead of calculating its value
+					ExpressionST* constant = boolean_lhs ? op_st->lhs : op_st->rhs;
+					ExpressionST* inner = boolean_lhs ? op_st->rhs : op_st->lhs;
+					bool constant_value = static_cast<ConstantST*>(constant)->constant.compare("0") != 0;
+					// inner == true and inner != false jump when inner is true
+					bool same_sense = constant_value == (op_st->op == Operation::EQ);
+					assemble_condition_jump(instructions, inner, stack_offset, label, same_sense ? jump_if_true : !jump_if_true);
+					return;
+				}
 			}
+			if (is_flag_condition(condition)) {
+				AsmType jump = assemble_condition_flags(instructions, condition, stack_offset);
+				instructions.push_back(new Asm1<std::string>(jump_if_true ? jump : invert_jump(jump), label));
+				return;
+			}
+			// Anything else: calculate the value and compare it with 0
+			assemble_expression_stres(instructions, condition, stack_offset);
+			std::string reg = get_register_name(Register::A, get_register_size(get_value_type(condition)));
+			instructions.push_back(new Asm2<std::string, std::string>(AsmType::TEST_REG_REG, reg, reg));
+			instructions.push_back(new Asm1<std::string>(jump_if_true ? AsmType::JUMP_NEQ : AsmType::JUMP_EQ, label));
+		}
+
+		// Assemble a condition as a value (1 or 0) in eax
+		void assemble_condition_value(std::vector<AssemblyInstruction*>& instructions, ExpressionST* condition, uint32_t& stack_offset) {
+			std::string false_label_name = "__false" + std::to_string(name_counter);
+			std::string end_label_name = "__cond_end" + std::to_string(name_counter);
+			++name_counter;
+
+			assemble_condition_jump(instructions, condition, stack_offset, false_label_name, false);
+			instructions.push_back(new Asm2<std::string, std::string>(AsmType::MOVE_REG_CONST, "eax", "1"));
+			instructions.push_back(new Asm1<std::string>(AsmType::JUMP, end_label_name));
+			instructions.push_back(new Asm1<std::string>(AsmType::LABEL, false_label_name));
+			instructions.push_back(new Asm2<std::string, std::string>(AsmType::MOVE_REG_CONST, "eax", "0"));
+			instructions.push_back(new Asm1<std::string>(AsmType::LABEL, end_label_name));
 		}
 
+		// Assemble an operation and store the result in eax (rax for 64-bit values)
+		void assemble_operation_stres(std::vector<AssemblyInstruction*>& instructions, OperationST* op_st, uint32_t& stack_offset) {
+			uint8_t size = get_register_size(get_compare_type(op_st->lhs, op_st->rhs));
+			std::string acc = get_register_name(Register::A, size);
+			std::string rcx = get_register_name(Register::C, size);
+			std::string rdx = get_register_name(Register::D, size);
+			AsmType reg_reg, reg_mem, reg_const;
+			switch (op_st->op) {
+			case Operation::ADD:
+				reg_reg = AsmType::ADD_REG_REG; reg_mem = AsmType::ADD_REG_MEM; reg_const = AsmType::ADD_REG_CONST;
+				break;
+			case Operation::SUB:
+				reg_reg = AsmType::SUB_REG_REG; reg_mem = AsmType::SUB_REG_MEM; reg_const = AsmType::SUB_REG_CONST;
+				break;
+			case Operation::MUL:
+				reg_reg = AsmType::IMUL_REG_REG; reg_mem = AsmType::IMUL_REG_MEM; reg_const = AsmType::IMUL_REG_CONST;
+				break;
+			case Operation::DIV:
+			case Operation::MOD:
+			{
+				// Divides edx:eax by ecx, the quotient ends up in eax and the remainder in edx
+				bool is_unsigned = is_unsigned_integer_type(get_compare_type(op_st->lhs, op_st->rhs));
+				assemble_operand_stres(instructions, op_st->lhs, stack_offset, size);
+				assemble_rhs_into_ecx(instructions, op_st->rhs, stack_offset, size);
+				if (is_unsigned) {
+					// Writing edx clears the upper half of rdx too
+					instructions.push_back(new Asm2<std::string, std::string>(AsmType::XOR_REG_REG, "edx", "edx"));
+					instructions.push_back(new Asm1<std::string>(AsmType::DIV_REG, rcx));
+				}
+				else {
+					instructions.push_back(new AssemblyInstruction(size == 8 ? AsmType::SIGN_EXTEND_ACC_64 : AsmType::SIGN_EXTEND_ACC));
+					instructions.push_back(new Asm1<std::string>(AsmType::IDIV_REG, rcx));
+				}
+				if (op_st->op == Operation::MOD) instructions.push_back(new Asm2<std::string, std::string>(AsmType::MOVE_REG_REG, acc, rdx));
+				return;
+			}
+			case Operation::POW:
+			{
+				// Multiply the base (edx) into eax, ecx times
+				std::string loop_label_name = "__pow_loop" + std::to_string(name_counter);
+				std::string end_label_name = "__pow_end" + std::to_string(name_counter);
+				++name_counter;
+				assemble_operand_stres(instructions, op_st->lhs, stack_offset, size);
+				assemble_rhs_into_ecx(instructions, op_st->rhs, stack_offset, size);
+				instructions.push_back(new Asm2<std::string, std::string>(AsmType::MOVE_REG_REG, rdx, acc));
+				instructions.push_back(new Asm2<std::string, std::string>(AsmType::MOVE_REG_CONST, "eax", "1"));
+				instructions.push_back(new Asm1<std::string>(AsmType::LABEL, loop_label_name));
+				instructions.push_back(new Asm2<std::string, std::string>(AsmType::TEST_REG_REG, rcx, rcx));
+				instructions.push_back(new Asm1<std::string>(AsmType::JUMP_EQ, end_label_name));
+				instructions.push_back(new Asm2<std::string, std::string>(AsmType::IMUL_REG_REG, acc, rdx));
+				instructions.push_back(new Asm2<std::string, std::string>(AsmType::SUB_REG_CONST, rcx, "1"));
+				instructions.push_back(new Asm1<std::string>(AsmType::JUMP, loop_label_name));
+				instructions.push_back(new Asm1<std::string>(AsmType::LABEL, end_label_name));
+				return;
+			}
+			default:
+				if (is_comparison(op_st->op)) {
+					// setcc writes the result of the comparison into al, without a branch
+					AsmType condition = assemble_condition_flags(instructions, op_st, stack_offset);
+					instructions.push_back(new Asm2<AsmType, std::string>(AsmType::SET_COND, condition, "al"));
+					instructions.push_back(new Asm2<std::string, std::string>(AsmType::MOVEZX_REG_REG, "eax", "al"));
+					return;
+				}
+				// Lazy operations
+				assemble_condition_value(instructions, op_st, stack_offset);
+				return;
+			}
+
+			assemble_operand_stres(instructions, op_st->lhs, stack_offset, size);
+			if (is_simple_operand(op_st->rhs, size) && op_st->rhs->type == AstType::CONSTANT) {
+				instructions.push_back(new Asm2<std::string, std::string>(reg_const, acc, static_cast<ConstantST*>(op_st->rhs)->constant));
+			}
+			else if (is_simple_operand(op_st->rhs, size)) {
+				VariableValST* var_st = static_cast<VariableValST*>(op_st->rhs);
+				instructions.push_back(new Asm3<std::string, std::string, uint32_t>(reg_mem, acc, get_asm_size(size), get_stack_offset_by_var_name(var_st->identifier)));
+			}
+			else {
+				assemble_rhs_into_ecx(instructions, op_st->rhs, stack_offset, size);
+				instructions.push_back(new Asm2<std::string, std::string>(reg_reg, acc, rcx));
+			}
+		}
+
+		// Every way out of a function closes its frame, instrumented functions call their exit hook first
+		void assemble_close_frame(std::vector<AssemblyInstruction*>& instructions) {
+			if (Profile::instrument_functions) instructions.push_back(new Asm1<std::string>(AsmType::HOOK, Profile::get_exit_hook(current_function->name)));
+			instructions.push_back(new AssemblyInstruction(AsmType::CLOSE_SF));
+		}
+
+		// Counts the execution of a probe (--profile-generate). counter is the counter of the probe: executions, then arm, ...
+		void assemble_count(std::vector<AssemblyInstruction*>& instructions, AbstractSyntaxTree* node, uint32_t counter) {
+			if (!Profile::generate || node->probe < 0) return;
+			instructions.push_back(new Asm1<uint32_t>(AsmType::COUNT, Profile::probes[node->probe].first_counter + counter));
+		}
+
+		// The profile (--profile-use) says the else arm of an if runs more often than the then arm. It becomes the fall-through
+		bool is_else_hotter(IfST* if_st) {
+			const std::vector<uint64_t>* counts = Profile::get_counts(if_st);
+			if (!if_st->has_else || !counts || (*counts)[0] - (*counts)[1] <= (*counts)[1]) return false;
+			if (!dry_run) Report::add_line("profile", "else arm first in " + Profile::describe(if_st) + ", then arm ran " + std::to_string((*counts)[1]) + " of " + std::to_string((*counts)[0]) + " times");
+			return true;
+		}
+
+		// Loops are aligned unless they are in cold code or the profile says the body hardly runs
+		bool is_loop_cold(LoopST* loop_st) {
+			if (cold_depth) return true;
+			const std::vector<uint64_t>* counts = Profile::get_counts(loop_st);
+			if (!counts || Profile::is_hot((*counts)[1])) return false;
+			if (!dry_run) Report::add_line("profile", "not aligned " + Profile::describe(loop_st) + ", " + std::to_string((*counts)[1]) + " iterations");
+			return true;
+		}
+
+		void assemble_vector_loop(std::vector<AssemblyInstruction*>& instructions, LoopST* loop_st, uint32_t& stack_offset);
+
 		void assemble_loop(std::vector<AssemblyInstruction*>& instructions, ExpressionST* expression, uint32_t& stack_offset, bool can_return, const char* code_block_label) {
 			LoopST* loop_st = static_cast<LoopST*>(expression);
+			// The vector loop goes first, the loop does what it leaves
+			if (loop_st->vector) assemble_vector_loop(instructions, loop_st, stack_offset);
 
-			//bool is_op = loop_st->condition->type == AstType::OPERATION;
-			if (loop_st->condition->type == AstType::VAR_VALUE) {
-				std::string beginning_label_name = "__w_begin" + std::to_string(name_counter);
-				std::string continue_label_name = "__w_continue" + std::to_string(name_counter);
-				++name_counter;
+			std::string beginning_label_name = "__w_begin" + std::to_string(name_counter);
+			std::string continue_label_name = "__w_continue" + std::to_string(name_counter);
+			++name_counter;
 
-				// Set begin label
-				//stream << string_format(ASM_FORMAT_LABEL, beginning_label_name.c_str());
-				instructions.push_back(new Asm1<std::string>(AsmType::LABEL, beginning_label_name));
-				// TODO: Assemble operations and comparisons correctly
+			// The loop is rotated: the condition is checked once before the loop (the guard) and then at the bottom of the body,
+			// so every iteration only takes one conditional jump. A loop without condition only jumps back
+			assemble_count(instructions, loop_st, 0);
+			if (loop_st->condition) {
+				assemble_condition_jump(instructions, loop_st->condition, stack_offset, continue_label_name, false);
+			}
 
-				// TODO: Add things other than variables
-				// This is a variable, compare with 0 (0 = false, so if equals, we jump to else)
-				VariableValST* var_st = static_cast<VariableValST*>(loop_st->condition);
-				uint32_t var_stack_offset = get_stack_offset_by_var_name(var_st->identifier);
-				std::string asm_size = get_asm_size(var_st->return_type);
-				// Compare with 0 (false)
-				//stream << string_format(ASM_FORMAT_CMP_MEM_CONST, asm_size.c_str(), var_stack_offset, "0");
-				instructions.push_back(new Asm3<std::string, uint32_t, std::string>(AsmType::COMP_MEM_CONST, asm_size, var_stack_offset, "0"));
-				// If it is 0 (false) then jump to else
-				//stream << string_format(ASM_FORMAT_JMP_EQ, continue_label_name.c_str());
-				instructions.push_back(new Asm1<std::string>(AsmType::JUMP_EQ, continue_label_name));
-
-				// Loop body
-				assemble_expression(instructions, loop_st->body, stack_offset, can_return, code_block_label);
-				// jump to beginning (loop)
-				//stream << string_format(ASM_FORMAT_JMP, beginning_label_name.c_str());
+			// Set begin label
+			if (!is_loop_cold(loop_st)) instructions.push_back(new Asm1<uint32_t>(AsmType::ALIGN, 4));
+			instructions.push_back(new Asm1<std::string>(AsmType::LABEL, beginning_label_name));
+			assemble_count(instructions, loop_st, 1);
+
+			// Loop body
+			++loop_depth;
+			assemble_expression(instructions, loop_st->body, stack_offset, can_return, code_block_label);
+			--loop_depth;
+
+			// Jump back to the beginning as long as the condition is true
+			if (loop_st->condition) {
+				assemble_condition_jump(instructions, loop_st->condition, stack_offset, beginning_label_name, true);
+			}
+			else {
 				instructions.push_back(new Asm1<std::string>(AsmType::JUMP, beginning_label_name));
-				// continue label
-				//stream << string_format(ASM_FORMAT_LABEL, continue_label_name.c_str());
-				instructions.push_back(new Asm1<std::string>(AsmType::LABEL, continue_label_name));
 			}
+			// continue label
+			instructions.push_back(new Asm1<std::string>(AsmType::LABEL, continue_label_name));
+		}
+
+		// The last statement of an expression is a return
+		bool ends_in_return(ExpressionST* expression) {
+			if (expression->type == AstType::RETURN) return true;
+			if (expression->type != AstType::BLOCK) return false;
+			BlockST* block_st = static_cast<BlockST*>(expression);
+			return block_st->num_children && ends_in_return(block_st->children[block_st->num_children - 1]);
+		}
+
+		enum class ColdArm { NONE, THEN, ELSE };
+
+		// Decides which arm of an if goes out of line. With a profile, an arm that ran less than the hot threshold while the if
+		// itself is hot. Without one, an arm that returns from the function when the other one doesn't (an early return)
+		ColdArm get_cold_arm(IfST* if_st, bool can_return) {
+			if (cold_depth) return ColdArm::NONE;
+			std::string where = "if in " + current_function->name + " at line " + std::to_string(if_st->line);
+			ColdArm arm = ColdArm::NONE;
+			const std::vector<uint64_t>* counts = Profile::get_counts(if_st);
+			if (counts) {
+				uint64_t then_count = (*counts)[1];
+				uint64_t else_count = (*counts)[0] - then_count;
+				if (!Profile::is_hot((*counts)[0])) return ColdArm::NONE;
+				if (!Profile::is_hot(then_count) && (!if_st->has_else || then_count <= else_count)) arm = ColdArm::THEN;
+				else if (if_st->has_else && !Profile::is_hot(else_count)) arm = ColdArm::ELSE;
+				if (arm != ColdArm::NONE && !dry_run) {
+					Report::add_line("layout", std::string(arm == ColdArm::THEN ? "then" : "else") + " arm of " + where + " out of line, ran "
+						+ std::to_string(arm == ColdArm::THEN ? then_count : else_count) + " of " + std::to_string((*counts)[0]) + " times");
+				}
+				return arm;
+			}
+			if (!can_return) return ColdArm::NONE;
+			bool then_returns = ends_in_return(if_st->then_body);
+			bool else_returns = if_st->has_else && ends_in_return(if_st->else_body);
+			if (then_returns && !else_returns) arm = ColdArm::THEN;
+			else if (else_returns && !then_returns) arm = ColdArm::ELSE;
+			if (arm != ColdArm::NONE && !dry_run) {
+				Report::add_line("layout", std::string(arm == ColdArm::THEN ? "then" : "else") + " arm of " + where + " out of line (early return)");
+			}
+			return arm;
+		}
+
+		// Assembles an arm of an if into the cold blocks of the function: its label, the arm and the jump back behind the if.
+		// An arm that returns doesn't need the jump
+		void assemble_cold_arm(IfST* if_st, ExpressionST* arm, const std::string& label, const std::string& continue_label, uint32_t counter,
+			uint32_t& stack_offset, bool can_return, const char* code_block_label) {
+			std::vector<AssemblyInstruction*> cold;
+			++cold_depth;
+			cold.push_back(new Asm1<std::string>(AsmType::LABEL, label));
+			if (counter) assemble_count(cold, if_st, counter);
+			assemble_expression(cold, arm, stack_offset, can_return, code_block_label);
+			if (!(can_return && ends_in_return(arm))) cold.push_back(new Asm1<std::string>(AsmType::JUMP, continue_label));
+			--cold_depth;
+			set_line(cold, 0, if_st->line);
+			cold_blocks.insert(cold_blocks.end(), cold.begin(), cold.end());
+		}
+
+		// A branch target is hot if the profile says its arm is, or without one, if it is inside of a loop
+		void mark_hot_target(IfST* if_st, const std::string& label, bool then_arm) {
+			if (cold_depth) return;
+			const std::vector<uint64_t>* counts = Profile::get_counts(if_st);
+			if (counts ? Profile::is_hot(then_arm ? (*counts)[1] : (*counts)[0] - (*counts)[1]) : loop_depth > 0) hot_targets.insert(label);
 		}
 
 		void assemble_if(std::vector<AssemblyInstruction*>& instructions, ExpressionST* expression, uint32_t& stack_offset, bool can_return, const char* code_block_label) {
 			IfST* if_st = static_cast<IfST*>(expression);
-			bool is_op = if_st->condition->type == AstType::OPERATION;
-			if (is_op || if_st->condition->type == AstType::VAR_VALUE) {
-				std::string else_label_name = "__else" + std::to_string(name_counter);
-				std::string continue_label_name = "__continue" + std::to_string(name_counter);
-				++name_counter;
+			std::string else_label_name = "__else" + std::to_string(name_counter);
+			std::string then_label_name = "__then" + std::to_string(name_counter);
+			std::string continue_label_name = "__continue" + std::to_string(name_counter);
+			++name_counter;
+
+			assemble_count(instructions, if_st, 0);
+			ColdArm cold_arm = get_cold_arm(if_st, can_return);
+			if (cold_arm == ColdArm::THEN) {
+				// The then arm is jumped to, the else arm (if there is one) falls through
+				assemble_condition_jump(instructions, if_st->condition, stack_offset, then_label_name, true);
+				if (if_st->has_else) assemble_expression(instructions, if_st->else_body, stack_offset, can_return, code_block_label);
+				instructions.push_back(new Asm1<std::string>(AsmType::LABEL, continue_label_name));
+				assemble_cold_arm(if_st, if_st->then_body, then_label_name, continue_label_name, 1, stack_offset, can_return, code_block_label);
+				return;
+			}
+			if (cold_arm == ColdArm::ELSE) {
+				assemble_condition_jump(instructions, if_st->condition, stack_offset, else_label_name, false);
+				assemble_count(instructions, if_st, 1);
+				assemble_expression(instructions, if_st->then_body, stack_offset, can_return, code_block_label);
+				instructions.push_back(new Asm1<std::string>(AsmType::LABEL, continue_label_name));
+				assemble_cold_arm(if_st, if_st->else_body, else_label_name, continue_label_name, 0, stack_offset, can_return, code_block_label);
+				return;
+			}
+			if (is_else_hotter(if_st)) {
+				// If the condition is true, jump over the else body
+				assemble_condition_jump(instructions, if_st->condition, stack_offset, then_label_name, true);
+				assemble_expression(instructions, if_st->else_body, stack_offset, can_return, code_block_label);
+				instructions.push_back(new Asm1<std::string>(AsmType::JUMP, continue_label_name));
+				mark_hot_target(if_st, then_label_name, true);
+				instructions.push_back(new Asm1<std::string>(AsmType::LABEL, then_label_name));
+				assemble_count(instructions, if_st, 1);
+				assemble_expression(instructions, if_st->then_body, stack_offset, can_return, code_block_label);
+				instructions.push_back(new Asm1<std::string>(AsmType::LABEL, continue_label_name));
+				return;
+			}
+
+			// If the condition is false, jump over the then body
+			assemble_condition_jump(instructions, if_st->condition, stack_offset, if_st->has_else ? else_label_name : continue_label_name, false);
+
+			assemble_count(instructions, if_st, 1);
+			assemble_expression(instructions, if_st->then_body, stack_offset, can_return, code_block_label);
+			if (if_st->has_else) {
+				// Jump to continue to skip else
+				//stream << string_format(ASM_FORMAT_JMP, continue_label_name.c_str());
+				instructions.push_back(new Asm1<std::string>(AsmType::JUMP, continue_label_name));
+				// Put else label here
+				//stream << string_format(ASM_FORMAT_LABEL, else_label_name.c_str());
+				mark_hot_target(if_st, else_label_name, false);
+				instructions.push_back(new Asm1<std::string>(AsmType::LABEL, else_label_name));
+				assemble_expression(instructions, if_st->else_body, stack_offset, can_return, code_block_label);
+			}
+			// Put continue label here
+			//stream << string_format(ASM_FORMAT_LABEL, continue_label_name.c_str());
+			instructions.push_back(new Asm1<std::string>(AsmType::LABEL, continue_label_name));
+		}
+
+		// A match (??) with at least MATCH_TABLE_MIN_CASES values gets a table if the table has at most MATCH_TABLE_DENSITY
+		// entries per value and at most MATCH_TABLE_MAX_ENTRIES entries. The entries between the values go to the default
+		const uint32_t MATCH_TABLE_MIN_CASES = 4;
+		const uint32_t MATCH_TABLE_DENSITY = 3;
+		const uint64_t MATCH_TABLE_MAX_ENTRIES = 4096;
+
+		// A value as the immediate of an instruction on a register of the given size
+		std::string get_case_constant(int64_t value, uint8_t size) {
+			return std::to_string(size == 8 ? value : (int32_t)value);
+		}
+
+		// Compares the value in eax (rax) with the sorted cases [first, last) by halving them, like a binary search.
+		// Up to three cases are compared one after another
+		void assemble_decision_tree(std::vector<AssemblyInstruction*>& instructions, const std::vector<Optimizer::MatchCase>& cases, size_t first, size_t last,
+			const std::vector<std::string>& arm_labels, const std::string& default_label, uint8_t size, bool is_unsigned) {
+			std::string reg = get_register_name(Register::A, size);
+			if (last - first <= 3) {
+				for (size_t i = first; i < last; i++) {
+					instructions.push_back(new Asm2<std::string, std::string>(AsmType::COMP_REG_CONST, reg, get_case_constant(cases[i].value, size)));
+					instructions.push_back(new Asm1<std::string>(AsmType::JUMP_EQ, arm_labels[cases[i].arm]));
+				}
+				instructions.push_back(new Asm1<std::string>(AsmType::JUMP, default_label));
+				return;
+			}
+			size_t middle = first + (last - first) / 2;
+			std::string upper_label = "__upper" + std::to_string(name_counter);
+			++name_counter;
+			instructions.push_back(new Asm2<std::string, std::string>(AsmType::COMP_REG_CONST, reg, get_case_constant(cases[middle].value, size)));
+			instructions.push_back(new Asm1<std::string>(AsmType::JUMP_EQ, arm_labels[cases[middle].arm]));
+			instructions.push_back(new Asm1<std::string>(is_unsigned ? AsmType::JUMP_A : AsmType::JUMP_GT, upper_label));
+			assemble_decision_tree(instructions, cases, first, middle, arm_labels, default_label, size, is_unsigned);
+			instructions.push_back(new Asm1<std::string>(AsmType::LABEL, upper_label));
+			assemble_decision_tree(instructions, cases, middle + 1, last, arm_labels, default_label, size, is_unsigned);
+		}
+
+		// A match that produces a value and only has constants in its arms loads the value from a table, the entries have
+		// the size of the register the value is in. Returns false if an arm (or the default) isn't a constant that fits
+		bool get_match_values(MatchST* match_st, uint8_t size, std::vector<std::string>& values, std::string& default_value) {
+			auto get_entry = [&](ExpressionST* body, std::string& entry) {
+				int64_t value;
+				if (!body || !Optimizer::get_constant_value(body, value)) return false;
+				value = Optimizer::wrap_to_type(value, match_st->return_type);
+				if (size == 4 && (value < INT32_MIN || value > UINT32_MAX)) return false;
+				entry = std::to_string(value);
+				return true;
+			};
+			if (!get_entry(match_st->default_body, default_value)) return false;
+			for (MatchArm& arm : match_st->arms) {
+				values.push_back("");
+				if (!get_entry(arm.body, values.back())) return false;
+			}
+			return true;
+		}
 
-				if (is_op) {
-					OperationST* op_st = static_cast<OperationST*>(if_st->condition);
-					// Assemble comparison based on the operation
-					assemble_compare_by_op(instructions, op_st, stack_offset);
-					AsmType jump_type = AsmType::JUMP;
-					switch (op_st->op) {
-					case Operation::EQ:
-						jump_type = AsmType::JUMP_NEQ;
-						break;
-					case Operation::NEQ:
-						jump_type = AsmType::JUMP_EQ;
-						break;
-					case Operation::LT:
-						jump_type = AsmType::JUMP_GTE;
-						break;
-					case Operation::LTE:
-						jump_type = AsmType::JUMP_GT;
-						break;
-					case Operation::GT:
-						jump_type = AsmType::JUMP_LTE;
-						break;
-					case Operation::GTE:
-						jump_type = AsmType::JUMP_LT;
-						break;
+		// Matches (??) calculate their value into eax (rax) and pick the arm with one of three strategies:
+		//   lookup table:  every arm is a constant, the result is loaded from a table of them
+		//   jump table:    the values are dense, the value minus the smallest one is the index into a table of the arms
+		//   decision tree: compares that halve the sorted values, for sparse values
+		// The tables check the bounds first, values outside of them go to the default. With store_result, the value of the
+		// arm ends up in eax (rax)
+		void assemble_match(std::vector<AssemblyInstruction*>& instructions, MatchST* match_st, uint32_t& stack_offset, bool store_result, bool can_return, const char* code_block_label) {
+			Type value_type = get_value_type(match_st->value);
+			uint8_t size = get_register_size(value_type);
+			Type compare_type = Optimizer::get_match_type(value_type, size);
+			bool is_unsigned = is_unsigned_integer_type(compare_type);
+			std::vector<Optimizer::MatchCase> cases = Optimizer::get_match_cases(match_st, compare_type);
+			std::string reg = get_register_name(Register::A, size);
+
+			std::string id = std::to_string(name_counter);
+			++name_counter;
+			std::string default_label = "__default" + id;
+			std::string end_label = "__match" + id + "_end";
+			std::string table_label = "__table" + id;
+			std::vector<std::string> arm_labels;
+			for (size_t i = 0; i < match_st->arms.size(); i++) arm_labels.push_back("__case" + id + "_" + std::to_string(i));
+
+			uint64_t entries = cases.empty() ? 0 : (uint64_t)(cases.back().value - cases.front().value) + 1;
+			bool dense = cases.size() >= MATCH_TABLE_MIN_CASES && entries <= MATCH_TABLE_DENSITY * cases.size() && entries <= MATCH_TABLE_MAX_ENTRIES;
+			uint8_t value_size = get_register_size(match_st->return_type);
+			std::vector<std::string> values;
+			std::string default_value;
+			bool lookup = dense && store_result && get_match_values(match_st, value_size, values, default_value);
+			if (!dry_run) {
+				std::string strategy = lookup ? "lookup table" : dense ? "jump table" : "decision tree";
+				Report::add_line("match", "match in " + current_function->name + " at line " + std::to_string(match_st->line) + ": " + strategy + ", "
+					+ std::to_string(cases.size()) + " values" + (dense ? ", " + std::to_string(entries) + " entries" : ""));
+			}
+
+			assemble_operand_stres(instructions, match_st->value, stack_offset, size);
+			if (dense) {
+				// Subtracting the smallest value makes the values below it huge, so one unsigned compare checks both bounds
+				if (cases.front().value) instructions.push_back(new Asm2<std::string, std::string>(AsmType::SUB_REG_CONST, reg, get_case_constant(cases.front().value, size)));
+				instructions.push_back(new Asm2<std::string, std::string>(AsmType::COMP_REG_CONST, reg, std::to_string(entries - 1)));
+				instructions.push_back(new Asm1<std::string>(AsmType::JUMP_A, default_label));
+			}
+			if (lookup) {
+				std::vector<std::string> table(entries, default_value);
+				for (const Optimizer::MatchCase& match_case : cases) table[match_case.value - cases.front().value] = values[match_case.arm];
+				instructions.push_back(new Asm2<std::string, uint8_t>(AsmType::TABLE_LOAD, table_label, value_size));
+				instructions.push_back(new Asm1<std::string>(AsmType::JUMP, end_label));
+				instructions.push_back(new Asm3<std::string, uint8_t, std::vector<std::string>>(AsmType::VALUE_TABLE, table_label, value_size, table));
+				instructions.push_back(new Asm1<std::string>(AsmType::LABEL, default_label));
+				instructions.push_back(new Asm2<std::string, std::string>(AsmType::MOVE_REG_CONST, get_register_name(Register::A, value_size), default_value));
+				instructions.push_back(new Asm1<std::string>(AsmType::LABEL, end_label));
+				return;
+			}
+			if (dense) {
+				std::vector<std::string> table(entries, default_label);
+				for (const Optimizer::MatchCase& match_case : cases) table[match_case.value - cases.front().value] = arm_labels[match_case.arm];
+				instructions.push_back(new Asm1<std::string>(AsmType::TABLE_JUMP, table_label));
+				instructions.push_back(new Asm2<std::string, std::vector<std::string>>(AsmType::JUMP_TABLE, table_label, table));
+			}
+			else assemble_decision_tree(instructions, cases, 0, cases.size(), arm_labels, default_label, size, is_unsigned);
+
+			// The arms, each one jumps to the end. The default is last, so it falls through
+			for (size_t i = 0; i < match_st->arms.size(); i++) {
+				instructions.push_back(new Asm1<std::string>(AsmType::LABEL, arm_labels[i]));
+				if (store_result) assemble_expression_stres(instructions, match_st->arms[i].body, stack_offset);
+				else assemble_expression(instructions, match_st->arms[i].body, stack_offset, can_return, code_block_label);
+				instructions.push_back(new Asm1<std::string>(AsmType::JUMP, end_label));
+			}
+			instructions.push_back(new Asm1<std::string>(AsmType::LABEL, default_label));
+			if (match_st->default_body) {
+				if (store_result) assemble_expression_stres(instructions, match_st->default_body, stack_offset);
+				else assemble_expression(instructions, match_st->default_body, stack_offset, can_return, code_block_label);
+			}
+			instructions.push_back(new Asm1<std::string>(AsmType::LABEL, end_label));
+		}
+
+		// Failed bounds checks jump to the trap of their function, which is a cold block of it
+		std::string get_bounds_label(FunctionDefST* function) {
+			return "__bounds_" + function->name;
+		}
+
+		// Puts an index into a register of the size of a pointer. Signed indices are sign extended, so negative ones become huge
+		// and fail the unsigned bounds checks. Only constants and variables can go into another register than the accumulator
+		void assemble_index(std::vector<AssemblyInstruction*>& instructions, ExpressionST* index, Register reg, uint32_t& stack_offset) {
+			if (index->type == AstType::CONSTANT) {
+				instructions.push_back(new Asm2<std::string, std::string>(AsmType::MOVE_REG_CONST, get_register_name(reg), static_cast<ConstantST*>(index)->constant));
+				return;
+			}
+			if (index->type == AstType::VAR_VALUE) {
+				assemble_load_variable(instructions, reg, target->pointer_size, static_cast<VariableValST*>(index)->identifier);
+				return;
+			}
+			assemble_operand_stres(instructions, index, stack_offset, target->pointer_size);
+		}
+
+		// Jumps to the trap if the value in reg isn't below (or, with inclusive, above) the length of the array
+		void assemble_bounds_check(std::vector<AssemblyInstruction*>& instructions, const ArrayVariable& array, Register reg, bool inclusive) {
+			std::string name = get_register_name(reg);
+			if (array.kind == ArrayKind::SLICE) {
+				instructions.push_back(new Asm3<std::string, std::string, uint32_t>(AsmType::COMP_REG_MEM, name, get_asm_size(target->pointer_size), array.length_offset));
+			}
+			else instructions.push_back(new Asm2<std::string, std::string>(AsmType::COMP_REG_CONST, name, std::to_string(array.length)));
+			instructions.push_back(new Asm1<std::string>(inclusive ? AsmType::JUMP_A : AsmType::JUMP_AE, get_bounds_label(current_function)));
+			has_bounds_check = true;
+		}
+
+		// The base register of the elements of an array: the frame pointer for arrays on the stack, their offset goes into
+		// displacement. Otherwise ecx (rcx), with the address of the first element
+		std::string assemble_array_base(std::vector<AssemblyInstruction*>& instructions, const ArrayVariable& array, uint32_t& displacement) {
+			displacement = 0;
+			std::string rcx = get_register_name(Register::C);
+			switch (array.kind) {
+			case ArrayKind::STACK:
+				displacement = array.stack_offset;
+				return get_register_name(Register::BP);
+			case ArrayKind::STATIC:
+				instructions.push_back(new Asm2<std::string, std::string>(AsmType::STATIC_ADDRESS, rcx, array.symbol));
+				return rcx;
+			default:
+				instructions.push_back(new Asm3<std::string, std::string, uint32_t>(AsmType::MOVE_REG_MEM, rcx, get_asm_size(target->pointer_size), array.stack_offset));
+				return rcx;
+			}
+		}
+
+		// A constant index into an array on the stack that is known to be in bounds: the element is a variable of its own.
+		// Returns false if the element has to be addressed by its index
+		bool get_element_offset(const ArrayVariable& array, ExpressionST* index, uint32_t& offset) {
+			if (array.kind != ArrayKind::STACK || index->type != AstType::CONSTANT) return false;
+			int64_t value = strtoll(static_cast<ConstantST*>(index)->constant.c_str(), NULL, 10);
+			if (value < 0 || value >= array.length) return false;
+			offset = array.stack_offset - (uint32_t)value * get_type_size(array.element_type);
+			return true;
+		}
+
+		// Loads an element of an array into eax (rax), extended by its type like a variable
+		void assemble_index_stres(std::vector<AssemblyInstruction*>& instructions, IndexST* index_st, uint32_t& stack_offset) {
+			const ArrayVariable& array = get_array(index_st->identifier);
+			uint8_t reg_size = get_register_size(index_st->element_type);
+			uint32_t offset;
+			if (get_element_offset(array, index_st->index, offset)) {
+				assemble_load_memory(instructions, Register::A, reg_size, index_st->element_type, offset);
+				return;
+			}
+			assemble_index(instructions, index_st->index, Register::A, stack_offset);
+			if (index_st->checked) assemble_bounds_check(instructions, array, Register::A, false);
+			uint32_t displacement;
+			std::string base = assemble_array_base(instructions, array, displacement);
+			instructions.push_back(new Asm4<std::string, Type, std::string, uint32_t>(AsmType::LOAD_ELEMENT, get_register_name(Register::A, reg_size), index_st->element_type, base, displacement));
+		}
+
+		// a[index] = value. The value is calculated before the index, constants and variables are loaded once the index is known
+		void assemble_index_assignment(std::vector<AssemblyInstruction*>& instructions, IndexAssignST* index_st, uint32_t& stack_offset) {
+			const ArrayVariable& array = get_array(index_st->identifier);
+			uint8_t size = get_type_size(index_st->element_type);
+			uint8_t reg_size = get_register_size(index_st->element_type);
+			ExpressionST* value = index_st->value;
+			bool simple_value = value->type == AstType::CONSTANT || value->type == AstType::VAR_VALUE;
+			uint32_t offset;
+			if (get_element_offset(array, index_st->index, offset)) {
+				if (value->type == AstType::CONSTANT) {
+					assemble_store_constant(instructions, size, offset, static_cast<ConstantST*>(value)->constant);
+					return;
+				}
+				assemble_operand_stres(instructions, value, stack_offset, reg_size);
+				instructions.push_back(new Asm3<std::string, uint32_t, std::string>(AsmType::MOVE_MEM_REG, get_asm_size(size), offset, get_acc_register(size)));
+				return;
+			}
+			if (!simple_value) {
+				assemble_operand_stres(instructions, value, stack_offset, reg_size);
+				if (index_st->index->type == AstType::CONSTANT || index_st->index->type == AstType::VAR_VALUE) {
+					instructions.push_back(new Asm2<std::string, std::string>(AsmType::MOVE_REG_REG, get_register_name(Register::D), get_register_name(Register::A)));
+					assemble_index(instructions, index_st->index, Register::A, stack_offset);
+				}
+				else {
+					assemble_push(instructions, Register::A);
+					assemble_index(instructions, index_st->index, Register::A, stack_offset);
+					assemble_pop(instructions, Register::D);
+				}
+			}
+			else assemble_index(instructions, index_st->index, Register::A, stack_offset);
+			if (index_st->checked) assemble_bounds_check(instructions, array, Register::A, false);
+			uint32_t displacement;
+			std::string base = assemble_array_base(instructions, array, displacement);
+			if (simple_value) assemble_load_operand(instructions, value, Register::D, reg_size);
+			instructions.push_back(new Asm4<std::string, Type, std::string, uint32_t>(AsmType::STORE_ELEMENT, get_register_name(Register::D, size), index_st->element_type, base, displacement));
+		}
+
+		// len(a) into eax
+		void assemble_length_stres(std::vector<AssemblyInstruction*>& instructions, LengthST* length_st) {
+			const ArrayVariable& array = get_array(length_st->identifier);
+			if (array.kind == ArrayKind::SLICE) assemble_load_memory(instructions, Register::A, 4, Type::UINT32, array.length_offset);
+			else instructions.push_back(new Asm2<std::string, std::string>(AsmType::MOVE_REG_CONST, "eax", std::to_string(array.length)));
+		}
+
+		// Puts the address of the first element of an array into reg
+		void assemble_array_address(std::vector<AssemblyInstruction*>& instructions, const ArrayVariable& array, Register reg) {
+			std::string name = get_register_name(reg);
+			switch (array.kind) {
+			case ArrayKind::STACK:
+				instructions.push_back(new Asm2<std::string, uint32_t>(AsmType::LEA_REG_MEM, name, array.stack_offset));
+				break;
+			case ArrayKind::STATIC:
+				instructions.push_back(new Asm2<std::string, std::string>(AsmType::STATIC_ADDRESS, name, array.symbol));
+				break;
+			default:
+				instructions.push_back(new Asm3<std::string, std::string, uint32_t>(AsmType::MOVE_REG_MEM, name, get_asm_size(target->pointer_size), array.stack_offset));
+				break;
+			}
+		}
+
+		// Calculates a slice of an array: the address of its first element into ecx (rcx) and its length into eax (rax).
+		// begin is in edx (rdx) while end is checked
+		void assemble_slice(std::vector<AssemblyInstruction*>& instructions, SliceST* slice_st, uint32_t& stack_offset) {
+			ArrayVariable array = get_array(slice_st->identifier);
+			std::string acc = get_register_name(Register::A);
+			std::string rcx = get_register_name(Register::C);
+			std::string rdx = get_register_name(Register::D);
+			bool zero_begin = slice_st->begin->type == AstType::CONSTANT && !static_cast<ConstantST*>(slice_st->begin)->constant.compare("0");
+			if (zero_begin) assemble_index(instructions, slice_st->end, Register::A, stack_offset);
+			else if (slice_st->begin->type == AstType::CONSTANT || slice_st->begin->type == AstType::VAR_VALUE) {
+				assemble_index(instructions, slice_st->end, Register::A, stack_offset);
+				assemble_index(instructions, slice_st->begin, Register::D, stack_offset);
+			}
+			else {
+				assemble_index(instructions, slice_st->begin, Register::A, stack_offset);
+				assemble_push(instructions, Register::A);
+				assemble_index(instructions, slice_st->end, Register::A, stack_offset);
+				assemble_pop(instructions, Register::D);
+			}
+			if (slice_st->checked) {
+				// end <= len(a), then begin <= end. Unsigned, so negative values fail too
+				assemble_bounds_check(instructions, array, Register::A, true);
+				if (!zero_begin) {
+					instructions.push_back(new Asm2<std::string, std::string>(AsmType::COMP_REG_REG, rdx, acc));
+					instructions.push_back(new Asm1<std::string>(AsmType::JUMP_A, get_bounds_label(current_function)));
+				}
+			}
+			if (!zero_begin) instructions.push_back(new Asm2<std::string, std::string>(AsmType::SUB_REG_REG, acc, rdx));
+			assemble_array_address(instructions, array, Register::C);
+			if (zero_begin) return;
+			uint8_t size = get_type_size(slice_st->return_type);
+			if (size > 1) instructions.push_back(new Asm2<std::string, std::string>(AsmType::IMUL_REG_CONST, rdx, std::to_string(size)));
+			instructions.push_back(new Asm2<std::string, std::string>(AsmType::ADD_REG_REG, rcx, rdx));
+		}
+
+		// Reserves stack space for the elements of an array, 16 byte aligned. Returns the offset of the first element
+		uint32_t reserve_array(uint32_t& stack_offset, uint32_t size) {
+			stack_offset = (stack_offset + size + 15) / 16 * 16;
+			if (stack_offset > frame_size) frame_size = stack_offset;
+			return stack_offset;
+		}
+
+		// Arrays up to this size are zeroed with stores, bigger ones with rep stos
+		const uint32_t ARRAY_ZERO_STORES_MAX = 64;
+
+		void assemble_array_declaration(std::vector<AssemblyInstruction*>& instructions, ArrayDeclarationST* array_st, uint32_t& stack_offset) {
+			ArrayVariable array = { array_st->identifier, array_st->element_type, ArrayKind::STACK, array_st->length, 0, 0, "" };
+			uint8_t pointer_size = target->pointer_size;
+			if (array_st->is_slice()) {
+				// The source is looked up before the slice is declared, so a slice can be a slice of itself
+				assemble_slice(instructions, static_cast<SliceST*>(array_st->value), stack_offset);
+				array.kind = ArrayKind::SLICE;
+				array.in_frame = get_array(static_cast<SliceST*>(array_st->value)->identifier).in_frame;
+				array.stack_offset = reserve_stack(stack_offset, pointer_size);
+				array.length_offset = reserve_stack(stack_offset, pointer_size);
+				instructions.push_back(new Asm3<std::string, uint32_t, std::string>(AsmType::MOVE_MEM_REG, get_asm_size(pointer_size), array.stack_offset, get_register_name(Register::C)));
+				instructions.push_back(new Asm3<std::string, uint32_t, std::string>(AsmType::MOVE_MEM_REG, get_asm_size(pointer_size), array.length_offset, get_register_name(Register::A)));
+			}
+			else if (array_st->is_static) {
+				// Zeroed once, when the program is loaded
+				array.kind = ArrayKind::STATIC;
+				array.symbol = "__static_" + current_function->name + "_" + std::to_string(static_counter);
+				++static_counter;
+				if (!dry_run) static_arrays.push_back({ array.symbol, array_st->length * get_type_size(array_st->element_type) });
+			}
+			else {
+				// Zeroed every time the declaration runs, in whole words
+				uint32_t size = (array_st->length * get_type_size(array_st->element_type) + 7) & ~7u;
+				array.stack_offset = reserve_array(stack_offset, size);
+				array.in_frame = true;
+				if (size <= ARRAY_ZERO_STORES_MAX) {
+					for (uint32_t i = 0; i < size; i += pointer_size) {
+						instructions.push_back(new Asm3<std::string, uint32_t, std::string>(AsmType::MOVE_MEM_CONST, get_asm_size(pointer_size), array.stack_offset - i, "0"));
+					}
+				}
+				else instructions.push_back(new Asm2<uint32_t, uint32_t>(AsmType::ZERO_MEM, array.stack_offset, size));
+			}
+			glob_arrays.push_back(array);
+		}
+
+		// Vectorized loops (see Optimizer::vectorize_loops): in front of the loop, a loop that does a vector register of
+		// elements per iteration runs as long as enough of them are left. The loop itself does the rest, or everything if
+		// the counter is negative, the arrays are too short for the bound or overlap
+
+		// The vector registers of a vectorized loop: the accumulators of the reductions first, then the broadcast invariants,
+		// then the temporaries of the calculations
+		struct VectorRegisters {
+			VectorLoop* plan;
+			uint8_t first_invariant;
+			uint8_t first_temporary;
+
+			std::string get(uint8_t number) const {
+				return get_vector_register_name(number, plan->width);
+			}
+		};
+
+		void assemble_vector_op(std::vector<AssemblyInstruction*>& instructions, VectorOp op, Type t, const std::string& destination, const std::string& source) {
+			instructions.push_back(new Asm4<VectorOp, Type, std::string, std::string>(AsmType::VECTOR_OP, op, t, destination, source));
+		}
+
+		void assemble_vector_op_const(std::vector<AssemblyInstruction*>& instructions, VectorOp op, const std::string& destination, const std::string& source, uint32_t value) {
+			instructions.push_back(new Asm4<VectorOp, std::string, std::string, uint32_t>(AsmType::VECTOR_OP_CONST, op, destination, source, value));
+		}
+
+		// Copies eax (rax) into every element of reg
+		void assemble_broadcast(std::vector<AssemblyInstruction*>& instructions, Type t, const std::string& reg) {
+			uint8_t size = get_type_size(t);
+			instructions.push_back(new Asm2<std::string, std::string>(AsmType::VECTOR_FROM_REG, reg, get_register_name(Register::A, get_register_size(t))));
+			if (is_wide_vector_register(reg)) {
+				assemble_vector_op(instructions, VectorOp::BROADCAST, t, reg, reg);
+				return;
+			}
+			// SSE2 copies bytes into words, words into the lower 4 words and dwords into all 4
+			if (size == 8) {
+				assemble_vector_op(instructions, VectorOp::UNPACK_LOW, t, reg, reg);
+				return;
+			}
+			if (size == 1) assemble_vector_op(instructions, VectorOp::UNPACK_LOW, t, reg, reg);
+			if (size <= 2) assemble_vector_op_const(instructions, VectorOp::SHUFFLE_LOW, reg, reg, 0);
+			assemble_vector_op_const(instructions, VectorOp::SHUFFLE, reg, reg, 0);
+		}
+
+		// Loads (VECTOR_LOAD) or stores (VECTOR_STORE) the elements of an array from element eax (rax) on
+		void assemble_vector_access(std::vector<AssemblyInstruction*>& instructions, AsmType type, const ArrayVariable& array, const std::string& reg) {
+			uint32_t displacement;
+			std::string base = assemble_array_base(instructions, array, displacement);
+			instructions.push_back(new Asm4<std::string, Type, std::string, uint32_t>(type, reg, array.element_type, base, displacement));
+		}
+
+		// Calculates the elements of a value from element eax (rax) on. Returns the register they are in, the one of an
+		// invariant or temporary. The registers from temporary on can be used (see Optimizer::get_vector_registers)
+		uint8_t assemble_vector_value(std::vector<AssemblyInstruction*>& instructions, ExpressionST* value, const VectorRegisters& registers, uint8_t temporary) {
+			VectorLoop* plan = registers.plan;
+			auto broadcast = plan->broadcasts.find(value);
+			if (broadcast != plan->broadcasts.end()) return registers.first_invariant + broadcast->second;
+			if (value->type == AstType::INDEX) {
+				assemble_vector_access(instructions, AsmType::VECTOR_LOAD, get_array(static_cast<IndexST*>(value)->identifier), registers.get(temporary));
+				return temporary;
+			}
+			OperationST* op_st = static_cast<OperationST*>(value);
+			ExpressionST* lhs = op_st->lhs;
+			ExpressionST* rhs = op_st->rhs;
+			if (plan->broadcasts.count(lhs) && op_st->op != Operation::SUB) std::swap(lhs, rhs);
+			uint8_t lhs_register = assemble_vector_value(instructions, lhs, registers, temporary);
+			if (lhs_register != temporary) assemble_vector_op(instructions, VectorOp::MOVE, plan->element_type, registers.get(temporary), registers.get(lhs_register));
+			uint8_t rhs_register = assemble_vector_value(instructions, rhs, registers, temporary + 1);
+			VectorOp op = op_st->op == Operation::ADD ? VectorOp::ADD : op_st->op == Operation::SUB ? VectorOp::SUB : VectorOp::MUL;
+			assemble_vector_op(instructions, op, plan->element_type, registers.get(temporary), registers.get(rhs_register));
+			return temporary;
+		}
+
+		// Folds the elements of value into the accumulator. Without an instruction for the minimum or maximum, a comparison
+		// in scratch selects the elements of value that replace those of the accumulator. value is changed
+		void assemble_vector_reduction(std::vector<AssemblyInstruction*>& instructions, VectorReduction reduction, Type t, bool avx2,
+			const std::string& accumulator, const std::string& value, const std::string& scratch) {
+			if (reduction == VectorReduction::ADD || reduction == VectorReduction::SUB) {
+				assemble_vector_op(instructions, VectorOp::ADD, t, accumulator, value);
+				return;
+			}
+			VectorOp op = reduction == VectorReduction::MIN ? VectorOp::MIN : VectorOp::MAX;
+			if (has_vector_min_max(t, avx2)) {
+				assemble_vector_op(instructions, op, t, accumulator, value);
+				return;
+			}
+			// Minimum: accumulator > value, maximum: value > accumulator
+			assemble_vector_op(instructions, VectorOp::MOVE, t, scratch, op == VectorOp::MIN ? accumulator : value);
+			assemble_vector_op(instructions, VectorOp::COMPARE_GT, t, scratch, op == VectorOp::MIN ? value : accumulator);
+			assemble_vector_op(instructions, VectorOp::AND, t, value, scratch);
+			assemble_vector_op(instructions, VectorOp::AND_NOT, t, scratch, accumulator);
+			assemble_vector_op(instructions, VectorOp::OR, t, scratch, value);
+			assemble_vector_op(instructions, VectorOp::MOVE, t, accumulator, scratch);
+		}
+
+		// The bound of a vectorized loop into edx (rdx) and its counter into eax (rax), extended to the size of a pointer
+		void assemble_vector_range(std::vector<AssemblyInstruction*>& instructions, VectorLoop* plan, uint32_t& stack_offset) {
+			if (plan->bound->type == AstType::CONSTANT || plan->bound->type == AstType::VAR_VALUE) assemble_index(instructions, plan->bound, Register::D, stack_offset);
+			else {
+				assemble_index(instructions, plan->bound, Register::A, stack_offset);
+				instructions.push_back(new Asm2<std::string, std::string>(AsmType::MOVE_REG_REG, get_register_name(Register::D), get_register_name(Register::A)));
+			}
+			assemble_load_variable(instructions, Register::A, target->pointer_size, plan->counter);
+		}
+
+		void assemble_vector_loop(std::vector<AssemblyInstruction*>& instructions, LoopST* loop_st, uint32_t& stack_offset) {
+			VectorLoop* plan = loop_st->vector;
+			Type t = plan->element_type;
+			uint8_t size = get_type_size(t);
+			uint8_t reg_size = get_register_size(t);
+			uint32_t elements = plan->width / size;
+			bool avx2 = plan->width == 32;
+			std::string acc = get_register_name(Register::A);
+			std::string rcx = get_register_name(Register::C);
+			std::string rdx = get_register_name(Register::D);
+			std::string loop_label_name = "__v_loop" + std::to_string(name_counter);
+			std::string scalar_label_name = "__v_scalar" + std::to_string(name_counter);
+			++name_counter;
+			Type counter_type = get_type_by_var_name(plan->counter);
+			bool is_signed = is_signed_integer_type(counter_type);
+
+			// Arrays that overlap without being the same: |a - b| < width
+			for (auto& overlap : plan->overlaps) {
+				assemble_array_address(instructions, get_array(overlap.first), Register::A);
+				assemble_array_address(instructions, get_array(overlap.second), Register::C);
+				instructions.push_back(new Asm2<std::string, std::string>(AsmType::SUB_REG_REG, acc, rcx));
+				instructions.push_back(new Asm2<std::string, std::string>(AsmType::ADD_REG_CONST, acc, std::to_string(plan->width - 1)));
+				instructions.push_back(new Asm2<std::string, std::string>(AsmType::COMP_REG_CONST, acc, std::to_string(2 * (plan->width - 1))));
+				instructions.push_back(new Asm1<std::string>(AsmType::JUMP_BE, scalar_label_name));
+			}
+
+			// 0 <= counter, counter + elements <= bound and bound <= len(a) for every array that isn't known to be long enough
+			assemble_vector_range(instructions, plan, stack_offset);
+			if (is_signed) {
+				instructions.push_back(new Asm2<std::string, std::string>(AsmType::COMP_REG_CONST, acc, "0"));
+				instructions.push_back(new Asm1<std::string>(AsmType::JUMP_LT, scalar_label_name));
+			}
+			for (const std::string& name : plan->checked_lengths) {
+				const ArrayVariable& array = get_array(name);
+				if (array.kind == ArrayKind::SLICE) {
+					instructions.push_back(new Asm3<std::string, std::string, uint32_t>(AsmType::COMP_REG_MEM, rdx, get_asm_size(target->pointer_size), array.length_offset));
+				}
+				else instructions.push_back(new Asm2<std::string, std::string>(AsmType::COMP_REG_CONST, rdx, std::to_string(array.length)));
+				instructions.push_back(new Asm1<std::string>(AsmType::JUMP_A, scalar_label_name));
+			}
+			instructions.push_back(new Asm2<std::string, std::string>(AsmType::COMP_REG_REG, rdx, acc));
+			instructions.push_back(new Asm1<std::string>(is_signed ? AsmType::JUMP_LTE : AsmType::JUMP_BE, scalar_label_name));
+			instructions.push_back(new Asm2<std::string, std::string>(AsmType::MOVE_REG_REG, rcx, rdx));
+			instructions.push_back(new Asm2<std::string, std::string>(AsmType::SUB_REG_REG, rcx, acc));
+			instructions.push_back(new Asm2<std::string, std::string>(AsmType::COMP_REG_CONST, rcx, std::to_string(elements)));
+			instructions.push_back(new Asm1<std::string>(AsmType::JUMP_B, scalar_label_name));
+
+			// Sums start at 0 and are added to their variable at the end, minimums and maximums start with their variable
+			uint8_t num_accumulators = 0;
+			for (VectorStatement& statement : plan->statements) {
+				if (statement.reduction != VectorReduction::NONE) ++num_accumulators;
+			}
+			VectorRegisters registers = { plan, num_accumulators, (uint8_t)(num_accumulators + plan->invariants.size()) };
+			uint8_t accumulator = 0;
+			for (VectorStatement& statement : plan->statements) {
+				if (statement.reduction == VectorReduction::NONE) continue;
+				std::string reg = registers.get(accumulator++);
+				if (statement.reduction == VectorReduction::ADD || statement.reduction == VectorReduction::SUB) {
+					assemble_vector_op(instructions, VectorOp::XOR, t, reg, reg);
+					continue;
+				}
+				assemble_load_variable(instructions, Register::A, reg_size, statement.target);
+				assemble_broadcast(instructions, t, reg);
+			}
+			for (size_t i = 0; i < plan->invariants.size(); i++) {
+				ExpressionST* invariant = plan->invariants[i];
+				if (invariant->type == AstType::CONSTANT) {
+					instructions.push_back(new Asm2<std::string, std::string>(AsmType::MOVE_REG_CONST, get_register_name(Register::A, reg_size), static_cast<ConstantST*>(invariant)->constant));
+				}
+				else assemble_operand_stres(instructions, invariant, stack_offset, reg_size);
+				assemble_broadcast(instructions, t, registers.get(registers.first_invariant + i));
+			}
+
+			// The loop runs while counter <= bound - elements. The invariants may have used edx (rdx)
+			assemble_vector_range(instructions, plan, stack_offset);
+			instructions.push_back(new Asm2<std::string, std::string>(AsmType::SUB_REG_CONST, rdx, std::to_string(elements)));
+			if (!cold_depth) instructions.push_back(new Asm1<uint32_t>(AsmType::ALIGN, 4));
+			instructions.push_back(new Asm1<std::string>(AsmType::LABEL, loop_label_name));
+			accumulator = 0;
+			for (VectorStatement& statement : plan->statements) {
+				uint8_t value = assemble_vector_value(instructions, statement.value, registers, registers.first_temporary);
+				if (statement.reduction == VectorReduction::NONE) {
+					assemble_vector_access(instructions, AsmType::VECTOR_STORE, get_array(statement.target), registers.get(value));
+					continue;
+				}
+				assemble_vector_reduction(instructions, statement.reduction, t, avx2, registers.get(accumulator++), registers.get(value), registers.get(registers.first_temporary + 1));
+			}
+			instructions.push_back(new Asm2<std::string, std::string>(AsmType::ADD_REG_CONST, acc, std::to_string(elements)));
+			instructions.push_back(new Asm2<std::string, std::string>(AsmType::COMP_REG_REG, acc, rdx));
+			instructions.push_back(new Asm1<std::string>(AsmType::JUMP_BE, loop_label_name));
+			uint8_t counter_size = get_type_size(counter_type);
+			instructions.push_back(new Asm3<std::string, uint32_t, std::string>(AsmType::MOVE_MEM_REG, get_asm_size(counter_size), get_stack_offset_by_var_name(plan->counter), get_register_name(Register::A, counter_size)));
+
+			// The elements of the accumulators are folded in halves: the upper 16 bytes of ymm registers into the lower ones,
+			// then the upper 8 bytes into the lower 8 and so on, until the first element has the result
+			std::string scratch = registers.get(registers.first_temporary);
+			std::string mask = registers.get(registers.first_temporary + 1);
+			accumulator = 0;
+			for (VectorStatement& statement : plan->statements) {
+				if (statement.reduction == VectorReduction::NONE) continue;
+				std::string reg = registers.get(accumulator++);
+				if (avx2) {
+					assemble_vector_op_const(instructions, VectorOp::EXTRACT_HIGH, scratch, reg, 1);
+					assemble_vector_reduction(instructions, statement.reduction, t, avx2, reg, scratch, mask);
+				}
+				for (uint32_t bytes = 8; bytes >= size; bytes /= 2) {
+					if (avx2) assemble_vector_op_const(instructions, VectorOp::SHIFT_BYTES, scratch, reg, bytes);
+					else {
+						assemble_vector_op(instructions, VectorOp::MOVE, t, scratch, reg);
+						assemble_vector_op_const(instructions, VectorOp::SHIFT_BYTES, scratch, scratch, bytes);
+					}
+					assemble_vector_reduction(instructions, statement.reduction, t, avx2, reg, scratch, mask);
+				}
+				if (statement.reduction == VectorReduction::ADD || statement.reduction == VectorReduction::SUB) {
+					instructions.push_back(new Asm2<std::string, std::string>(AsmType::VECTOR_TO_REG, get_register_name(Register::C, reg_size), reg));
+					assemble_load_variable(instructions, Register::A, reg_size, statement.target);
+					instructions.push_back(new Asm2<std::string, std::string>(statement.reduction == VectorReduction::ADD ? AsmType::ADD_REG_REG : AsmType::SUB_REG_REG,
+						get_register_name(Register::A, reg_size), get_register_name(Register::C, reg_size)));
+				}
+				else instructions.push_back(new Asm2<std::string, std::string>(AsmType::VECTOR_TO_REG, get_register_name(Register::A, reg_size), reg));
+				instructions.push_back(new Asm3<std::string, uint32_t, std::string>(AsmType::MOVE_MEM_REG, get_asm_size(size), get_stack_offset_by_var_name(statement.target), get_register_name(Register::A, size)));
+			}
+			// Code without VEX is slow while the upper halves of the ymm registers are in use
+			if (avx2) instructions.push_back(new AssemblyInstruction(AsmType::VECTOR_ZERO_UPPER));
+			instructions.push_back(new Asm1<std::string>(AsmType::LABEL, scalar_label_name));
+		}
+
+		// Where the parameters of a function are passed. A value takes one slot, a slice two (its pointer, then its length).
+		// The first slots are the argument registers, a slice that doesn't fit into them completely goes onto the stack with
+		// every parameter after it
+		struct ParameterSlots {
+			std::vector<uint32_t> first;	// The first slot of every parameter
+			size_t num_register_parameters;
+			uint32_t num_stack_slots;
+		};
+
+		ParameterSlots get_parameter_slots(FunctionDefST* function) {
+			ParameterSlots slots = { {}, 0, 0 };
+			uint32_t num_registers = target->argument_registers.size();
+			uint32_t slot = 0;
+			for (const ParameterDef& parameter : function->parameters) {
+				uint32_t needed = parameter.slice ? 2 : 1;
+				if (slot < num_registers && slot + needed > num_registers) slot = num_registers;
+				if (slot < num_registers) ++slots.num_register_parameters;
+				slots.first.push_back(slot);
+				slot += needed;
+			}
+			slots.num_stack_slots = slot > num_registers ? slot - num_registers : 0;
+			return slots;
+		}
+
+		// Puts the first num_register_args arguments of a call into the argument registers
+		void assemble_register_arguments(std::vector<AssemblyInstruction*>& instructions, FunctionCallST* call_st, uint32_t& stack_offset, size_t num_register_args) {
+			const std::vector<Register>& registers = target->argument_registers;
+			std::vector<ParameterDef>& parameters = call_st->function->parameters;
+			std::vector<uint32_t> slots = get_parameter_slots(call_st->function).first;
+			auto is_loaded_directly = [&](size_t i) {
+				ExpressionST* argument = call_st->arguments[i];
+				return !parameters[i].slice && (argument->type == AstType::CONSTANT || is_simple_operand(argument, get_register_size(parameters[i].type)));
+			};
+			// Calculating an argument can overwrite the registers, so the arguments that need calculations are kept on the stack until all are done.
+			// Constants and variables are moved into their registers directly
+			std::vector<size_t> calculated;
+			for (size_t i = 0; i < num_register_args; i++) {
+				if (is_loaded_directly(i)) continue;
+				if (parameters[i].slice) {
+					assemble_slice(instructions, static_cast<SliceST*>(call_st->arguments[i]), stack_offset);
+					assemble_push(instructions, Register::A);
+					assemble_push(instructions, Register::C);
+				}
+				else {
+					assemble_expression_stres(instructions, call_st->arguments[i], stack_offset);
+					assemble_push(instructions, Register::A);
+				}
+				calculated.push_back(i);
+			}
+			for (size_t i = calculated.size(); i > 0; i--) {
+				uint32_t slot = slots[calculated[i - 1]];
+				assemble_pop(instructions, registers[slot]);
+				// The pointer of a slice is on top of its length
+				if (parameters[calculated[i - 1]].slice) assemble_pop(instructions, registers[slot + 1]);
+			}
+			for (size_t i = 0; i < num_register_args; i++) {
+				if (is_loaded_directly(i)) assemble_load_operand(instructions, call_st->arguments[i], registers[slots[i]], get_register_size(parameters[i].type));
+			}
+		}
+
+		// Calls a function and leaves its return value in eax
+		// The first arguments go into the argument registers of the target, the others are pushed from right to left (see get_parameter_slots)
+		void assemble_call_stres(std::vector<AssemblyInstruction*>& instructions, FunctionCallST* call_st, uint32_t& stack_offset) {
+			ParameterSlots slots = get_parameter_slots(call_st->function);
+			size_t num_register_args = slots.num_register_parameters;
+			uint32_t stack_args_size = slots.num_stack_slots * target->pointer_size;
+
+			// The stack has to be 16 byte aligned at the call. Below the frame are the return address, the saved frame pointer and the
+			// variables (a multiple of 16)
+			uint32_t padding = (16 - (2 * target->pointer_size + pushed_bytes + stack_args_size) % 16) % 16;
+			assemble_count(instructions, call_st, 0);
+			if (padding) {
+				instructions.push_back(new Asm2<std::string, std::string>(AsmType::SUB_REG_CONST, get_register_name(Register::SP), std::to_string(padding)));
+				pushed_bytes += padding;
+			}
+			for (size_t i = call_st->arguments.size(); i > num_register_args; i--) {
+				if (call_st->function->parameters[i - 1].slice) {
+					// The length is above the pointer
+					assemble_slice(instructions, static_cast<SliceST*>(call_st->arguments[i - 1]), stack_offset);
+					assemble_push(instructions, Register::A);
+					assemble_push(instructions, Register::C);
+					continue;
+				}
+				assemble_expression_stres(instructions, call_st->arguments[i - 1], stack_offset);
+				assemble_push(instructions, Register::A);
+			}
+			assemble_register_arguments(instructions, call_st, stack_offset, num_register_args);
+
+			instructions.push_back(new Asm1<std::string>(AsmType::CALL, get_function_symbol(call_st->function->name)));
+			if (stack_args_size + padding) {
+				instructions.push_back(new Asm2<std::string, std::string>(AsmType::ADD_REG_CONST, get_register_name(Register::SP), std::to_string(stack_args_size + padding)));
+				pushed_bytes -= stack_args_size + padding;
+			}
+		}
+
+		std::string get_tail_loop_label(FunctionDefST* function) {
+			return "__tail_" + function->name;
+		}
+
+		// A call in tail position (<- f(...), returning from the function) doesn't need a frame of its own.
+		// A call of the function itself stores the arguments in the parameters and jumps back to the start of the body, so the recursion
+		// becomes a loop. A call of another function that gets all of its arguments in registers closes the frame and jumps to the function,
+		// which then returns to our caller. Returns false if the call has to be a normal call
+		bool assemble_tail_call(std::vector<AssemblyInstruction*>& instructions, FunctionCallST* call_st, uint32_t& stack_offset) {
+			FunctionDefST* function = call_st->function;
+			// A slice of an array in our frame would point into a frame that is gone (a jump) or declared again (a loop)
+			for (ExpressionST* argument : call_st->arguments) {
+				if (argument->type != AstType::SLICE || !get_array(static_cast<SliceST*>(argument)->identifier).in_frame) continue;
+				if (!dry_run) Report::add_line("tailcalls", "call of " + function->name + " in " + current_function->name + " kept (slice of a local array)");
+				return false;
+			}
+			if (function == current_function) {
+				assemble_count(instructions, call_st, 0);
+				std::vector<ParameterDef>& parameters = function->parameters;
+				// The arguments can read the parameters, so every argument is calculated before the first parameter is overwritten
+				std::vector<size_t> calculated;
+				for (size_t i = 0; i < parameters.size(); i++) {
+					ExpressionST* argument = call_st->arguments[i];
+					if (argument->type == AstType::CONSTANT) continue;
+					// f(n, ...) in f keeps n as it is
+					if (argument->type == AstType::VAR_VALUE && !static_cast<VariableValST*>(argument)->identifier.compare(parameters[i].identifier)) continue;
+					if (!calculated.empty()) assemble_push(instructions, Register::A);
+					if (parameters[i].slice) {
+						// The pointer goes below the length, which stays in the accumulator
+						assemble_slice(instructions, static_cast<SliceST*>(argument), stack_offset);
+						assemble_push(instructions, Register::C);
 					}
-					//stream << string_format(jump_type, if_st->has_else ? else_label_name.c_str() : continue_label_name.c_str());
-					instructions.push_back(new Asm1<std::string>(jump_type, if_st->has_else ? else_label_name : continue_label_name));
+					else assemble_expression_stres(instructions, argument, stack_offset);
+					calculated.push_back(i);
+				}
+				// The last argument is still in the accumulator
+				for (size_t i = calculated.size(); i > 0; i--) {
+					ParameterDef& parameter = parameters[calculated[i - 1]];
+					if (i < calculated.size()) assemble_pop(instructions, Register::A);
+					if (parameter.slice) {
+						const ArrayVariable& array = get_array(parameter.identifier);
+						std::string size = get_asm_size(target->pointer_size);
+						instructions.push_back(new Asm3<std::string, uint32_t, std::string>(AsmType::MOVE_MEM_REG, size, array.length_offset, get_register_name(Register::A)));
+						assemble_pop(instructions, Register::A);
+						instructions.push_back(new Asm3<std::string, uint32_t, std::string>(AsmType::MOVE_MEM_REG, size, array.stack_offset, get_register_name(Register::A)));
+						continue;
+					}
+					uint8_t size = get_type_size(parameter.type);
+					instructions.push_back(new Asm3<std::string, uint32_t, std::string>(AsmType::MOVE_MEM_REG, get_asm_size(size), get_stack_offset_by_var_name(parameter.identifier), get_acc_register(size)));
+				}
+				for (size_t i = 0; i < parameters.size(); i++) {
+					if (call_st->arguments[i]->type != AstType::CONSTANT) continue;
+					assemble_store_constant(instructions, get_type_size(parameters[i].type), get_stack_offset_by_var_name(parameters[i].identifier), static_cast<ConstantST*>(call_st->arguments[i])->constant);
+				}
+				instructions.push_back(new Asm1<std::string>(AsmType::JUMP, get_tail_loop_label(function)));
+				has_tail_loop = true;
+				if (!dry_run) Report::add_line("tailcalls", "self call in " + function->name + " turned into a loop");
+				return true;
+			}
+
+			// Arguments on the stack would have to go where the arguments of our caller are, which may not be big enough
+			if (get_parameter_slots(function).num_register_parameters < call_st->arguments.size()) {
+				if (!dry_run) Report::add_line("tailcalls", "call of " + function->name + " in " + current_function->name + " kept (stack arguments)");
+				return false;
+			}
+			assemble_count(instructions, call_st, 0);
+			assemble_register_arguments(instructions, call_st, stack_offset, call_st->arguments.size());
+			assemble_close_frame(instructions);
+			instructions.push_back(new Asm1<std::string>(AsmType::JUMP, get_function_symbol(function->name)));
+			if (!dry_run) Report::add_line("tailcalls", "tail call of " + function->name + " in " + current_function->name + " turned into a jump");
+			return true;
+		}
+
+		// Assemble an if that produces a value and store the value in eax
+		void assemble_if_stres(std::vector<AssemblyInstruction*>& instructions, IfST* if_st, uint32_t& stack_offset) {
+			uint8_t size = get_register_size(if_st->return_type);
+			// An instrumented if needs its branch to count the then arm
+			if (!Profile::generate && if_st->has_else && is_flag_condition(if_st->condition) && is_simple_operand(if_st->then_body, size) && is_simple_operand(if_st->else_body, size)) {
+				// Both values are cheap to get, so calculate both and select one with cmov instead of branching.
+				// mov doesn't change the flags, so the values can be loaded after the compare
+				AsmType condition = assemble_condition_flags(instructions, if_st->condition, stack_offset);
+				assemble_load_operand(instructions, if_st->else_body, Register::A, size);
+				if (if_st->then_body->type == AstType::VAR_VALUE) {
+					VariableValST* var_st = static_cast<VariableValST*>(if_st->then_body);
+					instructions.push_back(new Asm4<AsmType, std::string, std::string, uint32_t>(AsmType::CMOV_REG_MEM, condition, get_register_name(Register::A, size), get_asm_size(size), get_stack_offset_by_var_name(var_st->identifier)));
 				}
 				else {
-					// This is a variable, compare with 0 (0 = false, so if equals, we jump to else)
-					VariableValST* var_st = static_cast<VariableValST*>(if_st->condition);
-					uint32_t var_stack_offset = get_stack_offset_by_var_name(var_st->identifier);
-					std::string asm_size = get_asm_size(var_st->return_type);
-					// Compare with 0 (false)
-					//stream << string_format(ASM_FORMAT_CMP_MEM_CONST, asm_size.c_str(), var_stack_offset, "0");
-					instructions.push_back(new Asm3<std::string, uint32_t, std::string>(AsmType::COMP_MEM_CONST, asm_size, var_stack_offset, "0"));
-					// If it is 0 (false) then jump to else or continue
-					//stream << string_format(ASM_FORMAT_JMP_EQ, if_st->has_else ? else_label_name.c_str() : continue_label_name.c_str());
-					instructions.push_back(new Asm1<std::string>(AsmType::JUMP_EQ, if_st->has_else ? else_label_name : continue_label_name));
+					// cmov can't take a constant
+					assemble_load_operand(instructions, if_st->then_body, Register::C, size);
+					instructions.push_back(new Asm3<AsmType, std::string, std::string>(AsmType::CMOV_REG_REG, condition, get_register_name(Register::A, size), get_register_name(Register::C, size)));
 				}
+				return;
+			}
 
-				assemble_expression(instructions, if_st->then_body, stack_offset, can_return, code_block_label);
-				if (if_st->has_else) {
-					// Jump to continue to skip else
-					//stream << string_format(ASM_FORMAT_JMP, continue_label_name.c_str());
-					instructions.push_back(new Asm1<std::string>(AsmType::JUMP, continue_label_name));
-					// Put else label here
-					//stream << string_format(ASM_FORMAT_LABEL, else_label_name.c_str());
-					instructions.push_back(new Asm1<std::string>(AsmType::LABEL, else_label_name));
-					assemble_expression(instructions, if_st->else_body, stack_offset, can_return, code_block_label);
-				}
-				// Put continue label here
-				//stream << string_format(ASM_FORMAT_LABEL, continue_label_name.c_str());
+			std::string else_label_name = "__else" + std::to_string(name_counter);
+			std::string then_label_name = "__then" + std::to_string(name_counter);
+			std::string continue_label_name = "__continue" + std::to_string(name_counter);
+			++name_counter;
+			assemble_count(instructions, if_st, 0);
+			if (is_else_hotter(if_st)) {
+				assemble_condition_jump(instructions, if_st->condition, stack_offset, then_label_name, true);
+				assemble_expression_stres(instructions, if_st->else_body, stack_offset);
+				instructions.push_back(new Asm1<std::string>(AsmType::JUMP, continue_label_name));
+				instructions.push_back(new Asm1<std::string>(AsmType::LABEL, then_label_name));
+				assemble_count(instructions, if_st, 1);
+				assemble_expression_stres(instructions, if_st->then_body, stack_offset);
 				instructions.push_back(new Asm1<std::string>(AsmType::LABEL, continue_label_name));
+				return;
+			}
+			assemble_condition_jump(instructions, if_st->condition, stack_offset, if_st->has_else ? else_label_name : continue_label_name, false);
+			assemble_count(instructions, if_st, 1);
+			assemble_expression_stres(instructions, if_st->then_body, stack_offset);
+			if (if_st->has_else) {
+				instructions.push_back(new Asm1<std::string>(AsmType::JUMP, continue_label_name));
+				instructions.push_back(new Asm1<std::string>(AsmType::LABEL, else_label_name));
+				assemble_expression_stres(instructions, if_st->else_body, stack_offset);
 			}
+			instructions.push_back(new Asm1<std::string>(AsmType::LABEL, continue_label_name));
 		}
 
 		// Converts a string from any constant expression into a number
@@ -260,16 +1551,18 @@ namespace Bonfire {
 			return assemble_only_code_block(instructions, block_st, stack_offset, can_return, code_block_label);
 		}
 
-		BlockST* assemble_code_block(std::vector<AssemblyInstruction*>& instructions, ExpressionST* block, uint32_t& stack_offset, bool can_parent_return) {
+		BlockST* assemble_code_block(std::vector<AssemblyInstruction*>& instructions, ExpressionST* block, uint32_t& stack_offset, bool can_parent_return, const char* parent_label) {
 
 			BlockST* block_st = static_cast<BlockST*>(block);
+			// An inlined call still counts its executions
+			assemble_count(instructions, block_st, 0);
 			// See if we have to set up a stack frame
 			bool stack_frame = false;
 			std::string end_label = "__block" + std::to_string(num_labels) + "_end";
 			++num_labels;
 
 			for (int i = 0; i < block_st->num_children; i++) {
-				if (block_st->children[i]->type == AstType::VAR_DECLARATION) {
+				if (block_st->children[i]->type == AstType::VAR_DECLARATION || block_st->children[i]->type == AstType::ARRAY_DECLARATION) {
 					stack_frame = true;
 					break;
 				}
@@ -278,18 +1571,26 @@ namespace Bonfire {
 			// Determine if this block can return the function
 			// If the parent can return and the current block type is void, when using return on this block, we want to return from the function instead of the block
 			bool can_return = can_parent_return && block_st->return_type == Type::VOID;
+			// A return inside a void block returns for the parent code block, a block with a type catches it
+			const char* return_label = block_st->return_type == Type::VOID && parent_label ? parent_label : end_label.c_str();
 
 			std::cout << "Can parent return? " << std::boolalpha << can_parent_return << std::endl;
 			std::cout << "Return type " << (int)block_st->return_type << std::endl;
 
+			bool parent_value_can_return = value_can_return;
+			const char* parent_value_return_label = value_return_label;
+			value_can_return = can_return;
+			value_return_label = return_label;
 			if (stack_frame) {
 				uint32_t start_stack_offset = stack_offset;
-				assemble_only_code_block(instructions, block_st, stack_offset, can_return, end_label.c_str());
+				assemble_only_code_block(instructions, block_st, stack_offset, can_return, return_label);
 				stack_offset = start_stack_offset;
 			}
 			else {
-				assemble_only_code_block(instructions, block_st, stack_offset, can_return, end_label.c_str());
+				assemble_only_code_block(instructions, block_st, stack_offset, can_return, return_label);
 			}
+			value_can_return = parent_value_can_return;
+			value_return_label = parent_value_return_label;
 			// Set block end label, if the last expression of the code block was not a return
 			//stream << string_format(ASM_FORMAT_LABEL, end_label.c_str());
 			instructions.push_back(new Asm1<std::string>(AsmType::LABEL, end_label));
@@ -299,30 +1600,34 @@ namespace Bonfire {
 		void assemble_return(std::vector<AssemblyInstruction*>& instructions, ExpressionST* ret, uint32_t& stack_offset, bool can_return, const char* code_block_end_label) {
 			ReturnST* ret_st = static_cast<ReturnST*>(ret);
 			if (ret_st) {
+				if (can_return && ret_st->expression->type == AstType::FUNCTION_CALL
+					&& assemble_tail_call(instructions, static_cast<FunctionCallST*>(ret_st->expression), stack_offset)) {
+					return;
+				}
 				switch (ret_st->expression->type) {
 				case AstType::CONSTANT:
 				{
 					ConstantST* constant = static_cast<ConstantST*>(ret_st->expression);
 					//stream << string_format(ASM_FORMAT_RETURN_CONST, const_as_num(constant->get_value()).c_str());
-					instructions.push_back(new Asm2<std::string, std::string>(AsmType::MOVE_REG_CONST, "eax", constant->constant));
+					// Constants in void blocks don't have a type, they return for the function
+					Type t = constant->return_type != Type::VOID ? constant->return_type : current_function->return_type;
+					instructions.push_back(new Asm2<std::string, std::string>(AsmType::MOVE_REG_CONST, get_acc_register(get_register_size(t)), constant->constant));
 					break;
 				}
 				case AstType::VAR_VALUE:
 				{
 					VariableValST* var_st = static_cast<VariableValST*>(ret_st->expression);
 					Type t = get_type_by_var_name(var_st->identifier);
-					std::string asm_size = get_asm_size(t);
-					//if (!asm_size.compare(ASM_32)) {
-						// Don't zero or sign extend
-						//stream << string_format(ASM_FORMAT_RETURN_VAR, get_stack_offset_by_var_name(var_st->identifier));
-					instructions.push_back(new Asm3<std::string, std::string, uint32_t>(AsmType::MOVE_REG_MEM, "eax", asm_size, get_stack_offset_by_var_name(var_st->identifier)));
-					//}
+					assemble_load_variable(instructions, Register::A, get_register_size(t), var_st->identifier);
 					break;
 				}
+				default:
+					assemble_expression_stres(instructions, ret_st->expression, stack_offset);
+					break;
 				}
 				if (can_return) {
 					//stream << ASM_RETURN;
-					instructions.push_back(new AssemblyInstruction(AsmType::CLOSE_SF));
+					assemble_close_frame(instructions);
 					instructions.push_back(new AssemblyInstruction(AsmType::RETURN));
 				}
 				else {
@@ -332,6 +1637,17 @@ namespace Bonfire {
 			}
 		}
 
+		// Stores a constant in a variable of the given size
+		void assemble_store_constant(std::vector<AssemblyInstruction*>& instructions, uint8_t size, uint32_t var_stack_offset, const std::string& constant) {
+			if (fits_immediate(constant, size)) {
+				instructions.push_back(new Asm3<std::string, uint32_t, std::string>(AsmType::MOVE_MEM_CONST, get_asm_size(size), var_stack_offset, constant));
+				return;
+			}
+			// Only mov reg, const takes a 64-bit constant
+			instructions.push_back(new Asm2<std::string, std::string>(AsmType::MOVE_REG_CONST, get_acc_register(size), constant));
+			instructions.push_back(new Asm3<std::string, uint32_t, std::string>(AsmType::MOVE_MEM_REG, get_asm_size(size), var_stack_offset, get_acc_register(size)));
+		}
+
 		void assemble_var_assignment(std::vector<AssemblyInstruction*>& instructions, ExpressionST* ret, uint32_t& stack_offset, bool can_return) {
 			VariableAssignST* var_st = static_cast<VariableAssignST*>(ret);
 			switch (var_st->value->type) {
@@ -342,7 +1658,7 @@ namespace Bonfire {
 				std::string asm_size = get_asm_size(get_size_by_var_name(var_st->identifier));
 
 				//stream << string_format(ASM_FORMAT_VAR_AS_CONST, asm_size.c_str(), stack_offset, num);
-				instructions.push_back(new Asm3<std::string, uint32_t, std::string>(AsmType::MOVE_MEM_CONST, asm_size, var_stack_offset, constant->constant));
+				assemble_store_constant(instructions, get_size_by_var_name(var_st->identifier), var_stack_offset, constant->constant);
 				return;
 			}
 			case AstType::VAR_VALUE:
@@ -354,7 +1670,23 @@ namespace Bonfire {
 				std::string lhs_asm_size = get_asm_size(get_size_by_var_name(var_st->identifier));
 
 				//stream << string_format(ASM_FORMAT_VAR_AS_VAR, rhs_asm_size.c_str(), rhs_stack_offset, lhs_asm_size.c_str(), lhs_stack_offset);
-				instructions.push_back(new Asm4<std::string, uint32_t, std::string, uint32_t>(AsmType::MOVE_MEM_MEM, lhs_asm_size, lhs_stack_offset, rhs_asm_size, rhs_stack_offset));
+				if (rhs_asm_size.compare(lhs_asm_size)) {
+					// Different sizes: extend (or cut) the value in a register
+					uint8_t size = get_size_by_var_name(var_st->identifier);
+					assemble_load_variable(instructions, Register::A, get_register_size(get_type_by_var_name(var_st->identifier)), var_val->identifier);
+					instructions.push_back(new Asm3<std::string, uint32_t, std::string>(AsmType::MOVE_MEM_REG, lhs_asm_size, lhs_stack_offset, get_acc_register(size)));
+					return;
+				}
+				// MOVE_MEM_MEM copies from the first to the second memory location
+				instructions.push_back(new Asm4<std::string, uint32_t, std::string, uint32_t>(AsmType::MOVE_MEM_MEM, rhs_asm_size, rhs_stack_offset, lhs_asm_size, lhs_stack_offset));
+				return;
+			}
+			default:
+			{
+				// Calculate the value into eax and store it
+				assemble_expression_stres(instructions, var_st->value, stack_offset);
+				uint8_t size = get_size_by_var_name(var_st->identifier);
+				instructions.push_back(new Asm3<std::string, uint32_t, std::string>(AsmType::MOVE_MEM_REG, get_asm_size(size), get_stack_offset_by_var_name(var_st->identifier), get_acc_register(size)));
 				return;
 			}
 			}
@@ -371,13 +1703,12 @@ namespace Bonfire {
 					std::cout << "Constant" << std::endl;
 					ConstantST* constant = static_cast<ConstantST*>(var_st->value);
 					// Decrease stack pointer by the size of the constant and move the value into it
-					int64_t num = std::stoi(const_as_num(constant->get_value()).c_str());
 					uint8_t size = get_type_size(constant->return_type);
 					std::string asm_size = get_asm_size(constant->return_type);
 
-					stack_offset += size;
+					reserve_stack(stack_offset, size);
 					//stream << string_format(ASM_FORMAT_VAR_DEC_INIT, asm_size.c_str(), stack_offset, num);
-					instructions.push_back(new Asm3<std::string, uint32_t, std::string>(AsmType::MOVE_MEM_CONST, asm_size, stack_offset, constant->constant));
+					assemble_store_constant(instructions, size, stack_offset, constant->constant);
 					glob_vars.push_back(Variable(var_st->identifier, stack_offset, constant->return_type));
 					return;
 				}
@@ -385,12 +1716,20 @@ namespace Bonfire {
 				{
 					std::cout << "Variable" << std::endl;
 					VariableValST* var_rhs = static_cast<VariableValST*>(var_st->value);
-					// Decrease stack pointer by the size of the rhs variable and move the value of rhs into it
-					uint8_t size = get_type_size(var_rhs->return_type);
+					// Decrease stack pointer by the size of the variable and move the value of rhs into it
+					uint8_t size = get_type_size(var_st->var_type);
 					uint32_t rhs_stack_offset = get_stack_offset_by_var_name(var_rhs->identifier);
-					std::string asm_size = get_asm_size(var_rhs->return_type);
-					std::string rhs_asm_size = asm_size;
-					stack_offset += size;
+					std::string asm_size = get_asm_size(var_st->var_type);
+					std::string rhs_asm_size = get_asm_size(get_type_by_var_name(var_rhs->identifier));
+					if (rhs_asm_size.compare(asm_size)) {
+						// Different sizes: extend (or cut) the value in a register
+						assemble_load_variable(instructions, Register::A, get_register_size(var_st->var_type), var_rhs->identifier);
+						reserve_stack(stack_offset, size);
+						instructions.push_back(new Asm3<std::string, uint32_t, std::string>(AsmType::MOVE_MEM_REG, asm_size, stack_offset, get_acc_register(size)));
+						glob_vars.push_back(Variable(var_st->identifier, stack_offset, var_st->var_type));
+						return;
+					}
+					reserve_stack(stack_offset, size);
 
 					std::cout << "Assembling Variable declaration by variable value" << std::endl;
 					std::cout << var_st->identifier << " stack offset: " << stack_offset << std::endl;
@@ -400,98 +1739,257 @@ namespace Bonfire {
 					//stream << string_format(ASM_FORMAT_VAR_DEC_INIT_VAR, asm_size.c_str(), rhs_stack_offset, stack_offset);
 					instructions.push_back(new Asm4<std::string, uint32_t, std::string, uint32_t>(AsmType::MOVE_MEM_MEM, rhs_asm_size, rhs_stack_offset, asm_size, stack_offset));
 
-					glob_vars.push_back(Variable(var_st->identifier, stack_offset, var_rhs->return_type));
+					glob_vars.push_back(Variable(var_st->identifier, stack_offset, var_st->var_type));
 					return;
 				}
 				case AstType::BLOCK:
+				{
 					std::cout << "Block" << std::endl;
 					// This block can't return void since it is used to assign a value to a variable. Therefore it can't return from the parent function
-					BlockST* block_st = assemble_code_block(instructions, var_st->value, stack_offset, false);
+					BlockST* block_st = assemble_code_block(instructions, var_st->value, stack_offset, false, NULL);
 
 
 					uint8_t size = get_type_size(block_st->return_type);
-					stack_offset += size;
+					reserve_stack(stack_offset, size);
 					std::string asm_size = get_asm_size(size);
 
 					//stream << string_format(ASM_FORMAT_VAR_DEC_RETURN, stack_offset);
 					//instructions.push_back(new Asm2<std::string, uin32_t);
-					instructions.push_back(new Asm3<std::string, uint32_t, std::string>(AsmType::MOVE_MEM_REG, asm_size, stack_offset, "eax"));
+					instructions.push_back(new Asm3<std::string, uint32_t, std::string>(AsmType::MOVE_MEM_REG, asm_size, stack_offset, get_acc_register(size)));
 
 					glob_vars.push_back(Variable(var_st->identifier, stack_offset, block_st->return_type));
 					return;
 				}
+				default:
+				{
+					// Calculate the value into eax and store it
+					assemble_expression_stres(instructions, var_st->value, stack_offset);
+					uint8_t size = get_type_size(var_st->var_type);
+					reserve_stack(stack_offset, size);
+					instructions.push_back(new Asm3<std::string, uint32_t, std::string>(AsmType::MOVE_MEM_REG, get_asm_size(size), stack_offset, get_acc_register(size)));
+					glob_vars.push_back(Variable(var_st->identifier, stack_offset, var_st->var_type));
+					return;
+				}
+				}
 			}
 		}
 
 		void assemble_expression(std::vector<AssemblyInstruction*>& instructions, ExpressionST* expression, uint32_t& stack_offset, bool can_return, const char* code_block_end_label) {
+			size_t first = instructions.size();
 			switch (expression->type) {
 			case AstType::BLOCK:
-				assemble_code_block(instructions, expression, stack_offset, can_return);
-				return;
+				assemble_code_block(instructions, expression, stack_offset, can_return, code_block_end_label);
+				break;
 			case AstType::RETURN:
 				assemble_return(instructions, expression, stack_offset, can_return, code_block_end_label);
-				return;
+				break;
 			case AstType::VAR_DECLARATION:
 				assemble_var_declaration(instructions, expression, stack_offset, can_return);
-				return;
+				break;
 			case AstType::VAR_ASSIGNMENT:
 				assemble_var_assignment(instructions, expression, stack_offset, can_return);
-				return;
+				break;
 			case AstType::IF:
 				assemble_if(instructions, expression, stack_offset, can_return, code_block_end_label);
-				return;
+				break;
 			case AstType::LOOP:
 				assemble_loop(instructions, expression, stack_offset, can_return, code_block_end_label);
-				return;
+				break;
+			case AstType::MATCH:
+				assemble_match(instructions, static_cast<MatchST*>(expression), stack_offset, false, can_return, code_block_end_label);
+				break;
+			case AstType::FUNCTION_CALL:
+				// The return value isn't used
+				assemble_call_stres(instructions, static_cast<FunctionCallST*>(expression), stack_offset);
+				break;
+			case AstType::ARRAY_DECLARATION:
+				assemble_array_declaration(instructions, static_cast<ArrayDeclarationST*>(expression), stack_offset);
+				break;
+			case AstType::INDEX_ASSIGNMENT:
+				assemble_index_assignment(instructions, static_cast<IndexAssignST*>(expression), stack_offset);
+				break;
+			case AstType::INDEX:
+				// The value isn't used, but the bounds check still has to run
+				assemble_index_stres(instructions, static_cast<IndexST*>(expression), stack_offset);
+				break;
 			}
+			set_line(instructions, first, expression->line);
 		}
 
 		// Assemble an expression and store the result in eax
 		void assemble_expression_stres(std::vector<AssemblyInstruction*>& instructions, ExpressionST* expression, uint32_t& stack_offset) {
 			switch (expression->type) {
 			case AstType::BLOCK:
-				assemble_code_block(instructions, expression, stack_offset, true);
+				// A void block returns for the block around the value
+				assemble_code_block(instructions, expression, stack_offset, value_can_return, value_return_label);
 				return;
 			case AstType::CONSTANT:
 			{
 				ConstantST* constant = static_cast<ConstantST*>(expression);
 				//stream << string_format(ASM_FORMAT_RETURN_CONST, constant->constant.c_str());
-				instructions.push_back(new Asm2<std::string, std::string>(AsmType::MOVE_REG_CONST, "eax", constant->constant));
+				instructions.push_back(new Asm2<std::string, std::string>(AsmType::MOVE_REG_CONST, get_acc_register(get_register_size(constant->return_type)), constant->constant));
 				return;
 			}
 			case AstType::VAR_VALUE:
 			{
 				VariableValST* var = static_cast<VariableValST*>(expression);
 				//stream << string_format(ASM_FORMAT_RETURN_VAR, get_stack_offset_by_var_name(var->identifier));
-				instructions.push_back(new Asm2<std::string, uint32_t>(AsmType::MOVE_REG_MEM, "eax", get_stack_offset_by_var_name(var->identifier)));
+				Type t = get_type_by_var_name(var->identifier);
+				assemble_load_variable(instructions, Register::A, get_register_size(t), var->identifier);
+				return;
+			}
+			case AstType::OPERATION:
+				assemble_operation_stres(instructions, static_cast<OperationST*>(expression), stack_offset);
+				return;
+			case AstType::IF:
+				assemble_if_stres(instructions, static_cast<IfST*>(expression), stack_offset);
+				return;
+			case AstType::MATCH:
+				assemble_match(instructions, static_cast<MatchST*>(expression), stack_offset, true, true, NULL);
+				return;
+			case AstType::FUNCTION_CALL:
+				assemble_call_stres(instructions, static_cast<FunctionCallST*>(expression), stack_offset);
+				return;
+			case AstType::INDEX:
+				assemble_index_stres(instructions, static_cast<IndexST*>(expression), stack_offset);
+				return;
+			case AstType::LENGTH:
+				assemble_length_stres(instructions, static_cast<LengthST*>(expression));
 				return;
 			}
+		}
+
+		// Moves the parameters from their registers (or from above the return address) into variables
+		void assemble_parameters(std::vector<AssemblyInstruction*>& instructions, FunctionDefST* function, uint32_t& stack_offset) {
+			const std::vector<Register>& registers = target->argument_registers;
+			std::vector<uint32_t> slots = get_parameter_slots(function).first;
+			for (size_t i = 0; i < function->parameters.size(); i++) {
+				ParameterDef& parameter = function->parameters[i];
+				if (parameter.slice) {
+					// The pointer and the length become two variables of pointer size
+					ArrayVariable array = { parameter.identifier, parameter.type, ArrayKind::SLICE, 0, 0, 0, "" };
+					uint8_t size = target->pointer_size;
+					std::string asm_size = get_asm_size(size);
+					for (uint32_t part = 0; part < 2; part++) {
+						uint32_t slot = slots[i] + part;
+						reserve_stack(stack_offset, size);
+						std::string reg = get_register_name(Register::A, size);
+						if (slot < registers.size()) reg = get_register_name(registers[slot], size);
+						else instructions.push_back(new Asm3<std::string, std::string, uint32_t>(AsmType::MOVE_REG_ARG, reg, asm_size, (2 + slot - registers.size()) * target->pointer_size));
+						instructions.push_back(new Asm3<std::string, uint32_t, std::string>(AsmType::MOVE_MEM_REG, asm_size, stack_offset, reg));
+						(part ? array.length_offset : array.stack_offset) = stack_offset;
+					}
+					glob_arrays.push_back(array);
+					continue;
+				}
+				uint8_t size = get_type_size(parameter.type);
+				reserve_stack(stack_offset, size);
+				std::string reg = get_register_name(Register::A, size);
+				if (slots[i] < registers.size()) {
+					reg = get_register_name(registers[slots[i]], size);
+				}
+				else {
+					uint32_t arg_offset = (2 + slots[i] - registers.size()) * target->pointer_size;
+					instructions.push_back(new Asm3<std::string, std::string, uint32_t>(AsmType::MOVE_REG_ARG, get_register_name(Register::A, get_register_size(parameter.type)), get_asm_size(size), arg_offset));
+				}
+				instructions.push_back(new Asm3<std::string, uint32_t, std::string>(AsmType::MOVE_MEM_REG, get_asm_size(size), stack_offset, reg));
+				glob_vars.push_back(Variable(parameter.identifier, stack_offset, parameter.type));
 			}
 		}
 
-		void assemble_function(std::vector<AssemblyInstruction*>& instructions, FunctionDefST* function, uint32_t& stack_offset) {
+		void assemble_function(std::vector<AssemblyInstruction*>& instructions, FunctionDefST* function) {
 			//stream << string_format(ASM_FORMAT_LABEL, !function->name.compare("main") ? "_main" : function->name.c_str());
-			instructions.push_back(new Asm1<std::string>(AsmType::LABEL, function->name));
-			// Setup stack frame for this function
+			size_t function_start = instructions.size();
+			instructions.push_back(new Asm1<std::string>(AsmType::LABEL, get_function_symbol(function->name)));
+			// Setup stack frame for this function. Its size is known once the body is assembled
 			//stream << ASM_SETUP_STACK_FRAME;
-			instructions.push_back(new AssemblyInstruction(AsmType::SETUP_SF));
+			Asm1<uint32_t>* setup_sf = new Asm1<uint32_t>(AsmType::SETUP_SF, 0);
+			instructions.push_back(setup_sf);
+			if (Profile::instrument_functions) instructions.push_back(new Asm1<std::string>(AsmType::HOOK, Profile::get_enter_hook(function->name)));
+			// Variables only live inside of their function
+			glob_vars.clear();
+			glob_arrays.clear();
+			static_counter = 0;
+			has_bounds_check = false;
+			uint32_t stack_offset = 0;
+			frame_size = 0;
+			pushed_bytes = 0;
+			scratch_depth = 0;
+			current_function = function;
+			has_tail_loop = false;
+			value_can_return = true;
+			value_return_label = NULL;
+			cold_blocks.clear();
+			cold_depth = 0;
+			loop_depth = 0;
+			assemble_parameters(instructions, function, stack_offset);
+			size_t body_start = instructions.size();
 			// Assemble the code block. It can return, since it is the body of a function
 			BlockST* block_st = assemble_only_code_block(instructions, function->statement, stack_offset, true, "");
+			// Calls of the function itself in tail position jump to the start of the body
+			if (has_tail_loop) instructions.insert(instructions.begin() + body_start, new Asm1<std::string>(AsmType::LABEL, get_tail_loop_label(function)));
+			// Keep the stack pointer 16 byte aligned
+			setup_sf->data1 = (frame_size + 15) & ~15;
 
 			// TODO: This only works if the return statement is the last expression in the code block
-			if (block_st->children[block_st->num_children - 1]->type != AstType::RETURN) {
+			if (block_st->num_children == 0 || block_st->children[block_st->num_children - 1]->type != AstType::RETURN) {
 				//stream << ASM_RETURN;
-				instructions.push_back(new AssemblyInstruction(AsmType::CLOSE_SF));
+				assemble_close_frame(instructions);
 				instructions.push_back(new AssemblyInstruction(AsmType::RETURN));
 			}
+			// Every failed bounds check of the function jumps to the same trap
+			if (has_bounds_check) {
+				cold_blocks.push_back(new Asm1<std::string>(AsmType::LABEL, get_bounds_label(function)));
+				cold_blocks.push_back(new AssemblyInstruction(AsmType::TRAP));
+			}
+			// Cold arms go behind the function, out of the way of the hot code
+			if (!cold_blocks.empty()) {
+				instructions.push_back(new Asm1<std::string>(AsmType::SECTION, ASM_SECTION_COLD));
+				instructions.insert(instructions.end(), cold_blocks.begin(), cold_blocks.end());
+				instructions.push_back(new Asm1<std::string>(AsmType::SECTION, ASM_SECTION_TEXT));
+				cold_blocks.clear();
+			}
+			// The frame setup, the parameters and the implicit return belong to the line of the function
+			set_line(instructions, function_start, function->line);
 		}
 
-		static std::string assemble(ProgramST* program) {
+		// Counts the instructions a function is assembled to, without changing the state of the assembler
+		uint32_t count_instructions(FunctionDefST* function) {
+			std::vector<Variable> saved_vars = glob_vars;
+			std::vector<ArrayVariable> saved_arrays = glob_arrays;
+			size_t saved_num_statics = static_arrays.size();
+			uint32_t saved_static_counter = static_counter;
+			uint32_t saved_num_labels = num_labels;
+			uint32_t saved_name_counter = name_counter;
+
+			std::vector<AssemblyInstruction*> instructions;
+			dry_run = true;
+			assemble_function(instructions, function);
+			dry_run = false;
+
+			glob_vars = saved_vars;
+			glob_arrays = saved_arrays;
+			static_arrays.resize(saved_num_statics);
+			static_counter = saved_static_counter;
+			num_labels = saved_num_labels;
+			name_counter = saved_name_counter;
+			return instructions.size();
+		}
+
+		// The instructions of the whole program, after the peephole optimizations
+		static std::vector<AssemblyInstruction*> assemble_instructions(ProgramST* program) {
 
-			uint32_t stack_offset = 0;
 			std::vector<AssemblyInstruction*> instructions;
+			hot_targets.clear();
+			static_arrays.clear();
 			instructions.push_back(new AssemblyInstruction(AsmType::PROGRAM));
-			assemble_function(instructions, program->main, stack_offset);
+			for (FunctionDefST* function : program->functions) {
+				assemble_function(instructions, function);
+			}
+			// Static arrays are zeroed memory outside of the code
+			for (const std::pair<std::string, uint32_t>& array : static_arrays) {
+				instructions.push_back(new Asm2<std::string, uint32_t>(AsmType::STATIC_ARRAY, array.first, array.second));
+			}
 
 			std::cout << "Generated Assembly:" << std::endl;
 			for(AssemblyInstruction* i : instructions) {
@@ -499,8 +1997,26 @@ namespace Bonfire {
 			}
 
 			optimize(instructions);
+			// After the jumps are final, so no alignment gets between a jump and its label
+			align_branch_targets(instructions, hot_targets);
+			return instructions;
+		}
 
+		// Assembly text (.s) of the program
+		static std::string assemble(ProgramST* program) {
+			std::vector<AssemblyInstruction*> instructions = assemble_instructions(program);
 			return final_assemble(instructions);
 		}
+
+		// Machine code of the program, encoded without an external assembler
+		static MachineCode assemble_machine_code(ProgramST* program) {
+			std::vector<AssemblyInstruction*> instructions = assemble_instructions(program);
+			return encode(instructions);
+		}
+
+		// ELF object file (.o) of the program
+		static std::string assemble_object(ProgramST* program, const std::string& source_name) {
+			return write_elf_object(assemble_machine_code(program), source_name);
+		}
 	}
 }
\ No newline at end of file
@@ -0,0 +1,237 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include <cstdint>
+
+#include "assembler/encoder.h"
+#include "assembler/target.h"
+
+namespace Bonfire {
+	namespace Elf {
+		// Values from the ELF specification (and the i386 and x86_64 psABIs)
+		const uint16_t TYPE_RELOCATABLE = 1;
+		const uint16_t MACHINE_386 = 3;
+		const uint16_t MACHINE_X86_64 = 62;
+
+		const uint32_t SECTION_PROGBITS = 1;
+		const uint32_t SECTION_SYMTAB = 2;
+		const uint32_t SECTION_STRTAB = 3;
+		const uint32_t SECTION_RELA = 4;
+		const uint32_t SECTION_NOBITS = 8;
+		const uint32_t SECTION_REL = 9;
+
+		const uint32_t FLAG_WRITE = 0x1;
+		const uint32_t FLAG_ALLOC = 0x2;
+		const uint32_t FLAG_EXECINSTR = 0x4;
+		const uint32_t FLAG_INFO_LINK = 0x40;
+
+		const uint8_t BIND_LOCAL = 0;
+		const uint8_t BIND_GLOBAL = 1;
+		const uint8_t SYMBOL_NOTYPE = 0;
+		const uint8_t SYMBOL_OBJECT = 1;
+		const uint8_t SYMBOL_FUNC = 2;
+		const uint8_t SYMBOL_SECTION = 3;
+		const uint8_t SYMBOL_FILE = 4;
+		const uint16_t SECTION_INDEX_ABS = 0xFFF1;
+
+		const uint32_t RELOCATION_386_32 = 1;
+		const uint32_t RELOCATION_386_PC32 = 2;
+		const uint32_t RELOCATION_X86_64_PC32 = 2;
+		const uint32_t RELOCATION_X86_64_PLT32 = 4;
+
+		// Section indices, in the order they are written
+		enum Section { NONE, TEXT, BSS, RELOCATIONS, SYMTAB, STRTAB, SHSTRTAB, GNU_STACK, NUM_SECTIONS };
+
+		struct SectionHeader {
+			uint32_t name;
+			uint32_t type;
+			uint32_t flags;
+			uint32_t offset;
+			uint32_t size;
+			uint32_t link;
+			uint32_t info;
+			uint32_t alignment;
+			uint32_t entry_size;
+		};
+
+		void put(std::string& out, uint64_t value, uint8_t size) {
+			for (uint8_t i = 0; i < size; i++) out.push_back((char)((value >> (i * 8)) & 0xFF));
+		}
+
+		// Addresses, offsets and sizes have the size of a pointer of the target
+		void put_word(std::string& out, uint64_t value) {
+			put(out, value, target->pointer_size);
+		}
+
+		void align(std::string& out, uint32_t alignment) {
+			while (out.size() % alignment) out.push_back(0);
+		}
+
+		// Adds a name to a string table, returns where it starts
+		uint32_t add_string(std::string& table, const std::string& name) {
+			uint32_t index = table.size();
+			table += name;
+			table.push_back(0);
+			return index;
+		}
+
+		void put_symbol(std::string& out, uint32_t name, uint64_t value, uint64_t size, uint8_t bind, uint8_t type, uint16_t section) {
+			uint8_t info = (bind << 4) | type;
+			if (target->pointer_size == 8) {
+				put(out, name, 4);
+				put(out, info, 1);
+				put(out, 0, 1);
+				put(out, section, 2);
+				put(out, value, 8);
+				put(out, size, 8);
+			}
+			else {
+				put(out, name, 4);
+				put(out, value, 4);
+				put(out, size, 4);
+				put(out, info, 1);
+				put(out, 0, 1);
+				put(out, section, 2);
+			}
+		}
+
+		void put_section_header(std::string& out, const SectionHeader& header) {
+			put(out, header.name, 4);
+			put(out, header.type, 4);
+			put_word(out, header.flags);
+			put_word(out, 0);	// Address, only executables are loaded
+			put_word(out, header.offset);
+			put_word(out, header.size);
+			put(out, header.link, 4);
+			put(out, header.info, 4);
+			put_word(out, header.alignment);
+			put_word(out, header.entry_size);
+		}
+	}
+
+	// Writes the machine code as an ELF relocatable object (.o), for x86 (ELF32) or x86_64 (ELF64). Functions become
+	// symbols of .text, main is global, static arrays local symbols of .bss. Calls of functions that aren't in the code are left to the linker
+	static std::string write_elf_object(const MachineCode& code, const std::string& source_name) {
+		using namespace Elf;
+		bool x64 = target->pointer_size == 8;
+		uint32_t header_size = x64 ? 64 : 52;
+
+		std::string shstrtab(1, '\0');
+		std::string strtab(1, '\0');
+		SectionHeader headers[NUM_SECTIONS] = {};
+		headers[TEXT].name = add_string(shstrtab, ".text");
+		headers[BSS].name = add_string(shstrtab, ".bss");
+		headers[RELOCATIONS].name = add_string(shstrtab, x64 ? ".rela.text" : ".rel.text");
+		headers[SYMTAB].name = add_string(shstrtab, ".symtab");
+		headers[STRTAB].name = add_string(shstrtab, ".strtab");
+		headers[SHSTRTAB].name = add_string(shstrtab, ".shstrtab");
+		// Without it, the linker assumes the code needs an executable stack
+		headers[GNU_STACK].name = add_string(shstrtab, ".note.GNU-stack");
+
+		// Symbols: the file, the .text section, the local functions and the static arrays, then the global ones
+		std::string symtab;
+		put_symbol(symtab, 0, 0, 0, BIND_LOCAL, SYMBOL_NOTYPE, 0);
+		put_symbol(symtab, add_string(strtab, source_name), 0, 0, BIND_LOCAL, SYMBOL_FILE, SECTION_INDEX_ABS);
+		put_symbol(symtab, 0, 0, 0, BIND_LOCAL, SYMBOL_SECTION, TEXT);
+		uint32_t num_symbols = 3;
+		for (const CodeSymbol& symbol : code.symbols) {
+			if (symbol.global) continue;
+			put_symbol(symtab, add_string(strtab, symbol.name), symbol.offset, symbol.size, BIND_LOCAL, SYMBOL_FUNC, TEXT);
+			++num_symbols;
+		}
+		std::map<std::string, uint32_t> statics;
+		for (const CodeSymbol& symbol : code.statics) {
+			put_symbol(symtab, add_string(strtab, symbol.name), symbol.offset, symbol.size, BIND_LOCAL, SYMBOL_OBJECT, BSS);
+			statics[symbol.name] = num_symbols++;
+		}
+		uint32_t first_global = num_symbols;
+		for (const CodeSymbol& symbol : code.symbols) {
+			if (!symbol.global) continue;
+			put_symbol(symtab, add_string(strtab, symbol.name), symbol.offset, symbol.size, BIND_GLOBAL, SYMBOL_FUNC, TEXT);
+			++num_symbols;
+		}
+		// Undefined symbols the relocations refer to
+		std::map<std::string, uint32_t> undefined;
+		for (const CodeRelocation& relocation : code.relocations) {
+			if (relocation.data || undefined.count(relocation.symbol)) continue;
+			put_symbol(symtab, add_string(strtab, relocation.symbol), 0, 0, BIND_GLOBAL, SYMBOL_NOTYPE, 0);
+			undefined[relocation.symbol] = num_symbols++;
+		}
+
+		// The rel32 of a call is relative to the end of the instruction, 4 bytes after the relocation. ELF32 keeps this
+		// addend in the code, ELF64 in the relocation. The address of a static array is absolute on x86, with an addend of 0
+		std::vector<uint8_t> text = code.text;
+		std::string relocations;
+		for (const CodeRelocation& relocation : code.relocations) {
+			if (relocation.data) {
+				uint32_t symbol = statics[relocation.symbol];
+				if (x64) {
+					put(relocations, relocation.offset, 8);
+					put(relocations, ((uint64_t)symbol << 32) | RELOCATION_X86_64_PC32, 8);
+					put(relocations, (uint64_t)-4, 8);
+				}
+				else {
+					put(relocations, relocation.offset, 4);
+					put(relocations, (symbol << 8) | RELOCATION_386_32, 4);
+				}
+				continue;
+			}
+			uint32_t symbol = undefined[relocation.symbol];
+			if (x64) {
+				put(relocations, relocation.offset, 8);
+				put(relocations, ((uint64_t)symbol << 32) | RELOCATION_X86_64_PLT32, 8);
+				put(relocations, (uint64_t)-4, 8);
+			}
+			else {
+				put(relocations, relocation.offset, 4);
+				put(relocations, (symbol << 8) | RELOCATION_386_PC32, 4);
+				for (uint8_t i = 0; i < 4; i++) text[relocation.offset + i] = ((uint32_t)-4 >> (i * 8)) & 0xFF;
+			}
+		}
+
+		std::string out(header_size, '\0');
+		headers[TEXT] = { headers[TEXT].name, SECTION_PROGBITS, FLAG_ALLOC | FLAG_EXECINSTR, (uint32_t)out.size(), (uint32_t)text.size(), 0, 0, 16, 0 };
+		out.append(text.begin(), text.end());
+		// .bss takes no space in the file
+		headers[BSS] = { headers[BSS].name, SECTION_NOBITS, FLAG_ALLOC | FLAG_WRITE, (uint32_t)out.size(), code.bss_size, 0, 0, 16, 0 };
+		align(out, 8);
+		headers[RELOCATIONS] = { headers[RELOCATIONS].name, x64 ? SECTION_RELA : SECTION_REL, FLAG_INFO_LINK, (uint32_t)out.size(), (uint32_t)relocations.size(),
+			SYMTAB, TEXT, target->pointer_size, (uint32_t)(x64 ? 24 : 8) };
+		out += relocations;
+		align(out, 8);
+		headers[SYMTAB] = { headers[SYMTAB].name, SECTION_SYMTAB, 0, (uint32_t)out.size(), (uint32_t)symtab.size(),
+			STRTAB, first_global, target->pointer_size, (uint32_t)(x64 ? 24 : 16) };
+		out += symtab;
+		headers[STRTAB] = { headers[STRTAB].name, SECTION_STRTAB, 0, (uint32_t)out.size(), (uint32_t)strtab.size(), 0, 0, 1, 0 };
+		out += strtab;
+		headers[SHSTRTAB] = { headers[SHSTRTAB].name, SECTION_STRTAB, 0, (uint32_t)out.size(), (uint32_t)shstrtab.size(), 0, 0, 1, 0 };
+		out += shstrtab;
+		headers[GNU_STACK] = { headers[GNU_STACK].name, SECTION_PROGBITS, 0, (uint32_t)out.size(), 0, 0, 0, 1, 0 };
+		align(out, 8);
+		uint32_t section_headers = out.size();
+		for (const SectionHeader& header : headers) put_section_header(out, header);
+
+		// The file header, now that everything has its place
+		std::string header = "\x7F" "ELF";
+		put(header, x64 ? 2 : 1, 1);	// Class: 32 or 64 bit
+		put(header, 1, 1);				// Little endian
+		put(header, 1, 1);				// Version
+		header.resize(16, '\0');
+		put(header, TYPE_RELOCATABLE, 2);
+		put(header, x64 ? MACHINE_X86_64 : MACHINE_386, 2);
+		put(header, 1, 4);
+		put_word(header, 0);				// Entry
+		put_word(header, 0);				// Program headers
+		put_word(header, section_headers);
+		put(header, 0, 4);				// Flags
+		put(header, header_size, 2);
+		put(header, 0, 2);
+		put(header, 0, 2);
+		put(header, x64 ? 64 : 40, 2);	// Size of a section header
+		put(header, NUM_SECTIONS, 2);
+		put(header, SHSTRTAB, 2);
+		out.replace(0, header_size, header);
+		return out;
+	}
+}
@@ -0,0 +1,872 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include <cstdint>
+#include <cstdlib>
+
+#include "assembler/instructions.h"
+#include "assembler/target.h"
+#include "assembler/final.h"
+#include "assembler/vector.h"
+#include "utils/report.h"
+
+namespace Bonfire {
+
+	// Exception to throw if an instruction can't be turned into machine code (like cmp with two constants)
+	class encoding_error : std::exception {
+	public:
+		std::string message;
+		encoding_error(const std::string& message) {
+			this->message = message;
+		}
+	};
+
+	// A function in the encoded code, it becomes a symbol of the object file
+	struct CodeSymbol {
+		std::string name;
+		uint32_t offset;
+		uint32_t size;
+		bool global;
+	};
+
+	// A call to a symbol that isn't in the encoded code. The linker writes the distance to it (rel32) at offset.
+	// The address of a static array is relative to rip on x86_64 too, x86 gets the address itself
+	struct CodeRelocation {
+		uint32_t offset;
+		std::string symbol;
+		bool data = false;	// The symbol is a static array
+	};
+
+	struct MachineCode {
+		std::vector<uint8_t> text;
+		std::vector<CodeSymbol> symbols;
+		std::vector<CodeRelocation> relocations;
+		// Static arrays, with their offset in the zeroed data behind the code (.bss)
+		std::vector<CodeSymbol> statics;
+		uint32_t bss_size = 0;
+	};
+
+	namespace Encoder {
+
+		// A register as it is encoded: number is the Register, size the part of it in bytes
+		struct RegisterOperand {
+			uint8_t number;
+			uint8_t size;
+		};
+
+		// The r/m operand of an instruction, either a register or a variable relative to the frame pointer.
+		// Elements of arrays are indexed by the accumulator and relative to base
+		struct RmOperand {
+			bool memory;
+			uint8_t reg;
+			int32_t displacement;
+			bool indexed = false;
+			uint8_t base = (uint8_t)Register::BP;
+			uint8_t scale = 1;
+		};
+
+		// 4 bytes of a fragment that hold the distance from base to the label target. base is a label, or the offset
+		// base_position in the fragment itself if it is empty (like the end of an instruction that addresses relative to rip)
+		struct LabelFixup {
+			uint32_t position;
+			std::string target;
+			std::string base;
+			uint32_t base_position;
+		};
+
+		// A piece of the output. Jumps, calls and alignment only get their bytes once the labels are placed
+		struct Fragment {
+			std::vector<uint8_t> bytes;
+			AsmType jump = AsmType::PROGRAM;	// JUMP or a conditional jump, PROGRAM if this is no jump
+			bool call = false;
+			bool static_address = false;	// The last 4 bytes are the address of the static array target
+			bool near = false;			// The jump needs a rel32, the distance doesn't fit into a rel8
+			std::string target;
+			uint32_t alignment = 0;
+			uint32_t offset = 0;
+			uint32_t size = 0;
+			std::vector<LabelFixup> fixups;
+		};
+
+		RegisterOperand get_register(const std::string& name) {
+			for (uint8_t number = 0; number < target->num_registers; number++) {
+				for (uint8_t size : { 1, 2, 4, 8 }) {
+					if (size == 8 && target->pointer_size != 8) continue;
+					if (!get_register_name((Register)number, size).compare(name)) return { number, size };
+				}
+			}
+			throw encoding_error("Unknown register " + name);
+		}
+
+		int64_t get_constant(const std::string& constant) {
+			// Unsigned 64-bit constants don't fit into strtoll, their bits are the same
+			if (!constant.empty() && constant[0] == '-') return strtoll(constant.c_str(), NULL, 10);
+			return (int64_t)strtoull(constant.c_str(), NULL, 10);
+		}
+
+		bool fits_int8(int64_t value) {
+			return value >= -128 && value <= 127;
+		}
+
+		bool fits_int32(int64_t value) {
+			return value >= INT32_MIN && value <= INT32_MAX;
+		}
+
+		RmOperand register_rm(const RegisterOperand& reg) {
+			return { false, reg.number, 0 };
+		}
+
+		// [bp-stack_offset], a variable
+		RmOperand memory_rm(uint32_t stack_offset) {
+			return { true, 0, -(int32_t)stack_offset };
+		}
+
+		// [base+ax*size-stack_offset], an element of an array
+		RmOperand element_rm(uint8_t size, const std::string& base, uint32_t stack_offset) {
+			RmOperand rm = memory_rm(stack_offset);
+			rm.indexed = true;
+			rm.base = get_register(base).number;
+			rm.scale = size;
+			return rm;
+		}
+
+		// [bp+stack_offset], an argument that was passed on the stack
+		RmOperand argument_rm(uint32_t stack_offset) {
+			return { true, 0, (int32_t)stack_offset };
+		}
+
+		void put_bytes(std::vector<uint8_t>& out, uint64_t value, uint8_t size) {
+			for (uint8_t i = 0; i < size; i++) out.push_back((value >> (i * 8)) & 0xFF);
+		}
+
+		// spl, bpl, sil and dil only exist with a REX prefix, without it their numbers are ah, ch, dh and bh
+		bool needs_rex(uint8_t reg, uint8_t size) {
+			return size == 1 && reg >= 4 && reg < 8;
+		}
+
+		// Prefixes, opcode, ModR/M and displacement of an instruction. size is the operand size, reg the value of the
+		// reg field (a register or an opcode extension). reg_size is only needed if reg is a register
+		void emit(std::vector<uint8_t>& out, uint8_t size, std::vector<uint8_t> opcode, uint8_t reg, const RmOperand& rm, uint8_t reg_size = 0, uint8_t rm_size = 0) {
+			if (size == 2) out.push_back(0x66);
+			uint8_t rex = 0x40;
+			if (size == 8) rex |= 0x08;
+			if (reg >= 8) rex |= 0x04;
+			if (!rm.memory && rm.reg >= 8) rex |= 0x01;
+			if (rex != 0x40 || needs_rex(reg, reg_size) || (!rm.memory && needs_rex(rm.reg, rm_size))) {
+				if (target->pointer_size != 8) throw encoding_error("64-bit operands and registers only exist on x86_64");
+				out.push_back(rex);
+			}
+			out.insert(out.end(), opcode.begin(), opcode.end());
+			if (!rm.memory) {
+				out.push_back(0xC0 | ((reg & 7) << 3) | (rm.reg & 7));
+				return;
+			}
+			if (rm.indexed) {
+				// A SIB byte with the accumulator as the index. The frame pointer as base always has a displacement
+				uint8_t sib = ((rm.scale == 1 ? 0 : rm.scale == 2 ? 1 : rm.scale == 4 ? 2 : 3) << 6) | ((uint8_t)Register::A << 3) | (rm.base & 7);
+				uint8_t mod = !rm.displacement && rm.base != (uint8_t)Register::BP ? 0x00 : fits_int8(rm.displacement) ? 0x40 : 0x80;
+				out.push_back(mod | ((reg & 7) << 3) | 0x04);
+				out.push_back(sib);
+				if (mod) put_bytes(out, rm.displacement, mod == 0x40 ? 1 : 4);
+				return;
+			}
+			// Always relative to the frame pointer. Its encoding without a displacement means something else, so there
+			// is at least a disp8
+			if (fits_int8(rm.displacement)) {
+				out.push_back(0x40 | ((reg & 7) << 3) | (uint8_t)Register::BP);
+				put_bytes(out, rm.displacement, 1);
+			}
+			else {
+				out.push_back(0x80 | ((reg & 7) << 3) | (uint8_t)Register::BP);
+				put_bytes(out, rm.displacement, 4);
+			}
+		}
+
+		// Instructions with a register operand (reg field) and an r/m operand, the byte version of the opcode is one less
+		void emit_reg_rm(std::vector<uint8_t>& out, uint8_t opcode, const RegisterOperand& reg, const RmOperand& rm, uint8_t rm_size) {
+			emit(out, reg.size, { (uint8_t)(reg.size == 1 ? opcode - 1 : opcode) }, reg.number, rm, reg.size, rm_size);
+		}
+
+		// movzx and movsx, source_size is the size of the value that is extended
+		void emit_extend(std::vector<uint8_t>& out, bool sign, const RegisterOperand& reg, const RmOperand& rm, uint8_t source_size) {
+			if (source_size >= 4) {
+				// movsxd extends 32 bits, a zero extended 32-bit value is a normal 32-bit mov
+				if (sign && reg.size == 8) emit(out, 8, { 0x63 }, reg.number, rm);
+				else emit(out, 4, { 0x8B }, reg.number, rm);
+				return;
+			}
+			uint8_t opcode = (sign ? 0xBE : 0xB6) + (source_size == 2 ? 1 : 0);
+			emit(out, reg.size, { 0x0F, opcode }, reg.number, rm, reg.size, source_size);
+		}
+
+		// Instructions with an immediate, group is the opcode extension in the reg field (add /0, sub /5, cmp /7)
+		void emit_group_immediate(std::vector<uint8_t>& out, uint8_t size, uint8_t group, const RmOperand& rm, int64_t value, uint8_t rm_size) {
+			bool accumulator = !rm.memory && rm.reg == (uint8_t)Register::A;
+			if (size == 1) {
+				// The accumulator has its own opcode without a ModR/M byte
+				if (accumulator) out.push_back((group << 3) | 0x04);
+				else emit(out, size, { 0x80 }, group, rm, 0, rm_size);
+				put_bytes(out, value, 1);
+			}
+			else if (fits_int8(value)) {
+				emit(out, size, { 0x83 }, group, rm, 0, rm_size);
+				put_bytes(out, value, 1);
+			}
+			else {
+				if (accumulator) {
+					if (size == 2) out.push_back(0x66);
+					if (size == 8) out.push_back(0x48);
+					out.push_back((group << 3) | 0x05);
+				}
+				else emit(out, size, { 0x81 }, group, rm, 0, rm_size);
+				put_bytes(out, value, size == 2 ? 2 : 4);
+			}
+		}
+
+		// mov r/m, imm. A 64-bit immediate is the sign extended imm32
+		void emit_move_immediate(std::vector<uint8_t>& out, uint8_t size, const RmOperand& rm, int64_t value, uint8_t rm_size) {
+			if (size == 8 && !fits_int32(value)) throw encoding_error("Constant doesn't fit into 32 bits: " + std::to_string(value));
+			emit(out, size, { (uint8_t)(size == 1 ? 0xC6 : 0xC7) }, 0, rm, 0, rm_size);
+			put_bytes(out, value, size == 8 ? 4 : size);
+		}
+
+		// Packed integer instructions. The legacy SSE encoding is the mandatory prefix, 0F (then 38 or 3A) and the opcode,
+		// a VEX prefix holds all of them: wide is VEX.L (256 bits) and source the extra source register in VEX.vvvv
+		// (0 if there is none, it is stored inverted). w makes movd a movq. Only xmm0-xmm7 and the first 8 general
+		// purpose registers, so the register extension bits are always clear
+		void emit_vector(std::vector<uint8_t>& out, const VectorEncoding& encoding, bool vex, bool wide, bool w, uint8_t source, uint8_t reg, const RmOperand& rm) {
+			if (!encoding.mnemonic) throw encoding_error("No packed instruction for the element type");
+			std::vector<uint8_t> opcode;
+			if (!vex) {
+				if (encoding.prefix) out.push_back(encoding.prefix);
+				opcode.push_back(0x0F);
+				if (encoding.map == 2) opcode.push_back(0x38);
+				if (encoding.map == 3) opcode.push_back(0x3A);
+				opcode.push_back(encoding.opcode);
+				emit(out, w ? 8 : 4, opcode, reg, rm);
+				return;
+			}
+			uint8_t pp = encoding.prefix == 0x66 ? 1 : encoding.prefix == 0xF3 ? 2 : encoding.prefix == 0xF2 ? 3 : 0;
+			uint8_t vvvv_l_pp = ((~source & 0xF) << 3) | (wide ? 0x04 : 0) | pp;
+			if (encoding.map == 1 && !w) {
+				out.push_back(0xC5);
+				out.push_back(0x80 | vvvv_l_pp);
+			}
+			else {
+				out.push_back(0xC4);
+				out.push_back(0xE0 | encoding.map);
+				out.push_back((w ? 0x80 : 0) | vvvv_l_pp);
+			}
+			emit(out, 4, { encoding.opcode }, reg, rm);
+		}
+
+		RmOperand vector_register_rm(const std::string& name) {
+			return { false, get_vector_register_number(name), 0 };
+		}
+
+		// Opcode of the instructions with a register operand, byte versions are one less
+		uint8_t get_reg_rm_opcode(AsmType type) {
+			switch (type) {
+			case AsmType::ADD_REG_REG: return 0x01;
+			case AsmType::SUB_REG_REG: return 0x29;
+			case AsmType::XOR_REG_REG: return 0x31;
+			case AsmType::TEST_REG_REG: return 0x85;
+			case AsmType::ADD_REG_MEM: return 0x03;
+			case AsmType::SUB_REG_MEM: return 0x2B;
+			default: return 0;
+			}
+		}
+
+		uint8_t get_condition_number(AsmType type) {
+			switch (type) {
+			case AsmType::JUMP_EQ: return 0x4;
+			case AsmType::JUMP_NEQ: return 0x5;
+			case AsmType::JUMP_GT: return 0xF;
+			case AsmType::JUMP_GTE: return 0xD;
+			case AsmType::JUMP_LT: return 0xC;
+			case AsmType::JUMP_LTE: return 0xE;
+			case AsmType::JUMP_A: return 0x7;
+			case AsmType::JUMP_AE: return 0x3;
+			case AsmType::JUMP_B: return 0x2;
+			case AsmType::JUMP_BE: return 0x6;
+			default: return 0;
+			}
+		}
+
+		// Multi-byte nops, like the assembler pads with
+		void put_padding(std::vector<uint8_t>& out, uint32_t size) {
+			static const std::vector<uint8_t> nops[] = {
+				{},
+				{ 0x90 },
+				{ 0x66, 0x90 },
+				{ 0x0F, 0x1F, 0x00 },
+				{ 0x0F, 0x1F, 0x40, 0x00 },
+				{ 0x0F, 0x1F, 0x44, 0x00, 0x00 },
+				{ 0x66, 0x0F, 0x1F, 0x44, 0x00, 0x00 },
+				{ 0x0F, 0x1F, 0x80, 0x00, 0x00, 0x00, 0x00 },
+				{ 0x0F, 0x1F, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00 }
+			};
+			while (size > 0) {
+				uint32_t n = size < 8 ? size : 8;
+				out.insert(out.end(), nops[n].begin(), nops[n].end());
+				size -= n;
+			}
+		}
+
+		// The bytes of an instruction that doesn't depend on where it ends up
+		void encode_instruction(std::vector<uint8_t>& out, AssemblyInstruction* instruction) {
+			uint8_t pointer_size = target->pointer_size;
+			RegisterOperand sp = { (uint8_t)Register::SP, pointer_size };
+			RegisterOperand bp = { (uint8_t)Register::BP, pointer_size };
+			switch (instruction->type) {
+			case AsmType::PROGRAM:
+				return;
+			case AsmType::SETUP_SF:
+			{
+				auto as = static_cast<Asm1<uint32_t>*>(instruction);
+				out.push_back(0x50 + (uint8_t)Register::BP);
+				emit(out, pointer_size, { 0x89 }, sp.number, register_rm(bp));
+				if (as->data1) emit_group_immediate(out, pointer_size, 5, register_rm(sp), as->data1, pointer_size);
+				return;
+			}
+			case AsmType::CLOSE_SF:
+				emit(out, pointer_size, { 0x89 }, bp.number, register_rm(sp));
+				out.push_back(0x58 + (uint8_t)Register::BP);
+				return;
+			case AsmType::RETURN:
+				out.push_back(0xC3);
+				return;
+			/////////////// MOVE
+			case AsmType::MOVE_REG_MEM:
+			{
+				auto as = static_cast<Asm3<std::string, std::string, uint32_t>*>(instruction);
+				emit_reg_rm(out, 0x8B, get_register(as->data1), memory_rm(as->data3), 0);
+				return;
+			}
+			case AsmType::MOVEZX_REG_MEM:
+			case AsmType::MOVESX_REG_MEM:
+			{
+				auto as = static_cast<Asm3<std::string, std::string, uint32_t>*>(instruction);
+				emit_extend(out, instruction->type == AsmType::MOVESX_REG_MEM, get_register(as->data1), memory_rm(as->data3), get_asm_size_bytes(as->data2));
+				return;
+			}
+			case AsmType::MOVESXD_REG_REG:
+			{
+				auto as = static_cast<Asm2<std::string, std::string>*>(instruction);
+				RegisterOperand source = get_register(as->data2);
+				emit_extend(out, true, get_register(as->data1), register_rm(source), source.size);
+				return;
+			}
+			case AsmType::MOVEZX_REG_REG:
+			{
+				auto as = static_cast<Asm2<std::string, std::string>*>(instruction);
+				RegisterOperand source = get_register(as->data2);
+				emit_extend(out, false, get_register(as->data1), register_rm(source), source.size);
+				return;
+			}
+			case AsmType::MOVE_REG_REG:
+			{
+				auto as = static_cast<Asm2<std::string, std::string>*>(instruction);
+				RegisterOperand destination = get_register(as->data1);
+				emit_reg_rm(out, 0x89, get_register(as->data2), register_rm(destination), destination.size);
+				return;
+			}
+			case AsmType::MOVE_REG_CONST:
+			{
+				auto as = static_cast<Asm2<std::string, std::string>*>(instruction);
+				RegisterOperand reg = get_register(as->data1);
+				int64_t value = get_constant(as->data2);
+				if (reg.size == 8 && fits_int32(value)) {
+					emit_move_immediate(out, 8, register_rm(reg), value, 8);
+					return;
+				}
+				// mov reg, imm with the register in the opcode, movabs for 64-bit values
+				if (reg.size == 2) out.push_back(0x66);
+				if (reg.size == 8 || reg.number >= 8 || needs_rex(reg.number, reg.size)) out.push_back(0x40 | (reg.size == 8 ? 0x08 : 0) | (reg.number >= 8 ? 0x01 : 0));
+				out.push_back((reg.size == 1 ? 0xB0 : 0xB8) + (reg.number & 7));
+				put_bytes(out, value, reg.size);
+				return;
+			}
+			case AsmType::MOVE_REG_ARG:
+			{
+				auto as = static_cast<Asm3<std::string, std::string, uint32_t>*>(instruction);
+				RegisterOperand reg = get_register(as->data1);
+				uint8_t size = get_asm_size_bytes(as->data2);
+				if (size < 4) emit_extend(out, false, reg, argument_rm(as->data3), size);
+				else emit_reg_rm(out, 0x8B, reg, argument_rm(as->data3), 0);
+				return;
+			}
+			case AsmType::MOVE_MEM_MEM:
+			case AsmType::COMP_MEM_MEM:
+			{
+				// Through the accumulator, like final_assemble does it
+				auto as = static_cast<Asm4<std::string, uint32_t, std::string, uint32_t>*>(instruction);
+				uint8_t size = get_asm_size_bytes(as->data1);
+				RegisterOperand acc = { (uint8_t)Register::A, size };
+				if (size < 4) emit_extend(out, false, { (uint8_t)Register::A, 4 }, memory_rm(as->data2), size);
+				else emit_reg_rm(out, 0x8B, acc, memory_rm(as->data2), 0);
+				if (instruction->type == AsmType::MOVE_MEM_MEM) emit_reg_rm(out, 0x89, acc, memory_rm(as->data4), 0);
+				else emit_reg_rm(out, 0x3B, acc, memory_rm(as->data4), 0);
+				return;
+			}
+			case AsmType::MOVE_MEM_REG:
+			{
+				auto as = static_cast<Asm3<std::string, uint32_t, std::string>*>(instruction);
+				emit_reg_rm(out, 0x89, get_register(as->data3), memory_rm(as->data2), 0);
+				return;
+			}
+			case AsmType::MOVE_MEM_CONST:
+			{
+				auto as = static_cast<Asm3<std::string, uint32_t, std::string>*>(instruction);
+				emit_move_immediate(out, get_asm_size_bytes(as->data1), memory_rm(as->data2), get_constant(as->data3), 0);
+				return;
+			}
+			case AsmType::PUSH_REG:
+			case AsmType::POP_REG:
+			{
+				auto as = static_cast<Asm1<std::string>*>(instruction);
+				RegisterOperand reg = get_register(as->data1);
+				if (reg.number >= 8) out.push_back(0x41);
+				out.push_back((instruction->type == AsmType::PUSH_REG ? 0x50 : 0x58) + (reg.number & 7));
+				return;
+			}
+			/////////////// ARITHMETIC
+			case AsmType::ADD_REG_REG:
+			case AsmType::SUB_REG_REG:
+			case AsmType::XOR_REG_REG:
+			case AsmType::TEST_REG_REG:
+			{
+				auto as = static_cast<Asm2<std::string, std::string>*>(instruction);
+				RegisterOperand destination = get_register(as->data1);
+				emit_reg_rm(out, get_reg_rm_opcode(instruction->type), get_register(as->data2), register_rm(destination), destination.size);
+				return;
+			}
+			case AsmType::IMUL_REG_REG:
+			{
+				auto as = static_cast<Asm2<std::string, std::string>*>(instruction);
+				RegisterOperand destination = get_register(as->data1);
+				RegisterOperand source = get_register(as->data2);
+				emit(out, destination.size, { 0x0F, 0xAF }, destination.number, register_rm(source));
+				return;
+			}
+			case AsmType::ADD_REG_MEM:
+			case AsmType::SUB_REG_MEM:
+			{
+				auto as = static_cast<Asm3<std::string, std::string, uint32_t>*>(instruction);
+				emit_reg_rm(out, get_reg_rm_opcode(instruction->type), get_register(as->data1), memory_rm(as->data3), 0);
+				return;
+			}
+			case AsmType::IMUL_REG_MEM:
+			{
+				auto as = static_cast<Asm3<std::string, std::string, uint32_t>*>(instruction);
+				RegisterOperand destination = get_register(as->data1);
+				emit(out, destination.size, { 0x0F, 0xAF }, destination.number, memory_rm(as->data3));
+				return;
+			}
+			case AsmType::ADD_REG_CONST:
+			case AsmType::SUB_REG_CONST:
+			{
+				auto as = static_cast<Asm2<std::string, std::string>*>(instruction);
+				RegisterOperand reg = get_register(as->data1);
+				emit_group_immediate(out, reg.size, instruction->type == AsmType::ADD_REG_CONST ? 0 : 5, register_rm(reg), get_constant(as->data2), reg.size);
+				return;
+			}
+			case AsmType::IMUL_REG_CONST:
+			{
+				// imul reg, reg, imm
+				auto as = static_cast<Asm2<std::string, std::string>*>(instruction);
+				RegisterOperand reg = get_register(as->data1);
+				int64_t value = get_constant(as->data2);
+				emit(out, reg.size, { (uint8_t)(fits_int8(value) ? 0x6B : 0x69) }, reg.number, register_rm(reg));
+				put_bytes(out, value, fits_int8(value) ? 1 : reg.size == 2 ? 2 : 4);
+				return;
+			}
+			case AsmType::SIGN_EXTEND_ACC:
+				out.push_back(0x99);
+				return;
+			case AsmType::SIGN_EXTEND_ACC_64:
+				out.push_back(0x48);
+				out.push_back(0x99);
+				return;
+			case AsmType::IDIV_REG:
+			case AsmType::DIV_REG:
+			{
+				auto as = static_cast<Asm1<std::string>*>(instruction);
+				RegisterOperand reg = get_register(as->data1);
+				emit(out, reg.size, { (uint8_t)(reg.size == 1 ? 0xF6 : 0xF7) }, instruction->type == AsmType::IDIV_REG ? 7 : 6, register_rm(reg), 0, reg.size);
+				return;
+			}
+			case AsmType::SET_COND:
+			{
+				auto as = static_cast<Asm2<AsmType, std::string>*>(instruction);
+				RegisterOperand reg = get_register(as->data2);
+				emit(out, 1, { 0x0F, (uint8_t)(0x90 + get_condition_number(as->data1)) }, 0, register_rm(reg), 0, reg.size);
+				return;
+			}
+			case AsmType::CMOV_REG_REG:
+			{
+				auto as = static_cast<Asm3<AsmType, std::string, std::string>*>(instruction);
+				RegisterOperand destination = get_register(as->data2);
+				emit(out, destination.size, { 0x0F, (uint8_t)(0x40 + get_condition_number(as->data1)) }, destination.number, register_rm(get_register(as->data3)));
+				return;
+			}
+			case AsmType::CMOV_REG_MEM:
+			{
+				auto as = static_cast<Asm4<AsmType, std::string, std::string, uint32_t>*>(instruction);
+				RegisterOperand destination = get_register(as->data2);
+				emit(out, destination.size, { 0x0F, (uint8_t)(0x40 + get_condition_number(as->data1)) }, destination.number, memory_rm(as->data4));
+				return;
+			}
+			//////////////// COMPARE
+			case AsmType::COMP_MEM_CONST:
+			{
+				auto as = static_cast<Asm3<std::string, uint32_t, std::string>*>(instruction);
+				emit_group_immediate(out, get_asm_size_bytes(as->data1), 7, memory_rm(as->data2), get_constant(as->data3), 0);
+				return;
+			}
+			case AsmType::COMP_MEM_REG:
+			{
+				auto as = static_cast<Asm3<std::string, uint32_t, std::string>*>(instruction);
+				emit_reg_rm(out, 0x39, get_register(as->data3), memory_rm(as->data2), 0);
+				return;
+			}
+			case AsmType::COMP_REG_CONST:
+			{
+				auto as = static_cast<Asm2<std::string, std::string>*>(instruction);
+				RegisterOperand reg = get_register(as->data1);
+				emit_group_immediate(out, reg.size, 7, register_rm(reg), get_constant(as->data2), reg.size);
+				return;
+			}
+			case AsmType::COMP_REG_MEM:
+			{
+				auto as = static_cast<Asm3<std::string, std::string, uint32_t>*>(instruction);
+				emit_reg_rm(out, 0x3B, get_register(as->data1), memory_rm(as->data3), 0);
+				return;
+			}
+			case AsmType::COMP_REG_REG:
+			{
+				auto as = static_cast<Asm2<std::string, std::string>*>(instruction);
+				RegisterOperand lhs = get_register(as->data1);
+				emit_reg_rm(out, 0x39, get_register(as->data2), register_rm(lhs), lhs.size);
+				return;
+			}
+			//////////////// ARRAYS
+			case AsmType::LOAD_ELEMENT:
+			{
+				auto as = static_cast<Asm4<std::string, Type, std::string, uint32_t>*>(instruction);
+				RegisterOperand reg = get_register(as->data1);
+				uint8_t size = get_type_size(as->data2);
+				RmOperand rm = element_rm(size, as->data3, as->data4);
+				if (size == 4 && !is_signed_integer_type(as->data2)) emit_reg_rm(out, 0x8B, { (uint8_t)Register::A, 4 }, rm, 0);
+				else if (size >= reg.size) emit_reg_rm(out, 0x8B, reg, rm, 0);
+				else emit_extend(out, is_signed_integer_type(as->data2), reg, rm, size);
+				return;
+			}
+			case AsmType::STORE_ELEMENT:
+			{
+				auto as = static_cast<Asm4<std::string, Type, std::string, uint32_t>*>(instruction);
+				emit_reg_rm(out, 0x89, get_register(as->data1), element_rm(get_type_size(as->data2), as->data3, as->data4), 0);
+				return;
+			}
+			case AsmType::LEA_REG_MEM:
+			{
+				auto as = static_cast<Asm2<std::string, uint32_t>*>(instruction);
+				RegisterOperand reg = get_register(as->data1);
+				emit(out, reg.size, { 0x8D }, reg.number, memory_rm(as->data2));
+				return;
+			}
+			case AsmType::ZERO_MEM:
+			{
+				// See ASM_ZERO_MEM_64 and ASM_ZERO_MEM_32
+				auto as = static_cast<Asm2<uint32_t, uint32_t>*>(instruction);
+				if (pointer_size == 4) out.push_back(0x50 + (uint8_t)Register::DI);
+				emit(out, pointer_size, { 0x8D }, (uint8_t)Register::DI, memory_rm(as->data1));
+				out.insert(out.end(), { 0x31, 0xC0, 0xB9 });
+				put_bytes(out, as->data2 / pointer_size, 4);
+				out.push_back(0xF3);
+				if (pointer_size == 8) out.push_back(0x48);
+				out.push_back(0xAB);
+				if (pointer_size == 4) out.push_back(0x58 + (uint8_t)Register::DI);
+				return;
+			}
+			case AsmType::TRAP:
+				out.insert(out.end(), { 0x0F, 0x0B });
+				return;
+			//////////////// VECTORS
+			case AsmType::VECTOR_LOAD:
+			case AsmType::VECTOR_STORE:
+			{
+				// movdqu, the elements don't have to be aligned
+				auto as = static_cast<Asm4<std::string, Type, std::string, uint32_t>*>(instruction);
+				bool wide = is_wide_vector_register(as->data1);
+				VectorEncoding encoding = { "movdqu", 0xF3, 1, (uint8_t)(instruction->type == AsmType::VECTOR_LOAD ? 0x6F : 0x7F) };
+				emit_vector(out, encoding, wide, wide, false, 0, get_vector_register_number(as->data1), element_rm(get_type_size(as->data2), as->data3, as->data4));
+				return;
+			}
+			case AsmType::VECTOR_OP:
+			{
+				auto as = static_cast<Asm4<VectorOp, Type, std::string, std::string>*>(instruction);
+				VectorEncoding encoding = get_vector_encoding(as->data1, as->data2);
+				uint8_t destination = get_vector_register_number(as->data3);
+				bool wide = is_wide_vector_register(as->data3);
+				// Moves and broadcasts have a single source, the others take the destination as the first one
+				bool single_source = as->data1 == VectorOp::MOVE || as->data1 == VectorOp::BROADCAST;
+				emit_vector(out, encoding, wide, wide, false, single_source ? 0 : destination, destination, vector_register_rm(as->data4));
+				return;
+			}
+			case AsmType::VECTOR_OP_CONST:
+			{
+				auto as = static_cast<Asm4<VectorOp, std::string, std::string, uint32_t>*>(instruction);
+				VectorEncoding encoding = get_vector_encoding(as->data1, Type::UINT8);
+				bool wide = is_wide_vector_register(as->data3);
+				uint8_t destination = get_vector_register_number(as->data2);
+				uint8_t source = get_vector_register_number(as->data3);
+				switch (as->data1) {
+				case VectorOp::SHIFT_BYTES:
+					// psrldq is /3, the shifted register is the destination without VEX
+					emit_vector(out, encoding, wide, wide, false, wide ? destination : 0, 3, register_rm({ wide ? source : destination, 16 }));
+					break;
+				case VectorOp::EXTRACT_HIGH:
+					emit_vector(out, encoding, true, true, false, 0, source, register_rm({ destination, 16 }));
+					break;
+				default:
+					emit_vector(out, encoding, wide, wide, false, 0, destination, register_rm({ source, 16 }));
+					break;
+				}
+				put_bytes(out, as->data4, 1);
+				return;
+			}
+			case AsmType::VECTOR_FROM_REG:
+			case AsmType::VECTOR_TO_REG:
+			{
+				// movd (movq) xmm, r/m is 6E, movd r/m, xmm is 7E. Both have the vector register in the reg field
+				auto as = static_cast<Asm2<std::string, std::string>*>(instruction);
+				bool from_reg = instruction->type == AsmType::VECTOR_FROM_REG;
+				const std::string& vector_register = from_reg ? as->data1 : as->data2;
+				RegisterOperand reg = get_register(from_reg ? as->data2 : as->data1);
+				VectorEncoding encoding = { "movd", 0x66, 1, (uint8_t)(from_reg ? 0x6E : 0x7E) };
+				emit_vector(out, encoding, is_wide_vector_register(vector_register), false, reg.size == 8, 0, get_vector_register_number(vector_register), register_rm(reg));
+				return;
+			}
+			case AsmType::VECTOR_ZERO_UPPER:
+				out.insert(out.end(), { 0xC5, 0xF8, 0x77 });
+				return;
+			default:
+				// cmp can't have a constant as its first operand
+				throw encoding_error(std::string("Can't encode instruction ") + asmtype_to_string(instruction->type) + " (" + std::to_string((int)instruction->type) + ")");
+			}
+		}
+
+		// Puts the address of a table into ecx (rcx), see ASM_TABLE_ADDRESS_64 and ASM_TABLE_ADDRESS_32
+		void encode_table_address(Fragment& fragment, const std::string& table) {
+			if (target->pointer_size == 8) {
+				// lea rcx, [rip+table]
+				fragment.bytes = { 0x48, 0x8D, 0x0D, 0, 0, 0, 0 };
+				fragment.fixups.push_back({ 3, table, "", 7 });
+				return;
+			}
+			// call base, base: pop ecx, add ecx, table - base
+			fragment.bytes = { 0xE8, 0, 0, 0, 0, 0x59, 0x81, 0xC1, 0, 0, 0, 0 };
+			fragment.fixups.push_back({ 8, table, "", 5 });
+		}
+
+		uint32_t get_fragment_size(const Fragment& fragment, uint32_t offset) {
+			if (fragment.alignment) return (fragment.alignment - offset % fragment.alignment) % fragment.alignment;
+			if (fragment.jump != AsmType::PROGRAM) {
+				if (!fragment.near) return 2;
+				return fragment.jump == AsmType::JUMP ? 5 : 6;
+			}
+			return fragment.bytes.size();
+		}
+
+		// Places the fragments. Returns false if a short jump doesn't reach its label, it is then made near
+		bool layout(std::vector<Fragment>& fragments, const std::map<std::string, size_t>& labels) {
+			uint32_t offset = 0;
+			for (Fragment& fragment : fragments) {
+				fragment.offset = offset;
+				fragment.size = get_fragment_size(fragment, offset);
+				offset += fragment.size;
+			}
+			bool fits = true;
+			for (Fragment& fragment : fragments) {
+				if (fragment.jump == AsmType::PROGRAM || fragment.near) continue;
+				int64_t distance = (int64_t)fragments[labels.at(fragment.target)].offset - (fragment.offset + fragment.size);
+				if (!fits_int8(distance)) {
+					fragment.near = true;
+					fits = false;
+				}
+			}
+			return fits;
+		}
+	}
+
+	// Turns the instructions directly into x86 machine code. Jumps start out short (rel8) and are made near (rel32)
+	// until every one of them reaches its label. Jumps only ever grow, so this ends
+	static MachineCode encode(std::vector<AssemblyInstruction*>& instructions) {
+		using namespace Encoder;
+		MachineCode code;
+		std::vector<Fragment> fragments;
+		// Labels are at the start of the fragment after them
+		std::map<std::string, size_t> labels;
+		std::vector<std::pair<std::string, size_t>> functions;
+		for (size_t i = 0; i < instructions.size(); i++) {
+			AssemblyInstruction* instruction = instructions[i];
+			Fragment fragment;
+			switch (instruction->type) {
+			case AsmType::LABEL:
+			{
+				const std::string& name = static_cast<Asm1<std::string>*>(instruction)->data1;
+				labels[name] = fragments.size();
+				// A function starts with its stack frame
+				if (i + 1 < instructions.size() && instructions[i + 1]->type == AsmType::SETUP_SF) functions.push_back({ name, fragments.size() });
+				continue;
+			}
+			case AsmType::ALIGN:
+				fragment.alignment = 1 << static_cast<Asm1<uint32_t>*>(instruction)->data1;
+				break;
+			case AsmType::SECTION:
+				// Machine code is one piece, the cold blocks stay behind their function
+				continue;
+			case AsmType::TABLE_JUMP:
+			{
+				encode_table_address(fragment, static_cast<Asm1<std::string>*>(instruction)->data1);
+				// movsxd rax, DWORD PTR [rcx+rax*4] (mov on x86), add rax, rcx, jmp rax
+				std::vector<uint8_t> jump = { 0x63, 0x04, 0x81, 0x48, 0x01, 0xC8, 0xFF, 0xE0 };
+				if (target->pointer_size == 8) fragment.bytes.push_back(0x48);
+				else jump = { 0x8B, 0x04, 0x81, 0x01, 0xC8, 0xFF, 0xE0 };
+				fragment.bytes.insert(fragment.bytes.end(), jump.begin(), jump.end());
+				break;
+			}
+			case AsmType::TABLE_LOAD:
+			{
+				// mov eax, DWORD PTR [rcx+rax*4] or mov rax, QWORD PTR [rcx+rax*8]
+				auto as = static_cast<Asm2<std::string, uint8_t>*>(instruction);
+				encode_table_address(fragment, as->data1);
+				if (as->data2 == 8) fragment.bytes.insert(fragment.bytes.end(), { 0x48, 0x8B, 0x04, 0xC1 });
+				else fragment.bytes.insert(fragment.bytes.end(), { 0x8B, 0x04, 0x81 });
+				break;
+			}
+			case AsmType::JUMP_TABLE:
+			case AsmType::VALUE_TABLE:
+			{
+				// The table is aligned to its entries, its label is at the start of the entries
+				bool jump_table = instruction->type == AsmType::JUMP_TABLE;
+				Fragment alignment;
+				alignment.alignment = jump_table ? 4 : static_cast<Asm3<std::string, uint8_t, std::vector<std::string>>*>(instruction)->data2;
+				fragments.push_back(alignment);
+				if (jump_table) {
+					auto as = static_cast<Asm2<std::string, std::vector<std::string>>*>(instruction);
+					labels[as->data1] = fragments.size();
+					for (const std::string& entry : as->data2) {
+						fragment.fixups.push_back({ (uint32_t)fragment.bytes.size(), entry, as->data1, 0 });
+						put_bytes(fragment.bytes, 0, 4);
+					}
+				}
+				else {
+					auto as = static_cast<Asm3<std::string, uint8_t, std::vector<std::string>>*>(instruction);
+					labels[as->data1] = fragments.size();
+					for (const std::string& entry : as->data3) put_bytes(fragment.bytes, get_constant(entry), as->data2);
+				}
+				break;
+			}
+			case AsmType::STATIC_ADDRESS:
+			{
+				// lea reg, [rip+symbol] on x86_64, lea reg, [symbol] on x86. The ModR/M byte is the same
+				auto as = static_cast<Asm2<std::string, std::string>*>(instruction);
+				RegisterOperand reg = get_register(as->data1);
+				if (reg.size == 8) fragment.bytes.push_back(0x48);
+				fragment.bytes.insert(fragment.bytes.end(), { 0x8D, (uint8_t)(0x05 | ((reg.number & 7) << 3)), 0, 0, 0, 0 });
+				fragment.static_address = true;
+				fragment.target = as->data2;
+				break;
+			}
+			case AsmType::STATIC_ARRAY:
+			{
+				// The static arrays follow each other in .bss, 16 byte aligned
+				auto as = static_cast<Asm2<std::string, uint32_t>*>(instruction);
+				code.statics.push_back({ as->data1, code.bss_size, as->data2, false });
+				code.bss_size += (as->data2 + 15) & ~15u;
+				continue;
+			}
+			case AsmType::CALL:
+				fragment.call = true;
+				fragment.target = static_cast<Asm1<std::string>*>(instruction)->data1;
+				fragment.bytes = { 0xE8, 0, 0, 0, 0 };
+				break;
+			default:
+				if (instruction->type == AsmType::JUMP || is_conditional_jump(instruction->type)) {
+					fragment.jump = instruction->type;
+					fragment.target = static_cast<Asm1<std::string>*>(instruction)->data1;
+					break;
+				}
+				encode_instruction(fragment.bytes, instruction);
+				break;
+			}
+			fragments.push_back(fragment);
+		}
+		// Labels at the very end
+		fragments.push_back(Fragment());
+
+		for (Fragment& fragment : fragments) {
+			if (fragment.jump != AsmType::PROGRAM && !labels.count(fragment.target)) throw encoding_error("Jump to unknown label " + fragment.target);
+			for (const LabelFixup& fixup : fragment.fixups) {
+				if (!labels.count(fixup.target) || (!fixup.base.empty() && !labels.count(fixup.base))) throw encoding_error("Table of unknown label " + fixup.target);
+			}
+		}
+		uint32_t passes = 1;
+		while (!layout(fragments, labels)) ++passes;
+
+		uint32_t near_jumps = 0, short_jumps = 0;
+		for (Fragment& fragment : fragments) {
+			if (fragment.alignment) {
+				put_padding(code.text, fragment.size);
+				continue;
+			}
+			if (fragment.jump != AsmType::PROGRAM) {
+				int64_t distance = (int64_t)fragments[labels[fragment.target]].offset - (fragment.offset + fragment.size);
+				if (!fragment.near) {
+					code.text.push_back(fragment.jump == AsmType::JUMP ? 0xEB : 0x70 + get_condition_number(fragment.jump));
+					put_bytes(code.text, distance, 1);
+					++short_jumps;
+				}
+				else {
+					if (fragment.jump == AsmType::JUMP) code.text.push_back(0xE9);
+					else {
+						code.text.push_back(0x0F);
+						code.text.push_back(0x80 + get_condition_number(fragment.jump));
+					}
+					put_bytes(code.text, distance, 4);
+					++near_jumps;
+				}
+				continue;
+			}
+			if (fragment.call) {
+				// Calls of functions in this code are resolved here, others by the linker
+				auto label = labels.find(fragment.target);
+				if (label != labels.end()) {
+					int64_t distance = (int64_t)fragments[label->second].offset - (fragment.offset + fragment.size);
+					for (uint8_t i = 0; i < 4; i++) fragment.bytes[1 + i] = (distance >> (i * 8)) & 0xFF;
+				}
+				else code.relocations.push_back({ fragment.offset + 1, fragment.target });
+			}
+			if (fragment.static_address) code.relocations.push_back({ fragment.offset + fragment.size - 4, fragment.target, true });
+			for (const LabelFixup& fixup : fragment.fixups) {
+				uint32_t base = fixup.base.empty() ? fragment.offset + fixup.base_position : fragments[labels[fixup.base]].offset;
+				int64_t distance = (int64_t)fragments[labels[fixup.target]].offset - base;
+				for (uint8_t i = 0; i < 4; i++) fragment.bytes[fixup.position + i] = (distance >> (i * 8)) & 0xFF;
+			}
+			code.text.insert(code.text.end(), fragment.bytes.begin(), fragment.bytes.end());
+		}
+
+		for (size_t i = 0; i < functions.size(); i++) {
+			uint32_t start = fragments[functions[i].second].offset;
+			uint32_t end = i + 1 < functions.size() ? fragments[functions[i + 1].second].offset : code.text.size();
+			code.symbols.push_back({ functions[i].first, start, end - start, !functions[i].first.compare("main") });
+		}
+
+		Report::add_line("passes", "encoder wrote " + std::to_string(instructions.size()) + " instructions into " + std::to_string(code.text.size()) + " bytes, "
+			+ std::to_string(short_jumps) + " short and " + std::to_string(near_jumps) + " near jumps after " + std::to_string(passes) + " passes");
+		return code;
+	}
+}
@@ -6,29 +6,150 @@
 
 #include "assembler/instructions.h"
 #include "assembler/format.h"
+#include "assembler/target.h"
+#include "assembler/vector.h"
 #include "utils/strutils.h"
+#include "ast.h"
 
 namespace Bonfire {
 
+	// Instruction name of the two operand instructions
+	const char* get_op_mnemonic(AsmType type) {
+		switch (type) {
+		case AsmType::ADD_REG_REG: case AsmType::ADD_REG_MEM: case AsmType::ADD_REG_CONST: return "add";
+		case AsmType::SUB_REG_REG: case AsmType::SUB_REG_MEM: case AsmType::SUB_REG_CONST: return "sub";
+		case AsmType::IMUL_REG_REG: case AsmType::IMUL_REG_MEM: case AsmType::IMUL_REG_CONST: return "imul";
+		case AsmType::XOR_REG_REG: return "xor";
+		case AsmType::TEST_REG_REG: return "test";
+		default: return "err";
+		}
+	}
+
+	// Condition code of a conditional jump, used by setcc and cmovcc
+	const char* get_condition_code(AsmType type) {
+		switch (type) {
+		case AsmType::JUMP_EQ: return "e";
+		case AsmType::JUMP_NEQ: return "ne";
+		case AsmType::JUMP_GT: return "g";
+		case AsmType::JUMP_GTE: return "ge";
+		case AsmType::JUMP_LT: return "l";
+		case AsmType::JUMP_LTE: return "le";
+		case AsmType::JUMP_A: return "a";
+		case AsmType::JUMP_AE: return "ae";
+		case AsmType::JUMP_B: return "b";
+		case AsmType::JUMP_BE: return "be";
+		default: return "err";
+		}
+	}
+
+	// Memory operand of a variable on the stack, stack_offset bytes below the frame pointer
+	std::string get_memory_operand(const std::string& size, uint32_t stack_offset) {
+		return string_format(ASM_MEM, size.c_str(), get_register_name(Register::BP).c_str(), stack_offset);
+	}
+
+	// Memory operand of an argument that was passed on the stack, stack_offset bytes above the frame pointer
+	std::string get_argument_operand(const std::string& size, uint32_t stack_offset) {
+		return string_format(ASM_ARG, size.c_str(), get_register_name(Register::BP).c_str(), stack_offset);
+	}
+
+	// Number of bytes of an operand size (BYTE, WORD, ...)
+	uint8_t get_asm_size_bytes(const std::string& size) {
+		if (!size.compare(ASM_SIZE_8)) return 1;
+		if (!size.compare(ASM_SIZE_16)) return 2;
+		if (!size.compare(ASM_SIZE_64)) return 8;
+		return 4;
+	}
+
+	// Puts the address of a table into ecx (rcx)
+	std::string get_table_address(const std::string& table) {
+		std::string reg = get_register_name(Register::C);
+		if (target->pointer_size == 8) return string_format(ASM_TABLE_ADDRESS_64, reg.c_str(), table.c_str());
+		return string_format(ASM_TABLE_ADDRESS_32, table.c_str(), table.c_str(), reg.c_str(), reg.c_str(), table.c_str(), table.c_str());
+	}
+
+	// Memory operand of an element of an array, the index is in the accumulator. Arrays on the stack are addressed relative to
+	// the frame pointer, stack_offset bytes below it, all others relative to ecx (rcx)
+	std::string get_element_operand(Type element_type, const std::string& base, uint32_t stack_offset) {
+		uint8_t size = get_type_size(element_type);
+		std::string asm_size = size == 1 ? ASM_SIZE_8 : size == 2 ? ASM_SIZE_16 : size == 4 ? ASM_SIZE_32 : ASM_SIZE_64;
+		std::string index = get_register_name(Register::A);
+		if (stack_offset) return string_format(ASM_ELEMENT_STACK, asm_size.c_str(), base.c_str(), index.c_str(), size, stack_offset);
+		return string_format(ASM_ELEMENT, asm_size.c_str(), base.c_str(), index.c_str(), size);
+	}
+
+	// Memory operand of the elements of an array from element eax (rax) on, as many as fit into the vector register
+	std::string get_vector_operand(const std::string& vector_register, Type element_type, const std::string& base, uint32_t stack_offset) {
+		std::string element = get_element_operand(element_type, base, stack_offset);
+		return element.replace(0, element.find(' '), is_wide_vector_register(vector_register) ? ASM_SIZE_256 : ASM_SIZE_128);
+	}
+
+	// The lower 16 bytes of a vector register, for the instructions that only have them as an operand
+	std::string get_vector_low_half(const std::string& vector_register) {
+		return get_vector_register_name(get_vector_register_number(vector_register), 16);
+	}
+
+	// Moves between general purpose and vector registers: movd with 32-bit registers, movq with 64-bit ones
+	const char* get_vector_move(const std::string& reg) {
+		return reg.size() == 3 && reg[0] == 'r' ? "movq" : "movd";
+	}
+
+	// Source file the line table refers to (-g). Without it, no .file and .loc directives are written
+	std::string debug_source_name;
+
 	static std::string final_assemble(std::vector<AssemblyInstruction*>& instructions) {
 		std::stringstream stream;
 		std::cout << "Amount of Instructions: " << instructions.size() << std::endl;
+		bool in_function = false;
+		bool frame_closed = false;
+		std::string function_name;
+		uint32_t line = 0;
 		for (uint32_t i = 0; i < instructions.size(); i++) {
 			std::cout << "instruction " << i << " (";
-			switch (instructions[i]->type) {
+			AsmType type = instructions[i]->type;
+			// A function is a label followed by the frame setup, everything up to the next one is its code
+			bool function_start = type == AsmType::LABEL && i + 1 < instructions.size() && instructions[i + 1]->type == AsmType::SETUP_SF;
+			if (function_start) {
+				if (in_function) stream << ASM_CFI_ENDPROC;
+				in_function = true;
+				function_name = static_cast<Asm1<std::string>*>(instructions[i])->data1;
+				line = 0;
+			}
+			if (!debug_source_name.empty() && instructions[i]->line && instructions[i]->line != line
+				&& type != AsmType::LABEL && type != AsmType::ALIGN && type != AsmType::PROGRAM) {
+				line = instructions[i]->line;
+				stream << string_format(ASM_LOC, line);
+			}
+			switch (type) {
 			case AsmType::PROGRAM:
 				stream << ASM_PROGRAM;
+				if (!debug_source_name.empty()) stream << string_format(ASM_FILE, debug_source_name.c_str());
 				break;
 			case AsmType::SETUP_SF:
-				stream << ASM_SETUP_STACK_FRAME;
+			{
+				// data1 is the stack space the variables of the function need
+				auto as = static_cast<Asm1<uint32_t>*>(instructions[i]);
+				std::string bp = get_register_name(Register::BP);
+				std::string sp = get_register_name(Register::SP);
+				uint32_t pushed = 2 * target->pointer_size;
+				stream << string_format(ASM_SETUP_STACK_FRAME, bp.c_str(), pushed, bp.c_str(), pushed, bp.c_str(), sp.c_str(), bp.c_str());
+				if (as->data1) stream << string_format(ASM_ALLOC_STACK_FRAME, sp.c_str(), as->data1);
 				break;
+			}
 			case AsmType::CLOSE_SF:
-				stream << ASM_CLOSE_STACK_FRAME;
+			{
+				std::string bp = get_register_name(Register::BP);
+				std::string sp = get_register_name(Register::SP);
+				stream << ASM_CFI_REMEMBER_STATE;
+				stream << string_format(ASM_CLOSE_STACK_FRAME, sp.c_str(), bp.c_str(), bp.c_str());
+				stream << string_format(ASM_CFI_CLOSE_STACK_FRAME, sp.c_str(), target->pointer_size);
+				frame_closed = true;
 				break;
+			}
 			case AsmType::RETURN:
 				stream << ASM_RETURN;
 				break;
 			case AsmType::CALL:
+			case AsmType::HOOK:
 			{
 				auto as = static_cast<Asm1<std::string>*>(instructions[i]);
 				stream << string_format(ASM_CALL, as->data1.c_str());
@@ -38,7 +159,23 @@ namespace Bonfire {
 			case AsmType::MOVE_REG_MEM:
 			{
 				auto as = static_cast<Asm3<std::string, std::string, uint32_t>*>(instructions[i]);
-				stream << string_format(ASM_MOVE_REG_MEM, as->data1.c_str(), as->data2.c_str(), as->data3);
+				stream << string_format(ASM_MOVE_REG_MEM, as->data1.c_str(), get_memory_operand(as->data2, as->data3).c_str());
+				break;
+			}
+			case AsmType::MOVEZX_REG_MEM:
+			case AsmType::MOVESX_REG_MEM:
+			{
+				auto as = static_cast<Asm3<std::string, std::string, uint32_t>*>(instructions[i]);
+				// 32-bit values are sign extended with movsxd
+				const char* format = instructions[i]->type == AsmType::MOVEZX_REG_MEM ? ASM_MOVEZX_REG_MEM
+					: get_asm_size_bytes(as->data2) == 4 ? ASM_MOVESXD_REG_MEM : ASM_MOVESX_REG_MEM;
+				stream << string_format(format, as->data1.c_str(), get_memory_operand(as->data2, as->data3).c_str());
+				break;
+			}
+			case AsmType::MOVESXD_REG_REG:
+			{
+				auto as = static_cast<Asm2<std::string, std::string>*>(instructions[i]);
+				stream << string_format(ASM_MOVESXD_REG_REG, as->data1.c_str(), as->data2.c_str());
 				break;
 			}
 			case AsmType::MOVE_REG_REG:
@@ -53,28 +190,161 @@ namespace Bonfire {
 				stream << string_format(ASM_MOVE_REG_CONST, as->data1.c_str(), as->data2.c_str());
 				break;
 			}
+			case AsmType::MOVE_REG_ARG:
+			{
+				auto as = static_cast<Asm3<std::string, std::string, uint32_t>*>(instructions[i]);
+				// data1 is the whole register, smaller arguments are zero extended into it
+				const char* format = get_asm_size_bytes(as->data2) < 4 ? ASM_MOVEZX_REG_MEM : ASM_MOVE_REG_ARG;
+				stream << string_format(format, as->data1.c_str(), get_argument_operand(as->data2, as->data3).c_str());
+				break;
+			}
 			case AsmType::MOVE_MEM_MEM:
 			{
 				auto as = static_cast<Asm4<std::string, uint32_t, std::string, uint32_t>*>(instructions[i]);
-				stream << string_format(ASM_MOVE_MEM_MEM, "ebx", as->data1.c_str(), as->data2, as->data3.c_str(), as->data4, "ebx");
+				// Copies through the accumulator, nothing is kept in it between statements. Small values are loaded with movzx,
+				// writing only a part of the register would make the cpu merge it with the rest
+				std::string reg = get_register_name(Register::A, get_asm_size_bytes(as->data1));
+				if (get_asm_size_bytes(as->data1) < 4) {
+					stream << string_format(ASM_MOVEZX_REG_MEM, "eax", get_memory_operand(as->data1, as->data2).c_str());
+					stream << string_format(ASM_MOVE_MEM_REG, get_memory_operand(as->data3, as->data4).c_str(), reg.c_str());
+				}
+				else stream << string_format(ASM_MOVE_MEM_MEM, reg.c_str(), get_memory_operand(as->data1, as->data2).c_str(), get_memory_operand(as->data3, as->data4).c_str(), reg.c_str());
 				break;
 			}
 			case AsmType::MOVE_MEM_REG:
 			{
 				auto as = static_cast<Asm3<std::string, uint32_t, std::string>*>(instructions[i]);
-				stream << string_format(ASM_MOVE_MEM_REG, as->data1.c_str(), as->data2, as->data3.c_str());
+				stream << string_format(ASM_MOVE_MEM_REG, get_memory_operand(as->data1, as->data2).c_str(), as->data3.c_str());
 				break;
 			}
 			case AsmType::MOVE_MEM_CONST:
 			{
 				auto as = static_cast<Asm3<std::string, uint32_t, std::string>*>(instructions[i]);
-				stream << string_format(ASM_MOVE_MEM_CONST, as->data1.c_str(), as->data2, as->data3.c_str());
+				stream << string_format(ASM_MOVE_MEM_CONST, get_memory_operand(as->data1, as->data2).c_str(), as->data3.c_str());
 				break;
 			}
 			case AsmType::LABEL:
 			{
 				auto as = static_cast<Asm1<std::string>*>(instructions[i]);
 				stream << string_format(ASM_LABEL, as->data1.c_str());
+				if (function_start) stream << ASM_CFI_STARTPROC;
+				break;
+			}
+			case AsmType::SECTION:
+			{
+				// data1 is the section the code after it goes into. The cold blocks behind a function get a procedure of their own
+				auto as = static_cast<Asm1<std::string>*>(instructions[i]);
+				if (in_function) stream << ASM_CFI_ENDPROC;
+				in_function = false;
+				stream << string_format(ASM_SECTION, as->data1.c_str());
+				if (!as->data1.compare(ASM_SECTION_COLD)) {
+					std::string bp = get_register_name(Register::BP);
+					uint32_t pushed = 2 * target->pointer_size;
+					stream << string_format(ASM_COLD_LABEL, function_name.c_str());
+					stream << ASM_CFI_STARTPROC;
+					stream << string_format(ASM_CFI_FRAME_STATE, bp.c_str(), pushed, bp.c_str(), pushed);
+					in_function = true;
+				}
+				break;
+			}
+			case AsmType::ALIGN:
+			{
+				auto as = static_cast<Asm1<uint32_t>*>(instructions[i]);
+				stream << string_format(ASM_ALIGN, as->data1);
+				break;
+			}
+			case AsmType::COUNT:
+			{
+				// data1 is the index of the counter
+				auto as = static_cast<Asm1<uint32_t>*>(instructions[i]);
+				std::string counter = ASM_PROFILE_COUNTERS "+" + std::to_string(8 * as->data1);
+				if (target->pointer_size == 8) {
+					stream << string_format(ASM_COUNT, get_symbol_operand(ASM_SIZE_64, counter).c_str());
+				}
+				else {
+					stream << string_format(ASM_COUNT_32, get_symbol_operand(ASM_SIZE_32, counter).c_str(), get_symbol_operand(ASM_SIZE_32, counter + "+4").c_str());
+				}
+				break;
+			}
+			case AsmType::PUSH_REG:
+			{
+				auto as = static_cast<Asm1<std::string>*>(instructions[i]);
+				stream << string_format(ASM_PUSH_REG, as->data1.c_str());
+				break;
+			}
+			case AsmType::POP_REG:
+			{
+				auto as = static_cast<Asm1<std::string>*>(instructions[i]);
+				stream << string_format(ASM_POP_REG, as->data1.c_str());
+				break;
+			}
+			/////////////// ARITHMETIC
+			case AsmType::ADD_REG_REG:
+			case AsmType::SUB_REG_REG:
+			case AsmType::IMUL_REG_REG:
+			case AsmType::XOR_REG_REG:
+			case AsmType::TEST_REG_REG:
+			{
+				auto as = static_cast<Asm2<std::string, std::string>*>(instructions[i]);
+				stream << string_format(ASM_OP_REG_REG, get_op_mnemonic(instructions[i]->type), as->data1.c_str(), as->data2.c_str());
+				break;
+			}
+			case AsmType::ADD_REG_MEM:
+			case AsmType::SUB_REG_MEM:
+			case AsmType::IMUL_REG_MEM:
+			{
+				auto as = static_cast<Asm3<std::string, std::string, uint32_t>*>(instructions[i]);
+				stream << string_format(ASM_OP_REG_MEM, get_op_mnemonic(instructions[i]->type), as->data1.c_str(), get_memory_operand(as->data2, as->data3).c_str());
+				break;
+			}
+			case AsmType::ADD_REG_CONST:
+			case AsmType::SUB_REG_CONST:
+			case AsmType::IMUL_REG_CONST:
+			{
+				auto as = static_cast<Asm2<std::string, std::string>*>(instructions[i]);
+				stream << string_format(ASM_OP_REG_CONST, get_op_mnemonic(instructions[i]->type), as->data1.c_str(), as->data2.c_str());
+				break;
+			}
+			case AsmType::SIGN_EXTEND_ACC:
+				stream << ASM_SIGN_EXTEND_ACC;
+				break;
+			case AsmType::SIGN_EXTEND_ACC_64:
+				stream << ASM_SIGN_EXTEND_ACC_64;
+				break;
+			case AsmType::IDIV_REG:
+			{
+				auto as = static_cast<Asm1<std::string>*>(instructions[i]);
+				stream << string_format(ASM_IDIV_REG, as->data1.c_str());
+				break;
+			}
+			case AsmType::DIV_REG:
+			{
+				auto as = static_cast<Asm1<std::string>*>(instructions[i]);
+				stream << string_format(ASM_DIV_REG, as->data1.c_str());
+				break;
+			}
+			case AsmType::MOVEZX_REG_REG:
+			{
+				auto as = static_cast<Asm2<std::string, std::string>*>(instructions[i]);
+				stream << string_format(ASM_MOVEZX_REG_REG, as->data1.c_str(), as->data2.c_str());
+				break;
+			}
+			case AsmType::SET_COND:
+			{
+				auto as = static_cast<Asm2<AsmType, std::string>*>(instructions[i]);
+				stream << string_format(ASM_SET_COND, get_condition_code(as->data1), as->data2.c_str());
+				break;
+			}
+			case AsmType::CMOV_REG_REG:
+			{
+				auto as = static_cast<Asm3<AsmType, std::string, std::string>*>(instructions[i]);
+				stream << string_format(ASM_CMOV_REG_REG, get_condition_code(as->data1), as->data2.c_str(), as->data3.c_str());
+				break;
+			}
+			case AsmType::CMOV_REG_MEM:
+			{
+				auto as = static_cast<Asm4<AsmType, std::string, std::string, uint32_t>*>(instructions[i]);
+				stream << string_format(ASM_CMOV_REG_MEM, get_condition_code(as->data1), as->data2.c_str(), get_memory_operand(as->data3, as->data4).c_str());
 				break;
 			}
 			//////////////// COMPARE
@@ -88,7 +358,7 @@ namespace Bonfire {
 			case AsmType::COMP_CONST_MEM:
 			{
 				auto as = static_cast<Asm3<std::string, std::string, uint32_t>*>(instructions[i]);
-				stream << string_format(CMP_CONST_MEM, as->data1.c_str(), as->data2.c_str(), as->data3);
+				stream << string_format(CMP_CONST_MEM, as->data1.c_str(), get_memory_operand(as->data2, as->data3).c_str());
 				break;
 			}
 			case AsmType::COMP_CONST_REG:
@@ -101,19 +371,24 @@ namespace Bonfire {
 			case AsmType::COMP_MEM_CONST:
 			{
 				auto as = static_cast<Asm3<std::string, uint32_t, std::string>*>(instructions[i]);
-				stream << string_format(CMP_MEM_CONST, as->data1.c_str(), as->data2, as->data3.c_str());
+				stream << string_format(CMP_MEM_CONST, get_memory_operand(as->data1, as->data2).c_str(), as->data3.c_str());
 				break;
 			}
 			case AsmType::COMP_MEM_MEM:
 			{
 				auto as = static_cast<Asm4<std::string, uint32_t, std::string, uint32_t>*>(instructions[i]);
-				stream << string_format(CMP_MEM_MEM, "ebx", as->data1.c_str(), as->data2, "ebx", as->data3.c_str(), as->data4);
+				std::string reg = get_register_name(Register::A, get_asm_size_bytes(as->data1));
+				if (get_asm_size_bytes(as->data1) < 4) {
+					stream << string_format(ASM_MOVEZX_REG_MEM, "eax", get_memory_operand(as->data1, as->data2).c_str());
+					stream << string_format(CMP_REG_MEM, reg.c_str(), get_memory_operand(as->data3, as->data4).c_str());
+				}
+				else stream << string_format(CMP_MEM_MEM, reg.c_str(), get_memory_operand(as->data1, as->data2).c_str(), reg.c_str(), get_memory_operand(as->data3, as->data4).c_str());
 				break;
 			}
 			case AsmType::COMP_MEM_REG:
 			{
 				auto as = static_cast<Asm3<std::string, uint32_t, std::string>*>(instructions[i]);
-				stream << string_format(CMP_MEM_REG, as->data1.c_str(), as->data2, as->data3.c_str());
+				stream << string_format(CMP_MEM_REG, get_memory_operand(as->data1, as->data2).c_str(), as->data3.c_str());
 				break;
 			}
 			// REGISTERS
@@ -126,7 +401,7 @@ namespace Bonfire {
 			case AsmType::COMP_REG_MEM:
 			{
 				auto as = static_cast<Asm3<std::string, std::string, uint32_t>*>(instructions[i]);
-				stream << string_format(CMP_REG_MEM, as->data1.c_str(), as->data2.c_str(), as->data3);
+				stream << string_format(CMP_REG_MEM, as->data1.c_str(), get_memory_operand(as->data2, as->data3).c_str());
 				break;
 			}
 			case AsmType::COMP_REG_REG:
@@ -178,9 +453,175 @@ namespace Bonfire {
 				stream << string_format(JMP_LTE, as->data1.c_str());
 				break;
 			}
+			case AsmType::JUMP_A:
+			{
+				auto as = static_cast<Asm1<std::string>*>(instructions[i]);
+				stream << string_format(JMP_A, as->data1.c_str());
+				break;
+			}
+			case AsmType::JUMP_AE:
+			{
+				auto as = static_cast<Asm1<std::string>*>(instructions[i]);
+				stream << string_format(JMP_AE, as->data1.c_str());
+				break;
+			}
+			case AsmType::JUMP_B:
+			{
+				auto as = static_cast<Asm1<std::string>*>(instructions[i]);
+				stream << string_format(JMP_B, as->data1.c_str());
+				break;
+			}
+			case AsmType::JUMP_BE:
+			{
+				auto as = static_cast<Asm1<std::string>*>(instructions[i]);
+				stream << string_format(JMP_BE, as->data1.c_str());
+				break;
+			}
+			//////////////// TABLES
+			case AsmType::TABLE_JUMP:
+			{
+				auto as = static_cast<Asm1<std::string>*>(instructions[i]);
+				std::string acc = get_register_name(Register::A);
+				std::string base = get_register_name(Register::C);
+				stream << get_table_address(as->data1);
+				stream << string_format(target->pointer_size == 8 ? ASM_TABLE_JUMP_64 : ASM_TABLE_JUMP_32, acc.c_str(), base.c_str(), acc.c_str(), acc.c_str(), base.c_str(), acc.c_str());
+				break;
+			}
+			case AsmType::TABLE_LOAD:
+			{
+				auto as = static_cast<Asm2<std::string, uint8_t>*>(instructions[i]);
+				stream << get_table_address(as->data1);
+				stream << string_format(ASM_TABLE_LOAD, get_register_name(Register::A, as->data2).c_str(), as->data2 == 8 ? ASM_SIZE_64 : ASM_SIZE_32,
+					get_register_name(Register::C).c_str(), get_register_name(Register::A).c_str(), as->data2);
+				break;
+			}
+			case AsmType::JUMP_TABLE:
+			{
+				auto as = static_cast<Asm2<std::string, std::vector<std::string>>*>(instructions[i]);
+				stream << string_format(ASM_ALIGN, 2);
+				stream << string_format(ASM_LABEL, as->data1.c_str());
+				for (const std::string& entry : as->data2) stream << string_format(ASM_JUMP_TABLE_ENTRY, entry.c_str(), as->data1.c_str());
+				break;
+			}
+			case AsmType::VALUE_TABLE:
+			{
+				auto as = static_cast<Asm3<std::string, uint8_t, std::vector<std::string>>*>(instructions[i]);
+				stream << string_format(ASM_ALIGN, as->data2 == 8 ? 3 : 2);
+				stream << string_format(ASM_LABEL, as->data1.c_str());
+				for (const std::string& entry : as->data3) stream << string_format(as->data2 == 8 ? ASM_TABLE_ENTRY_64 : ASM_TABLE_ENTRY_32, entry.c_str());
+				break;
+			}
+			//////////////// ARRAYS
+			case AsmType::LOAD_ELEMENT:
+			{
+				// Into eax or rax, extended like assemble_load_variable does it. A bigger element is cut to its lower bytes
+				auto as = static_cast<Asm4<std::string, Type, std::string, uint32_t>*>(instructions[i]);
+				uint8_t size = get_type_size(as->data2);
+				uint8_t reg_size = as->data1.compare(get_register_name(Register::A, 8)) ? 4 : 8;
+				std::string element = get_element_operand(as->data2, as->data3, as->data4);
+				if (size > reg_size) element.replace(0, element.find(' '), ASM_SIZE_32);
+				const char* format = ASM_MOVE_REG_MEM;
+				std::string reg = as->data1;
+				if (size == 4 && !is_signed_integer_type(as->data2)) reg = "eax";
+				else if (size < reg_size) format = !is_signed_integer_type(as->data2) ? ASM_MOVEZX_REG_MEM : size == 4 ? ASM_MOVESXD_REG_MEM : ASM_MOVESX_REG_MEM;
+				stream << string_format(format, reg.c_str(), element.c_str());
+				break;
+			}
+			case AsmType::STORE_ELEMENT:
+			{
+				auto as = static_cast<Asm4<std::string, Type, std::string, uint32_t>*>(instructions[i]);
+				stream << string_format(ASM_MOVE_MEM_REG, get_element_operand(as->data2, as->data3, as->data4).c_str(), as->data1.c_str());
+				break;
+			}
+			case AsmType::LEA_REG_MEM:
+			{
+				auto as = static_cast<Asm2<std::string, uint32_t>*>(instructions[i]);
+				stream << string_format(ASM_LEA_REG_MEM, as->data1.c_str(), get_register_name(Register::BP).c_str(), as->data2);
+				break;
+			}
+			case AsmType::STATIC_ADDRESS:
+			{
+				auto as = static_cast<Asm2<std::string, std::string>*>(instructions[i]);
+				stream << string_format(target->pointer_size == 8 ? ASM_STATIC_ADDRESS_64 : ASM_STATIC_ADDRESS_32, as->data1.c_str(), as->data2.c_str());
+				break;
+			}
+			case AsmType::ZERO_MEM:
+			{
+				auto as = static_cast<Asm2<uint32_t, uint32_t>*>(instructions[i]);
+				if (target->pointer_size == 8) stream << string_format(ASM_ZERO_MEM_64, as->data1, as->data2 / 8);
+				else stream << string_format(ASM_ZERO_MEM_32, as->data1, as->data2 / 4);
+				break;
+			}
+			case AsmType::TRAP:
+				stream << ASM_TRAP;
+				break;
+			case AsmType::STATIC_ARRAY:
+			{
+				auto as = static_cast<Asm2<std::string, uint32_t>*>(instructions[i]);
+				stream << string_format(ASM_STATIC_ARRAY, as->data1.c_str(), as->data1.c_str(), as->data2);
+				break;
+			}
+			//////////////// VECTORS
+			case AsmType::VECTOR_LOAD:
+			case AsmType::VECTOR_STORE:
+			{
+				auto as = static_cast<Asm4<std::string, Type, std::string, uint32_t>*>(instructions[i]);
+				const char* vex = is_wide_vector_register(as->data1) ? "v" : "";
+				std::string memory = get_vector_operand(as->data1, as->data2, as->data3, as->data4);
+				if (type == AsmType::VECTOR_LOAD) stream << string_format(ASM_VECTOR_MOVE, vex, as->data1.c_str(), memory.c_str());
+				else stream << string_format(ASM_VECTOR_MOVE, vex, memory.c_str(), as->data1.c_str());
+				break;
+			}
+			case AsmType::VECTOR_OP:
+			{
+				auto as = static_cast<Asm4<VectorOp, Type, std::string, std::string>*>(instructions[i]);
+				const char* mnemonic = get_vector_encoding(as->data1, as->data2).mnemonic;
+				bool vex = is_wide_vector_register(as->data3);
+				if (as->data1 == VectorOp::BROADCAST) {
+					stream << string_format(ASM_VECTOR_OP, "v", mnemonic, as->data3.c_str(), get_vector_low_half(as->data4).c_str());
+				}
+				else if (!vex || as->data1 == VectorOp::MOVE) stream << string_format(ASM_VECTOR_OP, vex ? "v" : "", mnemonic, as->data3.c_str(), as->data4.c_str());
+				else stream << string_format(ASM_VECTOR_OP_VEX, mnemonic, as->data3.c_str(), as->data3.c_str(), as->data4.c_str());
+				break;
+			}
+			case AsmType::VECTOR_OP_CONST:
+			{
+				auto as = static_cast<Asm4<VectorOp, std::string, std::string, uint32_t>*>(instructions[i]);
+				const char* mnemonic = get_vector_encoding(as->data1, Type::UINT8).mnemonic;
+				bool vex = is_wide_vector_register(as->data3);
+				if (as->data1 == VectorOp::EXTRACT_HIGH) {
+					stream << string_format(ASM_VECTOR_OP_CONST_3, "v", mnemonic, get_vector_low_half(as->data2).c_str(), as->data3.c_str(), as->data4);
+				}
+				else if (as->data1 == VectorOp::SHIFT_BYTES && !vex) stream << string_format(ASM_VECTOR_OP_CONST, mnemonic, as->data2.c_str(), as->data4);
+				else stream << string_format(ASM_VECTOR_OP_CONST_3, vex ? "v" : "", mnemonic, as->data2.c_str(), as->data3.c_str(), as->data4);
+				break;
+			}
+			case AsmType::VECTOR_FROM_REG:
+			{
+				auto as = static_cast<Asm2<std::string, std::string>*>(instructions[i]);
+				const char* move = get_vector_move(as->data2);
+				stream << string_format(ASM_VECTOR_MOVE_REG, is_wide_vector_register(as->data1) ? "v" : "", move, get_vector_low_half(as->data1).c_str(), as->data2.c_str());
+				break;
+			}
+			case AsmType::VECTOR_TO_REG:
+			{
+				auto as = static_cast<Asm2<std::string, std::string>*>(instructions[i]);
+				const char* move = get_vector_move(as->data1);
+				stream << string_format(ASM_VECTOR_MOVE_REG, is_wide_vector_register(as->data2) ? "v" : "", move, as->data1.c_str(), get_vector_low_half(as->data2).c_str());
+				break;
+			}
+			case AsmType::VECTOR_ZERO_UPPER:
+				stream << ASM_VECTOR_ZERO_UPPER;
+				break;
+			}
+			// The return (or the jump of a tail call) leaves the function, the code behind it has the frame again
+			if (frame_closed && (type == AsmType::RETURN || type == AsmType::JUMP)) {
+				stream << ASM_CFI_RESTORE_STATE;
+				frame_closed = false;
 			}
 			std::cout << ")" << std::endl;
 		}
+		if (in_function) stream << ASM_CFI_ENDPROC;
 		std::cout << "I knew it!" << std::endl;
 		return stream.str();
 	}
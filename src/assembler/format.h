@@ -7,31 +7,51 @@
 
 #define ASM_PROGRAM "\t.intel_syntax noprefix\n\t.global main\n\t.text\n"
 
-#define ASM_SETUP_STACK_FRAME "\tpush ebp\n\tmov ebp, esp\n"
-#define ASM_CLOSE_STACK_FRAME "\tpop ebp\n"
+// Registers and memory operands come from the target (see target.h), a memory operand looks like ASM_MEM
+#define ASM_MEM "%s PTR [%s-%u]"
+// Arguments on the stack are above the return address
+#define ASM_ARG "%s PTR [%s+%u]"
+
+// With call frame information: the return address is at CFA-pointer size, the frame pointer is pushed below it
+// and the CFA is relative to it from then on
+#define ASM_SETUP_STACK_FRAME "\tpush %s\n\t.cfi_def_cfa_offset %u\n\t.cfi_offset %s, -%u\n\tmov %s, %s\n\t.cfi_def_cfa_register %s\n"
+#define ASM_ALLOC_STACK_FRAME "\tsub %s, %u\n"
+#define ASM_CLOSE_STACK_FRAME "\tmov %s, %s\n\tpop %s\n"
+// After the frame is closed, the CFA is relative to the stack pointer again. The code behind the return still has the frame
+#define ASM_CFI_CLOSE_STACK_FRAME "\t.cfi_def_cfa %s, %u\n"
+#define ASM_CFI_REMEMBER_STATE "\t.cfi_remember_state\n"
+#define ASM_CFI_RESTORE_STATE "\t.cfi_restore_state\n"
+#define ASM_CFI_STARTPROC "\t.cfi_startproc\n"
+#define ASM_CFI_ENDPROC "\t.cfi_endproc\n"
 #define ASM_RETURN "\tret\n"
 
 #define ASM_LABEL "%s:\n"
+#define ASM_ALIGN "\t.p2align %u\n"
 #define ASM_CALL "\tcall %s\n"
 
-#define ASM_MOVE_REG_MEM "\tmov %s, %s PTR [ebp-%u]\n"
+// Line table: every instruction after .loc was generated for that line of the source file
+#define ASM_FILE "\t.file 1 \"%s\"\n"
+#define ASM_LOC "\t.loc 1 %u\n"
+
+#define ASM_MOVE_REG_MEM "\tmov %s, %s\n"
 #define ASM_MOVE_REG_REG "\tmov %s, %s\n"
 #define ASM_MOVE_REG_CONST "\tmov %s, %s\n"
+#define ASM_MOVE_REG_ARG "\tmov %s, %s\n"
 
-#define ASM_MOVE_MEM_MEM "\tmov %s, %s PTR [ebp-%u]\n\tmov %s PTR [ebp-%u], %s\n"
-#define ASM_MOVE_MEM_REG "\tmov %s PTR [ebp-%u], %s\n"
-#define ASM_MOVE_MEM_CONST "\tmov %s PTR [ebp-%u], %s\n"
+#define ASM_MOVE_MEM_MEM "\tmov %s, %s\n\tmov %s, %s\n"
+#define ASM_MOVE_MEM_REG "\tmov %s, %s\n"
+#define ASM_MOVE_MEM_CONST "\tmov %s, %s\n"
 
 #define CMP_CONST_CONST "\tcmp %s, %s\n"
-#define CMP_CONST_MEM "\tcmp %s, %s PTR [ebp-%u]\n"
+#define CMP_CONST_MEM "\tcmp %s, %s\n"
 #define CMP_CONST_REG "\tcmp %s, %s\n"
 
-#define CMP_MEM_CONST "\tcmp %s PTR [ebp-%u], %s\n"
-#define CMP_MEM_MEM "\tmov %s, %s PTR [ebp-%u]\n\tcmp %s, %s PTR [ebp-%u]"
-#define CMP_MEM_REG "\tcmp %s PTR [ebp-%u], %s\n"
+#define CMP_MEM_CONST "\tcmp %s, %s\n"
+#define CMP_MEM_MEM "\tmov %s, %s\n\tcmp %s, %s\n"
+#define CMP_MEM_REG "\tcmp %s, %s\n"
 
 #define CMP_REG_CONST "\tcmp %s, %s\n"
-#define CMP_REG_MEM "\tcmp %s, %s PTR [ebp-%u]\n"
+#define CMP_REG_MEM "\tcmp %s, %s\n"
 #define CMP_REG_REG "\tcmp %s, %s\n"
 
 #define JMP "\tjmp %s\n"
@@ -40,4 +60,81 @@
 #define JMP_GT "\tjg %s\n"
 #define JMP_GTE "\tjge %s\n"
 #define JMP_LT "\tjl %s\n"
-#define JMP_LTE "\tjle %s\n"
\ No newline at end of file
+#define JMP_LTE "\tjle %s\n"
+#define JMP_A "\tja %s\n"
+#define JMP_AE "\tjae %s\n"
+#define JMP_B "\tjb %s\n"
+#define JMP_BE "\tjbe %s\n"
+
+#define ASM_PUSH_REG "\tpush %s\n"
+#define ASM_POP_REG "\tpop %s\n"
+
+// Two operand instructions (add, sub, imul, xor, test), the first %s is the instruction
+#define ASM_OP_REG_REG "\t%s %s, %s\n"
+#define ASM_OP_REG_MEM "\t%s %s, %s\n"
+#define ASM_OP_REG_CONST "\t%s %s, %s\n"
+
+#define ASM_SIGN_EXTEND_ACC "\tcdq\n"
+#define ASM_SIGN_EXTEND_ACC_64 "\tcqo\n"
+#define ASM_IDIV_REG "\tidiv %s\n"
+#define ASM_DIV_REG "\tdiv %s\n"
+
+#define ASM_MOVEZX_REG_REG "\tmovzx %s, %s\n"
+// Loads of values smaller than the register fill the rest of it
+#define ASM_MOVEZX_REG_MEM "\tmovzx %s, %s\n"
+#define ASM_MOVESX_REG_MEM "\tmovsx %s, %s\n"
+#define ASM_MOVESXD_REG_MEM "\tmovsxd %s, %s\n"
+#define ASM_MOVESXD_REG_REG "\tmovsxd %s, %s\n"
+// The first %s is the condition code (e, ne, g, ...)
+#define ASM_SET_COND "\tset%s %s\n"
+#define ASM_CMOV_REG_REG "\tcmov%s %s, %s\n"
+#define ASM_CMOV_REG_MEM "\tcmov%s %s, %s\n"
+
+// Profile counters (--profile-generate) are 64 bits, x86 adds the carry into the upper half
+#define ASM_PROFILE_COUNTERS "__bonfire_counters"
+#define ASM_COUNT "\tadd %s, 1\n"
+#define ASM_COUNT_32 "\tadd %s, 1\n\tadc %s, 0\n"
+
+// Code that hardly runs goes into its own section, so the hot code of all functions stays together
+#define ASM_SECTION_TEXT ".text"
+#define ASM_SECTION_COLD ".text.unlikely"
+#define ASM_SECTION "\t.section %s,\"ax\",@progbits\n"
+#define ASM_COLD_LABEL "%s.cold:\n"
+// The cold part of a function is a procedure of its own for the unwinder, it starts with the frame already set up
+#define ASM_CFI_FRAME_STATE "\t.cfi_def_cfa %s, %u\n\t.cfi_offset %s, -%u\n"
+
+// Tables of matches (??) are in the code behind the jump that uses them. Their address is relative to rip on x86_64,
+// x86 gets it from the return address of a call to the next instruction
+#define ASM_TABLE_ADDRESS_64 "\tlea %s, [rip+%s]\n"
+#define ASM_TABLE_ADDRESS_32 "\tcall %s_base\n%s_base:\n\tpop %s\n\tadd %s, OFFSET %s - %s_base\n"
+// The entries of a jump table are the distances of the labels to the table
+#define ASM_TABLE_JUMP_64 "\tmovsxd %s, DWORD PTR [%s+%s*4]\n\tadd %s, %s\n\tjmp %s\n"
+#define ASM_TABLE_JUMP_32 "\tmov %s, DWORD PTR [%s+%s*4]\n\tadd %s, %s\n\tjmp %s\n"
+#define ASM_TABLE_LOAD "\tmov %s, %s PTR [%s+%s*%u]\n"
+#define ASM_JUMP_TABLE_ENTRY "\t.long %s - %s\n"
+#define ASM_TABLE_ENTRY_32 "\t.long %s\n"
+#define ASM_TABLE_ENTRY_64 "\t.quad %s\n"
+
+// Elements of arrays: the index is in the accumulator, the base is the frame pointer (arrays on the stack) or ecx (rcx)
+#define ASM_ELEMENT "%s PTR [%s+%s*%u]"
+#define ASM_ELEMENT_STACK "%s PTR [%s+%s*%u-%u]"
+#define ASM_LEA_REG_MEM "\tlea %s, [%s-%u]\n"
+#define ASM_STATIC_ADDRESS_64 "\tlea %s, [rip+%s]\n"
+#define ASM_STATIC_ADDRESS_32 "\tlea %s, [%s]\n"
+// rep stos writes ecx times eax (rax) from edi (rdi) on. edi has to be kept on x86
+#define ASM_ZERO_MEM_64 "\tlea rdi, [rbp-%u]\n\txor eax, eax\n\tmov ecx, %u\n\trep stosq\n"
+#define ASM_ZERO_MEM_32 "\tpush edi\n\tlea edi, [ebp-%u]\n\txor eax, eax\n\tmov ecx, %u\n\trep stosd\n\tpop edi\n"
+#define ASM_TRAP "\tud2\n"
+// Static arrays are in .bss, which is zeroed when the program is loaded
+#define ASM_STATIC_ARRAY "\t.local %s\n\t.comm %s,%u,16\n"
+
+// Packed integers. VEX encoded instructions (v...) have a separate destination, the others change their first operand
+#define ASM_SIZE_128 "XMMWORD"
+#define ASM_SIZE_256 "YMMWORD"
+#define ASM_VECTOR_MOVE "\t%smovdqu %s, %s\n"
+#define ASM_VECTOR_OP "\t%s%s %s, %s\n"
+#define ASM_VECTOR_OP_VEX "\tv%s %s, %s, %s\n"
+#define ASM_VECTOR_OP_CONST "\t%s %s, %u\n"
+#define ASM_VECTOR_OP_CONST_3 "\t%s%s %s, %s, %u\n"
+#define ASM_VECTOR_MOVE_REG "\t%s%s %s, %s\n"
+#define ASM_VECTOR_ZERO_UPPER "\tvzeroupper\n"
\ No newline at end of file
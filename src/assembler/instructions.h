@@ -33,7 +33,57 @@ namespace Bonfire {
 		JUMP_GT,
 		JUMP_GTE,
 		JUMP_LT,
-		JUMP_LTE
+		JUMP_LTE,
+		JUMP_A,		// Unsigned >
+		JUMP_AE,	// Unsigned >=
+		JUMP_B,		// Unsigned <
+		JUMP_BE,	// Unsigned <=
+		PUSH_REG,
+		POP_REG,
+		ADD_REG_REG,
+		ADD_REG_MEM,
+		ADD_REG_CONST,
+		SUB_REG_REG,
+		SUB_REG_MEM,
+		SUB_REG_CONST,
+		IMUL_REG_REG,
+		IMUL_REG_MEM,
+		IMUL_REG_CONST,
+		SIGN_EXTEND_ACC,	// cdq: Sign extend eax into edx, before a signed division
+		SIGN_EXTEND_ACC_64,	// cqo: Sign extend rax into rdx
+		IDIV_REG,
+		DIV_REG,
+		XOR_REG_REG,
+		TEST_REG_REG,
+		ALIGN,
+		MOVEZX_REG_REG,
+		SET_COND,		// setcc, the condition is given as the conditional jump that would be taken
+		CMOV_REG_REG,	// cmovcc, the condition is given like for SET_COND
+		CMOV_REG_MEM,
+		MOVE_REG_ARG,	// Loads an argument that was passed on the stack
+		MOVESXD_REG_REG,	// Sign extends a 32-bit register into a 64-bit one
+		COUNT,			// Adds 1 to a 64-bit profile counter (--profile-generate), data1 is its index
+		HOOK,			// Calls a runtime hook that keeps every register (--instrument), data1 is its symbol
+		SECTION,		// The code after it goes into the section data1 (cold blocks go into .text.unlikely)
+		TABLE_JUMP,		// Jumps to entry eax (rax) of the jump table data1
+		TABLE_LOAD,		// Loads entry eax (rax) of the value table data1 into eax (rax), data2 is the size of the entries
+		JUMP_TABLE,		// Table data1 of the labels data2, as their distance to the table
+		VALUE_TABLE,	// Table data1 of the constants data3, data2 bytes each
+		LOAD_ELEMENT,	// Loads the element rax (eax) of type data2 at data3 + data4 into the register data1, extended by its type
+		STORE_ELEMENT,	// Stores the register data1 into the element rax (eax) of type data2 at data3 + data4
+		LEA_REG_MEM,	// Puts the address of the variable data2 into the register data1
+		STATIC_ADDRESS,	// Puts the address of the static array data2 into the register data1
+		ZERO_MEM,		// Zeroes data2 bytes (a multiple of 8) from the variable data1 on
+		TRAP,			// ud2, a failed bounds check
+		STATIC_ARRAY,	// Static array data1 of data2 bytes, zeroed once before the program starts
+		// Packed integers in the vector registers xmm0-xmm7 (ymm0-ymm7 with AVX2, see assembler/vector.h)
+		VECTOR_LOAD,	// Loads the elements of type data2 at data3 + data4 from element rax (eax) on into the vector register data1
+		VECTOR_STORE,	// Stores the vector register data1 into the elements of type data2 at data3 + data4 from element rax (eax) on
+		VECTOR_OP,		// Operation data1 on elements of type data2: data3 = data3 op data4
+		VECTOR_OP_CONST,	// Operation data1 with the immediate data4: data2 = op(data3, data4)
+		VECTOR_FROM_REG,	// Moves the general purpose register data2 into the lowest element of data1, the others become 0
+		VECTOR_TO_REG,		// Moves the lowest element of data2 into the general purpose register data1
+		VECTOR_ZERO_UPPER	// vzeroupper, after code with ymm registers
 	};
 
 	const char* asmtype_to_string(AsmType type) {
@@ -50,13 +100,82 @@ namespace Bonfire {
 				return "Return";
 			case AsmType::MOVE_REG_MEM:
 				return "Move Reg Mem";
+			case AsmType::COUNT:
+				return "Count";
+			case AsmType::HOOK:
+				return "Hook";
+			case AsmType::SECTION:
+				return "Section";
+			case AsmType::TABLE_JUMP:
+				return "Table Jump";
+			case AsmType::TABLE_LOAD:
+				return "Table Load";
+			case AsmType::JUMP_TABLE:
+				return "Jump Table";
+			case AsmType::VALUE_TABLE:
+				return "Value Table";
+			case AsmType::LOAD_ELEMENT:
+				return "Load Element";
+			case AsmType::STORE_ELEMENT:
+				return "Store Element";
+			case AsmType::STATIC_ADDRESS:
+				return "Static Address";
+			case AsmType::ZERO_MEM:
+				return "Zero Memory";
+			case AsmType::TRAP:
+				return "Trap";
+			case AsmType::STATIC_ARRAY:
+				return "Static Array";
+			case AsmType::VECTOR_LOAD:
+				return "Vector Load";
+			case AsmType::VECTOR_STORE:
+				return "Vector Store";
+			case AsmType::VECTOR_OP:
+				return "Vector Op";
+			case AsmType::VECTOR_OP_CONST:
+				return "Vector Op Const";
+			case AsmType::VECTOR_FROM_REG:
+				return "Vector From Reg";
+			case AsmType::VECTOR_TO_REG:
+				return "Vector To Reg";
+			case AsmType::VECTOR_ZERO_UPPER:
+				return "Vector Zero Upper";
 			default:
 				return "Other";
 		}
 	}
 
+	bool is_conditional_jump(AsmType type) {
+		switch (type) {
+		case AsmType::JUMP_EQ: case AsmType::JUMP_NEQ:
+		case AsmType::JUMP_GT: case AsmType::JUMP_GTE: case AsmType::JUMP_LT: case AsmType::JUMP_LTE:
+		case AsmType::JUMP_A: case AsmType::JUMP_AE: case AsmType::JUMP_B: case AsmType::JUMP_BE:
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	// The conditional jump that is taken exactly when the given one is not
+	AsmType invert_jump(AsmType type) {
+		switch (type) {
+		case AsmType::JUMP_EQ:	return AsmType::JUMP_NEQ;
+		case AsmType::JUMP_NEQ:	return AsmType::JUMP_EQ;
+		case AsmType::JUMP_GT:	return AsmType::JUMP_LTE;
+		case AsmType::JUMP_GTE:	return AsmType::JUMP_LT;
+		case AsmType::JUMP_LT:	return AsmType::JUMP_GTE;
+		case AsmType::JUMP_LTE:	return AsmType::JUMP_GT;
+		case AsmType::JUMP_A:	return AsmType::JUMP_BE;
+		case AsmType::JUMP_AE:	return AsmType::JUMP_B;
+		case AsmType::JUMP_B:	return AsmType::JUMP_AE;
+		case AsmType::JUMP_BE:	return AsmType::JUMP_A;
+		default: return type;
+		}
+	}
+
 	struct AssemblyInstruction {
 		AsmType type;
+		uint32_t line = 0;	// Source line of the statement it was generated for, 0 if unknown
 
 		AssemblyInstruction() {}
 
@@ -0,0 +1,133 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include <cstdint>
+#include <cstring>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "assembler/encoder.h"
+#include "assembler/target.h"
+#include "ast.h"
+
+namespace Bonfire {
+
+	// Exception to throw if the code can't be run in the compiler process
+	class jit_error : std::exception {
+	public:
+		std::string message;
+		jit_error(const std::string& message) {
+			this->message = message;
+		}
+	};
+
+	namespace Jit {
+		// Functions of the compiler process the generated code can call, by symbol name. Calls of other symbols
+		// can't be linked
+		std::map<std::string, void*> runtime_symbols;
+
+		// jmp QWORD PTR [rip+0], followed by the address. Calls from the code reach it with a rel32, wherever in the
+		// 64-bit address space the runtime function is
+		const uint32_t STUB_SIZE = 14;
+
+		// The target the compiler process itself runs on, NULL if it is none of ours
+		const Target* get_host_target() {
+#if defined(__x86_64__)
+			return &TARGET_X86_64;
+#elif defined(__i386__)
+			return &TARGET_X86;
+#else
+			return NULL;
+#endif
+		}
+
+		void put_rel32(uint8_t* at, int64_t distance) {
+			for (uint8_t i = 0; i < 4; i++) at[i] = (distance >> (i * 8)) & 0xFF;
+		}
+
+		// Only the part of the accumulator that holds a value of the type is defined
+		int64_t extend_result(int64_t value, Type type) {
+			switch (get_type_size(type)) {
+			case 1: return is_signed_integer_type(type) ? (int64_t)(int8_t)value : (int64_t)(uint8_t)value;
+			case 2: return is_signed_integer_type(type) ? (int64_t)(int16_t)value : (int64_t)(uint16_t)value;
+			case 4: return is_signed_integer_type(type) ? (int64_t)(int32_t)value : (int64_t)(uint32_t)value;
+			default: return value;
+			}
+		}
+	}
+
+	// Runs the code in the compiler process: it is copied into fresh pages, the calls of runtime functions are linked,
+	// and the pages are made executable (and no longer writable) before main is called. The static arrays are in zeroed
+	// pages behind the code, which stay writable. Returns what main returned,
+	// as a value of its return type
+	static int64_t run_in_memory(const MachineCode& code, Type return_type) {
+		using namespace Jit;
+		if (target != get_host_target()) throw jit_error("The code has to be generated for the target the compiler runs on");
+		const CodeSymbol* main_symbol = NULL;
+		for (const CodeSymbol& symbol : code.symbols) {
+			if (!symbol.name.compare("main")) main_symbol = &symbol;
+		}
+		if (!main_symbol) throw jit_error("There is no main function");
+#ifdef __linux__
+		// Every runtime function that is called gets a stub behind the code
+		std::map<std::string, uint32_t> stubs;
+		uint32_t stub_size = target->pointer_size == 8 ? STUB_SIZE : 0;
+		for (const CodeRelocation& relocation : code.relocations) {
+			if (relocation.data) continue;
+			if (!runtime_symbols.count(relocation.symbol)) throw jit_error("Unknown function " + relocation.symbol);
+			if (!stubs.count(relocation.symbol)) stubs[relocation.symbol] = code.text.size() + stubs.size() * stub_size;
+		}
+		size_t page_size = sysconf(_SC_PAGESIZE);
+		size_t size = (code.text.size() + stubs.size() * stub_size + page_size - 1) / page_size * page_size;
+		if (size == 0) size = page_size;
+		size_t bss_size = (code.bss_size + page_size - 1) / page_size * page_size;
+		std::map<std::string, uint32_t> statics;
+		for (const CodeSymbol& symbol : code.statics) statics[symbol.name] = size + symbol.offset;
+		void* memory = mmap(NULL, size + bss_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (memory == MAP_FAILED) throw jit_error("Can't allocate memory for the code");
+		uint8_t* base = static_cast<uint8_t*>(memory);
+		memcpy(base, code.text.data(), code.text.size());
+
+		for (auto& stub : stubs) {
+			if (!stub_size) continue;
+			uint8_t* at = base + stub.second;
+			uintptr_t address = reinterpret_cast<uintptr_t>(runtime_symbols[stub.first]);
+			at[0] = 0xFF;
+			at[1] = 0x25;
+			put_rel32(at + 2, 0);
+			for (uint8_t i = 0; i < 8; i++) at[6 + i] = ((uint64_t)address >> (i * 8)) & 0xFF;
+		}
+		for (const CodeRelocation& relocation : code.relocations) {
+			if (relocation.data) {
+				// Relative to the end of the lea on x86_64, the address itself on x86
+				uintptr_t address = reinterpret_cast<uintptr_t>(base + statics[relocation.symbol]);
+				if (target->pointer_size == 8) put_rel32(base + relocation.offset, (int64_t)(address - reinterpret_cast<uintptr_t>(base + relocation.offset + 4)));
+				else put_rel32(base + relocation.offset, (int64_t)address);
+				continue;
+			}
+			// rel32 is relative to the end of the call
+			uintptr_t end = reinterpret_cast<uintptr_t>(base + relocation.offset + 4);
+			uintptr_t destination = stub_size ? reinterpret_cast<uintptr_t>(base + stubs[relocation.symbol])
+				: reinterpret_cast<uintptr_t>(runtime_symbols[relocation.symbol]);
+			put_rel32(base + relocation.offset, (int64_t)(destination - end));
+		}
+
+		// W^X: the pages are never writable and executable at the same time
+		if (mprotect(memory, size, PROT_READ | PROT_EXEC)) {
+			munmap(memory, size + bss_size);
+			throw jit_error("Can't make the code executable");
+		}
+		// main takes no arguments and returns in the accumulator, like any C function
+		int64_t (*main_function)() = reinterpret_cast<int64_t (*)()>(base + main_symbol->offset);
+		int64_t result = main_function();
+		munmap(memory, size + bss_size);
+		return extend_result(result, return_type);
+#else
+		throw jit_error("Running code in memory is only supported on Linux");
+#endif
+	}
+}
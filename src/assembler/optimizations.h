@@ -1,32 +1,94 @@
 #pragma once
+#include <vector>
+#include <map>
+#include <set>
+#include <string>
+
 #include "assembler/instructions.h"
 
 namespace Bonfire {
+	// Removes jumps to the label that directly follows them
 	static void optimize_jumps(std::vector<AssemblyInstruction*>& instructions) {
-		std::vector<int> to_remove;
-		for(int i = 0; i < instructions.size() - 1; i++) {
-			if(instructions[i]->type == AsmType::JUMP) {
+		std::vector<AssemblyInstruction*> result;
+		for (size_t i = 0; i < instructions.size(); i++) {
+			if (instructions[i]->type == AsmType::JUMP && i + 1 < instructions.size() && instructions[i + 1]->type == AsmType::LABEL) {
 				auto jump_instruction = static_cast<Asm1<std::string>*>(instructions[i]);
-				// Check if the instruction after that is the label
-				if(instructions[i + 1]->type == AsmType::LABEL) {
-					auto label_instruction = static_cast<Asm1<std::string>*>(instructions[i]);
-					// Check if the jump from before calls the label
-					if(!jump_instruction->data1.compare(label_instruction->data1)) {
-						// Remove
-						to_remove.push_back(i);
-						to_remove.push_back(i + 1);
-					}
+				auto label_instruction = static_cast<Asm1<std::string>*>(instructions[i + 1]);
+				// Check if the jump goes to the label. The label stays, other jumps can go there too
+				if (!jump_instruction->data1.compare(label_instruction->data1)) continue;
+			}
+			result.push_back(instructions[i]);
+		}
+		instructions = result;
+	}
+
+	// Jumps to a label that is directly followed by a jmp go to the target of that jmp instead
+	static void thread_jumps(std::vector<AssemblyInstruction*>& instructions) {
+		std::map<std::string, std::string> forward;
+		for (size_t i = 0; i < instructions.size(); i++) {
+			if (instructions[i]->type != AsmType::LABEL) continue;
+			size_t next = i + 1;
+			while (next < instructions.size() && instructions[next]->type == AsmType::LABEL) ++next;
+			if (next < instructions.size() && instructions[next]->type == AsmType::JUMP) {
+				forward[static_cast<Asm1<std::string>*>(instructions[i])->data1] = static_cast<Asm1<std::string>*>(instructions[next])->data1;
+			}
+		}
+		for (AssemblyInstruction* instruction : instructions) {
+			if (instruction->type != AsmType::JUMP && !is_conditional_jump(instruction->type)) continue;
+			auto jump_instruction = static_cast<Asm1<std::string>*>(instruction);
+			// Limit the number of steps, jumps can form a cycle (| {})
+			for (size_t steps = 0; steps < forward.size() && forward.count(jump_instruction->data1); steps++) {
+				jump_instruction->data1 = forward[jump_instruction->data1];
+			}
+		}
+	}
+
+	// A conditional jump over a jmp (jcc a, jmp b, a:) becomes the inverted conditional jump (j!cc b, a:)
+	static void optimize_jump_over_jump(std::vector<AssemblyInstruction*>& instructions) {
+		std::vector<AssemblyInstruction*> result;
+		for (size_t i = 0; i < instructions.size(); i++) {
+			if (is_conditional_jump(instructions[i]->type) && i + 2 < instructions.size()
+				&& instructions[i + 1]->type == AsmType::JUMP && instructions[i + 2]->type == AsmType::LABEL) {
+				auto condition_jump = static_cast<Asm1<std::string>*>(instructions[i]);
+				auto jump = static_cast<Asm1<std::string>*>(instructions[i + 1]);
+				auto label = static_cast<Asm1<std::string>*>(instructions[i + 2]);
+				if (!condition_jump->data1.compare(label->data1)) {
+					AssemblyInstruction* inverted = new Asm1<std::string>(invert_jump(condition_jump->type), jump->data1);
+					inverted->line = condition_jump->line;
+					result.push_back(inverted);
+					++i;
+					continue;
 				}
 			}
+			result.push_back(instructions[i]);
+		}
+		instructions = result;
+	}
+
+	// Aligns the given labels where nothing falls through into them (the instruction before is a jmp or ret), so the padding
+	// never runs. Labels no jump goes to anymore are left alone
+	static void align_branch_targets(std::vector<AssemblyInstruction*>& instructions, const std::set<std::string>& targets) {
+		std::set<std::string> jumped_to;
+		for (AssemblyInstruction* instruction : instructions) {
+			if (instruction->type == AsmType::JUMP || is_conditional_jump(instruction->type)) jumped_to.insert(static_cast<Asm1<std::string>*>(instruction)->data1);
 		}
-		int offset = 0; // Number of already removed elements
-		for(int i : to_remove) {
-			instructions.erase(instructions.begin() + i - offset);
-			++offset;
+		std::vector<AssemblyInstruction*> result;
+		for (size_t i = 0; i < instructions.size(); i++) {
+			if (instructions[i]->type == AsmType::LABEL && i > 0) {
+				const std::string& name = static_cast<Asm1<std::string>*>(instructions[i])->data1;
+				AsmType before = instructions[i - 1]->type;
+				if (targets.count(name) && jumped_to.count(name) && (before == AsmType::JUMP || before == AsmType::RETURN)) {
+					result.push_back(new Asm1<uint32_t>(AsmType::ALIGN, 4));
+				}
+			}
+			result.push_back(instructions[i]);
 		}
+		instructions = result;
 	}
 
 	static void optimize(std::vector<AssemblyInstruction*>& instructions) {
+		thread_jumps(instructions);
+		optimize_jump_over_jump(instructions);
 		optimize_jumps(instructions);
 	}
 }
\ No newline at end of file
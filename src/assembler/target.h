@@ -0,0 +1,87 @@
+#pragma once
+#include <string>
+#include <cstdint>
+#include <vector>
+
+namespace Bonfire {
+	// General purpose registers, in the order of their encoding
+	enum class Register {
+		A, C, D, B, SP, BP, SI, DI,
+		// Only on x86_64
+		R8, R9, R10, R11, R12, R13, R14, R15
+	};
+
+	// Everything the assembler needs to know about the machine it generates code for
+	struct Target {
+		std::string name;
+		uint8_t pointer_size;	// Size of addresses, and of the values push and pop move
+		uint8_t num_registers;	// The generated code only uses the first registers of Register
+		const char* gcc_flags;	// Flags gcc needs to assemble and link the output (-gcc)
+		// The first arguments of a call are passed in these registers, the rest on the stack.
+		// The return value is in the accumulator, the caller removes the stack arguments
+		std::vector<Register> argument_registers;
+		// Registers that hold left operands while the right operand is calculated, instead of the stack. Calls don't
+		// keep them, argument registers can be among them because they are only loaded once all arguments are calculated
+		std::vector<Register> scratch_registers;
+	};
+
+	// fastcall-like: ecx, edx
+	const Target TARGET_X86 = { "x86", 4, 8, "-m32", { Register::C, Register::D }, {} };
+	// System V ABI, 16 byte aligned stack at every call. r12 to r15 would have to be saved by the function, they aren't used
+	const Target TARGET_X86_64 = { "x86_64", 8, 12, "", { Register::DI, Register::SI, Register::D, Register::C, Register::R8, Register::R9 },
+		{ Register::R8, Register::R9, Register::R10, Register::R11 } };
+
+	// The target code is generated for, selected with --target=<name>
+	const Target* target = &TARGET_X86;
+
+	// Returns NULL if there is no target with the given name
+	const Target* find_target(const std::string& name) {
+		if (!name.compare(TARGET_X86.name) || !name.compare("i386")) return &TARGET_X86;
+		if (!name.compare(TARGET_X86_64.name) || !name.compare("amd64")) return &TARGET_X86_64;
+		return NULL;
+	}
+
+	// Name of the part of a register that holds a value of the given size (1, 2, 4 or 8 bytes)
+	std::string get_register_name(Register reg, uint8_t size) {
+		static const char* names[16][4] = {
+			{ "al", "ax", "eax", "rax" },
+			{ "cl", "cx", "ecx", "rcx" },
+			{ "dl", "dx", "edx", "rdx" },
+			{ "bl", "bx", "ebx", "rbx" },
+			{ "spl", "sp", "esp", "rsp" },
+			{ "bpl", "bp", "ebp", "rbp" },
+			{ "sil", "si", "esi", "rsi" },
+			{ "dil", "di", "edi", "rdi" },
+			{ "r8b", "r8w", "r8d", "r8" },
+			{ "r9b", "r9w", "r9d", "r9" },
+			{ "r10b", "r10w", "r10d", "r10" },
+			{ "r11b", "r11w", "r11d", "r11" },
+			{ "r12b", "r12w", "r12d", "r12" },
+			{ "r13b", "r13w", "r13d", "r13" },
+			{ "r14b", "r14w", "r14d", "r14" },
+			{ "r15b", "r15w", "r15d", "r15" }
+		};
+		switch (size) {
+		case 1: return names[(int)reg][0];
+		case 2: return names[(int)reg][1];
+		case 8: return names[(int)reg][3];
+		default: return names[(int)reg][2];
+		}
+	}
+
+	// The whole register, as push and pop need it
+	std::string get_register_name(Register reg) {
+		return get_register_name(reg, target->pointer_size);
+	}
+
+	// Size of the registers a value of the given size is calculated in. Only x86_64 has 64-bit registers
+	uint8_t get_register_size(uint8_t value_size) {
+		return value_size == 8 && target->pointer_size == 8 ? 8 : 4;
+	}
+
+	// Operand for the address of a symbol. x86_64 addresses it relative to rip, so the code stays position independent
+	std::string get_symbol_operand(const std::string& size, const std::string& symbol) {
+		if (target->pointer_size == 8) return size + " PTR [rip+" + symbol + "]";
+		return size + " PTR [" + symbol + "]";
+	}
+}
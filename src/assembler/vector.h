@@ -0,0 +1,137 @@
+#pragma once
+#include <string>
+#include <cstdint>
+
+#include "ast.h"
+
+namespace Bonfire {
+
+	// Operations on packed integers (SSE2 and AVX2), the element type decides the instruction
+	enum class VectorOp {
+		MOVE,			// movdqa
+		ADD,
+		SUB,
+		MUL,			// 16 and 32-bit elements, 32-bit only with AVX2 (pmulld is SSE4.1)
+		AND,
+		AND_NOT,		// dst = ~dst & src
+		OR,
+		XOR,
+		COMPARE_GT,		// Signed, every bit of an element is set if dst > src
+		MIN,
+		MAX,
+		UNPACK_LOW,		// Interleaves the lower elements of dst and src
+		BROADCAST,		// AVX2: the lowest element of src into every element of dst
+		SHUFFLE,		// pshufd with the immediate
+		SHUFFLE_LOW,	// pshuflw with the immediate, the 16-bit elements of the lower 8 bytes
+		SHIFT_BYTES,	// psrldq: src shifted right by the immediate in bytes (in both 16 byte halves with AVX2)
+		EXTRACT_HIGH	// vextracti128 with 1: the upper 16 bytes of src into dst
+	};
+
+	// How a packed instruction is encoded: the mandatory prefix (0x66, 0xF2, 0xF3 or none), the opcode map (1 is 0F,
+	// 2 is 0F 38, 3 is 0F 3A) and the opcode. mnemonic is NULL if there is no instruction for the element type
+	struct VectorEncoding {
+		const char* mnemonic;
+		uint8_t prefix;
+		uint8_t map;
+		uint8_t opcode;
+	};
+
+	VectorEncoding get_vector_encoding(VectorOp op, Type element_type) {
+		uint8_t size = get_type_size(element_type);
+		bool is_signed = is_signed_integer_type(element_type);
+		// Index by size: 1, 2, 4, 8 bytes
+		uint8_t i = size == 1 ? 0 : size == 2 ? 1 : size == 4 ? 2 : 3;
+		switch (op) {
+		case VectorOp::MOVE: return { "movdqa", 0x66, 1, 0x6F };
+		case VectorOp::ADD:
+		{
+			static const VectorEncoding add[] = { { "paddb", 0x66, 1, 0xFC }, { "paddw", 0x66, 1, 0xFD }, { "paddd", 0x66, 1, 0xFE }, { "paddq", 0x66, 1, 0xD4 } };
+			return add[i];
+		}
+		case VectorOp::SUB:
+		{
+			static const VectorEncoding sub[] = { { "psubb", 0x66, 1, 0xF8 }, { "psubw", 0x66, 1, 0xF9 }, { "psubd", 0x66, 1, 0xFA }, { "psubq", 0x66, 1, 0xFB } };
+			return sub[i];
+		}
+		case VectorOp::MUL:
+			if (size == 2) return { "pmullw", 0x66, 1, 0xD5 };
+			if (size == 4) return { "pmulld", 0x66, 2, 0x40 };
+			return { NULL, 0, 0, 0 };
+		case VectorOp::AND: return { "pand", 0x66, 1, 0xDB };
+		case VectorOp::AND_NOT: return { "pandn", 0x66, 1, 0xDF };
+		case VectorOp::OR: return { "por", 0x66, 1, 0xEB };
+		case VectorOp::XOR: return { "pxor", 0x66, 1, 0xEF };
+		case VectorOp::COMPARE_GT:
+		{
+			static const VectorEncoding compare[] = { { "pcmpgtb", 0x66, 1, 0x64 }, { "pcmpgtw", 0x66, 1, 0x65 }, { "pcmpgtd", 0x66, 1, 0x66 }, { NULL, 0, 0, 0 } };
+			return compare[i];
+		}
+		case VectorOp::MIN:
+		{
+			static const VectorEncoding min_signed[] = { { "pminsb", 0x66, 2, 0x38 }, { "pminsw", 0x66, 1, 0xEA }, { "pminsd", 0x66, 2, 0x39 }, { NULL, 0, 0, 0 } };
+			static const VectorEncoding min_unsigned[] = { { "pminub", 0x66, 1, 0xDA }, { "pminuw", 0x66, 2, 0x3A }, { "pminud", 0x66, 2, 0x3B }, { NULL, 0, 0, 0 } };
+			return is_signed ? min_signed[i] : min_unsigned[i];
+		}
+		case VectorOp::MAX:
+		{
+			static const VectorEncoding max_signed[] = { { "pmaxsb", 0x66, 2, 0x3C }, { "pmaxsw", 0x66, 1, 0xEE }, { "pmaxsd", 0x66, 2, 0x3D }, { NULL, 0, 0, 0 } };
+			static const VectorEncoding max_unsigned[] = { { "pmaxub", 0x66, 1, 0xDE }, { "pmaxuw", 0x66, 2, 0x3E }, { "pmaxud", 0x66, 2, 0x3F }, { NULL, 0, 0, 0 } };
+			return is_signed ? max_signed[i] : max_unsigned[i];
+		}
+		case VectorOp::UNPACK_LOW:
+		{
+			static const VectorEncoding unpack[] = { { "punpcklbw", 0x66, 1, 0x60 }, { "punpcklwd", 0x66, 1, 0x61 }, { "punpckldq", 0x66, 1, 0x62 }, { "punpcklqdq", 0x66, 1, 0x6C } };
+			return unpack[i];
+		}
+		case VectorOp::BROADCAST:
+		{
+			static const VectorEncoding broadcast[] = { { "pbroadcastb", 0x66, 2, 0x78 }, { "pbroadcastw", 0x66, 2, 0x79 }, { "pbroadcastd", 0x66, 2, 0x58 }, { "pbroadcastq", 0x66, 2, 0x59 } };
+			return broadcast[i];
+		}
+		case VectorOp::SHUFFLE: return { "pshufd", 0x66, 1, 0x70 };
+		case VectorOp::SHUFFLE_LOW: return { "pshuflw", 0xF2, 1, 0x70 };
+		case VectorOp::SHIFT_BYTES: return { "psrldq", 0x66, 1, 0x73 };
+		case VectorOp::EXTRACT_HIGH: return { "extracti128", 0x66, 3, 0x39 };
+		default: return { NULL, 0, 0, 0 };
+		}
+	}
+
+	// Vector registers are named like general purpose ones, xmm0 to xmm7 hold 16 bytes, ymm0 to ymm7 32 bytes (AVX2).
+	// Only the first 8 are used, they exist on x86 too and need no REX prefix
+	const uint8_t NUM_VECTOR_REGISTERS = 8;
+
+	std::string get_vector_register_name(uint8_t number, uint8_t width) {
+		return (width == 32 ? "ymm" : "xmm") + std::to_string(number);
+	}
+
+	bool is_vector_register(const std::string& name) {
+		return name.size() == 4 && (name[0] == 'x' || name[0] == 'y') && !name.compare(1, 2, "mm");
+	}
+
+	// Code with ymm registers is AVX2 and VEX encoded, even where it only uses the lower half
+	bool is_wide_vector_register(const std::string& name) {
+		return is_vector_register(name) && name[0] == 'y';
+	}
+
+	uint8_t get_vector_register_number(const std::string& name) {
+		return name[3] - '0';
+	}
+
+	// Packed multiplications: pmullw is SSE2, pmulld needs AVX2. There is none for 8 and 64-bit elements
+	bool has_vector_multiply(Type element_type, bool avx2) {
+		uint8_t size = get_type_size(element_type);
+		return size == 2 || (size == 4 && avx2);
+	}
+
+	// Packed minimum and maximum. SSE2 only has them for u8 and i16, AVX2 for every element up to 32 bits
+	bool has_vector_min_max(Type element_type, bool avx2) {
+		uint8_t size = get_type_size(element_type);
+		if (size == 8) return false;
+		return avx2 || element_type == Type::UINT8 || element_type == Type::INT16;
+	}
+
+	// Without the instruction, the minimum or maximum of signed 8 and 32-bit elements is selected with a comparison
+	bool can_select_min_max(Type element_type) {
+		return element_type == Type::INT8 || element_type == Type::INT32;
+	}
+}
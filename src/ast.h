@@ -1,5 +1,8 @@
 #pragma once
 #include <cstdint>
+#include <string>
+#include <vector>
+#include <map>
 
 namespace Bonfire {
 	enum class Type {
@@ -47,7 +50,26 @@ namespace Bonfire {
 		return type == Type::UINT8 || type == Type::UINT16 || type == Type::UINT32 || type == Type::UINT64;
 	}
 
-	Type get_type_for_op(Type lhs, Type rhs) {
+	bool is_signed_integer_type(Type type) {
+		return type == Type::INT8 || type == Type::INT16 || type == Type::INT32 || type == Type::INT64;
+	}
+
+	// The name of a type in the source
+	const char* get_type_name(Type type) {
+		switch (type) {
+		case Type::INT8: return "i8";
+		case Type::INT16: return "i16";
+		case Type::INT32: return "i32";
+		case Type::INT64: return "i64";
+		case Type::UINT8: return "u8";
+		case Type::UINT16: return "u16";
+		case Type::UINT32: return "u32";
+		case Type::UINT64: return "u64";
+		default: return "void";
+		}
+	}
+
+	Type compute_type_for_op(Type lhs, Type rhs) {
 		bool can_be_unsigned = is_unsigned_integer_type(lhs) && is_unsigned_integer_type(rhs);
 		Type biggest;
 		if (can_be_unsigned && (lhs == Type::UINT64 || rhs == Type::UINT64)) return Type::UINT64;
@@ -61,6 +83,24 @@ namespace Bonfire {
 		return Type::VOID;
 	}
 
+	const uint32_t NUM_TYPES = (uint32_t)Type::DOUBLE + 1;
+
+	// Gets the type an arithmetic operation on lhs and rhs has to be done in
+	// This is needed for every operation node, so the results are looked up in a table that is filled once
+	Type get_type_for_op(Type lhs, Type rhs) {
+		static Type table[NUM_TYPES][NUM_TYPES];
+		static bool table_filled = false;
+		if (!table_filled) {
+			for (uint32_t i = 0; i < NUM_TYPES; i++) {
+				for (uint32_t j = 0; j < NUM_TYPES; j++) {
+					table[i][j] = compute_type_for_op((Type)i, (Type)j);
+				}
+			}
+			table_filled = true;
+		}
+		return table[(uint32_t)lhs][(uint32_t)rhs];
+	}
+
 	// Represents a variable definition, including its runtime position on the stack
 	struct VariableDef {
 		const char* identifier;
@@ -91,7 +131,13 @@ namespace Bonfire {
 		VAR_DECLARATION,
 		VAR_DECL_INIT,
 		VAR_VALUE,
-		OPERATION
+		OPERATION,
+		MATCH,
+		ARRAY_DECLARATION,
+		SLICE,
+		INDEX,
+		INDEX_ASSIGNMENT,
+		LENGTH
 	};
 
 	enum class Operation {
@@ -114,8 +160,70 @@ namespace Bonfire {
 		OR
 	};
 
+	// Operations where (a op b) op c == a op (b op c), so chains of them can be regrouped freely
+	bool is_associative(Operation op) {
+		return op == Operation::ADD || op == Operation::MUL || op == Operation::ANDL || op == Operation::ORL
+			|| op == Operation::AND || op == Operation::OR;
+	}
+
+	bool is_comparison(Operation op) {
+		return op == Operation::EQ || op == Operation::NEQ || op == Operation::LT || op == Operation::LTE
+			|| op == Operation::GT || op == Operation::GTE;
+	}
+
+	// The comparison that is true exactly when op is false (a < b is !(a >= b))
+	Operation negate_comparison(Operation op) {
+		switch (op) {
+		case Operation::EQ:		return Operation::NEQ;
+		case Operation::NEQ:	return Operation::EQ;
+		case Operation::LT:		return Operation::GTE;
+		case Operation::LTE:	return Operation::GT;
+		case Operation::GT:		return Operation::LTE;
+		case Operation::GTE:	return Operation::LT;
+		default: return op;
+		}
+	}
+
+	// The comparison that gives the same result with swapped operands (a < b is b > a)
+	Operation mirror_comparison(Operation op) {
+		switch (op) {
+		case Operation::LT:		return Operation::GT;
+		case Operation::LTE:	return Operation::GTE;
+		case Operation::GT:		return Operation::LT;
+		case Operation::GTE:	return Operation::LTE;
+		default: return op;
+		}
+	}
+
+	// Gets the type an operation produces from its operand types
+	Type get_op_result_type(Operation op, Type lhs, Type rhs) {
+		switch (op) {
+		case Operation::EQ:
+		case Operation::NEQ:
+		case Operation::LT:
+		case Operation::LTE:
+		case Operation::GT:
+		case Operation::GTE:
+		case Operation::ANDL:
+		case Operation::ORL:
+			return Type::INT8;
+		case Operation::ADD:
+		case Operation::SUB:
+		case Operation::MUL:
+		case Operation::DIV:
+		case Operation::MOD:
+		case Operation::POW:
+			// Get the type that is big enough so it can fit the result
+			return get_type_for_op(lhs, rhs);
+		default:
+			return Type::VOID;
+		}
+	}
+
 	struct AbstractSyntaxTree {
 		AstType type = AstType::NONE;
+		uint32_t line = 0;	// Source line it was parsed from, 0 for nodes the optimizer created
+		int32_t probe = -1;	// Index into Profile::probes for ifs, loops and calls, -1 for everything else
 
 		AbstractSyntaxTree() {}
 
@@ -149,9 +257,36 @@ namespace Bonfire {
 		}
 	};
 
+	// How a statement of a vectorized loop uses its value: stores it into target[i], or folds it into the variable target
+	enum class VectorReduction { NONE, ADD, SUB, MIN, MAX };
+
+	struct VectorStatement {
+		std::string target;
+		VectorReduction reduction;
+		ExpressionST* value;
+	};
+
+	// A loop the vectorizer (see optimizer/vectorize.h) runs width bytes of elements at a time, from counter up to bound.
+	// The elements that are left over run in the loop itself
+	struct VectorLoop {
+		std::string counter;
+		ExpressionST* bound;
+		Type element_type;
+		uint8_t width;
+		std::vector<VectorStatement> statements;
+		std::vector<std::string> arrays;	// Every array the loop accesses, in the order they appear
+		std::vector<std::string> checked_lengths;	// Arrays bound isn't known to fit into, it is compared with their length first
+		std::vector<std::pair<std::string, std::string>> overlaps;	// Arrays that may overlap, one of them is written
+		// Values that are the same in every iteration. They are calculated once and copied into every element of a register,
+		// broadcasts gives every part of a statement that is one of them its index
+		std::vector<ExpressionST*> invariants;
+		std::map<ExpressionST*, uint8_t> broadcasts;
+	};
+
 	struct LoopST : public ExpressionST {
 		ExpressionST* condition;
 		ExpressionST* body;
+		VectorLoop* vector = NULL;
 
 		LoopST(ExpressionST* condition, ExpressionST* body) {
 			this->type = AstType::LOOP;
@@ -185,8 +320,18 @@ namespace Bonfire {
 		}
 	};
 	
+	struct FunctionDefST;
+
 	struct FunctionCallST : public ExpressionST {
-		// TODO: Implement Function calls
+		FunctionDefST* function;
+		std::vector<ExpressionST*> arguments;
+
+		FunctionCallST(FunctionDefST* function, std::vector<ExpressionST*> arguments, Type return_type) {
+			this->type = AstType::FUNCTION_CALL;
+			this->function = function;
+			this->arguments = arguments;
+			this->return_type = return_type;
+		}
 	};
 
 	struct VariableValST : public ExpressionST {
@@ -256,43 +401,181 @@ namespace Bonfire {
 			this->op = op;
 			this->lhs = lhs;
 			this->rhs = rhs;
-			switch (op) {
-			case Operation::EQ:
-			case Operation::LT:
-			case Operation::LTE:
-			case Operation::GT:
-			case Operation::GTE:
-				return_type = Type::INT8;
-				break;
-			case Operation::ADD:
-			case Operation::SUB:
-			case Operation::MUL:
-			case Operation::DIV:
-			case Operation::MOD:
-			case Operation::POW:
-				// Get the type that is big enough so it can fit the result
-				return_type = get_type_for_op(lhs->return_type, rhs->return_type);
-				break;
-			}
+			this->return_type = get_op_result_type(op, lhs->return_type, rhs->return_type);
+		}
+	};
+
+	// value | value ... -> body
+	struct MatchArm {
+		std::vector<int64_t> values;
+		ExpressionST* body;
+
+		MatchArm(std::vector<int64_t> values, ExpressionST* body) {
+			this->values = values;
+			this->body = body;
+		}
+	};
+
+	// ??(value) { arm, arm, ..., : default }
+	// Runs the arm with the value, the default (if there is one) if no arm has it
+	struct MatchST : public ExpressionST {
+		ExpressionST* value;
+		std::vector<MatchArm> arms;
+		ExpressionST* default_body = NULL;
+
+		MatchST(ExpressionST* value, std::vector<MatchArm> arms, ExpressionST* default_body, Type return_type) {
+			this->type = AstType::MATCH;
+			this->value = value;
+			this->arms = arms;
+			this->default_body = default_body;
+			this->return_type = return_type;
+		}
+	};
+
+	// a[begin..end], the elements of an array or slice from begin up to (not including) end
+	// Only the value of a slice declaration or an argument of a slice parameter
+	struct SliceST : public ExpressionST {
+		std::string identifier = "";
+		ExpressionST* begin;
+		ExpressionST* end;
+		bool checked = true;	// If begin <= end <= len(a) is checked at runtime
+
+		SliceST(std::string identifier, Type element_type, ExpressionST* begin, ExpressionST* end) {
+			this->type = AstType::SLICE;
+			this->identifier = identifier;
+			this->return_type = element_type;
+			this->begin = begin;
+			this->end = end;
+		}
+	};
+
+	// a: [T; N] = zeroes on the stack, a: static [T; N] = zeroes once in the data of the program,
+	// s: [T] = a[begin..end] a slice (pointer and length) of another array or slice
+	struct ArrayDeclarationST : public ExpressionST {
+		std::string identifier = "";
+		Type element_type;
+		uint32_t length = 0;		// 0 for slices
+		bool is_static = false;
+		ExpressionST* value = NULL;	// The SliceST of a slice, NULL for arrays
+
+		ArrayDeclarationST(std::string identifier, Type element_type, uint32_t length, bool is_static) {
+			this->type = AstType::ARRAY_DECLARATION;
+			this->identifier = identifier;
+			this->element_type = element_type;
+			this->length = length;
+			this->is_static = is_static;
+			this->return_type = Type::VOID;
+		}
+
+		ArrayDeclarationST(std::string identifier, Type element_type, ExpressionST* value) {
+			this->type = AstType::ARRAY_DECLARATION;
+			this->identifier = identifier;
+			this->element_type = element_type;
+			this->value = value;
+			this->return_type = Type::VOID;
+		}
+
+		bool is_slice() const {
+			return value != NULL;
+		}
+	};
+
+	// a[index], the return type is the type the value is used as, like for variables
+	struct IndexST : public ExpressionST {
+		std::string identifier = "";
+		Type element_type;
+		ExpressionST* index;
+		bool checked = true;	// If 0 <= index < len(a) is checked at runtime
+
+		IndexST(std::string identifier, Type element_type, ExpressionST* index, Type return_type) {
+			this->type = AstType::INDEX;
+			this->identifier = identifier;
+			this->element_type = element_type;
+			this->index = index;
+			this->return_type = return_type;
+		}
+	};
+
+	// a[index] = value
+	struct IndexAssignST : public ExpressionST {
+		std::string identifier = "";
+		Type element_type;
+		ExpressionST* index;
+		ExpressionST* value;
+		bool checked = true;
+
+		IndexAssignST(std::string identifier, Type element_type, ExpressionST* index, ExpressionST* value) {
+			this->type = AstType::INDEX_ASSIGNMENT;
+			this->identifier = identifier;
+			this->element_type = element_type;
+			this->index = index;
+			this->value = value;
+			this->return_type = Type::VOID;
+		}
+	};
+
+	// len(a), the number of elements of an array or slice as u32
+	struct LengthST : public ExpressionST {
+		std::string identifier = "";
+
+		LengthST(std::string identifier, Type return_type) {
+			this->type = AstType::LENGTH;
+			this->identifier = identifier;
+			this->return_type = return_type;
+		}
+	};
+
+	struct ParameterDef {
+		std::string identifier;
+		Type type;
+		bool slice = false;	// xs: [T], passed as a pointer and a length. type is the element type
+
+		ParameterDef(std::string identifier, Type type) {
+			this->identifier = identifier;
+			this->type = type;
+		}
+
+		ParameterDef(std::string identifier, Type type, bool slice) {
+			this->identifier = identifier;
+			this->type = type;
+			this->slice = slice;
 		}
 	};
 
 	struct FunctionDefST : public AbstractSyntaxTree {
 		std::string name = "";
+		std::vector<ParameterDef> parameters;
+		Type return_type = Type::VOID;
 		BlockST* statement = NULL;
 
 		FunctionDefST(std::string name, BlockST* statement) {
+			this->type = AstType::FUNCTION;
 			this->name = name;
 			this->statement = statement;
 		}
+
+		FunctionDefST(std::string name, std::vector<ParameterDef> parameters, Type return_type) {
+			this->type = AstType::FUNCTION;
+			this->name = name;
+			this->parameters = parameters;
+			this->return_type = return_type;
+		}
 	};
 
 	struct ProgramST : public AbstractSyntaxTree {
+		std::vector<FunctionDefST*> functions;
 		FunctionDefST* main;
 
 		ProgramST(FunctionDefST* main) {
 			this->type = AstType::PROGRAM;
 			this->main = main;
+			this->functions.push_back(main);
+		}
+
+		ProgramST(std::vector<FunctionDefST*> functions, FunctionDefST* main) {
+			this->type = AstType::PROGRAM;
+			this->functions = functions;
+			this->main = main;
 		}
 	};
 
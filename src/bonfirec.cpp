@@ -1,11 +1,27 @@
 #include <iostream>
 #include <string.h>
+#include <stdlib.h>
 
 #include "utils/fileutils.h"
+#include "utils/report.h"
 #include "preprocessor/preprocessor.h"
 #include "lexer/lexer.h"
 #include "assembler/assembler.h"
+#include "assembler/jit.h"
+#include "interpreter/compiler.h"
+#include "interpreter/vm.h"
 #include "parser/parser.h"
+#include "optimizer/folding.h"
+#include "optimizer/deadcode.h"
+#include "optimizer/inliner.h"
+#include "optimizer/loops.h"
+#include "optimizer/cse.h"
+#include "optimizer/copies.h"
+#include "optimizer/bounds.h"
+#include "optimizer/vectorize.h"
+#include "profile/profile.h"
+#include "profile/runtime.h"
+#include "profile/instrument.h"
 #include "ast.h"
 
 using namespace Bonfire;
@@ -21,47 +37,35 @@ void print_compile_error_exit(const char* message, int64_t line) {
 	exit(ERRCODE_COMPILE);
 }
 
-// Start indices of every line, for debugging purposes
-// With this, we can determine in which line the char at our cursor is
-std::vector<uint64_t> line_start_indices;
-
-// For finding the character index a token starts at. To determine the line
+// The character index every token starts at. The lexer gives every token its line from it
 std::vector<uint64_t> token_indices;
 
-void find_line_start_indices(std::string source) {
-	line_start_indices.push_back(0);
-	for (int64_t i = 0; i < source.size(); i++) {
-		if (source[i] == '\n') {
-			++i;
-			if(i != source.size()) line_start_indices.push_back(i);
-		}
-	}
-}
-
-int64_t find_line_by_token(int64_t token_index) {
-	int64_t curr_line = 0;
-	for (int64_t i = 0; i < line_start_indices.size(); i++) {
-		if (line_start_indices[i] > token_indices[token_index]) {
-			return curr_line + 1;
-		}
-		curr_line = i;
-	}
-	return 0;
-}
-
-int64_t find_line_by_char(int64_t char_index) {
-	int64_t curr_line = 0;
-	for (int64_t i = 0; i < line_start_indices.size(); i++) {
-		if (line_start_indices[i] > char_index) {
-			return curr_line + 1;
-		}
-		curr_line = i;
-	}
-	return 0;
-}
-
 // Arguments:
-// BonfireC [-gcc] <source-file>
+// BonfireC [-gcc] [-obj] [-g] [--run] [--interp] [--target=<target>] [--inline-budget=<nodes>] [--report=<kind>[,<kind>...]]
+//          [--profile-generate[=<file>]] [--profile-use[=<file>]] [--instrument=functions] [--vectorize=<isa>] <source-file>
+// Targets: x86 (default, 32-bit), x86_64 (System V)
+// -obj writes an ELF object file (.o) with the built-in encoder instead of the .s file, -gcc then only links it
+// -g writes a line table into the .s file, so debuggers and profilers (perf annotate, addr2line) find the source lines.
+//    Call frame information is always written
+// --run runs main in the compiler process instead of writing any file, bonfirec exits with what it returned.
+//       The target is the machine bonfirec runs on
+// --interp compiles to bytecode and runs main in the interpreter instead, on any machine bonfirec runs on
+// --profile-generate counts how often every if, loop and call runs. The counters are in a C file (<source>.profile.c) that
+//                    -gcc links in, the program adds its counts to the profile file (default <source>.profile) at exit.
+//                    BONFIRE_PROFILE in the environment of the program overrides the file
+// --profile-use reads a profile back: hotter else arms become the fall-through, cold loops aren't aligned, call sites that never
+//               ran aren't inlined and hot ones get 4 times the inline budget
+// --instrument=functions times every function with rdtsc. The hooks are in a C file (<source>.instrument.c) that -gcc links in,
+//                        the program prints calls, inclusive and exclusive cycles and the deepest recursion of every function at exit.
+//                        BONFIRE_INSTRUMENT=<file> in the environment of the program writes them as CSV instead
+// --vectorize=none|sse2|avx2 runs simple counted loops over arrays several elements at a time. Default is sse2 on x86_64
+//                            and none on x86, avx2 needs a CPU that has it
+// Reports: size (time of every phase, instructions per function), inline (every call site and if it was inlined),
+//          tailcalls (every call in tail position and if it became a jump), profile (every decision --profile-use made),
+//          layout (every if arm that went out of line into .text.unlikely), match (the table or decision tree of every match),
+//          bounds (every bounds check of an array access or slice and why it was removed),
+//          vectorize (every loop and why it was or wasn't vectorized), passes (what every optimization pass did,
+//          how many instructions the encoder wrote and how big the bytecode of every function is)
 int main(int argc, char* argv[])
 {
 	if (argc < 2) {
@@ -69,7 +73,109 @@ int main(int argc, char* argv[])
 		return ERRCODE_INVALID_ARGS;
 	}
 
-	bool gcc = argc > 2 && strcmp(argv[1], "-gcc") == 0;
+	bool gcc = false;
+	bool obj = false;
+	bool run = false;
+	bool interp = false;
+	bool target_set = false;
+	bool profile_use = false;
+	bool vectorize_set = false;
+	std::string profile_file;
+	for (int i = 1; i < argc - 1; i++) {
+		if (!strcmp(argv[i], "-gcc")) {
+			gcc = true;
+		}
+		else if (!strcmp(argv[i], "-obj")) {
+			obj = true;
+		}
+		else if (!strcmp(argv[i], "-g")) {
+			debug_source_name = argv[argc - 1];
+		}
+		else if (!strcmp(argv[i], "--run")) {
+			run = true;
+		}
+		else if (!strcmp(argv[i], "--interp")) {
+			interp = true;
+		}
+		else if (!strncmp(argv[i], "--target=", 9)) {
+			target_set = true;
+			target = find_target(argv[i] + 9);
+			if (!target) {
+				std::cerr << "Unknown target: " << argv[i] + 9 << std::endl;
+				return ERRCODE_INVALID_ARGS;
+			}
+		}
+		else if (!strncmp(argv[i], "--inline-budget=", 16)) {
+			Optimizer::inline_budget = atoi(argv[i] + 16);
+		}
+		else if (!strncmp(argv[i], "--report=", 9)) {
+			Report::enable(argv[i] + 9);
+		}
+		else if (!strcmp(argv[i], "--profile-generate") || !strncmp(argv[i], "--profile-generate=", 19)) {
+			Profile::generate = true;
+			if (argv[i][18]) profile_file = argv[i] + 19;
+		}
+		else if (!strcmp(argv[i], "--instrument=functions")) {
+			Profile::instrument_functions = true;
+		}
+		else if (!strcmp(argv[i], "--profile-use") || !strncmp(argv[i], "--profile-use=", 14)) {
+			profile_use = true;
+			if (argv[i][13]) profile_file = argv[i] + 14;
+		}
+		else if (!strncmp(argv[i], "--vectorize=", 12)) {
+			vectorize_set = true;
+			const char* isa = argv[i] + 12;
+			if (!strcmp(isa, "none")) Optimizer::vector_isa = Optimizer::VectorIsa::NONE;
+			else if (!strcmp(isa, "sse2")) Optimizer::vector_isa = Optimizer::VectorIsa::SSE2;
+			else if (!strcmp(isa, "avx2")) Optimizer::vector_isa = Optimizer::VectorIsa::AVX2;
+			else {
+				std::cerr << "Unknown vector instructions: " << isa << std::endl;
+				return ERRCODE_INVALID_ARGS;
+			}
+		}
+		else {
+			std::cerr << "Invalid Arguments" << std::endl;
+			return ERRCODE_INVALID_ARGS;
+		}
+	}
+
+	if (obj && !debug_source_name.empty()) {
+		std::cerr << "-g only writes the line table into the .s file, it can't be combined with -obj" << std::endl;
+		return ERRCODE_INVALID_ARGS;
+	}
+	if (run && (gcc || obj)) {
+		std::cerr << "--run doesn't write any files, it can't be combined with -gcc or -obj" << std::endl;
+		return ERRCODE_INVALID_ARGS;
+	}
+	if (interp && (gcc || obj || run)) {
+		std::cerr << "--interp doesn't write any files, it can't be combined with -gcc, -obj or --run" << std::endl;
+		return ERRCODE_INVALID_ARGS;
+	}
+	if (Profile::generate && (obj || run || interp)) {
+		std::cerr << "--profile-generate needs the .s file, it can't be combined with -obj, --run or --interp" << std::endl;
+		return ERRCODE_INVALID_ARGS;
+	}
+	if (Profile::instrument_functions && (obj || run || interp)) {
+		std::cerr << "--instrument needs the .s file, it can't be combined with -obj, --run or --interp" << std::endl;
+		return ERRCODE_INVALID_ARGS;
+	}
+	if (Profile::generate && profile_use) {
+		std::cerr << "--profile-generate and --profile-use can't be combined" << std::endl;
+		return ERRCODE_INVALID_ARGS;
+	}
+	if ((Profile::generate || profile_use) && profile_file.empty()) {
+		// Next to the source. The instrumented program can run anywhere, so the path is absolute
+		char* source_path = realpath(argv[argc - 1], NULL);
+		profile_file = source_path ? source_path : argv[argc - 1];
+		free(source_path);
+		FileUtils::change_extension(profile_file, ".profile");
+	}
+	if (run && !target_set) target = Jit::get_host_target();
+	if (!target) {
+		std::cerr << "bonfirec doesn't run on a target it can generate code for" << std::endl;
+		return ERRCODE_INVALID_ARGS;
+	}
+	if (!vectorize_set && target->pointer_size == 8) Optimizer::vector_isa = Optimizer::VectorIsa::SSE2;
 
 	// Load source file
 	char* file_contents;
@@ -79,26 +185,114 @@ int main(int argc, char* argv[])
 		return ERRCODE_INVALID_FILE;
 	}
 	std::string source = PreProcessor::process(file_contents);
-	
-	find_line_start_indices(source);
 
 	std::vector<Token> tokens;
 	std::vector<FunctionDef> functions;
 	try {
 		// Tokenize
+		Report::PhaseTimer lex_timer("lex");
 		Lexer::tokenize(source, tokens, token_indices);
+		lex_timer.stop();
 
 		// Parse
+		Report::PhaseTimer parse_timer("parse");
 		ProgramST* program = Parser::parse(tokens);
+		parse_timer.stop();
+
+		// Probes are assigned before any optimization, so instrumented and optimized builds agree on them
+		if (Profile::generate || profile_use) Profile::assign_probes(program);
+		if (profile_use && !Profile::load(profile_file)) {
+			std::cerr << "Can't read the profile " << profile_file << std::endl;
+			return ERRCODE_INVALID_FILE;
+		}
 
-		// Assemble
-		std::string assembly = Assembler::assemble(program);
-		//std::cout << assembly << std::endl;
+		// Optimize
+		Report::PhaseTimer optimize_timer("optimize");
+		// Inline first, so folding sees the arguments in the inlined bodies
+		uint32_t inlined_calls = Optimizer::inline_functions(program);
+		Report::add_line("passes", "inlining inlined " + std::to_string(inlined_calls) + " calls");
+		uint32_t folded_nodes = Optimizer::fold_constants(program);
+		Report::add_line("passes", "constant folding removed " + std::to_string(folded_nodes) + " nodes");
 
-		// Output .s file
-		std::string asm_file_name = argv[argc - 1];
-		FileUtils::change_extension(asm_file_name, ".s");
-		FileUtils::write_file(asm_file_name.c_str(), assembly);
+		for (FunctionDefST* function : program->functions) {
+			Report::FunctionSize& size = Report::get_function_size(function->name);
+			Optimizer::LoopContext loops = Optimizer::optimize_loops(function);
+			Report::add_line("passes", "loop optimization hoisted " + std::to_string(loops.hoisted) + " expressions, reduced " + std::to_string(loops.reduced)
+				+ " multiplications and removed " + std::to_string(loops.counters) + " counters in " + function->name);
+			uint32_t reused = Optimizer::eliminate_common_subexpressions(function);
+			Report::add_line("passes", "common subexpression elimination reused " + std::to_string(reused) + " expressions in " + function->name);
+			Optimizer::CopyContext copies = Optimizer::propagate_copies(function);
+			Report::add_line("passes", "copy propagation replaced " + std::to_string(copies.propagated) + " reads and removed " + std::to_string(copies.removed) + " copies in " + function->name);
+			// Only dead code elimination counts as eliminated, the other passes also add instructions
+			int64_t instructions_before = Report::is_enabled("size") ? Assembler::count_instructions(function) : 0;
+			uint32_t dead_nodes = Optimizer::eliminate_dead_code(function);
+			if (Report::is_enabled("size")) size.eliminated = (int32_t)(instructions_before - Assembler::count_instructions(function));
+			Report::add_line("passes", "dead code elimination removed " + std::to_string(dead_nodes) + " nodes from " + function->name);
+			Optimizer::BoundsContext bounds = Optimizer::eliminate_bounds_checks(function);
+			Report::add_line("passes", "bounds check elimination removed " + std::to_string(bounds.removed) + " and kept " + std::to_string(bounds.kept) + " checks in " + function->name);
+			// The interpreter runs the loops as they are
+			if (!interp) {
+				Optimizer::VectorizeContext vectorized = Optimizer::vectorize_loops(function);
+				Report::add_line("passes", "vectorization vectorized " + std::to_string(vectorized.vectorized) + " and rejected " + std::to_string(vectorized.rejected) + " loops in " + function->name);
+			}
+			if (Report::is_enabled("size")) {
+				size.instructions = Assembler::count_instructions(function);
+			}
+		}
+		optimize_timer.stop();
+
+		if (interp) {
+			// Compile to bytecode and interpret it
+			Report::PhaseTimer compile_timer("bytecode");
+			Interpreter::BytecodeProgram bytecode = Interpreter::compile_program(program);
+			compile_timer.stop();
+			Report::PhaseTimer interpret_timer("interpret");
+			int64_t result = Interpreter::run_bytecode(bytecode);
+			interpret_timer.stop();
+			std::cout << "main returned " << result << std::endl;
+			Report::print(std::cout);
+			return (int)(result & 0xFF);
+		}
+
+		if (run) {
+			// Encode, link and run in memory
+			Report::PhaseTimer assemble_timer("assemble");
+			MachineCode code = Assembler::assemble_machine_code(program);
+			assemble_timer.stop();
+			Report::PhaseTimer run_timer("run");
+			int64_t result = run_in_memory(code, program->main->return_type);
+			run_timer.stop();
+			std::cout << "main returned " << result << std::endl;
+			Report::print(std::cout);
+			return (int)(result & 0xFF);
+		}
+
+		// Assemble, into text for an assembler or directly into an object file
+		std::string output_file_name = argv[argc - 1];
+		FileUtils::change_extension(output_file_name, obj ? ".o" : ".s");
+		Report::PhaseTimer assemble_timer("assemble");
+		std::string output = obj ? Assembler::assemble_object(program, argv[argc - 1]) : Assembler::assemble(program);
+		assemble_timer.stop();
+		//std::cout << output << std::endl;
+
+		// Output .s or .o file
+		FileUtils::write_file(output_file_name.c_str(), output);
+
+		// The counters of an instrumented program and the code that writes them at exit
+		std::string runtime_file_names;
+		if (Profile::generate) {
+			std::string runtime_file_name = argv[argc - 1];
+			FileUtils::change_extension(runtime_file_name, ".profile.c");
+			FileUtils::write_file(runtime_file_name.c_str(), Profile::generate_runtime(profile_file));
+			runtime_file_names += " " + runtime_file_name;
+		}
+		if (Profile::instrument_functions) {
+			std::string runtime_file_name = argv[argc - 1];
+			FileUtils::change_extension(runtime_file_name, ".instrument.c");
+			FileUtils::write_file(runtime_file_name.c_str(), Profile::generate_instrument_runtime(program));
+			runtime_file_names += " " + runtime_file_name;
+		}
+		if (!gcc && !runtime_file_names.empty()) std::cout << "Link" << runtime_file_names << " into the program" << std::endl;
 
 		if (gcc) {
 			if (!system(NULL)) {
@@ -110,8 +304,10 @@ int main(int argc, char* argv[])
 			std::string exe_file_name = argv[argc - 1];
 			FileUtils::change_extension(exe_file_name, ".exe");
 
-			// Invoke gcc to assemble the .s file
-			int err_gcc = system(string_format("gcc -o %s -m32 %s", exe_file_name.c_str(), asm_file_name.c_str()).c_str());
+			// Invoke gcc to assemble the .s file, or only to link the .o file
+			// The runtimes are C, -O2 keeps them cheap. It doesn't change the assembly
+			if (!runtime_file_names.empty()) runtime_file_names = " -O2" + runtime_file_names;
+			int err_gcc = system(string_format("gcc -o %s %s %s%s", exe_file_name.c_str(), target->gcc_flags, output_file_name.c_str(), runtime_file_names.c_str()).c_str());
 			// Check if assembly was successful
 			if (err_gcc) {
 				std::cerr << "Assembly using GCC failed: Code " << err_gcc << std::endl;
@@ -122,8 +318,25 @@ int main(int argc, char* argv[])
 	catch (const Parser::unexpected_token& e) {
 		char buf[512];
 		sprintf(buf, "Unexpected token: '%s'", tokens[e.index].to_string());
-		print_compile_error_exit(buf, find_line_by_token(e.index));
+		print_compile_error_exit(buf, tokens[e.index].line);
+	}
+	catch (const encoding_error& e) {
+		std::cerr << "Encoding failed: " << e.message << std::endl;
+		return ERRCODE_COMPILE;
+	}
+	catch (const jit_error& e) {
+		std::cerr << "Running failed: " << e.message << std::endl;
+		return ERRCODE_COMPILE;
+	}
+	catch (const Interpreter::bytecode_error& e) {
+		std::cerr << "Bytecode compilation failed: " << e.message << std::endl;
+		return ERRCODE_COMPILE;
+	}
+	catch (const Interpreter::vm_error& e) {
+		std::cerr << "Interpreting failed: " << e.message << std::endl;
+		return ERRCODE_COMPILE;
 	}
 
+	Report::print(std::cout);
 	return 0;
 }
\ No newline at end of file
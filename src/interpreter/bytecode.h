@@ -0,0 +1,135 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstdlib>
+
+#include "ast.h"
+
+namespace Bonfire {
+	namespace Interpreter {
+
+		// Bytecode is a stream of 32-bit words. The first word of an instruction is op | a << 8 | b << 16 | c << 24,
+		// a, b and c are registers of the frame (or a type for CONV). Depending on the format, it is followed by
+		// the index of a constant (K), the word a jump goes to (J) or the index of the called function (F)
+		enum class Format { ABC, ABK, AKJ, ABJ, AJ, J, ABF };
+
+		// Every instruction: name and format. Values are kept in registers normalized to their type (see normalize),
+		// arithmetic comes in variants for 32-bit signed, 32-bit unsigned and 64-bit registers, like the native code
+		// calculates in eax or rax. The ...K and J... instructions are superinstructions: an operation on a constant
+		// (load+add) and a compare with a conditional jump (compare+branch).
+		// Arrays live in memory next to the registers: ARRAY and STATIC put the address of an array into a register
+		// (K: offset << 32 | bytes to zero for ARRAY, offset for STATIC), LOAD_... a = b[c] and STORE_... b[c] = a
+		// take the address in b and the index in c. CHECK traps if a >= b and CHECK_SLICE if not a <= b <= c (unsigned)
+		#define BONFIRE_OPCODES(X) \
+			X(MOV, ABC) X(LOADK, ABK) X(CONV, ABC) \
+			X(ADD_I32, ABC) X(ADD_U32, ABC) X(ADD_64, ABC) \
+			X(SUB_I32, ABC) X(SUB_U32, ABC) X(SUB_64, ABC) \
+			X(MUL_I32, ABC) X(MUL_U32, ABC) X(MUL_64, ABC) \
+			X(ADDK_I32, ABK) X(ADDK_U32, ABK) X(ADDK_64, ABK) \
+			X(SUBK_I32, ABK) X(SUBK_U32, ABK) X(SUBK_64, ABK) \
+			X(MULK_I32, ABK) X(MULK_U32, ABK) X(MULK_64, ABK) \
+			X(DIV_I32, ABC) X(DIV_U32, ABC) X(DIV_I64, ABC) X(DIV_U64, ABC) \
+			X(MOD_I32, ABC) X(MOD_U32, ABC) X(MOD_I64, ABC) X(MOD_U64, ABC) \
+			X(POW_I32, ABC) X(POW_U32, ABC) X(POW_64, ABC) \
+			X(AND, ABC) X(OR, ABC) \
+			X(EQ, ABC) X(NE, ABC) \
+			X(LT_S, ABC) X(LE_S, ABC) X(GT_S, ABC) X(GE_S, ABC) \
+			X(LT_U, ABC) X(LE_U, ABC) X(GT_U, ABC) X(GE_U, ABC) \
+			X(JUMP, J) X(JZ, AJ) X(JNZ, AJ) \
+			X(JEQ, ABJ) X(JNE, ABJ) \
+			X(JLT_S, ABJ) X(JLE_S, ABJ) X(JGT_S, ABJ) X(JGE_S, ABJ) \
+			X(JLT_U, ABJ) X(JLE_U, ABJ) X(JGT_U, ABJ) X(JGE_U, ABJ) \
+			X(JEQK, AKJ) X(JNEK, AKJ) \
+			X(JLTK_S, AKJ) X(JLEK_S, AKJ) X(JGTK_S, AKJ) X(JGEK_S, AKJ) \
+			X(JLTK_U, AKJ) X(JLEK_U, AKJ) X(JGTK_U, AKJ) X(JGEK_U, AKJ) \
+			X(ARRAY, ABK) X(STATIC, ABK) \
+			X(LOAD_I8, ABC) X(LOAD_U8, ABC) X(LOAD_I16, ABC) X(LOAD_U16, ABC) X(LOAD_I32, ABC) X(LOAD_U32, ABC) X(LOAD_64, ABC) \
+			X(STORE_8, ABC) X(STORE_16, ABC) X(STORE_32, ABC) X(STORE_64, ABC) \
+			X(CHECK, ABC) X(CHECK_SLICE, ABC) \
+			X(CALL, ABF) X(RET, ABC)
+
+		#define BONFIRE_OPCODE_ENUM(name, format) name,
+		enum class Opcode : uint8_t { BONFIRE_OPCODES(BONFIRE_OPCODE_ENUM) NUM_OPCODES };
+		#undef BONFIRE_OPCODE_ENUM
+
+		Format get_format(Opcode op) {
+			#define BONFIRE_OPCODE_FORMAT(name, format) Format::format,
+			static const Format formats[] = { BONFIRE_OPCODES(BONFIRE_OPCODE_FORMAT) };
+			#undef BONFIRE_OPCODE_FORMAT
+			return formats[(int)op];
+		}
+
+		const char* get_opcode_name(Opcode op) {
+			#define BONFIRE_OPCODE_NAME(name, format) #name,
+			static const char* names[] = { BONFIRE_OPCODES(BONFIRE_OPCODE_NAME) };
+			#undef BONFIRE_OPCODE_NAME
+			return names[(int)op];
+		}
+
+		// Number of words an instruction takes
+		uint32_t get_instruction_words(Opcode op) {
+			switch (get_format(op)) {
+			case Format::ABC: return 1;
+			case Format::AKJ: return 3;
+			default: return 2;
+			}
+		}
+
+		uint32_t encode_word(Opcode op, uint8_t a, uint8_t b, uint8_t c) {
+			return (uint32_t)op | a << 8 | b << 16 | (uint32_t)c << 24;
+		}
+
+		struct BytecodeFunction {
+			std::string name;
+			uint32_t num_parameters = 0;
+			uint32_t frame_size = 0;		// Registers the function uses, its parameters are the first ones
+			uint32_t memory_size = 0;		// Bytes of its stack arrays
+			Type return_type = Type::VOID;
+			std::vector<uint32_t> code;
+			std::vector<int64_t> constants;
+		};
+
+		struct BytecodeProgram {
+			std::vector<BytecodeFunction> functions;
+			uint32_t main = 0;
+			uint32_t static_size = 0;		// Bytes of the static arrays of all functions
+		};
+
+		// Cuts a value to its type and extends it back to 64 bits. 32-bit values of a narrower type are calculated
+		// like 32-bit values (see get_register_type), 64-bit values and void stay as they are
+		int64_t normalize(int64_t value, Type type) {
+			switch (type) {
+			case Type::INT8: return (int8_t)value;
+			case Type::UINT8: return (uint8_t)value;
+			case Type::INT16: return (int16_t)value;
+			case Type::UINT16: return (uint16_t)value;
+			case Type::INT32: return (int32_t)value;
+			case Type::UINT32: return (uint32_t)value;
+			default: return value;
+			}
+		}
+
+		// The type a value of the given type is calculated in: its 32-bit or 64-bit register, signed or unsigned
+		Type get_register_type(Type type) {
+			if (get_type_size(type) == 8) return is_unsigned_integer_type(type) ? Type::UINT64 : Type::INT64;
+			return is_unsigned_integer_type(type) ? Type::UINT32 : Type::INT32;
+		}
+
+		// True if every normalized value of from is also normalized as a value of to, so no CONV is needed
+		bool fits_representation(Type from, Type to) {
+			if (from == to || get_type_size(to) == 8 || to == Type::VOID) return true;
+			if (get_type_size(from) == 8 || from == Type::VOID) return false;
+			if (is_unsigned_integer_type(from)) {
+				return get_type_size(from) < get_type_size(to) || (get_type_size(from) == get_type_size(to) && is_unsigned_integer_type(to));
+			}
+			return is_signed_integer_type(to) && get_type_size(from) <= get_type_size(to);
+		}
+
+		int64_t parse_constant(const std::string& constant) {
+			// Unsigned 64-bit constants don't fit into strtoll, their bits are the same
+			if (!constant.empty() && constant[0] == '-') return strtoll(constant.c_str(), NULL, 10);
+			return (int64_t)strtoull(constant.c_str(), NULL, 10);
+		}
+	}
+}
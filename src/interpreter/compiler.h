@@ -0,0 +1,745 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+
+#include "interpreter/bytecode.h"
+#include "optimizer/constants.h"
+#include "ast.h"
+#include "utils/report.h"
+
+namespace Bonfire {
+	namespace Interpreter {
+
+		// Exception to throw if a function can't be compiled to bytecode
+		class bytecode_error : std::exception {
+		public:
+			std::string message;
+			bytecode_error(const std::string& message) {
+				this->message = message;
+			}
+		};
+
+		// Where a return goes: out of the function, or out of the closest block with a type, into its register
+		struct ReturnTarget {
+			bool function;
+			uint8_t reg;
+			Type type;
+			uint32_t label;
+		};
+
+		// An array or slice is its address and its length in two registers next to each other
+		struct ArrayRegisters {
+			uint8_t pointer;
+			uint8_t length;
+		};
+
+		struct FunctionCompiler {
+			BytecodeFunction& function;
+			const std::map<FunctionDefST*, uint32_t>& function_indices;
+			uint32_t& static_size;
+			// Every variable has its own register. Names are unique in a function, so the registers are assigned once
+			std::map<std::string, uint8_t> registers;
+			std::map<std::string, Type> types;
+			std::map<std::string, ArrayRegisters> arrays;
+			// Offsets of the elements of every array declaration, in the memory of the frame or in the static memory
+			std::map<ArrayDeclarationST*, uint32_t> array_offsets;
+			uint32_t next_register = 0;
+			// Registers from here on are temporaries, the ones below belong to parameters, variables and arrays
+			uint32_t first_temporary = 0;
+			// Types of the operations, get_value_type is needed for every operand
+			std::map<ExpressionST*, Type> operation_types;
+			std::map<int64_t, uint32_t> constant_indices;
+			std::vector<int64_t> label_positions;
+			std::vector<std::pair<size_t, uint32_t>> jumps;	// Words that hold the position of a label
+			// Where returns in the statements being compiled go. Void blocks inside of values return there too
+			ReturnTarget return_target = { true, 0, Type::VOID, 0 };
+
+			FunctionCompiler(BytecodeFunction& function, const std::map<FunctionDefST*, uint32_t>& function_indices, uint32_t& static_size)
+				: function(function), function_indices(function_indices), static_size(static_size) {}
+
+			uint8_t allocate_register() {
+				if (next_register >= 256) throw bytecode_error(function.name + " needs more than 256 registers");
+				uint8_t reg = next_register++;
+				if (next_register > function.frame_size) function.frame_size = next_register;
+				return reg;
+			}
+
+			uint32_t add_constant(int64_t value) {
+				auto it = constant_indices.find(value);
+				if (it != constant_indices.end()) return it->second;
+				function.constants.push_back(value);
+				return constant_indices[value] = function.constants.size() - 1;
+			}
+
+			uint32_t new_label() {
+				label_positions.push_back(-1);
+				return label_positions.size() - 1;
+			}
+
+			void place_label(uint32_t label) {
+				label_positions[label] = function.code.size();
+			}
+
+			void emit(Opcode op, uint8_t a, uint8_t b = 0, uint8_t c = 0) {
+				function.code.push_back(encode_word(op, a, b, c));
+			}
+
+			void emit_constant(Opcode op, uint8_t a, uint8_t b, int64_t value) {
+				emit(op, a, b);
+				function.code.push_back(add_constant(value));
+			}
+
+			void emit_jump(Opcode op, uint32_t label, uint8_t a = 0, uint8_t b = 0) {
+				emit(op, a, b);
+				jumps.push_back({ function.code.size(), label });
+				function.code.push_back(0);
+			}
+
+			void emit_jump_constant(Opcode op, uint32_t label, uint8_t a, int64_t value) {
+				emit(op, a);
+				function.code.push_back(add_constant(value));
+				jumps.push_back({ function.code.size(), label });
+				function.code.push_back(0);
+			}
+
+			// Type of the value an expression leaves in its register. Operations have the type of their register
+			Type get_value_type(ExpressionST* expression) {
+				switch (expression->type) {
+				case AstType::VAR_VALUE:
+					return types[static_cast<VariableValST*>(expression)->identifier];
+				case AstType::OPERATION:
+				{
+					OperationST* op_st = static_cast<OperationST*>(expression);
+					if (is_comparison(op_st->op) || op_st->op == Operation::ANDL || op_st->op == Operation::ORL) return Type::INT8;
+					if (op_st->op == Operation::AND || op_st->op == Operation::OR) return Type::INT64;
+					auto known = operation_types.find(op_st);
+					if (known != operation_types.end()) return known->second;
+					return operation_types[op_st] = get_register_type(get_compare_type(op_st->lhs, op_st->rhs));
+				}
+				case AstType::FUNCTION_CALL:
+					return static_cast<FunctionCallST*>(expression)->function->return_type;
+				case AstType::INDEX:
+					return static_cast<IndexST*>(expression)->element_type;
+				case AstType::LENGTH:
+					return Type::UINT32;
+				default:
+					return expression->return_type;
+				}
+			}
+
+			// Type two values are calculated or compared in. Constants take the type of the other side
+			Type get_compare_type(ExpressionST* lhs, ExpressionST* rhs) {
+				if (lhs->type == AstType::CONSTANT) return get_value_type(rhs);
+				if (rhs->type == AstType::CONSTANT) return get_value_type(lhs);
+				return get_type_for_op(get_value_type(lhs), get_value_type(rhs));
+			}
+
+			// Variables, in the order of the parameters and declarations
+			void collect_variables(ExpressionST* expression) {
+				if (!expression) return;
+				switch (expression->type) {
+				case AstType::BLOCK:
+				{
+					BlockST* block_st = static_cast<BlockST*>(expression);
+					for (uint32_t i = 0; i < block_st->num_children; i++) collect_variables(block_st->children[i]);
+					return;
+				}
+				case AstType::VAR_DECLARATION:
+				{
+					VariableDeclarationST* var_st = static_cast<VariableDeclarationST*>(expression);
+					if (!registers.count(var_st->identifier)) {
+						registers[var_st->identifier] = allocate_register();
+						types[var_st->identifier] = var_st->var_type;
+					}
+					collect_variables(var_st->value);
+					return;
+				}
+				case AstType::VAR_ASSIGNMENT:
+					collect_variables(static_cast<VariableAssignST*>(expression)->value);
+					return;
+				case AstType::RETURN:
+					collect_variables(static_cast<ReturnST*>(expression)->expression);
+					return;
+				case AstType::IF:
+				{
+					IfST* if_st = static_cast<IfST*>(expression);
+					collect_variables(if_st->condition);
+					collect_variables(if_st->then_body);
+					if (if_st->has_else) collect_variables(if_st->else_body);
+					return;
+				}
+				case AstType::LOOP:
+					collect_variables(static_cast<LoopST*>(expression)->condition);
+					collect_variables(static_cast<LoopST*>(expression)->body);
+					return;
+				case AstType::MATCH:
+				{
+					MatchST* match_st = static_cast<MatchST*>(expression);
+					collect_variables(match_st->value);
+					for (MatchArm& arm : match_st->arms) collect_variables(arm.body);
+					collect_variables(match_st->default_body);
+					return;
+				}
+				case AstType::OPERATION:
+					collect_variables(static_cast<OperationST*>(expression)->lhs);
+					collect_variables(static_cast<OperationST*>(expression)->rhs);
+					return;
+				case AstType::FUNCTION_CALL:
+					for (ExpressionST* argument : static_cast<FunctionCallST*>(expression)->arguments) collect_variables(argument);
+					return;
+				case AstType::ARRAY_DECLARATION:
+				{
+					ArrayDeclarationST* array_st = static_cast<ArrayDeclarationST*>(expression);
+					if (!arrays.count(array_st->identifier)) arrays[array_st->identifier] = allocate_array();
+					if (!array_st->is_slice()) {
+						// Every declaration gets elements of its own, aligned to 8 bytes
+						uint32_t& size = array_st->is_static ? static_size : function.memory_size;
+						array_offsets[array_st] = size;
+						size += (array_st->length * get_type_size(array_st->element_type) + 7) & ~7u;
+					}
+					collect_variables(array_st->value);
+					return;
+				}
+				case AstType::SLICE:
+					collect_variables(static_cast<SliceST*>(expression)->begin);
+					collect_variables(static_cast<SliceST*>(expression)->end);
+					return;
+				case AstType::INDEX:
+					collect_variables(static_cast<IndexST*>(expression)->index);
+					return;
+				case AstType::INDEX_ASSIGNMENT:
+					collect_variables(static_cast<IndexAssignST*>(expression)->index);
+					collect_variables(static_cast<IndexAssignST*>(expression)->value);
+					return;
+				default:
+					return;
+				}
+			}
+
+			ArrayRegisters allocate_array() {
+				ArrayRegisters array;
+				array.pointer = allocate_register();
+				array.length = allocate_register();
+				return array;
+			}
+
+			Opcode get_load_opcode(Type element_type) {
+				switch (element_type) {
+				case Type::INT8: return Opcode::LOAD_I8;
+				case Type::UINT8: return Opcode::LOAD_U8;
+				case Type::INT16: return Opcode::LOAD_I16;
+				case Type::UINT16: return Opcode::LOAD_U16;
+				case Type::INT32: return Opcode::LOAD_I32;
+				case Type::UINT32: return Opcode::LOAD_U32;
+				default: return Opcode::LOAD_64;
+				}
+			}
+
+			Opcode get_store_opcode(Type element_type) {
+				switch (get_type_size(element_type)) {
+				case 1: return Opcode::STORE_8;
+				case 2: return Opcode::STORE_16;
+				case 4: return Opcode::STORE_32;
+				default: return Opcode::STORE_64;
+				}
+			}
+
+			// An index in the register of its own type. Negative indices are huge as unsigned values, so CHECK catches them too
+			uint8_t compile_index_operand(ExpressionST* index) {
+				return compile_operand(index, get_register_type(get_value_type(index)));
+			}
+
+			uint8_t compile_index(IndexST* index_st, int dest) {
+				const ArrayRegisters& array = arrays.at(index_st->identifier);
+				uint32_t mark = next_register;
+				uint8_t index = compile_index_operand(index_st->index);
+				if (index_st->checked) emit(Opcode::CHECK, index, array.length);
+				next_register = mark;
+				uint8_t reg = dest >= 0 ? dest : allocate_register();
+				emit(get_load_opcode(index_st->element_type), reg, array.pointer, index);
+				return reg;
+			}
+
+			// The value is calculated before the index, like in the native code
+			void compile_index_assignment(IndexAssignST* index_st) {
+				const ArrayRegisters& array = arrays.at(index_st->identifier);
+				uint8_t value = compile_operand(index_st->value, get_register_type(index_st->element_type));
+				uint8_t index = compile_index_operand(index_st->index);
+				if (index_st->checked) emit(Opcode::CHECK, index, array.length);
+				emit(get_store_opcode(index_st->element_type), value, array.pointer, index);
+			}
+
+			// Puts the address of the first element of a slice into pointer and its length into length
+			void compile_slice(SliceST* slice_st, uint8_t pointer, uint8_t length) {
+				ArrayRegisters source = arrays.at(slice_st->identifier);
+				uint32_t mark = next_register;
+				uint8_t begin = compile_index_operand(slice_st->begin);
+				uint8_t end = compile_index_operand(slice_st->end);
+				if (slice_st->checked) emit(Opcode::CHECK_SLICE, begin, end, source.length);
+				// The slice can be a slice of itself, so its registers are only written at the end
+				uint8_t offset = allocate_register();
+				uint8_t new_length = allocate_register();
+				emit_constant(Opcode::MULK_64, offset, begin, get_type_size(slice_st->return_type));
+				emit(Opcode::SUB_U32, new_length, end, begin);
+				emit(Opcode::ADD_64, pointer, source.pointer, offset);
+				emit(Opcode::MOV, length, new_length);
+				next_register = mark;
+			}
+
+			void compile_array_declaration(ArrayDeclarationST* array_st) {
+				const ArrayRegisters& array = arrays.at(array_st->identifier);
+				if (array_st->is_slice()) {
+					compile_slice(static_cast<SliceST*>(array_st->value), array.pointer, array.length);
+					return;
+				}
+				uint32_t offset = array_offsets.at(array_st);
+				if (array_st->is_static) emit_constant(Opcode::STATIC, array.pointer, 0, offset);
+				else emit_constant(Opcode::ARRAY, array.pointer, 0, (int64_t)offset << 32 | array_st->length * get_type_size(array_st->element_type));
+				emit_constant(Opcode::LOADK, array.length, 0, array_st->length);
+			}
+
+			Opcode get_arithmetic_opcode(Operation op, Type register_type, bool constant) {
+				// Variants are in the order I32, U32, 64
+				int variant = register_type == Type::INT32 ? 0 : register_type == Type::UINT32 ? 1 : 2;
+				switch (op) {
+				case Operation::ADD: return (Opcode)((int)(constant ? Opcode::ADDK_I32 : Opcode::ADD_I32) + variant);
+				case Operation::SUB: return (Opcode)((int)(constant ? Opcode::SUBK_I32 : Opcode::SUB_I32) + variant);
+				case Operation::MUL: return (Opcode)((int)(constant ? Opcode::MULK_I32 : Opcode::MUL_I32) + variant);
+				case Operation::POW: return (Opcode)((int)Opcode::POW_I32 + variant);
+				default: break;
+				}
+				// Division is different for signed and unsigned 64-bit values: I32, U32, I64, U64
+				variant = register_type == Type::INT32 ? 0 : register_type == Type::UINT32 ? 1 : register_type == Type::INT64 ? 2 : 3;
+				if (op == Operation::DIV) return (Opcode)((int)Opcode::DIV_I32 + variant);
+				return (Opcode)((int)Opcode::MOD_I32 + variant);
+			}
+
+			// Compare instructions are in the order EQ, NE, LT, LE, GT, GE (signed), LT, LE, GT, GE (unsigned)
+			Opcode get_compare_opcode(Opcode first, Operation op, bool is_unsigned) {
+				switch (op) {
+				case Operation::EQ: return first;
+				case Operation::NEQ: return (Opcode)((int)first + 1);
+				default: break;
+				}
+				int offset = op == Operation::LT ? 2 : op == Operation::LTE ? 3 : op == Operation::GT ? 4 : 5;
+				if (is_unsigned) offset += 4;
+				return (Opcode)((int)first + offset);
+			}
+
+			// Jumps to the label of the arm the value of a match has, or to default_label. Returns a label for every arm.
+			// The cases are compared one after another, in the order of their values
+			std::vector<uint32_t> compile_match_jumps(MatchST* match_st, uint32_t default_label) {
+				Type register_type = get_register_type(get_value_type(match_st->value));
+				std::vector<uint32_t> arm_labels;
+				for (size_t i = 0; i < match_st->arms.size(); i++) arm_labels.push_back(new_label());
+				uint32_t mark = next_register;
+				uint8_t value = compile_operand(match_st->value, register_type);
+				for (const Optimizer::MatchCase& match_case : Optimizer::get_match_cases(match_st, register_type)) {
+					emit_jump_constant(Opcode::JEQK, arm_labels[match_case.arm], value, match_case.value);
+				}
+				emit_jump(Opcode::JUMP, default_label);
+				next_register = mark;
+				return arm_labels;
+			}
+
+			// An operand of an operation calculated in register_type. Variables are used in their registers directly
+			uint8_t compile_operand(ExpressionST* operand, Type register_type) {
+				if (operand->type == AstType::VAR_VALUE) {
+					VariableValST* var_st = static_cast<VariableValST*>(operand);
+					if (fits_representation(types[var_st->identifier], register_type)) return registers[var_st->identifier];
+				}
+				uint8_t reg = allocate_register();
+				compile_into(operand, reg, register_type);
+				return reg;
+			}
+
+			// Calculates an expression into reg, normalized to type
+			void compile_into(ExpressionST* expression, uint8_t reg, Type type) {
+				if (expression->type == AstType::CONSTANT) {
+					emit_constant(Opcode::LOADK, reg, 0, normalize(parse_constant(static_cast<ConstantST*>(expression)->constant), type));
+					return;
+				}
+				uint32_t mark = next_register;
+				bool fits = fits_representation(get_value_type(expression), type);
+				uint8_t result = compile_expression(expression, fits ? reg : -1);
+				if (!fits) emit(Opcode::CONV, reg, result, (uint8_t)type);
+				next_register = mark;
+			}
+
+			// Calculates an expression into a register, which is dest if it isn't -1. Without dest, variables are not copied
+			uint8_t compile_expression(ExpressionST* expression, int dest = -1) {
+				switch (expression->type) {
+				case AstType::CONSTANT:
+				{
+					uint8_t reg = dest >= 0 ? dest : allocate_register();
+					emit_constant(Opcode::LOADK, reg, 0, parse_constant(static_cast<ConstantST*>(expression)->constant));
+					return reg;
+				}
+				case AstType::VAR_VALUE:
+				{
+					uint8_t reg = registers[static_cast<VariableValST*>(expression)->identifier];
+					if (dest < 0 || dest == reg) return reg;
+					emit(Opcode::MOV, dest, reg);
+					return dest;
+				}
+				case AstType::OPERATION:
+					return compile_operation(static_cast<OperationST*>(expression), dest);
+				case AstType::FUNCTION_CALL:
+					return compile_call(static_cast<FunctionCallST*>(expression), dest);
+				case AstType::INDEX:
+					return compile_index(static_cast<IndexST*>(expression), dest);
+				case AstType::LENGTH:
+				{
+					uint8_t reg = arrays.at(static_cast<LengthST*>(expression)->identifier).length;
+					if (dest < 0 || dest == reg) return reg;
+					emit(Opcode::MOV, dest, reg);
+					return dest;
+				}
+				case AstType::IF:
+				{
+					IfST* if_st = static_cast<IfST*>(expression);
+					uint8_t reg = dest >= 0 ? dest : allocate_register();
+					uint32_t else_label = new_label();
+					uint32_t end_label = new_label();
+					compile_condition_jump(if_st->condition, if_st->has_else ? else_label : end_label, false);
+					compile_into(if_st->then_body, reg, if_st->return_type);
+					if (if_st->has_else) {
+						emit_jump(Opcode::JUMP, end_label);
+						place_label(else_label);
+						compile_into(if_st->else_body, reg, if_st->return_type);
+					}
+					place_label(end_label);
+					return reg;
+				}
+				case AstType::MATCH:
+				{
+					MatchST* match_st = static_cast<MatchST*>(expression);
+					uint8_t reg = dest >= 0 ? dest : allocate_register();
+					uint32_t default_label = new_label();
+					uint32_t end_label = new_label();
+					std::vector<uint32_t> arm_labels = compile_match_jumps(match_st, default_label);
+					for (size_t i = 0; i < match_st->arms.size(); i++) {
+						place_label(arm_labels[i]);
+						compile_into(match_st->arms[i].body, reg, match_st->return_type);
+						emit_jump(Opcode::JUMP, end_label);
+					}
+					place_label(default_label);
+					compile_into(match_st->default_body, reg, match_st->return_type);
+					place_label(end_label);
+					return reg;
+				}
+				case AstType::BLOCK:
+				{
+					// A return in a block with a type ends it, with the value in the register. A void block returns for the
+					// block around the value, like it does as a statement
+					BlockST* block_st = static_cast<BlockST*>(expression);
+					uint8_t reg = dest >= 0 ? dest : allocate_register();
+					if (block_st->return_type == Type::VOID) {
+						compile_block(block_st, return_target);
+						return reg;
+					}
+					ReturnTarget target = { false, reg, block_st->return_type, new_label() };
+					compile_block(block_st, target);
+					place_label(target.label);
+					return reg;
+				}
+				default:
+					throw bytecode_error("Expression can't be compiled to bytecode");
+				}
+			}
+
+			uint8_t compile_operation(OperationST* op_st, int dest) {
+				if (is_comparison(op_st->op) || op_st->op == Operation::ANDL || op_st->op == Operation::ORL) {
+					// 1 if the condition is true, 0 otherwise
+					uint8_t reg = dest >= 0 ? dest : allocate_register();
+					uint32_t false_label = new_label();
+					uint32_t end_label = new_label();
+					if (is_comparison(op_st->op) && op_st->lhs->type != AstType::CONSTANT && op_st->rhs->type != AstType::CONSTANT) {
+						Type compare_type = get_register_type(get_compare_type(op_st->lhs, op_st->rhs));
+						uint32_t mark = next_register;
+						uint8_t lhs = compile_operand(op_st->lhs, compare_type);
+						uint8_t rhs = compile_operand(op_st->rhs, compare_type);
+						next_register = mark;
+						emit(get_compare_opcode(Opcode::EQ, op_st->op, is_unsigned_integer_type(compare_type)), reg, lhs, rhs);
+						return reg;
+					}
+					compile_condition_jump(op_st, false_label, false);
+					emit_constant(Opcode::LOADK, reg, 0, 1);
+					emit_jump(Opcode::JUMP, end_label);
+					place_label(false_label);
+					emit_constant(Opcode::LOADK, reg, 0, 0);
+					place_label(end_label);
+					return reg;
+				}
+
+				uint32_t mark = next_register;
+				uint8_t reg;
+				if (op_st->op == Operation::AND || op_st->op == Operation::OR) {
+					uint8_t lhs = compile_operand(op_st->lhs, Type::INT64);
+					uint8_t rhs = compile_operand(op_st->rhs, Type::INT64);
+					next_register = mark;
+					reg = dest >= 0 ? dest : allocate_register();
+					emit(op_st->op == Operation::AND ? Opcode::AND : Opcode::OR, reg, lhs, rhs);
+					return reg;
+				}
+
+				Type register_type = get_register_type(get_compare_type(op_st->lhs, op_st->rhs));
+				ExpressionST* lhs_st = op_st->lhs;
+				ExpressionST* rhs_st = op_st->rhs;
+				// The constant goes right, so the operation can take it directly
+				if (lhs_st->type == AstType::CONSTANT && (op_st->op == Operation::ADD || op_st->op == Operation::MUL)) std::swap(lhs_st, rhs_st);
+				bool constant = rhs_st->type == AstType::CONSTANT && (op_st->op == Operation::ADD || op_st->op == Operation::SUB || op_st->op == Operation::MUL);
+
+				// The left operand is calculated in the register of the result, so a chain like a / b / c / d needs one register
+				// and not one per operation. Not if it is a variable, the right operand could still read it
+				uint8_t lhs;
+				bool into_result = dest < 0 || (uint32_t)dest >= first_temporary;
+				if (into_result && !(lhs_st->type == AstType::VAR_VALUE && fits_representation(get_value_type(lhs_st), register_type))) {
+					reg = dest >= 0 ? dest : allocate_register();
+					compile_into(lhs_st, reg, register_type);
+					lhs = reg;
+				}
+				else lhs = compile_operand(lhs_st, register_type);
+				uint8_t rhs = constant ? 0 : compile_operand(rhs_st, register_type);
+				next_register = mark;
+				reg = dest >= 0 ? dest : allocate_register();
+				if (constant) {
+					int64_t value = normalize(parse_constant(static_cast<ConstantST*>(rhs_st)->constant), register_type);
+					emit_constant(get_arithmetic_opcode(op_st->op, register_type, true), reg, lhs, value);
+				}
+				else emit(get_arithmetic_opcode(op_st->op, register_type, false), reg, lhs, rhs);
+				return reg;
+			}
+
+			// The arguments are put into registers after all others, the frame of the called function starts at the first one.
+			// A slice takes two of them
+			uint8_t compile_call(FunctionCallST* call_st, int dest) {
+				uint32_t mark = next_register;
+				uint32_t first = next_register;
+				for (size_t i = 0; i < call_st->arguments.size(); i++) {
+					if (call_st->function->parameters[i].slice) {
+						ArrayRegisters slice = allocate_array();
+						compile_slice(static_cast<SliceST*>(call_st->arguments[i]), slice.pointer, slice.length);
+						next_register = slice.length + 1;
+						continue;
+					}
+					uint8_t reg = allocate_register();
+					compile_into(call_st->arguments[i], reg, call_st->function->parameters[i].type);
+					next_register = reg + 1;
+				}
+				next_register = mark;
+				uint8_t reg = dest >= 0 ? dest : allocate_register();
+				// The called function needs at least one register, for its return value
+				if (first + 1 > function.frame_size) function.frame_size = first + 1;
+				emit(Opcode::CALL, reg, first);
+				function.code.push_back(function_indices.at(call_st->function));
+				return reg;
+			}
+
+			// Jumps to label if the condition is jump_if_true, otherwise falls through
+			void compile_condition_jump(ExpressionST* condition, uint32_t label, bool jump_if_true) {
+				if (condition->type == AstType::CONSTANT) {
+					if ((parse_constant(static_cast<ConstantST*>(condition)->constant) != 0) == jump_if_true) emit_jump(Opcode::JUMP, label);
+					return;
+				}
+				uint32_t mark = next_register;
+				if (condition->type == AstType::OPERATION) {
+					OperationST* op_st = static_cast<OperationST*>(condition);
+					if (op_st->op == Operation::ANDL || op_st->op == Operation::ORL) {
+						// The value of lhs that decides the result on its own (false for &&, true for ||)
+						bool lhs_decides = op_st->op == Operation::ORL;
+						if (lhs_decides == jump_if_true) {
+							compile_condition_jump(op_st->lhs, label, jump_if_true);
+							compile_condition_jump(op_st->rhs, label, jump_if_true);
+						}
+						else {
+							uint32_t skip_label = new_label();
+							compile_condition_jump(op_st->lhs, skip_label, lhs_decides);
+							compile_condition_jump(op_st->rhs, label, jump_if_true);
+							place_label(skip_label);
+						}
+						return;
+					}
+					if (is_comparison(op_st->op)) {
+						// Compare and jump in one instruction
+						Type compare_type = get_register_type(get_compare_type(op_st->lhs, op_st->rhs));
+						bool is_unsigned = is_unsigned_integer_type(compare_type);
+						ExpressionST* lhs_st = op_st->lhs;
+						ExpressionST* rhs_st = op_st->rhs;
+						Operation op = op_st->op;
+						if (lhs_st->type == AstType::CONSTANT) {
+							std::swap(lhs_st, rhs_st);
+							op = mirror_comparison(op);
+						}
+						if (!jump_if_true) op = negate_comparison(op);
+						uint8_t lhs = compile_operand(lhs_st, compare_type);
+						if (rhs_st->type == AstType::CONSTANT) {
+							int64_t value = normalize(parse_constant(static_cast<ConstantST*>(rhs_st)->constant), compare_type);
+							emit_jump_constant(get_compare_opcode(Opcode::JEQK, op, is_unsigned), label, lhs, value);
+						}
+						else {
+							uint8_t rhs = compile_operand(rhs_st, compare_type);
+							emit_jump(get_compare_opcode(Opcode::JEQ, op, is_unsigned), label, lhs, rhs);
+						}
+						next_register = mark;
+						return;
+					}
+				}
+				uint8_t reg = compile_expression(condition);
+				emit_jump(jump_if_true ? Opcode::JNZ : Opcode::JZ, label, reg);
+				next_register = mark;
+			}
+
+			void compile_block(BlockST* block_st, const ReturnTarget& target) {
+				ReturnTarget parent_target = return_target;
+				return_target = target;
+				for (uint32_t i = 0; i < block_st->num_children; i++) compile_statement(block_st->children[i], target);
+				return_target = parent_target;
+			}
+
+			void compile_statement(ExpressionST* statement, const ReturnTarget& target) {
+				uint32_t mark = next_register;
+				switch (statement->type) {
+				case AstType::BLOCK:
+				{
+					BlockST* block_st = static_cast<BlockST*>(statement);
+					// Blocks with a type catch the returns in them, void blocks return for their parent
+					if (block_st->return_type != Type::VOID) compile_expression(block_st);
+					else compile_block(block_st, target);
+					break;
+				}
+				case AstType::RETURN:
+				{
+					ReturnST* ret_st = static_cast<ReturnST*>(statement);
+					if (target.function) {
+						uint8_t reg = allocate_register();
+						compile_into(ret_st->expression, reg, function.return_type);
+						emit(Opcode::RET, reg);
+					}
+					else {
+						compile_into(ret_st->expression, target.reg, target.type);
+						emit_jump(Opcode::JUMP, target.label);
+					}
+					break;
+				}
+				case AstType::VAR_DECLARATION:
+				{
+					VariableDeclarationST* var_st = static_cast<VariableDeclarationST*>(statement);
+					compile_into(var_st->value, registers[var_st->identifier], types[var_st->identifier]);
+					break;
+				}
+				case AstType::VAR_ASSIGNMENT:
+				{
+					VariableAssignST* var_st = static_cast<VariableAssignST*>(statement);
+					compile_into(var_st->value, registers[var_st->identifier], types[var_st->identifier]);
+					break;
+				}
+				case AstType::IF:
+				{
+					IfST* if_st = static_cast<IfST*>(statement);
+					uint32_t else_label = new_label();
+					uint32_t end_label = new_label();
+					compile_condition_jump(if_st->condition, if_st->has_else ? else_label : end_label, false);
+					compile_statement(if_st->then_body, target);
+					if (if_st->has_else) {
+						emit_jump(Opcode::JUMP, end_label);
+						place_label(else_label);
+						compile_statement(if_st->else_body, target);
+					}
+					place_label(end_label);
+					break;
+				}
+				case AstType::MATCH:
+				{
+					MatchST* match_st = static_cast<MatchST*>(statement);
+					uint32_t default_label = new_label();
+					uint32_t end_label = new_label();
+					std::vector<uint32_t> arm_labels = compile_match_jumps(match_st, default_label);
+					for (size_t i = 0; i < match_st->arms.size(); i++) {
+						place_label(arm_labels[i]);
+						compile_statement(match_st->arms[i].body, target);
+						emit_jump(Opcode::JUMP, end_label);
+					}
+					place_label(default_label);
+					if (match_st->default_body) compile_statement(match_st->default_body, target);
+					place_label(end_label);
+					break;
+				}
+				case AstType::LOOP:
+				{
+					// Rotated like the native loops: the condition is checked before the first iteration and at the bottom
+					LoopST* loop_st = static_cast<LoopST*>(statement);
+					uint32_t begin_label = new_label();
+					uint32_t end_label = new_label();
+					if (loop_st->condition) compile_condition_jump(loop_st->condition, end_label, false);
+					place_label(begin_label);
+					compile_statement(loop_st->body, target);
+					if (loop_st->condition) compile_condition_jump(loop_st->condition, begin_label, true);
+					else emit_jump(Opcode::JUMP, begin_label);
+					place_label(end_label);
+					break;
+				}
+				case AstType::ARRAY_DECLARATION:
+					compile_array_declaration(static_cast<ArrayDeclarationST*>(statement));
+					break;
+				case AstType::INDEX_ASSIGNMENT:
+					compile_index_assignment(static_cast<IndexAssignST*>(statement));
+					break;
+				case AstType::FUNCTION_CALL:
+				case AstType::OPERATION:
+				case AstType::INDEX:
+					// The value isn't used
+					compile_expression(statement);
+					break;
+				default:
+					break;
+				}
+				next_register = mark;
+			}
+
+			void compile(FunctionDefST* function_st) {
+				function.name = function_st->name;
+				function.num_parameters = function_st->parameters.size();
+				function.return_type = function_st->return_type;
+				for (ParameterDef& parameter : function_st->parameters) {
+					if (parameter.slice) {
+						arrays[parameter.identifier] = allocate_array();
+						continue;
+					}
+					registers[parameter.identifier] = allocate_register();
+					types[parameter.identifier] = parameter.type;
+				}
+				collect_variables(function_st->statement);
+				first_temporary = next_register;
+
+				ReturnTarget target = { true, 0, function_st->return_type, 0 };
+				compile_block(function_st->statement, target);
+				// A function without a return at its end returns 0
+				uint8_t reg = allocate_register();
+				emit_constant(Opcode::LOADK, reg, 0, 0);
+				emit(Opcode::RET, reg);
+
+				for (auto& jump : jumps) function.code[jump.first] = label_positions[jump.second];
+			}
+		};
+
+		// Compiles every function of the program to bytecode
+		static BytecodeProgram compile_program(ProgramST* program) {
+			BytecodeProgram bytecode;
+			std::map<FunctionDefST*, uint32_t> function_indices;
+			for (size_t i = 0; i < program->functions.size(); i++) {
+				function_indices[program->functions[i]] = i;
+				if (program->functions[i] == program->main) bytecode.main = i;
+			}
+			bytecode.functions.resize(program->functions.size());
+			for (size_t i = 0; i < program->functions.size(); i++) {
+				FunctionCompiler compiler(bytecode.functions[i], function_indices, bytecode.static_size);
+				compiler.compile(program->functions[i]);
+				Report::add_line("passes", "bytecode compiler compiled " + bytecode.functions[i].name + " to " + std::to_string(bytecode.functions[i].code.size())
+					+ " words of bytecode, " + std::to_string(bytecode.functions[i].frame_size) + " registers");
+			}
+			return bytecode;
+		}
+	}
+}
@@ -0,0 +1,320 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+
+#include "interpreter/bytecode.h"
+
+// Handlers are jumped to through their addresses (computed goto) where the compiler supports it, otherwise
+// they are cases of a switch. BONFIRE_SWITCH_DISPATCH forces the switch, to compare both
+#if (defined(__GNUC__) || defined(__clang__)) && !defined(BONFIRE_SWITCH_DISPATCH)
+#define BONFIRE_COMPUTED_GOTO
+#endif
+
+namespace Bonfire {
+	namespace Interpreter {
+
+		// Exception to throw if the program can't go on, like the native program would crash
+		class vm_error : std::exception {
+		public:
+			std::string message;
+			vm_error(const std::string& message) {
+				this->message = message;
+			}
+		};
+
+		// An instruction with everything decoded: the address of its handler, its registers, its constant and the
+		// instruction it jumps to. The loop runs from one to the next without looking at the bytecode again
+		struct Threaded {
+			const void* handler = NULL;
+			Opcode op = Opcode::RET;
+			uint8_t a = 0, b = 0, c = 0;
+			int64_t k = 0;
+			const Threaded* target = NULL;
+			uint32_t function = 0;
+		};
+
+		struct LoadedFunction {
+			std::vector<Threaded> code;
+			uint32_t frame_size;
+			uint32_t memory_size;
+		};
+
+		struct Frame {
+			const Threaded* return_ip;
+			int64_t* registers;
+			uint8_t result;
+			uint8_t* memory;
+			uint32_t memory_size;
+		};
+
+		// Registers of all frames, in 64-bit values
+		const size_t VM_STACK_SIZE = 1 << 20;
+		// Stack arrays of all frames, in bytes
+		const size_t VM_MEMORY_SIZE = 1 << 24;
+
+		// Threads the bytecode of a function: every instruction becomes one Threaded, jumps point to them
+		static LoadedFunction load_function(const BytecodeFunction& function, const void* const* handlers) {
+			LoadedFunction loaded;
+			loaded.frame_size = function.frame_size;
+			loaded.memory_size = function.memory_size;
+			std::vector<uint32_t> indices(function.code.size() + 1);
+			std::vector<uint32_t> targets;
+			for (size_t i = 0; i < function.code.size();) {
+				uint32_t word = function.code[i];
+				Threaded instruction;
+				instruction.op = (Opcode)(word & 0xFF);
+				if (instruction.op >= Opcode::NUM_OPCODES) throw vm_error("Invalid opcode in " + function.name);
+				instruction.handler = handlers ? handlers[(int)instruction.op] : NULL;
+				instruction.a = (word >> 8) & 0xFF;
+				instruction.b = (word >> 16) & 0xFF;
+				instruction.c = (word >> 24) & 0xFF;
+				uint32_t jump = 0;
+				switch (get_format(instruction.op)) {
+				case Format::ABK: instruction.k = function.constants[function.code[i + 1]]; break;
+				case Format::AKJ:
+					instruction.k = function.constants[function.code[i + 1]];
+					jump = function.code[i + 2];
+					break;
+				case Format::ABJ:
+				case Format::AJ:
+				case Format::J: jump = function.code[i + 1]; break;
+				case Format::ABF: instruction.function = function.code[i + 1]; break;
+				default: break;
+				}
+				indices[i] = loaded.code.size();
+				targets.push_back(jump);
+				loaded.code.push_back(instruction);
+				i += get_instruction_words(instruction.op);
+			}
+			for (size_t i = 0; i < loaded.code.size(); i++) {
+				Format format = get_format(loaded.code[i].op);
+				if (format == Format::AKJ || format == Format::ABJ || format == Format::AJ || format == Format::J) {
+					loaded.code[i].target = &loaded.code[indices[targets[i]]];
+				}
+			}
+			return loaded;
+		}
+
+		int64_t power(uint64_t base, uint64_t exponent) {
+			uint64_t result = 1;
+			while (exponent) {
+				if (exponent & 1) result *= base;
+				base *= base;
+				exponent >>= 1;
+			}
+			return result;
+		}
+
+		// Runs main of the program and returns what it returned, as a value of its return type
+		static int64_t run_bytecode(const BytecodeProgram& program) {
+#ifdef BONFIRE_COMPUTED_GOTO
+			#define BONFIRE_OPCODE_LABEL(name, format) &&op_##name,
+			static const void* const handlers[] = { BONFIRE_OPCODES(BONFIRE_OPCODE_LABEL) };
+			#undef BONFIRE_OPCODE_LABEL
+			#define VM_OP(name) op_##name:
+			#define VM_NEXT goto *ip->handler
+#else
+			static const void* const* handlers = NULL;
+			#define VM_OP(name) case Opcode::name:
+			#define VM_NEXT continue
+#endif
+			std::vector<LoadedFunction> functions;
+			for (const BytecodeFunction& function : program.functions) functions.push_back(load_function(function, handlers));
+
+			std::vector<int64_t> stack(VM_STACK_SIZE);
+			std::vector<Frame> frames;
+			frames.reserve(1024);
+			const LoadedFunction& main = functions[program.main];
+			if (main.frame_size > VM_STACK_SIZE) throw vm_error("Stack overflow");
+			int64_t* r = stack.data();
+			int64_t* stack_end = stack.data() + stack.size();
+
+			// Arrays are kept in 64-bit words, so every element is aligned. Programs without arrays don't get any memory
+			bool has_arrays = false;
+			for (const LoadedFunction& function : functions) has_arrays |= function.memory_size > 0;
+			std::vector<uint64_t> memory(has_arrays ? VM_MEMORY_SIZE / 8 : 0);
+			std::vector<uint64_t> statics((program.static_size + 7) / 8);
+			if (main.memory_size > memory.size() * 8) throw vm_error("Stack overflow");
+			uint8_t* m = (uint8_t*)memory.data();
+			uint8_t* memory_end = m + memory.size() * 8;
+			uint32_t memory_size = main.memory_size;
+			const Threaded* ip = main.code.data();
+			int64_t result = 0;
+
+			#define VM_BINARY(name, type, expression) VM_OP(name) { type x = (type)r[ip->b]; type y = (type)r[ip->c]; r[ip->a] = (expression); ++ip; VM_NEXT; }
+			#define VM_CONSTANT(name, type, expression) VM_OP(name) { type x = (type)r[ip->b]; type y = (type)ip->k; r[ip->a] = (expression); ++ip; VM_NEXT; }
+			#define VM_DIVIDE(name, type, expression) VM_OP(name) { type x = (type)r[ip->b]; type y = (type)r[ip->c]; \
+				if (y == 0) throw vm_error("Division by zero"); \
+				if ((type)-1 < 0 && y == (type)-1 && x == (type)((type)1 << (sizeof(type) * 8 - 1))) throw vm_error("Division overflow"); \
+				r[ip->a] = (expression); ++ip; VM_NEXT; }
+			#define VM_COMPARE(name, type, operator) VM_OP(name) { r[ip->a] = (type)r[ip->b] operator (type)r[ip->c]; ++ip; VM_NEXT; }
+			#define VM_JUMP(name, type, operator) VM_OP(name) { ip = (type)r[ip->a] operator (type)r[ip->b] ? ip->target : ip + 1; VM_NEXT; }
+			#define VM_JUMP_CONSTANT(name, type, operator) VM_OP(name) { ip = (type)r[ip->a] operator (type)ip->k ? ip->target : ip + 1; VM_NEXT; }
+			#define VM_ELEMENT(type) (uint8_t*)(intptr_t)r[ip->b] + r[ip->c] * (int64_t)sizeof(type)
+			#define VM_LOAD(name, type) VM_OP(name) { type value; memcpy(&value, VM_ELEMENT(type), sizeof(type)); r[ip->a] = (int64_t)value; ++ip; VM_NEXT; }
+			#define VM_STORE(name, type) VM_OP(name) { type value = (type)r[ip->a]; memcpy(VM_ELEMENT(type), &value, sizeof(type)); ++ip; VM_NEXT; }
+
+#ifdef BONFIRE_COMPUTED_GOTO
+			VM_NEXT;
+#else
+			for (;;) switch (ip->op) {
+#endif
+			VM_OP(MOV) { r[ip->a] = r[ip->b]; ++ip; VM_NEXT; }
+			VM_OP(LOADK) { r[ip->a] = ip->k; ++ip; VM_NEXT; }
+			VM_OP(CONV) { r[ip->a] = normalize(r[ip->b], (Type)ip->c); ++ip; VM_NEXT; }
+
+			// Values wrap around like in their registers: unsigned math, then cut to 32 bits
+			VM_BINARY(ADD_I32, uint32_t, (int64_t)(int32_t)(x + y))
+			VM_BINARY(ADD_U32, uint32_t, (int64_t)(x + y))
+			VM_BINARY(ADD_64, uint64_t, (int64_t)(x + y))
+			VM_BINARY(SUB_I32, uint32_t, (int64_t)(int32_t)(x - y))
+			VM_BINARY(SUB_U32, uint32_t, (int64_t)(x - y))
+			VM_BINARY(SUB_64, uint64_t, (int64_t)(x - y))
+			VM_BINARY(MUL_I32, uint32_t, (int64_t)(int32_t)(x * y))
+			VM_BINARY(MUL_U32, uint32_t, (int64_t)(x * y))
+			VM_BINARY(MUL_64, uint64_t, (int64_t)(x * y))
+			VM_CONSTANT(ADDK_I32, uint32_t, (int64_t)(int32_t)(x + y))
+			VM_CONSTANT(ADDK_U32, uint32_t, (int64_t)(x + y))
+			VM_CONSTANT(ADDK_64, uint64_t, (int64_t)(x + y))
+			VM_CONSTANT(SUBK_I32, uint32_t, (int64_t)(int32_t)(x - y))
+			VM_CONSTANT(SUBK_U32, uint32_t, (int64_t)(x - y))
+			VM_CONSTANT(SUBK_64, uint64_t, (int64_t)(x - y))
+			VM_CONSTANT(MULK_I32, uint32_t, (int64_t)(int32_t)(x * y))
+			VM_CONSTANT(MULK_U32, uint32_t, (int64_t)(x * y))
+			VM_CONSTANT(MULK_64, uint64_t, (int64_t)(x * y))
+			VM_DIVIDE(DIV_I32, int32_t, (int64_t)(x / y))
+			VM_DIVIDE(DIV_U32, uint32_t, (int64_t)(x / y))
+			VM_DIVIDE(DIV_I64, int64_t, (int64_t)(x / y))
+			VM_DIVIDE(DIV_U64, uint64_t, (int64_t)(x / y))
+			VM_DIVIDE(MOD_I32, int32_t, (int64_t)(x % y))
+			VM_DIVIDE(MOD_U32, uint32_t, (int64_t)(x % y))
+			VM_DIVIDE(MOD_I64, int64_t, (int64_t)(x % y))
+			VM_DIVIDE(MOD_U64, uint64_t, (int64_t)(x % y))
+			VM_BINARY(POW_I32, uint32_t, (int64_t)(int32_t)power(x, y))
+			VM_BINARY(POW_U32, uint32_t, (int64_t)(uint32_t)power(x, y))
+			VM_BINARY(POW_64, uint64_t, power(x, y))
+			VM_BINARY(AND, int64_t, x & y)
+			VM_BINARY(OR, int64_t, x | y)
+
+			VM_COMPARE(EQ, int64_t, ==)
+			VM_COMPARE(NE, int64_t, !=)
+			VM_COMPARE(LT_S, int64_t, <)
+			VM_COMPARE(LE_S, int64_t, <=)
+			VM_COMPARE(GT_S, int64_t, >)
+			VM_COMPARE(GE_S, int64_t, >=)
+			VM_COMPARE(LT_U, uint64_t, <)
+			VM_COMPARE(LE_U, uint64_t, <=)
+			VM_COMPARE(GT_U, uint64_t, >)
+			VM_COMPARE(GE_U, uint64_t, >=)
+
+			VM_OP(JUMP) { ip = ip->target; VM_NEXT; }
+			VM_OP(JZ) { ip = r[ip->a] == 0 ? ip->target : ip + 1; VM_NEXT; }
+			VM_OP(JNZ) { ip = r[ip->a] != 0 ? ip->target : ip + 1; VM_NEXT; }
+			VM_JUMP(JEQ, int64_t, ==)
+			VM_JUMP(JNE, int64_t, !=)
+			VM_JUMP(JLT_S, int64_t, <)
+			VM_JUMP(JLE_S, int64_t, <=)
+			VM_JUMP(JGT_S, int64_t, >)
+			VM_JUMP(JGE_S, int64_t, >=)
+			VM_JUMP(JLT_U, uint64_t, <)
+			VM_JUMP(JLE_U, uint64_t, <=)
+			VM_JUMP(JGT_U, uint64_t, >)
+			VM_JUMP(JGE_U, uint64_t, >=)
+			VM_JUMP_CONSTANT(JEQK, int64_t, ==)
+			VM_JUMP_CONSTANT(JNEK, int64_t, !=)
+			VM_JUMP_CONSTANT(JLTK_S, int64_t, <)
+			VM_JUMP_CONSTANT(JLEK_S, int64_t, <=)
+			VM_JUMP_CONSTANT(JGTK_S, int64_t, >)
+			VM_JUMP_CONSTANT(JGEK_S, int64_t, >=)
+			VM_JUMP_CONSTANT(JLTK_U, uint64_t, <)
+			VM_JUMP_CONSTANT(JLEK_U, uint64_t, <=)
+			VM_JUMP_CONSTANT(JGTK_U, uint64_t, >)
+			VM_JUMP_CONSTANT(JGEK_U, uint64_t, >=)
+
+			VM_OP(ARRAY)
+			{
+				uint8_t* array = m + (ip->k >> 32);
+				memset(array, 0, (uint32_t)ip->k);
+				r[ip->a] = (int64_t)(intptr_t)array;
+				++ip;
+				VM_NEXT;
+			}
+			VM_OP(STATIC) { r[ip->a] = (int64_t)(intptr_t)((uint8_t*)statics.data() + ip->k); ++ip; VM_NEXT; }
+			VM_LOAD(LOAD_I8, int8_t)
+			VM_LOAD(LOAD_U8, uint8_t)
+			VM_LOAD(LOAD_I16, int16_t)
+			VM_LOAD(LOAD_U16, uint16_t)
+			VM_LOAD(LOAD_I32, int32_t)
+			VM_LOAD(LOAD_U32, uint32_t)
+			VM_LOAD(LOAD_64, int64_t)
+			VM_STORE(STORE_8, uint8_t)
+			VM_STORE(STORE_16, uint16_t)
+			VM_STORE(STORE_32, uint32_t)
+			VM_STORE(STORE_64, uint64_t)
+			VM_OP(CHECK)
+			{
+				if ((uint64_t)r[ip->a] >= (uint64_t)r[ip->b]) throw vm_error("Index out of bounds");
+				++ip;
+				VM_NEXT;
+			}
+			VM_OP(CHECK_SLICE)
+			{
+				if ((uint64_t)r[ip->b] > (uint64_t)r[ip->c] || (uint64_t)r[ip->a] > (uint64_t)r[ip->b]) throw vm_error("Slice out of bounds");
+				++ip;
+				VM_NEXT;
+			}
+
+			VM_OP(CALL)
+			{
+				// The frame of the called function starts at its arguments, its arrays after the arrays of the caller
+				const LoadedFunction& function = functions[ip->function];
+				int64_t* registers = r + ip->b;
+				if (registers + function.frame_size > stack_end) throw vm_error("Stack overflow");
+				uint8_t* arrays = m + memory_size;
+				if (function.memory_size > (size_t)(memory_end - arrays)) throw vm_error("Stack overflow");
+				frames.push_back({ ip + 1, r, ip->a, m, memory_size });
+				r = registers;
+				m = arrays;
+				memory_size = function.memory_size;
+				ip = function.code.data();
+				VM_NEXT;
+			}
+			VM_OP(RET)
+			{
+				int64_t value = r[ip->a];
+				if (frames.empty()) {
+					result = value;
+					goto done;
+				}
+				Frame& frame = frames.back();
+				ip = frame.return_ip;
+				r = frame.registers;
+				r[frame.result] = value;
+				m = frame.memory;
+				memory_size = frame.memory_size;
+				frames.pop_back();
+				VM_NEXT;
+			}
+#ifndef BONFIRE_COMPUTED_GOTO
+			default:
+				throw vm_error("Invalid opcode");
+			}
+#endif
+		done:
+			#undef VM_BINARY
+			#undef VM_CONSTANT
+			#undef VM_DIVIDE
+			#undef VM_COMPARE
+			#undef VM_JUMP
+			#undef VM_JUMP_CONSTANT
+			#undef VM_ELEMENT
+			#undef VM_LOAD
+			#undef VM_STORE
+			#undef VM_OP
+			#undef VM_NEXT
+			return result;
+		}
+	}
+}
@@ -17,6 +17,18 @@ namespace Bonfire {
 			}
 		};
 
+		// Gives every token the line it starts in, counted from 1
+		void set_token_lines(const std::string& source, std::vector<Token>& tokens, const std::vector<uint64_t>& token_indices) {
+			uint64_t index = 0;
+			uint32_t line = 1;
+			for (size_t i = 0; i < tokens.size(); i++) {
+				for (; index < token_indices[i]; index++) {
+					if (source[index] == '\n') ++line;
+				}
+				tokens[i].line = line;
+			}
+		}
+
 		// Tokenize a given source into a vector of tokens
 		void tokenize(std::string source, std::vector<Token>& tokens_out, std::vector<uint64_t>& token_indices) {
 			uint64_t cursor = 0;
@@ -52,6 +64,18 @@ namespace Bonfire {
 					token_indices.push_back(cursor);
 					++cursor;
 				}
+				// [
+				else if (c == '[') {
+					tokens_out.push_back(Token(TokenType::BRACKET_OPEN, ""));
+					token_indices.push_back(cursor);
+					++cursor;
+				}
+				// ]
+				else if (c == ']') {
+					tokens_out.push_back(Token(TokenType::BRACKET_CLOSE, ""));
+					token_indices.push_back(cursor);
+					++cursor;
+				}
 				// -
 				else if (c == '-' && source[cursor + 1] == '>') {
 					tokens_out.push_back(Token(TokenType::RETURN_TYPE, ""));
@@ -64,12 +88,54 @@ namespace Bonfire {
 					token_indices.push_back(cursor);
 					cursor += 2;
 				}
+				// <=
+				else if (c == '<' && source[cursor + 1] == '=') {
+					tokens_out.push_back(Token(TokenType::LTE, ""));
+					token_indices.push_back(cursor);
+					cursor += 2;
+				}
+				// <
+				else if (c == '<') {
+					tokens_out.push_back(Token(TokenType::LT, ""));
+					token_indices.push_back(cursor);
+					++cursor;
+				}
+				// >=
+				else if (c == '>' && source[cursor + 1] == '=') {
+					tokens_out.push_back(Token(TokenType::GTE, ""));
+					token_indices.push_back(cursor);
+					cursor += 2;
+				}
+				// >
+				else if (c == '>') {
+					tokens_out.push_back(Token(TokenType::GT, ""));
+					token_indices.push_back(cursor);
+					++cursor;
+				}
 				// :
 				else if (c == ':') {
 					tokens_out.push_back(Token(TokenType::COLON, ""));
 					token_indices.push_back(cursor);
 					++cursor;
 				}
+				// ,
+				else if (c == ',') {
+					tokens_out.push_back(Token(TokenType::COMMA, ""));
+					token_indices.push_back(cursor);
+					++cursor;
+				}
+				// ;
+				else if (c == ';') {
+					tokens_out.push_back(Token(TokenType::SEMICOLON, ""));
+					token_indices.push_back(cursor);
+					++cursor;
+				}
+				// ..
+				else if (c == '.' && source[cursor + 1] == '.') {
+					tokens_out.push_back(Token(TokenType::DOT2, ""));
+					token_indices.push_back(cursor);
+					cursor += 2;
+				}
 				else if (c == '=' && source[cursor + 1] == '=') {
 					tokens_out.push_back(Token(TokenType::EQUALS2, ""));
 					token_indices.push_back(cursor);
@@ -87,6 +153,12 @@ namespace Bonfire {
 					token_indices.push_back(cursor);
 					cursor += 2;
 				}
+				// ??
+				else if (c == '?' && source[cursor + 1] == '?') {
+					tokens_out.push_back(Token(TokenType::MATCH, ""));
+					token_indices.push_back(cursor);
+					cursor += 2;
+				}
 				// ?
 				else if (c == '?') {
 					tokens_out.push_back(Token(TokenType::IF, ""));
@@ -183,6 +255,7 @@ namespace Bonfire {
 				}
 				else if (isdigit(c)) {
 					// Number Constant
+					token_indices.push_back(cursor);
 					std::string number = "";
 					while (isdigit(source[cursor])) {
 						number += source[cursor];
@@ -193,9 +266,11 @@ namespace Bonfire {
 				else {
 					// TODO: Throwing the correct exception (unexpected_char) generates a segfault
 					// So we throw a different one
+					set_token_lines(source, tokens_out, token_indices);
 					throw Parser::unexpected_token(0);
 				}
 			}
+			set_token_lines(source, tokens_out, token_indices);
 		}
 	}
 }
\ No newline at end of file
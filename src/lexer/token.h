@@ -7,14 +7,24 @@ namespace Bonfire {
 		PAR_CLOSE,		// )
 		BRACE_OPEN,		// {
 		BRACE_CLOSE,	// }
+		BRACKET_OPEN,	// [
+		BRACKET_CLOSE,	// ]
 		RETURN,			// <-
 		RETURN_TYPE,	// ->
 		CONSTANT,		// Hard-Coded Constants like 2 or '\n'
 		COLON,			// : (type) or else
+		COMMA,			// , (between parameters and arguments)
+		SEMICOLON,		// ; (between the element type and the length of an array)
+		DOT2,			// .. (range of a slice)
 		EQUALS,			// =
 		EQUALS2,		// ==
 		NEQUALS,		// !=
+		LT,				// <
+		LTE,			// <=
+		GT,				// >
+		GTE,			// >=
 		IF,				// ?
+		MATCH,			// ??
 		// Arithmetic operations
 		PLUS,			// +
 		MINUS,			// -
@@ -33,6 +43,7 @@ namespace Bonfire {
 	{
 		TokenType type;
 		std::string value;
+		uint32_t line = 0;
 
 		Token(TokenType type, std::string value) {
 			this->type = type;
@@ -51,14 +62,62 @@ namespace Bonfire {
 				return "{";
 			case TokenType::BRACE_CLOSE:
 				return "}";
+			case TokenType::BRACKET_OPEN:
+				return "[";
+			case TokenType::BRACKET_CLOSE:
+				return "]";
 			case TokenType::RETURN:
 				return "<-";
 			case TokenType::RETURN_TYPE:
 				return "->";
 			case TokenType::IF:
 				return "?";
+			case TokenType::MATCH:
+				return "??";
 			case TokenType::CONSTANT:
 				return value.c_str();
+			case TokenType::COLON:
+				return ":";
+			case TokenType::COMMA:
+				return ",";
+			case TokenType::SEMICOLON:
+				return ";";
+			case TokenType::DOT2:
+				return "..";
+			case TokenType::EQUALS:
+				return "=";
+			case TokenType::EQUALS2:
+				return "==";
+			case TokenType::NEQUALS:
+				return "!=";
+			case TokenType::LT:
+				return "<";
+			case TokenType::LTE:
+				return "<=";
+			case TokenType::GT:
+				return ">";
+			case TokenType::GTE:
+				return ">=";
+			case TokenType::PLUS:
+				return "+";
+			case TokenType::MINUS:
+				return "-";
+			case TokenType::MUL:
+				return "*";
+			case TokenType::SLASH:
+				return "/";
+			case TokenType::MODULO:
+				return "%";
+			case TokenType::POW:
+				return "^";
+			case TokenType::OR:
+				return "|";
+			case TokenType::ORL:
+				return "||";
+			case TokenType::AND:
+				return "&";
+			case TokenType::ANDL:
+				return "&&";
 			default:
 				return "Unknown token";
 			}
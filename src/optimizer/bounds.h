@@ -0,0 +1,402 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <cstdint>
+
+#include "optimizer/loops.h"
+#include "utils/report.h"
+#include "ast.h"
+
+namespace Bonfire {
+	namespace Optimizer {
+
+		// Something that is known to hold at a point of the function: 0 <= index < len(array). Without an array,
+		// index < length holds instead, which is in bounds for every array of at least that length
+		struct BoundsFact {
+			std::string index;
+			std::string array;
+			uint32_t length;
+			std::string reason;	// For --report=bounds
+		};
+
+		typedef std::vector<BoundsFact> FactList;
+
+		struct BoundsContext {
+			std::string function;
+			TypeMap types;
+			// Arrays that are declared once in the function with a length, so their name always means the same array
+			std::map<std::string, uint32_t> lengths;
+			// Variables that can never be negative: unsigned ones and counters that only count up from a constant
+			std::set<std::string> counters;
+			uint32_t removed = 0;	// Checks that can't fail
+			uint32_t kept = 0;
+		};
+
+		// The lengths of the arrays of a function that are declared only once, and not as slices
+		std::map<std::string, uint32_t> collect_array_lengths(FunctionDefST* function) {
+			std::map<std::string, uint32_t> lengths;
+			std::set<std::string> ambiguous;
+			for (ParameterDef& parameter : function->parameters) {
+				if (parameter.slice) ambiguous.insert(parameter.identifier);
+			}
+			ExpressionST* body = function->statement;
+			for_each_slot(body, [&](ExpressionST*& slot) {
+				if (slot->type != AstType::ARRAY_DECLARATION) return false;
+				ArrayDeclarationST* array_st = static_cast<ArrayDeclarationST*>(slot);
+				if (array_st->is_slice() || lengths.count(array_st->identifier)) ambiguous.insert(array_st->identifier);
+				else lengths[array_st->identifier] = array_st->length;
+				return false;
+			});
+			for (const std::string& name : ambiguous) lengths.erase(name);
+			return lengths;
+		}
+
+		// The terms of a condition that all hold if it is true: a && b && c. A loop without a condition has none
+		void collect_conjuncts(ExpressionST* condition, std::vector<ExpressionST*>& terms) {
+			if (!condition) return;
+			if (condition->type == AstType::OPERATION && static_cast<OperationST*>(condition)->op == Operation::ANDL) {
+				collect_conjuncts(static_cast<OperationST*>(condition)->lhs, terms);
+				collect_conjuncts(static_cast<OperationST*>(condition)->rhs, terms);
+				return;
+			}
+			terms.push_back(condition);
+		}
+
+		// Splits i < bound (or bound > i, i <= bound) into the variable and the bound. The bound is len(a) or a constant,
+		// the constant is the exclusive bound
+		bool get_upper_bound(ExpressionST* term, std::string& index, ExpressionST*& bound, int64_t& constant) {
+			if (term->type != AstType::OPERATION) return false;
+			OperationST* op_st = static_cast<OperationST*>(term);
+			ExpressionST* variable;
+			bool inclusive = false;
+			switch (op_st->op) {
+			case Operation::LT: variable = op_st->lhs; bound = op_st->rhs; break;
+			case Operation::LTE: variable = op_st->lhs; bound = op_st->rhs; inclusive = true; break;
+			case Operation::GT: variable = op_st->rhs; bound = op_st->lhs; break;
+			case Operation::GTE: variable = op_st->rhs; bound = op_st->lhs; inclusive = true; break;
+			default: return false;
+			}
+			if (variable->type != AstType::VAR_VALUE) return false;
+			index = static_cast<VariableValST*>(variable)->identifier;
+			if (bound->type == AstType::LENGTH) return !inclusive;
+			if (!get_constant_value(bound, constant) || constant < 0) return false;
+			if (inclusive) ++constant;
+			return true;
+		}
+
+		// A signed counter stays positive if it starts at a constant that isn't negative and is only ever counted up
+		// in a loop that runs while it is below a bound, by a step that can't make it overflow. Only i32 and i64 counters,
+		// every bound is an array length or constant that fits into an i32
+		void collect_counters(FunctionDefST* function, BoundsContext& context) {
+			std::set<std::string> negative;
+			std::set<std::string> mixed;
+			std::set<ExpressionST*> steps;
+			for (ParameterDef& parameter : function->parameters) {
+				if (parameter.slice) continue;
+				if (!is_unsigned_integer_type(parameter.type)) negative.insert(parameter.identifier);
+				if (parameter.type != context.types[parameter.identifier]) mixed.insert(parameter.identifier);
+			}
+			ExpressionST* function_body = function->statement;
+			for_each_slot(function_body, [&](ExpressionST*& slot) {
+				if (slot->type != AstType::LOOP) return false;
+				LoopST* loop_st = static_cast<LoopST*>(slot);
+				if (loop_st->body->type != AstType::BLOCK) return false;
+				BlockST* body = static_cast<BlockST*>(loop_st->body);
+				std::map<std::string, uint32_t> writes;
+				count_writes(loop_st->condition, writes);
+				count_writes(body, writes);
+				std::vector<ExpressionST*> terms;
+				collect_conjuncts(loop_st->condition, terms);
+				for (uint32_t i = 0; i < body->num_children; i++) {
+					int64_t step;
+					VariableValST* counter_st = get_induction_step(body->children[i], writes, step);
+					if (!counter_st || step < 0) continue;
+					for (ExpressionST* term : terms) {
+						std::string index;
+						ExpressionST* bound;
+						int64_t constant = 0;
+						if (!get_upper_bound(term, index, bound, constant) || index.compare(counter_st->identifier)) continue;
+						// len(a) <= INT32_MAX, so i + 1 can't overflow
+						if (bound->type == AstType::LENGTH ? step <= 1 : constant + step <= INT32_MAX) steps.insert(body->children[i]);
+					}
+				}
+				return false;
+			});
+			for_each_slot(function_body, [&](ExpressionST*& slot) {
+				if (slot->type == AstType::VAR_DECLARATION) {
+					VariableDeclarationST* var_st = static_cast<VariableDeclarationST*>(slot);
+					int64_t value;
+					if (!get_constant_value(var_st->value, value) || value < 0) negative.insert(var_st->identifier);
+					// Another variable of the same name with another type
+					if (var_st->var_type != context.types[var_st->identifier]) mixed.insert(var_st->identifier);
+				}
+				if (slot->type == AstType::VAR_ASSIGNMENT && !steps.count(slot)) negative.insert(static_cast<VariableAssignST*>(slot)->identifier);
+				return false;
+			});
+			for (auto& variable : context.types) {
+				Type t = variable.second;
+				if (mixed.count(variable.first)) continue;
+				if (is_unsigned_integer_type(t) || ((t == Type::INT32 || t == Type::INT64) && !negative.count(variable.first))) context.counters.insert(variable.first);
+			}
+		}
+
+		// The facts the terms of a true condition give
+		void add_guards(ExpressionST* condition, FactList& facts, BoundsContext& context) {
+			std::vector<ExpressionST*> terms;
+			collect_conjuncts(condition, terms);
+			for (ExpressionST* term : terms) {
+				std::string index;
+				ExpressionST* bound;
+				int64_t constant = 0;
+				if (!get_upper_bound(term, index, bound, constant) || !context.counters.count(index)) continue;
+				if (bound->type == AstType::LENGTH) {
+					const std::string& array = static_cast<LengthST*>(bound)->identifier;
+					facts.push_back({ index, array, 0, index + " < len(" + array + ")" });
+				}
+				else if (constant <= UINT32_MAX) facts.push_back({ index, "", (uint32_t)constant, index + " < " + std::to_string(constant) });
+			}
+		}
+
+		// Forgets the facts about variables an expression writes and arrays it declares again
+		void kill_facts(ExpressionST* expression, FactList& facts) {
+			std::map<std::string, uint32_t> writes;
+			count_writes(expression, writes);
+			uint32_t num_facts = 0;
+			for (BoundsFact& fact : facts) {
+				if (writes.count(fact.index) || writes.count(fact.array)) continue;
+				facts[num_facts++] = fact;
+			}
+			facts.resize(num_facts);
+		}
+
+		// The accesses an expression always makes before it completes. Once they didn't trap, they are in bounds
+		void collect_accesses(ExpressionST* expression, FactList& facts) {
+			if (!expression) return;
+			switch (expression->type) {
+			case AstType::OPERATION:
+			{
+				OperationST* op_st = static_cast<OperationST*>(expression);
+				collect_accesses(op_st->lhs, facts);
+				// The right side of && and || doesn't always run
+				if (op_st->op != Operation::ANDL && op_st->op != Operation::ORL) collect_accesses(op_st->rhs, facts);
+				return;
+			}
+			case AstType::INDEX:
+			{
+				IndexST* index_st = static_cast<IndexST*>(expression);
+				collect_accesses(index_st->index, facts);
+				if (index_st->index->type == AstType::VAR_VALUE) {
+					const std::string& index = static_cast<VariableValST*>(index_st->index)->identifier;
+					facts.push_back({ index, index_st->identifier, 0, index_st->identifier + "[" + index + "] checked before" });
+				}
+				return;
+			}
+			case AstType::INDEX_ASSIGNMENT:
+			{
+				IndexAssignST* index_st = static_cast<IndexAssignST*>(expression);
+				collect_accesses(index_st->value, facts);
+				collect_accesses(index_st->index, facts);
+				if (index_st->index->type == AstType::VAR_VALUE) {
+					const std::string& index = static_cast<VariableValST*>(index_st->index)->identifier;
+					facts.push_back({ index, index_st->identifier, 0, index_st->identifier + "[" + index + "] checked before" });
+				}
+				return;
+			}
+			case AstType::VAR_ASSIGNMENT:
+				collect_accesses(static_cast<VariableAssignST*>(expression)->value, facts);
+				return;
+			case AstType::VAR_DECLARATION:
+				collect_accesses(static_cast<VariableDeclarationST*>(expression)->value, facts);
+				return;
+			case AstType::FUNCTION_CALL:
+				for (ExpressionST* argument : static_cast<FunctionCallST*>(expression)->arguments) collect_accesses(argument, facts);
+				return;
+			case AstType::IF:
+				collect_accesses(static_cast<IfST*>(expression)->condition, facts);
+				return;
+			case AstType::LOOP:
+				// The condition runs at least once
+				collect_accesses(static_cast<LoopST*>(expression)->condition, facts);
+				return;
+			case AstType::MATCH:
+				collect_accesses(static_cast<MatchST*>(expression)->value, facts);
+				return;
+			default:
+				return;
+			}
+		}
+
+		// Returns the fact that puts an access in bounds, or NULL
+		const BoundsFact* find_fact(const std::string& array, ExpressionST* index, const FactList& facts, BoundsContext& context) {
+			if (index->type != AstType::VAR_VALUE) return NULL;
+			const std::string& name = static_cast<VariableValST*>(index)->identifier;
+			auto length = context.lengths.find(array);
+			for (const BoundsFact& fact : facts) {
+				if (fact.index.compare(name)) continue;
+				if (!fact.array.compare(array)) return &fact;
+				if (fact.array.empty() && length != context.lengths.end() && fact.length <= length->second) return &fact;
+			}
+			return NULL;
+		}
+
+		// Decides if the check of a[index] can go. Constant indices are in bounds of arrays of a known length
+		bool eliminate_index_check(const std::string& array, ExpressionST* index, uint32_t line, const FactList& facts, BoundsContext& context) {
+			int64_t constant;
+			bool is_constant = get_constant_value(index, constant);
+			std::string access = array + "[" + (index->type == AstType::VAR_VALUE ? static_cast<VariableValST*>(index)->identifier : is_constant ? std::to_string(constant) : "...") + "]";
+			std::string where = " in " + context.function + " at line " + std::to_string(line);
+			auto length = context.lengths.find(array);
+			if (is_constant && length != context.lengths.end() && constant >= 0 && constant < length->second) {
+				context.removed++;
+				Report::add_line("bounds", "removed check of " + access + where + " (constant index)");
+				return true;
+			}
+			const BoundsFact* fact = find_fact(array, index, facts, context);
+			if (fact) {
+				context.removed++;
+				Report::add_line("bounds", "removed check of " + access + where + " (" + fact->reason + ")");
+				return true;
+			}
+			context.kept++;
+			Report::add_line("bounds", "kept check of " + access + where);
+			return false;
+		}
+
+		// A slice of the whole array, or with constant bounds inside of an array of a known length, can't fail
+		bool eliminate_slice_check(SliceST* slice_st, BoundsContext& context) {
+			int64_t begin, end;
+			if (!get_constant_value(slice_st->begin, begin) || begin < 0) return false;
+			if (slice_st->end->type == AstType::LENGTH && !static_cast<LengthST*>(slice_st->end)->identifier.compare(slice_st->identifier)) return begin == 0;
+			auto length = context.lengths.find(slice_st->identifier);
+			return length != context.lengths.end() && get_constant_value(slice_st->end, end) && begin <= end && end <= length->second;
+		}
+
+		void eliminate_bounds_checks(ExpressionST* expression, FactList facts, BoundsContext& context) {
+			if (!expression) return;
+			switch (expression->type) {
+			case AstType::BLOCK:
+			{
+				BlockST* block_st = static_cast<BlockST*>(expression);
+				for (uint32_t i = 0; i < block_st->num_children; i++) {
+					ExpressionST* child = block_st->children[i];
+					eliminate_bounds_checks(child, facts, context);
+					// What the statement always checked holds after it, unless it changed the index
+					FactList accesses;
+					collect_accesses(child, accesses);
+					kill_facts(child, accesses);
+					kill_facts(child, facts);
+					facts.insert(facts.end(), accesses.begin(), accesses.end());
+				}
+				return;
+			}
+			case AstType::LOOP:
+			{
+				LoopST* loop_st = static_cast<LoopST*>(expression);
+				// Facts from before the loop only hold in every iteration if the loop doesn't change them
+				kill_facts(loop_st, facts);
+				eliminate_bounds_checks(loop_st->condition, facts, context);
+				collect_accesses(loop_st->condition, facts);
+				add_guards(loop_st->condition, facts, context);
+				eliminate_bounds_checks(loop_st->body, facts, context);
+				return;
+			}
+			case AstType::IF:
+			{
+				IfST* if_st = static_cast<IfST*>(expression);
+				eliminate_bounds_checks(if_st->condition, facts, context);
+				collect_accesses(if_st->condition, facts);
+				if (if_st->has_else) eliminate_bounds_checks(if_st->else_body, facts, context);
+				add_guards(if_st->condition, facts, context);
+				eliminate_bounds_checks(if_st->then_body, facts, context);
+				return;
+			}
+			case AstType::MATCH:
+			{
+				MatchST* match_st = static_cast<MatchST*>(expression);
+				eliminate_bounds_checks(match_st->value, facts, context);
+				collect_accesses(match_st->value, facts);
+				for (MatchArm& arm : match_st->arms) eliminate_bounds_checks(arm.body, facts, context);
+				eliminate_bounds_checks(match_st->default_body, facts, context);
+				return;
+			}
+			case AstType::OPERATION:
+			{
+				OperationST* op_st = static_cast<OperationST*>(expression);
+				eliminate_bounds_checks(op_st->lhs, facts, context);
+				// a && b only calculates b if a is true
+				if (op_st->op == Operation::ANDL || op_st->op == Operation::ORL) {
+					collect_accesses(op_st->lhs, facts);
+					if (op_st->op == Operation::ANDL) add_guards(op_st->lhs, facts, context);
+				}
+				eliminate_bounds_checks(op_st->rhs, facts, context);
+				return;
+			}
+			case AstType::RETURN:
+				eliminate_bounds_checks(static_cast<ReturnST*>(expression)->expression, facts, context);
+				return;
+			case AstType::VAR_ASSIGNMENT:
+				eliminate_bounds_checks(static_cast<VariableAssignST*>(expression)->value, facts, context);
+				return;
+			case AstType::VAR_DECLARATION:
+				eliminate_bounds_checks(static_cast<VariableDeclarationST*>(expression)->value, facts, context);
+				return;
+			case AstType::FUNCTION_CALL:
+				for (ExpressionST* argument : static_cast<FunctionCallST*>(expression)->arguments) eliminate_bounds_checks(argument, facts, context);
+				return;
+			case AstType::ARRAY_DECLARATION:
+				eliminate_bounds_checks(static_cast<ArrayDeclarationST*>(expression)->value, facts, context);
+				return;
+			case AstType::SLICE:
+			{
+				SliceST* slice_st = static_cast<SliceST*>(expression);
+				eliminate_bounds_checks(slice_st->begin, facts, context);
+				eliminate_bounds_checks(slice_st->end, facts, context);
+				if (eliminate_slice_check(slice_st, context)) {
+					slice_st->checked = false;
+					context.removed++;
+					Report::add_line("bounds", "removed check of a slice of " + slice_st->identifier + " in " + context.function + " at line " + std::to_string(slice_st->line));
+				}
+				else {
+					context.kept++;
+					Report::add_line("bounds", "kept check of a slice of " + slice_st->identifier + " in " + context.function + " at line " + std::to_string(slice_st->line));
+				}
+				return;
+			}
+			case AstType::INDEX:
+			{
+				IndexST* index_st = static_cast<IndexST*>(expression);
+				eliminate_bounds_checks(index_st->index, facts, context);
+				if (eliminate_index_check(index_st->identifier, index_st->index, index_st->line, facts, context)) index_st->checked = false;
+				return;
+			}
+			case AstType::INDEX_ASSIGNMENT:
+			{
+				// The value is calculated before the index is checked
+				IndexAssignST* index_st = static_cast<IndexAssignST*>(expression);
+				eliminate_bounds_checks(index_st->value, facts, context);
+				collect_accesses(index_st->value, facts);
+				eliminate_bounds_checks(index_st->index, facts, context);
+				if (eliminate_index_check(index_st->identifier, index_st->index, index_st->line, facts, context)) index_st->checked = false;
+				return;
+			}
+			default:
+				return;
+			}
+		}
+
+		// Removes the bounds checks that can't fail: constant indices, indices guarded by a loop or if condition
+		// like i < len(a), and indices that were already checked with the same value. Runs last, after the other
+		// passes moved the accesses around
+		BoundsContext eliminate_bounds_checks(FunctionDefST* function) {
+			BoundsContext context;
+			context.function = function->name;
+			context.types = collect_variable_types(function);
+			context.lengths = collect_array_lengths(function);
+			collect_counters(function, context);
+			eliminate_bounds_checks(function->statement, FactList(), context);
+			return context;
+		}
+	}
+}
@@ -0,0 +1,159 @@
+#pragma once
+#include <string>
+#include <cstdlib>
+#include <vector>
+#include <set>
+#include <algorithm>
+
+#include "ast.h"
+
+namespace Bonfire {
+	namespace Optimizer {
+
+		// Wraps a value around like a register of the given type would
+		int64_t wrap_to_type(int64_t value, Type t) {
+			switch (t) {
+			case Type::INT8:	return (int8_t)value;
+			case Type::UINT8:	return (uint8_t)value;
+			case Type::INT16:	return (int16_t)value;
+			case Type::UINT16:	return (uint16_t)value;
+			case Type::INT32:	return (int32_t)value;
+			case Type::UINT32:	return (uint32_t)value;
+			default: return value;
+			}
+		}
+
+		// Type the generated code calculates a value of the given type in: the whole 32-bit register, or the 64-bit one.
+		// Narrow values are extended when they are loaded and only cut to their size when they are stored
+		Type get_register_type(Type t) {
+			if (!is_signed_integer_type(t) && !is_unsigned_integer_type(t)) return t;
+			if (get_type_size(t) == 8) return t;
+			return is_unsigned_integer_type(t) ? Type::UINT32 : Type::INT32;
+		}
+
+		// Type the result of an arithmetic operation has in its register. Comparisons produce 0 or 1 in any type
+		Type get_calculated_type(Operation op, Type lhs, Type rhs) {
+			Type t = get_op_result_type(op, lhs, rhs);
+			switch (op) {
+			case Operation::ADD:
+			case Operation::SUB:
+			case Operation::MUL:
+			case Operation::DIV:
+			case Operation::MOD:
+			case Operation::POW:
+				return get_register_type(t);
+			default:
+				return t;
+			}
+		}
+
+		// Type a match compares its value in: the 32-bit or 64-bit register (register_size) of the type of the value
+		Type get_match_type(Type value_type, uint8_t register_size) {
+			if (register_size == 8) return is_unsigned_integer_type(value_type) ? Type::UINT64 : Type::INT64;
+			return is_unsigned_integer_type(value_type) ? Type::UINT32 : Type::INT32;
+		}
+
+		// A value of a match (??) as it is compared, and the arm that has it
+		struct MatchCase {
+			int64_t value;
+			uint32_t arm;
+		};
+
+		// The values of the arms of a match, converted to the type the value is compared in, sorted the way the type compares
+		// them. A value that is in more than one arm after the conversion belongs to the first one
+		std::vector<MatchCase> get_match_cases(MatchST* match_st, Type compare_type) {
+			std::vector<MatchCase> cases;
+			std::set<int64_t> seen;
+			for (uint32_t i = 0; i < match_st->arms.size(); i++) {
+				for (int64_t value : match_st->arms[i].values) {
+					int64_t converted = wrap_to_type(value, compare_type);
+					if (seen.insert(converted).second) cases.push_back({ converted, i });
+				}
+			}
+			bool is_unsigned = is_unsigned_integer_type(compare_type);
+			std::sort(cases.begin(), cases.end(), [is_unsigned](const MatchCase& lhs, const MatchCase& rhs) {
+				return is_unsigned ? (uint64_t)lhs.value < (uint64_t)rhs.value : lhs.value < rhs.value;
+			});
+			return cases;
+		}
+
+		// The arm of a match that runs for a value of the given type: its body, the default or NULL if nothing runs
+		ExpressionST* get_match_body(MatchST* match_st, int64_t value, Type value_type) {
+			Type compare_type = get_match_type(value_type, get_type_size(value_type) == 8 ? 8 : 4);
+			value = wrap_to_type(value, compare_type);
+			for (const MatchCase& match_case : get_match_cases(match_st, compare_type)) {
+				if (match_case.value == value) return match_st->arms[match_case.arm].body;
+			}
+			return match_st->default_body;
+		}
+
+		// Gets the numeric value of a constant expression. Returns false if the expression is no (integer) constant
+		// The value is wrapped like the register it is calculated in, not to the type of the constant. That type comes from
+		// where the constant is written (every constant in a condition is an i8), the value is only cut where it is stored
+		bool get_constant_value(ExpressionST* expression, int64_t& value) {
+			if (expression->type != AstType::CONSTANT) return false;
+			const std::string& constant = static_cast<ConstantST*>(expression)->constant;
+			if (constant.empty()) return false;
+			for (size_t i = constant[0] == '-' ? 1 : 0; i < constant.size(); i++) {
+				if (!isdigit(constant[i])) return false;
+			}
+			if (constant[0] == '-') value = strtoll(constant.c_str(), NULL, 10);
+			else value = (int64_t)strtoull(constant.c_str(), NULL, 10);
+			value = wrap_to_type(value, get_register_type(expression->return_type));
+			return true;
+		}
+
+		ConstantST* make_constant(Type t, int64_t value) {
+			value = wrap_to_type(value, t);
+			if (t == Type::UINT64) return new ConstantST(t, std::to_string((uint64_t)value));
+			return new ConstantST(t, std::to_string(value));
+		}
+
+		// Calculates lhs op rhs the way the generated code would
+		// operand_type is the type the operands are compared / calculated in, result_type the type of the result
+		// Returns false if the result is not defined (division by zero etc.), in that case the operation stays in the code
+		bool evaluate_operation(Operation op, Type operand_type, Type result_type, int64_t lhs, int64_t rhs, int64_t& result) {
+			bool is_unsigned = is_unsigned_integer_type(operand_type);
+			uint64_t ulhs = (uint64_t)lhs;
+			uint64_t urhs = (uint64_t)rhs;
+			switch (op) {
+			case Operation::ADD: result = (int64_t)(ulhs + urhs); break;
+			case Operation::SUB: result = (int64_t)(ulhs - urhs); break;
+			case Operation::MUL: result = (int64_t)(ulhs * urhs); break;
+			case Operation::DIV:
+				if (rhs == 0 || (!is_unsigned && lhs == INT64_MIN && rhs == -1)) return false;
+				result = is_unsigned ? (int64_t)(ulhs / urhs) : lhs / rhs;
+				break;
+			case Operation::MOD:
+				if (rhs == 0 || (!is_unsigned && lhs == INT64_MIN && rhs == -1)) return false;
+				result = is_unsigned ? (int64_t)(ulhs % urhs) : lhs % rhs;
+				break;
+			case Operation::POW:
+			{
+				if (rhs < 0 && !is_unsigned) return false;
+				uint64_t base = ulhs;
+				uint64_t power = 1;
+				for (uint64_t exponent = urhs; exponent; exponent >>= 1) {
+					if (exponent & 1) power *= base;
+					base *= base;
+				}
+				result = (int64_t)power;
+				break;
+			}
+			case Operation::EQ: result = lhs == rhs; break;
+			case Operation::NEQ: result = lhs != rhs; break;
+			case Operation::LT: result = is_unsigned ? ulhs < urhs : lhs < rhs; break;
+			case Operation::LTE: result = is_unsigned ? ulhs <= urhs : lhs <= rhs; break;
+			case Operation::GT: result = is_unsigned ? ulhs > urhs : lhs > rhs; break;
+			case Operation::GTE: result = is_unsigned ? ulhs >= urhs : lhs >= rhs; break;
+			case Operation::ANDL: result = lhs != 0 && rhs != 0; break;
+			case Operation::ORL: result = lhs != 0 || rhs != 0; break;
+			case Operation::AND: result = lhs & rhs; break;
+			case Operation::OR: result = lhs | rhs; break;
+			default: return false;
+			}
+			result = wrap_to_type(result, result_type);
+			return true;
+		}
+	}
+}
@@ -0,0 +1,195 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+
+#include "optimizer/loops.h"
+#include "ast.h"
+
+namespace Bonfire {
+	namespace Optimizer {
+
+		// Variables that hold the same value as another variable, since the last y = x
+		typedef std::map<std::string, std::string> CopyMap;
+
+		struct CopyContext {
+			TypeMap types;
+			uint32_t propagated = 0;	// Reads of a copy replaced by the original
+			uint32_t removed = 0;		// Copies into a variable that already had the value
+		};
+
+		// Forgets the copies of and into a variable that is written
+		void invalidate_copies(const std::string& name, CopyMap& copies) {
+			copies.erase(name);
+			for (auto it = copies.begin(); it != copies.end();) {
+				if (!it->second.compare(name)) it = copies.erase(it);
+				else ++it;
+			}
+		}
+
+		void invalidate_copies(ExpressionST* expression, CopyMap& copies) {
+			std::map<std::string, uint32_t> writes;
+			count_writes(expression, writes);
+			for (auto& write : writes) invalidate_copies(write.first, copies);
+		}
+
+		// Returns the variable a store copies, or NULL if it stores something else
+		VariableValST* get_copy_source(const std::string& target, ExpressionST* value, CopyContext& context) {
+			if (value->type != AstType::VAR_VALUE) return NULL;
+			VariableValST* source = static_cast<VariableValST*>(value);
+			// A copy into a smaller or bigger variable converts the value
+			if (context.types[source->identifier] != context.types[target]) return NULL;
+			return source;
+		}
+
+		void propagate_copies(ExpressionST*& slot, CopyMap& copies, CopyContext& context);
+
+		// y = x or y: T = x makes y a copy of x, any other store ends the copies of and into y
+		void record_store(const std::string& identifier, ExpressionST* value, CopyMap& copies, CopyContext& context) {
+			invalidate_copies(identifier, copies);
+			VariableValST* source = get_copy_source(identifier, value, context);
+			if (source && source->identifier.compare(identifier)) copies[identifier] = source->identifier;
+		}
+
+		void propagate_copies_in_block(BlockST* block_st, CopyMap& copies, CopyContext& context) {
+			uint32_t num_children = 0;
+			for (uint32_t i = 0; i < block_st->num_children; i++) {
+				ExpressionST* child = block_st->children[i];
+				// y = x when y is already a copy of x (or is x) stores what is already there
+				if (child->type == AstType::VAR_ASSIGNMENT) {
+					VariableAssignST* var_st = static_cast<VariableAssignST*>(child);
+					propagate_copies(var_st->value, copies, context);
+					VariableValST* source = get_copy_source(var_st->identifier, var_st->value, context);
+					auto copy = copies.find(var_st->identifier);
+					if (source && (!source->identifier.compare(var_st->identifier) || (copy != copies.end() && !copy->second.compare(source->identifier)))) {
+						context.removed++;
+						continue;
+					}
+					record_store(var_st->identifier, var_st->value, copies, context);
+				}
+				else propagate_copies(block_st->children[i], copies, context);
+				block_st->children[num_children++] = child;
+			}
+			block_st->num_children = num_children;
+		}
+
+		// Replaces the reads of copies by reads of the original variable, following the order the code runs in
+		void propagate_copies(ExpressionST*& slot, CopyMap& copies, CopyContext& context) {
+			if (!slot) return;
+			switch (slot->type) {
+			case AstType::VAR_VALUE:
+			{
+				auto it = copies.find(static_cast<VariableValST*>(slot)->identifier);
+				if (it == copies.end()) return;
+				slot = new VariableValST(it->second, slot->return_type);
+				context.propagated++;
+				return;
+			}
+			case AstType::OPERATION:
+			{
+				OperationST* op_st = static_cast<OperationST*>(slot);
+				propagate_copies(op_st->lhs, copies, context);
+				if (op_st->op == Operation::ANDL || op_st->op == Operation::ORL) {
+					// The right side doesn't always run
+					CopyMap rhs_copies = copies;
+					propagate_copies(op_st->rhs, rhs_copies, context);
+					invalidate_copies(op_st->rhs, copies);
+				}
+				else propagate_copies(op_st->rhs, copies, context);
+				return;
+			}
+			case AstType::FUNCTION_CALL:
+				for (ExpressionST*& argument : static_cast<FunctionCallST*>(slot)->arguments) propagate_copies(argument, copies, context);
+				return;
+			case AstType::ARRAY_DECLARATION:
+				propagate_copies(static_cast<ArrayDeclarationST*>(slot)->value, copies, context);
+				return;
+			case AstType::SLICE:
+				propagate_copies(static_cast<SliceST*>(slot)->begin, copies, context);
+				propagate_copies(static_cast<SliceST*>(slot)->end, copies, context);
+				return;
+			case AstType::INDEX:
+				propagate_copies(static_cast<IndexST*>(slot)->index, copies, context);
+				return;
+			case AstType::INDEX_ASSIGNMENT:
+				propagate_copies(static_cast<IndexAssignST*>(slot)->value, copies, context);
+				propagate_copies(static_cast<IndexAssignST*>(slot)->index, copies, context);
+				return;
+			case AstType::RETURN:
+				propagate_copies(static_cast<ReturnST*>(slot)->expression, copies, context);
+				return;
+			case AstType::VAR_ASSIGNMENT:
+			{
+				VariableAssignST* var_st = static_cast<VariableAssignST*>(slot);
+				propagate_copies(var_st->value, copies, context);
+				record_store(var_st->identifier, var_st->value, copies, context);
+				return;
+			}
+			case AstType::VAR_DECLARATION:
+			{
+				VariableDeclarationST* var_st = static_cast<VariableDeclarationST*>(slot);
+				propagate_copies(var_st->value, copies, context);
+				record_store(var_st->identifier, var_st->value, copies, context);
+				return;
+			}
+			case AstType::BLOCK:
+			{
+				// Variables declared in the block are gone after it
+				CopyMap block_copies = copies;
+				propagate_copies_in_block(static_cast<BlockST*>(slot), block_copies, context);
+				invalidate_copies(slot, copies);
+				return;
+			}
+			case AstType::IF:
+			{
+				IfST* if_st = static_cast<IfST*>(slot);
+				propagate_copies(if_st->condition, copies, context);
+				CopyMap then_copies = copies;
+				propagate_copies(if_st->then_body, then_copies, context);
+				if (if_st->has_else) {
+					CopyMap else_copies = copies;
+					propagate_copies(if_st->else_body, else_copies, context);
+				}
+				invalidate_copies(slot, copies);
+				return;
+			}
+			case AstType::MATCH:
+			{
+				// Only one of the arms runs
+				MatchST* match_st = static_cast<MatchST*>(slot);
+				propagate_copies(match_st->value, copies, context);
+				for (MatchArm& arm : match_st->arms) {
+					CopyMap arm_copies = copies;
+					propagate_copies(arm.body, arm_copies, context);
+				}
+				CopyMap default_copies = copies;
+				propagate_copies(match_st->default_body, default_copies, context);
+				invalidate_copies(slot, copies);
+				return;
+			}
+			case AstType::LOOP:
+			{
+				// The body runs again after itself, so only copies the loop doesn't change are valid in it
+				LoopST* loop_st = static_cast<LoopST*>(slot);
+				invalidate_copies(slot, copies);
+				CopyMap loop_copies = copies;
+				propagate_copies(loop_st->condition, loop_copies, context);
+				propagate_copies(loop_st->body, loop_copies, context);
+				return;
+			}
+			default:
+				return;
+			}
+		}
+
+		// Copy propagation: after y = x, y is read as x until either of them is assigned. The copies that are not read
+		// anymore are removed by the dead code elimination afterwards
+		CopyContext propagate_copies(FunctionDefST* function) {
+			CopyContext context;
+			context.types = collect_variable_types(function);
+			CopyMap copies;
+			propagate_copies_in_block(function->statement, copies, context);
+			return context;
+		}
+	}
+}
@@ -0,0 +1,260 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include <tuple>
+#include <algorithm>
+
+#include "optimizer/loops.h"
+#include "optimizer/deadcode.h"
+#include "ast.h"
+
+namespace Bonfire {
+	namespace Optimizer {
+
+		// An operation that was calculated before, and can be reused as long as none of the variables it reads is assigned.
+		// It is only put into a variable once it is reused
+		struct AvailableExpression {
+			ExpressionST** slot;		// Where it was first seen
+			ExpressionST* statement;	// Statement it was seen in, the variable is declared in front of it
+			AvailableExpression* parent;	// Closest available expression around it in the same statement
+			LiveSet reads;
+			VariableDeclarationST* declaration = NULL;
+			std::string name;
+		};
+
+		// Available expressions by their value number
+		typedef std::map<uint32_t, AvailableExpression*> Available;
+
+		// What CSE knows about an expression, worked out once from its operands
+		struct CseNode {
+			uint32_t number;	// Expressions with the same structure have the same value number
+			uint32_t cost;		// See get_cse_cost
+			bool safe;			// Arithmetic that can't fault, on constants and variables
+			LiveSet reads;
+		};
+
+		struct CseContext {
+			TypeMap types;
+			// Declarations of reused expressions, by the statement they go in front of
+			std::map<ExpressionST*, std::vector<ExpressionST*>> declarations;
+			// Value numbers of the constants, variables and lengths, and of an operation on the value numbers of its operands
+			std::map<std::string, uint32_t> leaf_numbers;
+			std::map<std::tuple<Operation, uint32_t, uint32_t>, uint32_t> operation_numbers;
+			uint32_t next_number = 0;
+			std::map<ExpressionST*, CseNode> nodes;
+			uint32_t reused = 0;
+		};
+
+		uint32_t cse_name_counter = 0;
+
+		// Only operations that are more expensive than storing and loading their result are worth a variable
+		uint32_t get_cse_cost(Operation op, uint32_t lhs_cost, uint32_t rhs_cost) {
+			return (op == Operation::DIV || op == Operation::MOD ? 3 : 1) + lhs_cost + rhs_cost;
+		}
+
+		// Gives an expression and everything in it a value number, so finding an expression that was calculated before
+		// is a lookup instead of a comparison with every available expression
+		const CseNode& number_expression(ExpressionST* expression, CseContext& context) {
+			auto known = context.nodes.find(expression);
+			if (known != context.nodes.end()) return known->second;
+			CseNode node = { 0, 0, false, LiveSet() };
+			std::string leaf;
+			switch (expression->type) {
+			case AstType::CONSTANT:
+				leaf = "c" + static_cast<ConstantST*>(expression)->constant;
+				node.safe = true;
+				break;
+			case AstType::VAR_VALUE:
+				leaf = "v" + static_cast<VariableValST*>(expression)->identifier;
+				node.safe = true;
+				break;
+			case AstType::LENGTH:
+				leaf = "l" + static_cast<LengthST*>(expression)->identifier;
+				node.safe = true;
+				break;
+			case AstType::OPERATION:
+			{
+				OperationST* op_st = static_cast<OperationST*>(expression);
+				const CseNode& lhs = number_expression(op_st->lhs, context);
+				const CseNode& rhs = number_expression(op_st->rhs, context);
+				auto key = std::make_tuple(op_st->op, lhs.number, rhs.number);
+				auto number = context.operation_numbers.find(key);
+				if (number == context.operation_numbers.end()) number = context.operation_numbers.insert({ key, context.next_number++ }).first;
+				node.number = number->second;
+				node.cost = get_cse_cost(op_st->op, lhs.cost, rhs.cost);
+				// Like is_invariant without any writes: only arithmetic that can't fault
+				int64_t divisor;
+				switch (op_st->op) {
+				case Operation::ADD: case Operation::SUB: case Operation::MUL: case Operation::AND: case Operation::OR:
+					node.safe = lhs.safe && rhs.safe;
+					break;
+				case Operation::DIV: case Operation::MOD:
+					node.safe = lhs.safe && rhs.safe && get_constant_value(op_st->rhs, divisor) && divisor != 0;
+					break;
+				default:
+					break;
+				}
+				node.reads = lhs.reads;
+				node.reads.insert(rhs.reads.begin(), rhs.reads.end());
+				return context.nodes[expression] = node;
+			}
+			default:
+				// Calls, indexes and the like are never the same
+				node.number = context.next_number++;
+				return context.nodes[expression] = node;
+			}
+			auto number = context.leaf_numbers.find(leaf);
+			if (number == context.leaf_numbers.end()) number = context.leaf_numbers.insert({ leaf, context.next_number++ }).first;
+			node.number = number->second;
+			collect_reads(expression, node.reads);
+			return context.nodes[expression] = node;
+		}
+
+		// Puts the value of an available expression into a variable, the first time it is reused
+		void declare_available(AvailableExpression* available, CseContext& context) {
+			if (available->declaration) return;
+			Type t = get_expression_type(*available->slot, context.types);
+			available->name = "__cse" + std::to_string(cse_name_counter++);
+			available->declaration = new VariableDeclarationST(available->name, t, *available->slot);
+			*available->slot = new VariableValST(available->name, t);
+			context.types[available->name] = t;
+
+			// If an expression around it already has its variable, this one is now part of that declaration and has to come before it
+			std::vector<ExpressionST*>& declarations = context.declarations[available->statement];
+			auto position = declarations.end();
+			for (AvailableExpression* parent = available->parent; parent; parent = parent->parent) {
+				if (parent->declaration) {
+					position = std::find(declarations.begin(), declarations.end(), parent->declaration);
+					break;
+				}
+			}
+			declarations.insert(position, available->declaration);
+		}
+
+		void eliminate_in_expression(ExpressionST*& slot, ExpressionST* statement, AvailableExpression* parent, Available& available, CseContext& context) {
+			if (slot->type != AstType::OPERATION) return;
+			OperationST* op_st = static_cast<OperationST*>(slot);
+			const CseNode& node = number_expression(slot, context);
+			if (node.cost >= 2 && node.safe) {
+				auto same = available.find(node.number);
+				if (same != available.end()) {
+					AvailableExpression* a = same->second;
+					declare_available(a, context);
+					slot = new VariableValST(a->name, a->declaration->var_type);
+					context.reused++;
+					return;
+				}
+				AvailableExpression* a = new AvailableExpression();
+				a->slot = &slot;
+				a->statement = statement;
+				a->parent = parent;
+				a->reads = node.reads;
+				available[node.number] = a;
+				parent = a;
+			}
+			eliminate_in_expression(op_st->lhs, statement, parent, available, context);
+			eliminate_in_expression(op_st->rhs, statement, parent, available, context);
+		}
+
+		// Forgets the expressions that read a variable the statement assigns
+		void invalidate_available(ExpressionST* statement, Available& available) {
+			std::map<std::string, uint32_t> writes;
+			count_writes(statement, writes);
+			if (writes.empty()) return;
+			for (auto it = available.begin(); it != available.end();) {
+				bool written = false;
+				for (auto& write : writes) written |= it->second->reads.count(write.first) > 0;
+				if (written) it = available.erase(it);
+				else ++it;
+			}
+		}
+
+		void eliminate_in_block(BlockST* block_st, Available available, CseContext& context);
+
+		// Code that only runs sometimes (if bodies, loops, blocks) sees what is available before it, but what it calculates
+		// is not available after it
+		void eliminate_in_body(ExpressionST* body, const Available& available, CseContext& context) {
+			if (body && body->type == AstType::BLOCK) eliminate_in_block(static_cast<BlockST*>(body), available, context);
+		}
+
+		void eliminate_in_statement(ExpressionST* statement, Available& available, CseContext& context) {
+			ExpressionST** value = NULL;
+			switch (statement->type) {
+			case AstType::VAR_ASSIGNMENT:
+				value = &static_cast<VariableAssignST*>(statement)->value;
+				break;
+			case AstType::VAR_DECLARATION:
+				value = &static_cast<VariableDeclarationST*>(statement)->value;
+				break;
+			case AstType::RETURN:
+				value = &static_cast<ReturnST*>(statement)->expression;
+				break;
+			case AstType::IF:
+			{
+				IfST* if_st = static_cast<IfST*>(statement);
+				if (is_pure(if_st->condition)) eliminate_in_expression(if_st->condition, statement, NULL, available, context);
+				eliminate_in_body(if_st->then_body, available, context);
+				if (if_st->has_else) eliminate_in_body(if_st->else_body, available, context);
+				return;
+			}
+			case AstType::MATCH:
+			{
+				MatchST* match_st = static_cast<MatchST*>(statement);
+				if (is_pure(match_st->value)) eliminate_in_expression(match_st->value, statement, NULL, available, context);
+				for (MatchArm& arm : match_st->arms) eliminate_in_body(arm.body, available, context);
+				eliminate_in_body(match_st->default_body, available, context);
+				return;
+			}
+			case AstType::LOOP:
+			{
+				// The condition runs again after the body, so only the body is searched. Inside of it, expressions from before
+				// the loop are available if the loop doesn't change them
+				LoopST* loop_st = static_cast<LoopST*>(statement);
+				Available in_loop = available;
+				invalidate_available(loop_st, in_loop);
+				eliminate_in_body(loop_st->body, in_loop, context);
+				return;
+			}
+			case AstType::BLOCK:
+				eliminate_in_body(statement, available, context);
+				return;
+			default:
+				return;
+			}
+			// The value is calculated before the statement writes anything, so it can be calculated in front of the statement,
+			// unless it has effects of its own
+			if ((*value)->type == AstType::BLOCK) eliminate_in_body(*value, available, context);
+			else if (is_pure(*value)) eliminate_in_expression(*value, statement, NULL, available, context);
+		}
+
+		void eliminate_in_block(BlockST* block_st, Available available, CseContext& context) {
+			for (uint32_t i = 0; i < block_st->num_children; i++) {
+				eliminate_in_statement(block_st->children[i], available, context);
+				invalidate_available(block_st->children[i], available);
+			}
+
+			// Put the declarations of reused expressions in front of their statements
+			std::vector<ExpressionST*> children;
+			for (uint32_t i = 0; i < block_st->num_children; i++) {
+				auto it = context.declarations.find(block_st->children[i]);
+				if (it != context.declarations.end()) children.insert(children.end(), it->second.begin(), it->second.end());
+				children.push_back(block_st->children[i]);
+			}
+			if (children.size() == block_st->num_children) return;
+			block_st->children = new ExpressionST*[children.size()];
+			block_st->num_children = children.size();
+			for (size_t i = 0; i < children.size(); i++) block_st->children[i] = children[i];
+		}
+
+		// Common subexpression elimination: an operation that was already calculated on every path to it, with none of its
+		// variables assigned since, reuses that value. Statements in a block dominate the statements after them, the code
+		// before an if or loop dominates its body. Returns the number of reused expressions
+		uint32_t eliminate_common_subexpressions(FunctionDefST* function) {
+			CseContext context;
+			context.types = collect_variable_types(function);
+			eliminate_in_block(function->statement, Available(), context);
+			return context.reused;
+		}
+	}
+}
@@ -0,0 +1,332 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <set>
+
+#include "optimizer/folding.h"
+#include "ast.h"
+
+namespace Bonfire {
+	namespace Optimizer {
+
+		typedef std::set<std::string> LiveSet;
+
+		struct DeadCodeContext {
+			// Variables that are live where a return jumps to (the end of the closest block with a type, or nothing for the function)
+			LiveSet return_live;
+			// Variables that are read anywhere in the function
+			LiveSet read_anywhere;
+			// Variables with stores that stay, because their value does more than calculate (see is_pure)
+			LiveSet stored;
+			// Statements are only removed once the liveness of every loop is final
+			bool remove = true;
+			uint32_t removed = 0;
+		};
+
+		// Returns true if control never gets past this statement, because it returns on every path
+		bool always_returns(ExpressionST* expression) {
+			switch (expression->type) {
+			case AstType::RETURN:
+				return true;
+			case AstType::BLOCK:
+			{
+				// A block with a type catches the returns inside of it
+				BlockST* block_st = static_cast<BlockST*>(expression);
+				if (block_st->return_type != Type::VOID) return false;
+				for (uint32_t i = 0; i < block_st->num_children; i++) {
+					if (always_returns(block_st->children[i])) return true;
+				}
+				return false;
+			}
+			case AstType::IF:
+			{
+				IfST* if_st = static_cast<IfST*>(expression);
+				return if_st->return_type == Type::VOID && if_st->has_else && always_returns(if_st->then_body) && always_returns(if_st->else_body);
+			}
+			case AstType::MATCH:
+			{
+				MatchST* match_st = static_cast<MatchST*>(expression);
+				if (match_st->return_type != Type::VOID || !match_st->default_body || !always_returns(match_st->default_body)) return false;
+				for (MatchArm& arm : match_st->arms) {
+					if (!always_returns(arm.body)) return false;
+				}
+				return true;
+			}
+			default:
+				return false;
+			}
+		}
+
+		void collect_reads(ExpressionST* expression, LiveSet& reads) {
+			if (!expression) return;
+			switch (expression->type) {
+			case AstType::VAR_VALUE:
+				reads.insert(static_cast<VariableValST*>(expression)->identifier);
+				return;
+			case AstType::BLOCK:
+			{
+				BlockST* block_st = static_cast<BlockST*>(expression);
+				for (uint32_t i = 0; i < block_st->num_children; i++) collect_reads(block_st->children[i], reads);
+				return;
+			}
+			case AstType::IF:
+			{
+				IfST* if_st = static_cast<IfST*>(expression);
+				collect_reads(if_st->condition, reads);
+				collect_reads(if_st->then_body, reads);
+				if (if_st->has_else) collect_reads(if_st->else_body, reads);
+				return;
+			}
+			case AstType::MATCH:
+			{
+				MatchST* match_st = static_cast<MatchST*>(expression);
+				collect_reads(match_st->value, reads);
+				for (MatchArm& arm : match_st->arms) collect_reads(arm.body, reads);
+				collect_reads(match_st->default_body, reads);
+				return;
+			}
+			case AstType::LOOP:
+				collect_reads(static_cast<LoopST*>(expression)->condition, reads);
+				collect_reads(static_cast<LoopST*>(expression)->body, reads);
+				return;
+			case AstType::RETURN:
+				collect_reads(static_cast<ReturnST*>(expression)->expression, reads);
+				return;
+			case AstType::VAR_ASSIGNMENT:
+				collect_reads(static_cast<VariableAssignST*>(expression)->value, reads);
+				return;
+			case AstType::VAR_DECLARATION:
+				collect_reads(static_cast<VariableDeclarationST*>(expression)->value, reads);
+				return;
+			case AstType::OPERATION:
+				collect_reads(static_cast<OperationST*>(expression)->lhs, reads);
+				collect_reads(static_cast<OperationST*>(expression)->rhs, reads);
+				return;
+			case AstType::FUNCTION_CALL:
+				for (ExpressionST* argument : static_cast<FunctionCallST*>(expression)->arguments) collect_reads(argument, reads);
+				return;
+			case AstType::ARRAY_DECLARATION:
+				collect_reads(static_cast<ArrayDeclarationST*>(expression)->value, reads);
+				return;
+			case AstType::SLICE:
+				collect_reads(static_cast<SliceST*>(expression)->begin, reads);
+				collect_reads(static_cast<SliceST*>(expression)->end, reads);
+				return;
+			case AstType::INDEX:
+				collect_reads(static_cast<IndexST*>(expression)->index, reads);
+				return;
+			case AstType::INDEX_ASSIGNMENT:
+				collect_reads(static_cast<IndexAssignST*>(expression)->index, reads);
+				collect_reads(static_cast<IndexAssignST*>(expression)->value, reads);
+				return;
+			default:
+				return;
+			}
+		}
+
+		// A statement is dead if nothing after it can see what it does
+		bool is_dead_statement(ExpressionST* statement, const LiveSet& live_after, DeadCodeContext& context) {
+			switch (statement->type) {
+			case AstType::VAR_ASSIGNMENT:
+			{
+				VariableAssignST* var_st = static_cast<VariableAssignST*>(statement);
+				return !live_after.count(var_st->identifier) && is_pure(var_st->value);
+			}
+			case AstType::VAR_DECLARATION:
+			{
+				// The declaration reserves the stack space, so it can only go if the variable is never read at all
+				// and no store to it stays. The stores come after the declaration, so they were seen already
+				VariableDeclarationST* var_st = static_cast<VariableDeclarationST*>(statement);
+				return !context.read_anywhere.count(var_st->identifier) && !context.stored.count(var_st->identifier) && is_pure(var_st->value);
+			}
+			case AstType::CONSTANT:
+			case AstType::VAR_VALUE:
+			case AstType::OPERATION:
+				return is_pure(statement);
+			case AstType::BLOCK:
+				return is_empty_block(statement);
+			default:
+				return false;
+			}
+		}
+
+		LiveSet live_before(ExpressionST* expression, const LiveSet& live_after, DeadCodeContext& context);
+
+		LiveSet live_before_block(BlockST* block_st, const LiveSet& live_after, DeadCodeContext& context) {
+			// Everything after a statement that always returns is unreachable
+			if (context.remove) {
+				for (uint32_t i = 0; i + 1 < block_st->num_children; i++) {
+					if (always_returns(block_st->children[i])) {
+						for (uint32_t j = i + 1; j < block_st->num_children; j++) context.removed += count_nodes(block_st->children[j]);
+						block_st->num_children = i + 1;
+						break;
+					}
+				}
+			}
+
+			// Returns inside of a block with a type jump to its end, so they see what is live after the block
+			LiveSet parent_return_live = context.return_live;
+			if (block_st->return_type != Type::VOID) context.return_live = live_after;
+
+			LiveSet live = live_after;
+			std::vector<bool> dead(block_st->num_children, false);
+			bool any_dead = false;
+			for (uint32_t i = block_st->num_children; i > 0; i--) {
+				ExpressionST* child = block_st->children[i - 1];
+				if (context.remove) {
+					// A call that stores into a variable that is never read still has to run, without the store
+					ExpressionST** value = NULL;
+					std::string identifier;
+					if (child->type == AstType::VAR_ASSIGNMENT) {
+						value = &static_cast<VariableAssignST*>(child)->value;
+						identifier = static_cast<VariableAssignST*>(child)->identifier;
+					}
+					if (child->type == AstType::VAR_DECLARATION && !context.stored.count(static_cast<VariableDeclarationST*>(child)->identifier)) {
+						value = &static_cast<VariableDeclarationST*>(child)->value;
+						identifier = static_cast<VariableDeclarationST*>(child)->identifier;
+					}
+					if (value && (*value)->type == AstType::FUNCTION_CALL && !context.read_anywhere.count(identifier)) {
+						child = block_st->children[i - 1] = *value;
+						context.removed++;
+					}
+				}
+				if (context.remove && is_dead_statement(child, live, context)) {
+					dead[i - 1] = true;
+					any_dead = true;
+					context.removed += count_nodes(child);
+					continue;
+				}
+				if (child->type == AstType::VAR_ASSIGNMENT) context.stored.insert(static_cast<VariableAssignST*>(child)->identifier);
+				live = live_before(child, live, context);
+			}
+			context.return_live = parent_return_live;
+
+			if (any_dead) {
+				uint32_t num_children = 0;
+				for (uint32_t i = 0; i < block_st->num_children; i++) {
+					if (!dead[i]) block_st->children[num_children++] = block_st->children[i];
+				}
+				block_st->num_children = num_children;
+			}
+			return live;
+		}
+
+		LiveSet live_before_loop(LoopST* loop_st, const LiveSet& live_after, DeadCodeContext& context) {
+			// What is live at the head of the loop depends on itself (through the back edge), so iterate until it doesn't change
+			bool remove = context.remove;
+			context.remove = false;
+			LiveSet live_head = live_after;
+			while (1) {
+				LiveSet live_body = live_before(loop_st->body, live_head, context);
+				LiveSet next_head = loop_st->condition ? live_after : LiveSet();
+				next_head.insert(live_body.begin(), live_body.end());
+				if (loop_st->condition) next_head = live_before(loop_st->condition, next_head, context);
+				if (next_head == live_head) break;
+				live_head = next_head;
+			}
+			context.remove = remove;
+			// Last pass with the final liveness, this one may remove statements
+			if (remove) live_before(loop_st->body, live_head, context);
+			return live_head;
+		}
+
+		// Variables that are live before the expression runs, if live_after are live after it
+		LiveSet live_before(ExpressionST* expression, const LiveSet& live_after, DeadCodeContext& context) {
+			switch (expression->type) {
+			case AstType::VAR_VALUE:
+			{
+				LiveSet live = live_after;
+				live.insert(static_cast<VariableValST*>(expression)->identifier);
+				return live;
+			}
+			case AstType::OPERATION:
+			{
+				OperationST* op_st = static_cast<OperationST*>(expression);
+				return live_before(op_st->lhs, live_before(op_st->rhs, live_after, context), context);
+			}
+			case AstType::RETURN:
+				return live_before(static_cast<ReturnST*>(expression)->expression, context.return_live, context);
+			case AstType::VAR_ASSIGNMENT:
+			{
+				VariableAssignST* var_st = static_cast<VariableAssignST*>(expression);
+				LiveSet live = live_after;
+				live.erase(var_st->identifier);
+				return live_before(var_st->value, live, context);
+			}
+			case AstType::VAR_DECLARATION:
+			{
+				VariableDeclarationST* var_st = static_cast<VariableDeclarationST*>(expression);
+				LiveSet live = live_after;
+				live.erase(var_st->identifier);
+				return live_before(var_st->value, live, context);
+			}
+			case AstType::IF:
+			{
+				IfST* if_st = static_cast<IfST*>(expression);
+				LiveSet live = live_before(if_st->then_body, live_after, context);
+				LiveSet live_else = if_st->has_else ? live_before(if_st->else_body, live_after, context) : live_after;
+				live.insert(live_else.begin(), live_else.end());
+				return live_before(if_st->condition, live, context);
+			}
+			case AstType::MATCH:
+			{
+				// Without a default nothing of the match might run
+				MatchST* match_st = static_cast<MatchST*>(expression);
+				LiveSet live = match_st->default_body ? live_before(match_st->default_body, live_after, context) : live_after;
+				for (MatchArm& arm : match_st->arms) {
+					LiveSet live_arm = live_before(arm.body, live_after, context);
+					live.insert(live_arm.begin(), live_arm.end());
+				}
+				return live_before(match_st->value, live, context);
+			}
+			case AstType::FUNCTION_CALL:
+			{
+				// The arguments are calculated from left to right
+				FunctionCallST* call_st = static_cast<FunctionCallST*>(expression);
+				LiveSet live = live_after;
+				for (size_t i = call_st->arguments.size(); i > 0; i--) live = live_before(call_st->arguments[i - 1], live, context);
+				return live;
+			}
+			case AstType::ARRAY_DECLARATION:
+			{
+				ArrayDeclarationST* array_st = static_cast<ArrayDeclarationST*>(expression);
+				return array_st->value ? live_before(array_st->value, live_after, context) : live_after;
+			}
+			case AstType::SLICE:
+			{
+				SliceST* slice_st = static_cast<SliceST*>(expression);
+				return live_before(slice_st->begin, live_before(slice_st->end, live_after, context), context);
+			}
+			case AstType::INDEX:
+				return live_before(static_cast<IndexST*>(expression)->index, live_after, context);
+			case AstType::INDEX_ASSIGNMENT:
+			{
+				// The value is calculated before the index
+				IndexAssignST* index_st = static_cast<IndexAssignST*>(expression);
+				return live_before(index_st->value, live_before(index_st->index, live_after, context), context);
+			}
+			case AstType::LOOP:
+				return live_before_loop(static_cast<LoopST*>(expression), live_after, context);
+			case AstType::BLOCK:
+				return live_before_block(static_cast<BlockST*>(expression), live_after, context);
+			default:
+				return live_after;
+			}
+		}
+
+		// Removes unreachable statements, stores to variables that are not read afterwards and
+		// declarations of variables that are never read. Returns the number of removed nodes
+		uint32_t eliminate_dead_code(FunctionDefST* function) {
+			uint32_t removed = 0;
+			// Removing a statement can make the statements it read from dead, so repeat until nothing changes
+			while (1) {
+				DeadCodeContext context;
+				collect_reads(function->statement, context.read_anywhere);
+				live_before_block(function->statement, LiveSet(), context);
+				if (!context.removed) break;
+				removed += context.removed;
+			}
+			return removed;
+		}
+	}
+}
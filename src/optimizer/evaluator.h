@@ -0,0 +1,225 @@
+#pragma once
+#include <string>
+#include <vector>
+
+#include "optimizer/constants.h"
+#include "ast.h"
+
+namespace Bonfire {
+	namespace Optimizer {
+
+		// Maximum number of statements and loop iterations the evaluator runs for one expression
+		// Anything that takes longer is left for the generated code
+		const uint32_t EVAL_STEP_BUDGET = 100000;
+
+		struct EvalVariable {
+			std::string name;
+			Type type;
+			int64_t value;
+
+			EvalVariable(std::string name, Type type, int64_t value) {
+				this->name = name;
+				this->type = type;
+				this->value = value;
+			}
+		};
+
+		// State of one compile-time evaluation
+		// Only variables declared inside the evaluated expression are known, everything else makes the evaluation fail
+		struct EvalContext {
+			std::vector<EvalVariable> variables;
+			uint32_t steps = 0;
+
+			EvalVariable* find(const std::string& name) {
+				for (size_t i = variables.size(); i > 0; i--) {
+					if (!variables[i - 1].name.compare(name)) return &variables[i - 1];
+				}
+				return NULL;
+			}
+
+			bool step() {
+				return ++steps <= EVAL_STEP_BUDGET;
+			}
+		};
+
+		// What happened when running a statement
+		enum class EvalFlow {
+			NEXT,	// Continue with the next statement
+			RETURN,	// A return was hit, it leaves every void block until it reaches a block with a type
+			FAIL	// The statement can't be run at compile time
+		};
+
+		bool eval_value(ExpressionST* expression, EvalContext& context, int64_t& value, Type& type);
+		EvalFlow eval_statement(ExpressionST* expression, EvalContext& context, int64_t& return_value);
+
+		// Runs the children of a block in their own scope
+		EvalFlow eval_block_children(BlockST* block_st, EvalContext& context, int64_t& return_value) {
+			size_t scope = context.variables.size();
+			EvalFlow flow = EvalFlow::NEXT;
+			for (uint32_t i = 0; i < block_st->num_children && flow == EvalFlow::NEXT; i++) {
+				flow = eval_statement(block_st->children[i], context, return_value);
+			}
+			context.variables.erase(context.variables.begin() + scope, context.variables.end());
+			return flow;
+		}
+
+		EvalFlow eval_statement(ExpressionST* expression, EvalContext& context, int64_t& return_value) {
+			if (!context.step()) return EvalFlow::FAIL;
+			int64_t value;
+			Type type;
+			switch (expression->type) {
+			case AstType::BLOCK:
+				// A block with a type catches the returns inside of it, so it is just a value here
+				if (expression->return_type != Type::VOID) {
+					return eval_value(expression, context, value, type) ? EvalFlow::NEXT : EvalFlow::FAIL;
+				}
+				return eval_block_children(static_cast<BlockST*>(expression), context, return_value);
+			case AstType::RETURN:
+			{
+				ReturnST* ret_st = static_cast<ReturnST*>(expression);
+				if (!eval_value(ret_st->expression, context, return_value, type)) return EvalFlow::FAIL;
+				return EvalFlow::RETURN;
+			}
+			case AstType::VAR_DECLARATION:
+			{
+				VariableDeclarationST* var_st = static_cast<VariableDeclarationST*>(expression);
+				if (!eval_value(var_st->value, context, value, type)) return EvalFlow::FAIL;
+				context.variables.push_back(EvalVariable(var_st->identifier, var_st->var_type, wrap_to_type(value, var_st->var_type)));
+				return EvalFlow::NEXT;
+			}
+			case AstType::VAR_ASSIGNMENT:
+			{
+				VariableAssignST* var_st = static_cast<VariableAssignST*>(expression);
+				EvalVariable* variable = context.find(var_st->identifier);
+				if (!variable || !eval_value(var_st->value, context, value, type)) return EvalFlow::FAIL;
+				variable->value = wrap_to_type(value, variable->type);
+				return EvalFlow::NEXT;
+			}
+			case AstType::IF:
+			{
+				IfST* if_st = static_cast<IfST*>(expression);
+				if (if_st->return_type != Type::VOID) {
+					return eval_value(expression, context, value, type) ? EvalFlow::NEXT : EvalFlow::FAIL;
+				}
+				if (!eval_value(if_st->condition, context, value, type)) return EvalFlow::FAIL;
+				if (value) return eval_statement(if_st->then_body, context, return_value);
+				if (if_st->has_else) return eval_statement(if_st->else_body, context, return_value);
+				return EvalFlow::NEXT;
+			}
+			case AstType::MATCH:
+			{
+				MatchST* match_st = static_cast<MatchST*>(expression);
+				if (match_st->return_type != Type::VOID) {
+					return eval_value(expression, context, value, type) ? EvalFlow::NEXT : EvalFlow::FAIL;
+				}
+				if (!eval_value(match_st->value, context, value, type)) return EvalFlow::FAIL;
+				ExpressionST* body = get_match_body(match_st, value, type);
+				return body ? eval_statement(body, context, return_value) : EvalFlow::NEXT;
+			}
+			case AstType::LOOP:
+			{
+				LoopST* loop_st = static_cast<LoopST*>(expression);
+				while (1) {
+					if (!context.step()) return EvalFlow::FAIL;
+					if (loop_st->condition) {
+						if (!eval_value(loop_st->condition, context, value, type)) return EvalFlow::FAIL;
+						if (!value) return EvalFlow::NEXT;
+					}
+					EvalFlow flow = eval_statement(loop_st->body, context, return_value);
+					if (flow != EvalFlow::NEXT) return flow;
+				}
+			}
+			case AstType::CONSTANT:
+			case AstType::VAR_VALUE:
+			case AstType::OPERATION:
+				return eval_value(expression, context, value, type) ? EvalFlow::NEXT : EvalFlow::FAIL;
+			default:
+				return EvalFlow::FAIL;
+			}
+		}
+
+		// Calculates the value of an expression. type is the type the value has to be calculated in further on
+		// (VOID for constants that don't have a type yet)
+		bool eval_value(ExpressionST* expression, EvalContext& context, int64_t& value, Type& type) {
+			switch (expression->type) {
+			case AstType::CONSTANT:
+				type = expression->return_type;
+				return get_constant_value(expression, value);
+			case AstType::VAR_VALUE:
+			{
+				EvalVariable* variable = context.find(static_cast<VariableValST*>(expression)->identifier);
+				if (!variable) return false;
+				value = variable->value;
+				type = variable->type;
+				return true;
+			}
+			case AstType::OPERATION:
+			{
+				OperationST* op_st = static_cast<OperationST*>(expression);
+				int64_t lhs, rhs;
+				Type lhs_type, rhs_type;
+				if (!eval_value(op_st->lhs, context, lhs, lhs_type)) return false;
+				// Lazy operations don't evaluate the rhs if the lhs already decides the result
+				if ((op_st->op == Operation::ANDL && !lhs) || (op_st->op == Operation::ORL && lhs)) {
+					value = op_st->op == Operation::ORL;
+					type = Type::INT8;
+					return true;
+				}
+				if (!eval_value(op_st->rhs, context, rhs, rhs_type)) return false;
+				// A constant is compared in the type of the other side, like the generated code does
+				if (is_comparison(op_st->op) && op_st->lhs->type == AstType::CONSTANT && op_st->rhs->type != AstType::CONSTANT) lhs_type = rhs_type;
+				if (is_comparison(op_st->op) && op_st->rhs->type == AstType::CONSTANT && op_st->lhs->type != AstType::CONSTANT) rhs_type = lhs_type;
+				Type operand_type = get_register_type(get_type_for_op(lhs_type, rhs_type));
+				lhs = wrap_to_type(lhs, operand_type);
+				rhs = wrap_to_type(rhs, operand_type);
+				type = get_calculated_type(op_st->op, lhs_type, rhs_type);
+				return evaluate_operation(op_st->op, operand_type, type, lhs, rhs, value);
+			}
+			case AstType::BLOCK:
+			{
+				BlockST* block_st = static_cast<BlockST*>(expression);
+				if (block_st->return_type == Type::VOID) return false;
+				// The value of a block is whatever its return returns, running off the end has no value
+				if (eval_block_children(block_st, context, value) != EvalFlow::RETURN) return false;
+				type = block_st->return_type;
+				value = wrap_to_type(value, type);
+				return true;
+			}
+			case AstType::IF:
+			{
+				IfST* if_st = static_cast<IfST*>(expression);
+				int64_t condition;
+				Type condition_type;
+				if (if_st->return_type == Type::VOID || !eval_value(if_st->condition, context, condition, condition_type)) return false;
+				if (!condition && !if_st->has_else) return false;
+				if (!eval_value(condition ? if_st->then_body : if_st->else_body, context, value, type)) return false;
+				type = if_st->return_type;
+				value = wrap_to_type(value, type);
+				return true;
+			}
+			case AstType::MATCH:
+			{
+				MatchST* match_st = static_cast<MatchST*>(expression);
+				int64_t matched;
+				Type matched_type;
+				if (match_st->return_type == Type::VOID || !eval_value(match_st->value, context, matched, matched_type)) return false;
+				ExpressionST* body = get_match_body(match_st, matched, matched_type);
+				if (!body || !eval_value(body, context, value, type)) return false;
+				type = match_st->return_type;
+				value = wrap_to_type(value, type);
+				return true;
+			}
+			default:
+				return false;
+			}
+		}
+
+		// Tries to calculate the value of a block, if or loop expression at compile time
+		// Only works if the expression has no side effects outside of itself and finishes within EVAL_STEP_BUDGET steps
+		bool evaluate_constant(ExpressionST* expression, int64_t& value) {
+			EvalContext context;
+			Type type;
+			return eval_value(expression, context, value, type);
+		}
+	}
+}
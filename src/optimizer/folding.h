@@ -0,0 +1,357 @@
+#pragma once
+#include <string>
+#include <vector>
+
+#include "optimizer/constants.h"
+#include "optimizer/evaluator.h"
+#include "ast.h"
+
+namespace Bonfire {
+	namespace Optimizer {
+
+		// An expression is pure if evaluating it has no effect other than producing its value
+		bool is_pure(ExpressionST* expression) {
+			switch (expression->type) {
+			case AstType::CONSTANT:
+			case AstType::VAR_VALUE:
+			case AstType::LENGTH:
+				return true;
+			case AstType::OPERATION:
+			{
+				OperationST* op_st = static_cast<OperationST*>(expression);
+				return is_pure(op_st->lhs) && is_pure(op_st->rhs);
+			}
+			default:
+				return false;
+			}
+		}
+
+		bool is_same_variable(ExpressionST* lhs, ExpressionST* rhs) {
+			return lhs->type == AstType::VAR_VALUE && rhs->type == AstType::VAR_VALUE
+				&& !static_cast<VariableValST*>(lhs)->identifier.compare(static_cast<VariableValST*>(rhs)->identifier);
+		}
+
+		// Counts the nodes of an expression tree
+		uint32_t count_nodes(ExpressionST* expression) {
+			if (!expression) return 0;
+			switch (expression->type) {
+			case AstType::BLOCK:
+			{
+				BlockST* block_st = static_cast<BlockST*>(expression);
+				uint32_t count = 1;
+				for (uint32_t i = 0; i < block_st->num_children; i++) count += count_nodes(block_st->children[i]);
+				return count;
+			}
+			case AstType::IF:
+			{
+				IfST* if_st = static_cast<IfST*>(expression);
+				return 1 + count_nodes(if_st->condition) + count_nodes(if_st->then_body) + (if_st->has_else ? count_nodes(if_st->else_body) : 0);
+			}
+			case AstType::LOOP:
+			{
+				LoopST* loop_st = static_cast<LoopST*>(expression);
+				return 1 + count_nodes(loop_st->condition) + count_nodes(loop_st->body);
+			}
+			case AstType::MATCH:
+			{
+				MatchST* match_st = static_cast<MatchST*>(expression);
+				uint32_t count = 1 + count_nodes(match_st->value) + count_nodes(match_st->default_body);
+				for (MatchArm& arm : match_st->arms) count += count_nodes(arm.body);
+				return count;
+			}
+			case AstType::RETURN:
+				return 1 + count_nodes(static_cast<ReturnST*>(expression)->expression);
+			case AstType::VAR_ASSIGNMENT:
+				return 1 + count_nodes(static_cast<VariableAssignST*>(expression)->value);
+			case AstType::VAR_DECLARATION:
+				return 1 + count_nodes(static_cast<VariableDeclarationST*>(expression)->value);
+			case AstType::OPERATION:
+			{
+				OperationST* op_st = static_cast<OperationST*>(expression);
+				return 1 + count_nodes(op_st->lhs) + count_nodes(op_st->rhs);
+			}
+			case AstType::FUNCTION_CALL:
+			{
+				uint32_t count = 1;
+				for (ExpressionST* argument : static_cast<FunctionCallST*>(expression)->arguments) count += count_nodes(argument);
+				return count;
+			}
+			case AstType::ARRAY_DECLARATION:
+				return 1 + count_nodes(static_cast<ArrayDeclarationST*>(expression)->value);
+			case AstType::SLICE:
+				return 1 + count_nodes(static_cast<SliceST*>(expression)->begin) + count_nodes(static_cast<SliceST*>(expression)->end);
+			case AstType::INDEX:
+				return 1 + count_nodes(static_cast<IndexST*>(expression)->index);
+			case AstType::INDEX_ASSIGNMENT:
+				return 1 + count_nodes(static_cast<IndexAssignST*>(expression)->index) + count_nodes(static_cast<IndexAssignST*>(expression)->value);
+			default:
+				return 1;
+			}
+		}
+
+		BlockST* make_empty_block() {
+			return new BlockST(Type::VOID, NULL, 0);
+		}
+
+		bool is_empty_block(ExpressionST* expression) {
+			return expression->type == AstType::BLOCK && expression->return_type == Type::VOID && static_cast<BlockST*>(expression)->num_children == 0;
+		}
+
+		ExpressionST* fold_expression(ExpressionST* expression, uint32_t& removed);
+
+		// Applies identities that hold whatever the value of the other operand is (x + 0, x * 1, x - x, ...)
+		// Returns NULL if nothing can be simplified
+		ExpressionST* simplify_identity(OperationST* op_st, uint32_t& removed) {
+			int64_t value;
+			bool lhs_const = get_constant_value(op_st->lhs, value);
+			int64_t lhs_value = value;
+			bool rhs_const = get_constant_value(op_st->rhs, value);
+			int64_t rhs_value = value;
+			Type t = op_st->return_type;
+
+			// Replace the operation by one of its operands, only if that doesn't change the type
+			auto keep_lhs = [&]() -> ExpressionST* {
+				if (op_st->lhs->return_type != t) return NULL;
+				removed += 1 + count_nodes(op_st->rhs);
+				return op_st->lhs;
+			};
+			auto keep_rhs = [&]() -> ExpressionST* {
+				if (op_st->rhs->return_type != t) return NULL;
+				removed += 1 + count_nodes(op_st->lhs);
+				return op_st->rhs;
+			};
+			// Replace the operation by a constant, only if nothing that has to run is dropped
+			auto replace = [&](int64_t result, bool needs_lhs, bool needs_rhs) -> ExpressionST* {
+				if ((needs_lhs && !is_pure(op_st->lhs)) || (needs_rhs && !is_pure(op_st->rhs))) return NULL;
+				removed += count_nodes(op_st) - 1;
+				return make_constant(t, result);
+			};
+
+			switch (op_st->op) {
+			case Operation::ADD:
+				if (rhs_const && rhs_value == 0) return keep_lhs();
+				if (lhs_const && lhs_value == 0) return keep_rhs();
+				break;
+			case Operation::SUB:
+				if (rhs_const && rhs_value == 0) return keep_lhs();
+				if (is_same_variable(op_st->lhs, op_st->rhs)) return replace(0, true, true);
+				break;
+			case Operation::MUL:
+				if (rhs_const && rhs_value == 1) return keep_lhs();
+				if (lhs_const && lhs_value == 1) return keep_rhs();
+				if (rhs_const && rhs_value == 0) return replace(0, true, false);
+				if (lhs_const && lhs_value == 0) return replace(0, false, true);
+				break;
+			case Operation::DIV:
+				if (rhs_const && rhs_value == 1) return keep_lhs();
+				break;
+			case Operation::MOD:
+				if (rhs_const && rhs_value == 1) return replace(0, true, false);
+				break;
+			case Operation::POW:
+				if (rhs_const && rhs_value == 1) return keep_lhs();
+				if (rhs_const && rhs_value == 0) return replace(1, true, false);
+				break;
+			case Operation::EQ:
+			case Operation::LTE:
+			case Operation::GTE:
+				if (is_same_variable(op_st->lhs, op_st->rhs)) return replace(1, true, true);
+				break;
+			case Operation::NEQ:
+			case Operation::LT:
+			case Operation::GT:
+				if (is_same_variable(op_st->lhs, op_st->rhs)) return replace(0, true, true);
+				break;
+			case Operation::ANDL:
+				// The rhs is never evaluated, so it doesn't matter if it is pure
+				if (lhs_const && lhs_value == 0) return replace(0, false, false);
+				break;
+			case Operation::ORL:
+				if (lhs_const && lhs_value != 0) return replace(1, false, false);
+				break;
+			}
+			return NULL;
+		}
+
+		ExpressionST* fold_operation(OperationST* op_st, uint32_t& removed) {
+			op_st->lhs = fold_expression(op_st->lhs, removed);
+			op_st->rhs = fold_expression(op_st->rhs, removed);
+
+			int64_t lhs, rhs, result;
+			if (get_constant_value(op_st->lhs, lhs) && get_constant_value(op_st->rhs, rhs)) {
+				// Calculated like the generated code does it, in whole registers
+				Type operand_type = get_register_type(get_type_for_op(op_st->lhs->return_type, op_st->rhs->return_type));
+				Type result_type = get_calculated_type(op_st->op, op_st->lhs->return_type, op_st->rhs->return_type);
+				if (evaluate_operation(op_st->op, operand_type, result_type, lhs, rhs, result)) {
+					removed += 2;
+					return make_constant(result_type, result);
+				}
+			}
+
+			ExpressionST* simplified = simplify_identity(op_st, removed);
+			return simplified ? simplified : op_st;
+		}
+
+		ExpressionST* fold_if(IfST* if_st, uint32_t& removed) {
+			if_st->condition = fold_expression(if_st->condition, removed);
+			if_st->then_body = fold_expression(if_st->then_body, removed);
+			if (if_st->has_else) if_st->else_body = fold_expression(if_st->else_body, removed);
+
+			int64_t condition;
+			if (!get_constant_value(if_st->condition, condition)) return if_st;
+
+			// Only the taken branch is left
+			removed += 1 + count_nodes(if_st->condition);
+			if (condition) {
+				if (if_st->has_else) removed += count_nodes(if_st->else_body);
+				return if_st->then_body;
+			}
+			removed += count_nodes(if_st->then_body);
+			if (if_st->has_else) return if_st->else_body;
+			// The empty block takes the place of the if
+			--removed;
+			return make_empty_block();
+		}
+
+		ExpressionST* fold_match(MatchST* match_st, uint32_t& removed) {
+			match_st->value = fold_expression(match_st->value, removed);
+			for (MatchArm& arm : match_st->arms) arm.body = fold_expression(arm.body, removed);
+			if (match_st->default_body) match_st->default_body = fold_expression(match_st->default_body, removed);
+
+			int64_t value;
+			if (!get_constant_value(match_st->value, value)) return match_st;
+
+			// Only the arm with the value is left, or the default
+			ExpressionST* taken = get_match_body(match_st, value, match_st->value->return_type);
+			removed += count_nodes(match_st) - count_nodes(taken);
+			if (taken) return taken;
+			--removed;
+			return make_empty_block();
+		}
+
+		ExpressionST* fold_loop(LoopST* loop_st, uint32_t& removed) {
+			if (loop_st->condition) loop_st->condition = fold_expression(loop_st->condition, removed);
+			loop_st->body = fold_expression(loop_st->body, removed);
+
+			int64_t condition;
+			if (loop_st->condition && get_constant_value(loop_st->condition, condition) && !condition) {
+				// The loop body never runs
+				removed += count_nodes(loop_st) - 1;
+				return make_empty_block();
+			}
+			return loop_st;
+		}
+
+		BlockST* fold_block(BlockST* block_st, uint32_t& removed) {
+			std::vector<ExpressionST*> children;
+			for (uint32_t i = 0; i < block_st->num_children; i++) {
+				ExpressionST* child = fold_expression(block_st->children[i], removed);
+				// Empty statements (like a folded away if) are left out
+				if (is_empty_block(child)) {
+					++removed;
+					continue;
+				}
+				children.push_back(child);
+			}
+			if (children.size() != block_st->num_children) {
+				for (uint32_t i = 0; i < children.size(); i++) {
+					block_st->children[i] = children[i];
+				}
+				block_st->num_children = children.size();
+			}
+			return block_st;
+		}
+
+		// Replaces a value producing block or if by its value, if it can be calculated at compile time
+		ExpressionST* fold_value_expression(ExpressionST* expression, uint32_t& removed) {
+			int64_t value;
+			if (expression->return_type == Type::VOID || (expression->type != AstType::BLOCK && expression->type != AstType::IF)) return expression;
+			if (!evaluate_constant(expression, value)) return expression;
+			removed += count_nodes(expression) - 1;
+			return make_constant(expression->return_type, value);
+		}
+
+		// Folds the expression and returns what should be used in its place
+		ExpressionST* fold_expression(ExpressionST* expression, uint32_t& removed) {
+			switch (expression->type) {
+			case AstType::BLOCK:
+				return fold_value_expression(fold_block(static_cast<BlockST*>(expression), removed), removed);
+			case AstType::IF:
+				return fold_value_expression(fold_if(static_cast<IfST*>(expression), removed), removed);
+			case AstType::LOOP:
+				return fold_loop(static_cast<LoopST*>(expression), removed);
+			case AstType::MATCH:
+				return fold_match(static_cast<MatchST*>(expression), removed);
+			case AstType::OPERATION:
+				return fold_operation(static_cast<OperationST*>(expression), removed);
+			case AstType::RETURN:
+			{
+				ReturnST* ret_st = static_cast<ReturnST*>(expression);
+				ret_st->expression = fold_expression(ret_st->expression, removed);
+				return ret_st;
+			}
+			case AstType::VAR_ASSIGNMENT:
+			{
+				VariableAssignST* var_st = static_cast<VariableAssignST*>(expression);
+				var_st->value = fold_expression(var_st->value, removed);
+				return var_st;
+			}
+			case AstType::VAR_DECLARATION:
+			{
+				VariableDeclarationST* var_st = static_cast<VariableDeclarationST*>(expression);
+				var_st->value = fold_expression(var_st->value, removed);
+				return var_st;
+			}
+			case AstType::FUNCTION_CALL:
+			{
+				FunctionCallST* call_st = static_cast<FunctionCallST*>(expression);
+				for (ExpressionST*& argument : call_st->arguments) argument = fold_expression(argument, removed);
+				return call_st;
+			}
+			case AstType::ARRAY_DECLARATION:
+			{
+				ArrayDeclarationST* array_st = static_cast<ArrayDeclarationST*>(expression);
+				if (array_st->value) array_st->value = fold_expression(array_st->value, removed);
+				return array_st;
+			}
+			case AstType::SLICE:
+			{
+				SliceST* slice_st = static_cast<SliceST*>(expression);
+				slice_st->begin = fold_expression(slice_st->begin, removed);
+				slice_st->end = fold_expression(slice_st->end, removed);
+				return slice_st;
+			}
+			case AstType::INDEX:
+			{
+				IndexST* index_st = static_cast<IndexST*>(expression);
+				index_st->index = fold_expression(index_st->index, removed);
+				return index_st;
+			}
+			case AstType::INDEX_ASSIGNMENT:
+			{
+				IndexAssignST* index_st = static_cast<IndexAssignST*>(expression);
+				index_st->index = fold_expression(index_st->index, removed);
+				index_st->value = fold_expression(index_st->value, removed);
+				return index_st;
+			}
+			default:
+				return expression;
+			}
+		}
+
+		// Evaluates constant operations, applies algebraic identities and removes branches with constant conditions
+		// Blocks and ifs that produce a value without side effects are replaced by that value
+		// Returns the number of nodes that were removed from the tree
+		uint32_t fold_constants(FunctionDefST* function) {
+			uint32_t removed = 0;
+			fold_block(function->statement, removed);
+			return removed;
+		}
+
+		uint32_t fold_constants(ProgramST* program) {
+			uint32_t removed = 0;
+			for (FunctionDefST* function : program->functions) removed += fold_constants(function);
+			return removed;
+		}
+	}
+}
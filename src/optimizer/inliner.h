@@ -0,0 +1,515 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+
+#include "optimizer/folding.h"
+#include "profile/profile.h"
+#include "utils/report.h"
+#include "ast.h"
+
+namespace Bonfire {
+	namespace Optimizer {
+
+		// Functions with at most this many nodes are inlined at every call site (--inline-budget=<nodes>, 0 turns inlining off)
+		// Functions with a single call site are inlined whatever their size, since their own copy goes away
+		uint32_t inline_budget = 30;
+
+		typedef std::map<std::string, std::string> RenameMap;
+
+		ExpressionST* clone_node(ExpressionST* expression, RenameMap& renames, const std::string& suffix);
+
+		// Copies an expression tree. Variables that are declared inside of it get the names from renames,
+		// new names are added for declarations that don't have one yet. Copies keep the line and the profile probe
+		ExpressionST* clone_expression(ExpressionST* expression, RenameMap& renames, const std::string& suffix) {
+			if (!expression) return NULL;
+			ExpressionST* clone = clone_node(expression, renames, suffix);
+			clone->line = expression->line;
+			clone->probe = expression->probe;
+			return clone;
+		}
+
+		ExpressionST* clone_node(ExpressionST* expression, RenameMap& renames, const std::string& suffix) {
+			auto rename = [&](const std::string& name) -> std::string {
+				auto it = renames.find(name);
+				return it != renames.end() ? it->second : name;
+			};
+			switch (expression->type) {
+			case AstType::BLOCK:
+			{
+				BlockST* block_st = static_cast<BlockST*>(expression);
+				ExpressionST** children = new ExpressionST*[block_st->num_children];
+				for (uint32_t i = 0; i < block_st->num_children; i++) children[i] = clone_expression(block_st->children[i], renames, suffix);
+				return new BlockST(block_st->return_type, children, block_st->num_children);
+			}
+			case AstType::IF:
+			{
+				IfST* if_st = static_cast<IfST*>(expression);
+				ExpressionST* condition = clone_expression(if_st->condition, renames, suffix);
+				ExpressionST* then_body = clone_expression(if_st->then_body, renames, suffix);
+				if (!if_st->has_else) return new IfST(condition, then_body, if_st->return_type);
+				return new IfST(condition, then_body, clone_expression(if_st->else_body, renames, suffix), if_st->return_type);
+			}
+			case AstType::LOOP:
+			{
+				LoopST* loop_st = static_cast<LoopST*>(expression);
+				ExpressionST* condition = clone_expression(loop_st->condition, renames, suffix);
+				return new LoopST(condition, clone_expression(loop_st->body, renames, suffix));
+			}
+			case AstType::MATCH:
+			{
+				MatchST* match_st = static_cast<MatchST*>(expression);
+				std::vector<MatchArm> arms;
+				for (MatchArm& arm : match_st->arms) arms.push_back(MatchArm(arm.values, clone_expression(arm.body, renames, suffix)));
+				return new MatchST(clone_expression(match_st->value, renames, suffix), arms, clone_expression(match_st->default_body, renames, suffix), match_st->return_type);
+			}
+			case AstType::RETURN:
+				return new ReturnST(clone_expression(static_cast<ReturnST*>(expression)->expression, renames, suffix));
+			case AstType::CONSTANT:
+				return new ConstantST(expression->return_type, static_cast<ConstantST*>(expression)->constant);
+			case AstType::VAR_VALUE:
+				return new VariableValST(rename(static_cast<VariableValST*>(expression)->identifier), expression->return_type);
+			case AstType::VAR_ASSIGNMENT:
+			{
+				VariableAssignST* var_st = static_cast<VariableAssignST*>(expression);
+				ExpressionST* value = clone_expression(var_st->value, renames, suffix);
+				return new VariableAssignST(rename(var_st->identifier), var_st->return_type, value);
+			}
+			case AstType::VAR_DECLARATION:
+			{
+				VariableDeclarationST* var_st = static_cast<VariableDeclarationST*>(expression);
+				// The value can't see the variable yet
+				ExpressionST* value = clone_expression(var_st->value, renames, suffix);
+				if (!renames.count(var_st->identifier)) renames[var_st->identifier] = var_st->identifier + suffix;
+				return new VariableDeclarationST(renames[var_st->identifier], var_st->var_type, value);
+			}
+			case AstType::OPERATION:
+			{
+				OperationST* op_st = static_cast<OperationST*>(expression);
+				OperationST* clone = new OperationST(op_st->op, clone_expression(op_st->lhs, renames, suffix), clone_expression(op_st->rhs, renames, suffix));
+				clone->return_type = op_st->return_type;
+				return clone;
+			}
+			case AstType::FUNCTION_CALL:
+			{
+				FunctionCallST* call_st = static_cast<FunctionCallST*>(expression);
+				std::vector<ExpressionST*> arguments;
+				for (ExpressionST* argument : call_st->arguments) arguments.push_back(clone_expression(argument, renames, suffix));
+				return new FunctionCallST(call_st->function, arguments, call_st->return_type);
+			}
+			case AstType::ARRAY_DECLARATION:
+			{
+				ArrayDeclarationST* array_st = static_cast<ArrayDeclarationST*>(expression);
+				ExpressionST* value = clone_expression(array_st->value, renames, suffix);
+				if (!renames.count(array_st->identifier)) renames[array_st->identifier] = array_st->identifier + suffix;
+				if (value) return new ArrayDeclarationST(renames[array_st->identifier], array_st->element_type, value);
+				return new ArrayDeclarationST(renames[array_st->identifier], array_st->element_type, array_st->length, array_st->is_static);
+			}
+			case AstType::SLICE:
+			{
+				SliceST* slice_st = static_cast<SliceST*>(expression);
+				SliceST* clone = new SliceST(rename(slice_st->identifier), slice_st->return_type, clone_expression(slice_st->begin, renames, suffix), clone_expression(slice_st->end, renames, suffix));
+				clone->checked = slice_st->checked;
+				return clone;
+			}
+			case AstType::INDEX:
+			{
+				IndexST* index_st = static_cast<IndexST*>(expression);
+				IndexST* clone = new IndexST(rename(index_st->identifier), index_st->element_type, clone_expression(index_st->index, renames, suffix), index_st->return_type);
+				clone->checked = index_st->checked;
+				return clone;
+			}
+			case AstType::INDEX_ASSIGNMENT:
+			{
+				IndexAssignST* index_st = static_cast<IndexAssignST*>(expression);
+				IndexAssignST* clone = new IndexAssignST(rename(index_st->identifier), index_st->element_type, clone_expression(index_st->index, renames, suffix), clone_expression(index_st->value, renames, suffix));
+				clone->checked = index_st->checked;
+				return clone;
+			}
+			case AstType::LENGTH:
+				return new LengthST(rename(static_cast<LengthST*>(expression)->identifier), expression->return_type);
+			default:
+				return expression;
+			}
+		}
+
+		// Calls every function on the call sites inside of expression
+		template<class F>
+		void for_each_call(ExpressionST* expression, F f) {
+			if (!expression) return;
+			switch (expression->type) {
+			case AstType::BLOCK:
+			{
+				BlockST* block_st = static_cast<BlockST*>(expression);
+				for (uint32_t i = 0; i < block_st->num_children; i++) for_each_call(block_st->children[i], f);
+				return;
+			}
+			case AstType::IF:
+			{
+				IfST* if_st = static_cast<IfST*>(expression);
+				for_each_call(if_st->condition, f);
+				for_each_call(if_st->then_body, f);
+				if (if_st->has_else) for_each_call(if_st->else_body, f);
+				return;
+			}
+			case AstType::LOOP:
+				for_each_call(static_cast<LoopST*>(expression)->condition, f);
+				for_each_call(static_cast<LoopST*>(expression)->body, f);
+				return;
+			case AstType::MATCH:
+			{
+				MatchST* match_st = static_cast<MatchST*>(expression);
+				for_each_call(match_st->value, f);
+				for (MatchArm& arm : match_st->arms) for_each_call(arm.body, f);
+				for_each_call(match_st->default_body, f);
+				return;
+			}
+			case AstType::RETURN:
+				for_each_call(static_cast<ReturnST*>(expression)->expression, f);
+				return;
+			case AstType::VAR_ASSIGNMENT:
+				for_each_call(static_cast<VariableAssignST*>(expression)->value, f);
+				return;
+			case AstType::VAR_DECLARATION:
+				for_each_call(static_cast<VariableDeclarationST*>(expression)->value, f);
+				return;
+			case AstType::OPERATION:
+				for_each_call(static_cast<OperationST*>(expression)->lhs, f);
+				for_each_call(static_cast<OperationST*>(expression)->rhs, f);
+				return;
+			case AstType::FUNCTION_CALL:
+			{
+				FunctionCallST* call_st = static_cast<FunctionCallST*>(expression);
+				f(call_st);
+				for (ExpressionST* argument : call_st->arguments) for_each_call(argument, f);
+				return;
+			}
+			case AstType::ARRAY_DECLARATION:
+				for_each_call(static_cast<ArrayDeclarationST*>(expression)->value, f);
+				return;
+			case AstType::SLICE:
+				for_each_call(static_cast<SliceST*>(expression)->begin, f);
+				for_each_call(static_cast<SliceST*>(expression)->end, f);
+				return;
+			case AstType::INDEX:
+				for_each_call(static_cast<IndexST*>(expression)->index, f);
+				return;
+			case AstType::INDEX_ASSIGNMENT:
+				for_each_call(static_cast<IndexAssignST*>(expression)->index, f);
+				for_each_call(static_cast<IndexAssignST*>(expression)->value, f);
+				return;
+			default:
+				return;
+			}
+		}
+
+		bool contains_return(ExpressionST* expression) {
+			if (!expression) return false;
+			switch (expression->type) {
+			case AstType::RETURN:
+				return true;
+			case AstType::BLOCK:
+			{
+				BlockST* block_st = static_cast<BlockST*>(expression);
+				for (uint32_t i = 0; i < block_st->num_children; i++) {
+					if (contains_return(block_st->children[i])) return true;
+				}
+				return false;
+			}
+			case AstType::IF:
+			{
+				IfST* if_st = static_cast<IfST*>(expression);
+				return contains_return(if_st->then_body) || (if_st->has_else && contains_return(if_st->else_body));
+			}
+			case AstType::LOOP:
+				return contains_return(static_cast<LoopST*>(expression)->body);
+			case AstType::MATCH:
+			{
+				MatchST* match_st = static_cast<MatchST*>(expression);
+				for (MatchArm& arm : match_st->arms) {
+					if (contains_return(arm.body)) return true;
+				}
+				return contains_return(match_st->default_body);
+			}
+			default:
+				return false;
+			}
+		}
+
+		// Every copy of a static array would have elements of its own
+		bool has_static_array(ExpressionST* expression) {
+			if (!expression) return false;
+			switch (expression->type) {
+			case AstType::ARRAY_DECLARATION:
+				return static_cast<ArrayDeclarationST*>(expression)->is_static;
+			case AstType::BLOCK:
+			{
+				BlockST* block_st = static_cast<BlockST*>(expression);
+				for (uint32_t i = 0; i < block_st->num_children; i++) {
+					if (has_static_array(block_st->children[i])) return true;
+				}
+				return false;
+			}
+			case AstType::IF:
+			{
+				IfST* if_st = static_cast<IfST*>(expression);
+				return has_static_array(if_st->then_body) || (if_st->has_else && has_static_array(if_st->else_body));
+			}
+			case AstType::LOOP:
+				return has_static_array(static_cast<LoopST*>(expression)->body);
+			case AstType::MATCH:
+			{
+				MatchST* match_st = static_cast<MatchST*>(expression);
+				for (MatchArm& arm : match_st->arms) {
+					if (has_static_array(arm.body)) return true;
+				}
+				return has_static_array(match_st->default_body);
+			}
+			case AstType::RETURN:
+				return has_static_array(static_cast<ReturnST*>(expression)->expression);
+			case AstType::VAR_ASSIGNMENT:
+				return has_static_array(static_cast<VariableAssignST*>(expression)->value);
+			case AstType::VAR_DECLARATION:
+				return has_static_array(static_cast<VariableDeclarationST*>(expression)->value);
+			default:
+				return false;
+			}
+		}
+
+		struct InlineContext {
+			std::set<FunctionDefST*> recursive;
+			std::map<FunctionDefST*, uint32_t> call_sites;
+			uint32_t num_inlined = 0;
+		};
+
+		// Finds the functions that can call themselves, directly or through other functions
+		std::set<FunctionDefST*> find_recursive_functions(ProgramST* program) {
+			std::map<FunctionDefST*, std::set<FunctionDefST*>> callees;
+			for (FunctionDefST* function : program->functions) {
+				for_each_call(function->statement, [&](FunctionCallST* call_st) { callees[function].insert(call_st->function); });
+			}
+			std::set<FunctionDefST*> recursive;
+			for (FunctionDefST* function : program->functions) {
+				std::set<FunctionDefST*> reached;
+				std::vector<FunctionDefST*> work(callees[function].begin(), callees[function].end());
+				while (!work.empty()) {
+					FunctionDefST* next = work.back();
+					work.pop_back();
+					if (next == function) {
+						recursive.insert(function);
+						break;
+					}
+					if (!reached.insert(next).second) continue;
+					work.insert(work.end(), callees[next].begin(), callees[next].end());
+				}
+			}
+			return recursive;
+		}
+
+		// Decides if a call site gets inlined, the reason goes into the inline report
+		bool should_inline(FunctionCallST* call_st, InlineContext& context, std::string& reason) {
+			FunctionDefST* function = call_st->function;
+			uint32_t size = count_nodes(function->statement);
+			if (!inline_budget) {
+				reason = "inlining is off";
+				return false;
+			}
+			if (context.recursive.count(function)) {
+				reason = "recursive";
+				return false;
+			}
+			if (has_static_array(function->statement)) {
+				reason = "static array";
+				return false;
+			}
+			// A return in a void function would return for the caller
+			if (function->return_type == Type::VOID && contains_return(function->statement)) {
+				reason = "void function with return";
+				return false;
+			}
+			if (context.call_sites[function] == 1) {
+				reason = "single call site, " + std::to_string(size) + " nodes";
+				return true;
+			}
+			// With a profile, call sites that never ran stay calls and hot call sites get a bigger budget
+			uint32_t budget = inline_budget;
+			const std::vector<uint64_t>* counts = Profile::get_counts(call_st);
+			if (counts && !(*counts)[0]) {
+				reason = "never called in the profile";
+				Report::add_line("profile", "not inlined " + Profile::describe(call_st) + ", never called");
+				return false;
+			}
+			if (counts && Profile::is_hot((*counts)[0])) {
+				budget = inline_budget * 4;
+				if (size > inline_budget && size <= budget) {
+					Report::add_line("profile", "inlined " + Profile::describe(call_st) + " over the budget, called " + std::to_string((*counts)[0]) + " times");
+				}
+			}
+			if (size > budget) {
+				reason = std::to_string(size) + " nodes, over the budget of " + std::to_string(budget);
+				return false;
+			}
+			reason = std::to_string(size) + " nodes";
+			return true;
+		}
+
+		// Replaces a call by a block with the type of the function. Its first statements declare the parameters with the values of the arguments,
+		// then comes the body of the function. Returns in the body return from the block now
+		BlockST* inline_call(FunctionCallST* call_st, InlineContext& context) {
+			FunctionDefST* function = call_st->function;
+			std::string suffix = "__inline" + std::to_string(context.num_inlined);
+			++context.num_inlined;
+
+			RenameMap renames;
+			std::vector<ExpressionST*> children;
+			for (size_t i = 0; i < function->parameters.size(); i++) {
+				ParameterDef& parameter = function->parameters[i];
+				renames[parameter.identifier] = parameter.identifier + suffix;
+				// A slice parameter is a slice of the argument
+				if (parameter.slice) children.push_back(new ArrayDeclarationST(renames[parameter.identifier], parameter.type, call_st->arguments[i]));
+				else children.push_back(new VariableDeclarationST(renames[parameter.identifier], parameter.type, call_st->arguments[i]));
+			}
+			BlockST* body = static_cast<BlockST*>(clone_expression(function->statement, renames, suffix));
+			// The calls in the copy are new call sites
+			for_each_call(body, [&](FunctionCallST* clone_call_st) { ++context.call_sites[clone_call_st->function]; });
+			for (uint32_t i = 0; i < body->num_children; i++) children.push_back(body->children[i]);
+
+			ExpressionST** children_arr = new ExpressionST*[children.size()];
+			for (size_t i = 0; i < children.size(); i++) children_arr[i] = children[i];
+			BlockST* inlined = new BlockST(function->return_type, children_arr, children.size());
+			// The block counts the calls for the profile now
+			inlined->line = call_st->line;
+			inlined->probe = call_st->probe;
+			return inlined;
+		}
+
+		ExpressionST* inline_expression(ExpressionST* expression, FunctionDefST* caller, InlineContext& context);
+
+		ExpressionST* inline_call_site(FunctionCallST* call_st, FunctionDefST* caller, InlineContext& context) {
+			for (ExpressionST*& argument : call_st->arguments) argument = inline_expression(argument, caller, context);
+			std::string reason;
+			bool inlined = should_inline(call_st, context, reason);
+			Report::add_line("inline", (inlined ? "inlined " : "not inlined ") + call_st->function->name + " into " + caller->name + " (" + reason + ")");
+			if (!inlined) return call_st;
+			--context.call_sites[call_st->function];
+			// The copied body can have calls of its own
+			return inline_expression(inline_call(call_st, context), caller, context);
+		}
+
+		// Inlines the call sites inside of expression and returns what should be used in its place
+		ExpressionST* inline_expression(ExpressionST* expression, FunctionDefST* caller, InlineContext& context) {
+			if (!expression) return NULL;
+			switch (expression->type) {
+			case AstType::BLOCK:
+			{
+				BlockST* block_st = static_cast<BlockST*>(expression);
+				for (uint32_t i = 0; i < block_st->num_children; i++) block_st->children[i] = inline_expression(block_st->children[i], caller, context);
+				return block_st;
+			}
+			case AstType::IF:
+			{
+				IfST* if_st = static_cast<IfST*>(expression);
+				if_st->condition = inline_expression(if_st->condition, caller, context);
+				if_st->then_body = inline_expression(if_st->then_body, caller, context);
+				if (if_st->has_else) if_st->else_body = inline_expression(if_st->else_body, caller, context);
+				return if_st;
+			}
+			case AstType::LOOP:
+			{
+				LoopST* loop_st = static_cast<LoopST*>(expression);
+				loop_st->condition = inline_expression(loop_st->condition, caller, context);
+				loop_st->body = inline_expression(loop_st->body, caller, context);
+				return loop_st;
+			}
+			case AstType::MATCH:
+			{
+				MatchST* match_st = static_cast<MatchST*>(expression);
+				match_st->value = inline_expression(match_st->value, caller, context);
+				for (MatchArm& arm : match_st->arms) arm.body = inline_expression(arm.body, caller, context);
+				match_st->default_body = inline_expression(match_st->default_body, caller, context);
+				return match_st;
+			}
+			case AstType::RETURN:
+			{
+				ReturnST* ret_st = static_cast<ReturnST*>(expression);
+				ret_st->expression = inline_expression(ret_st->expression, caller, context);
+				return ret_st;
+			}
+			case AstType::VAR_ASSIGNMENT:
+			{
+				VariableAssignST* var_st = static_cast<VariableAssignST*>(expression);
+				var_st->value = inline_expression(var_st->value, caller, context);
+				return var_st;
+			}
+			case AstType::VAR_DECLARATION:
+			{
+				VariableDeclarationST* var_st = static_cast<VariableDeclarationST*>(expression);
+				var_st->value = inline_expression(var_st->value, caller, context);
+				return var_st;
+			}
+			case AstType::OPERATION:
+			{
+				OperationST* op_st = static_cast<OperationST*>(expression);
+				op_st->lhs = inline_expression(op_st->lhs, caller, context);
+				op_st->rhs = inline_expression(op_st->rhs, caller, context);
+				return op_st;
+			}
+			case AstType::FUNCTION_CALL:
+				return inline_call_site(static_cast<FunctionCallST*>(expression), caller, context);
+			case AstType::ARRAY_DECLARATION:
+			{
+				ArrayDeclarationST* array_st = static_cast<ArrayDeclarationST*>(expression);
+				array_st->value = inline_expression(array_st->value, caller, context);
+				return array_st;
+			}
+			case AstType::SLICE:
+			{
+				SliceST* slice_st = static_cast<SliceST*>(expression);
+				slice_st->begin = inline_expression(slice_st->begin, caller, context);
+				slice_st->end = inline_expression(slice_st->end, caller, context);
+				return slice_st;
+			}
+			case AstType::INDEX:
+			{
+				IndexST* index_st = static_cast<IndexST*>(expression);
+				index_st->index = inline_expression(index_st->index, caller, context);
+				return index_st;
+			}
+			case AstType::INDEX_ASSIGNMENT:
+			{
+				IndexAssignST* index_st = static_cast<IndexAssignST*>(expression);
+				index_st->index = inline_expression(index_st->index, caller, context);
+				index_st->value = inline_expression(index_st->value, caller, context);
+				return index_st;
+			}
+			default:
+				return expression;
+			}
+		}
+
+		// Inlines small functions and functions with a single call site into their callers
+		// Functions (other than main) that aren't called anymore afterwards are removed. Returns the number of inlined call sites
+		uint32_t inline_functions(ProgramST* program) {
+			InlineContext context;
+			context.recursive = find_recursive_functions(program);
+			for (FunctionDefST* function : program->functions) {
+				for_each_call(function->statement, [&](FunctionCallST* call_st) { ++context.call_sites[call_st->function]; });
+			}
+
+			for (FunctionDefST* function : program->functions) {
+				// A function that isn't called anymore is removed anyway
+				if (function != program->main && !context.call_sites[function]) continue;
+				inline_expression(function->statement, function, context);
+			}
+
+			std::vector<FunctionDefST*> functions;
+			for (FunctionDefST* function : program->functions) {
+				if (function == program->main || context.call_sites[function]) functions.push_back(function);
+				else Report::add_line("inline", "removed " + function->name + " (not called anymore)");
+			}
+			program->functions = functions;
+			return context.num_inlined;
+		}
+	}
+}
@@ -0,0 +1,453 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+
+#include "optimizer/folding.h"
+#include "optimizer/inliner.h"
+#include "ast.h"
+
+namespace Bonfire {
+	namespace Optimizer {
+
+		// Loops in the tree are already structured: the body of a LoopST is the loop, the statement before it is its preheader
+		// and the end of the body is the only back edge, so no CFG has to be built to find them.
+
+		// Declared types of the variables of a function. The types in the tree come from where a value is used
+		typedef std::map<std::string, Type> TypeMap;
+
+		struct LoopContext {
+			uint32_t hoisted = 0;	// Invariant expressions moved in front of their loop
+			uint32_t reduced = 0;	// Multiplications by an induction variable replaced by additions
+			uint32_t counters = 0;	// Induction variables that were only used to count themselves up
+			uint32_t depth = 0;		// Number of loops around the current one
+			TypeMap types;
+		};
+
+		uint32_t loop_name_counter = 0;
+
+		// Calls f on every slot an expression is stored in, so f can replace it. If f returns true, the children of the
+		// replaced expression are skipped
+		template<class F>
+		void for_each_slot(ExpressionST*& expression, F f) {
+			if (!expression || f(expression)) return;
+			switch (expression->type) {
+			case AstType::BLOCK:
+			{
+				BlockST* block_st = static_cast<BlockST*>(expression);
+				for (uint32_t i = 0; i < block_st->num_children; i++) for_each_slot(block_st->children[i], f);
+				return;
+			}
+			case AstType::IF:
+			{
+				IfST* if_st = static_cast<IfST*>(expression);
+				for_each_slot(if_st->condition, f);
+				for_each_slot(if_st->then_body, f);
+				if (if_st->has_else) for_each_slot(if_st->else_body, f);
+				return;
+			}
+			case AstType::LOOP:
+				for_each_slot(static_cast<LoopST*>(expression)->condition, f);
+				for_each_slot(static_cast<LoopST*>(expression)->body, f);
+				return;
+			case AstType::MATCH:
+			{
+				MatchST* match_st = static_cast<MatchST*>(expression);
+				for_each_slot(match_st->value, f);
+				for (MatchArm& arm : match_st->arms) for_each_slot(arm.body, f);
+				for_each_slot(match_st->default_body, f);
+				return;
+			}
+			case AstType::RETURN:
+				for_each_slot(static_cast<ReturnST*>(expression)->expression, f);
+				return;
+			case AstType::VAR_ASSIGNMENT:
+				for_each_slot(static_cast<VariableAssignST*>(expression)->value, f);
+				return;
+			case AstType::VAR_DECLARATION:
+				for_each_slot(static_cast<VariableDeclarationST*>(expression)->value, f);
+				return;
+			case AstType::OPERATION:
+				for_each_slot(static_cast<OperationST*>(expression)->lhs, f);
+				for_each_slot(static_cast<OperationST*>(expression)->rhs, f);
+				return;
+			case AstType::FUNCTION_CALL:
+				for (ExpressionST*& argument : static_cast<FunctionCallST*>(expression)->arguments) for_each_slot(argument, f);
+				return;
+			case AstType::ARRAY_DECLARATION:
+				for_each_slot(static_cast<ArrayDeclarationST*>(expression)->value, f);
+				return;
+			case AstType::SLICE:
+				for_each_slot(static_cast<SliceST*>(expression)->begin, f);
+				for_each_slot(static_cast<SliceST*>(expression)->end, f);
+				return;
+			case AstType::INDEX:
+				for_each_slot(static_cast<IndexST*>(expression)->index, f);
+				return;
+			case AstType::INDEX_ASSIGNMENT:
+				for_each_slot(static_cast<IndexAssignST*>(expression)->index, f);
+				for_each_slot(static_cast<IndexAssignST*>(expression)->value, f);
+				return;
+			default:
+				return;
+			}
+		}
+
+		// Counts how often every variable is assigned or declared in an expression
+		void count_writes(ExpressionST* expression, std::map<std::string, uint32_t>& writes) {
+			for_each_slot(expression, [&](ExpressionST*& slot) {
+				if (slot->type == AstType::VAR_ASSIGNMENT) writes[static_cast<VariableAssignST*>(slot)->identifier]++;
+				if (slot->type == AstType::VAR_DECLARATION) writes[static_cast<VariableDeclarationST*>(slot)->identifier]++;
+				// A slice that is declared again can have another length
+				if (slot->type == AstType::ARRAY_DECLARATION) writes[static_cast<ArrayDeclarationST*>(slot)->identifier]++;
+				return false;
+			});
+		}
+
+		uint32_t count_reads(ExpressionST* expression, const std::string& name) {
+			uint32_t reads = 0;
+			for_each_slot(expression, [&](ExpressionST*& slot) {
+				if (slot->type == AstType::VAR_VALUE && !static_cast<VariableValST*>(slot)->identifier.compare(name)) reads++;
+				return false;
+			});
+			return reads;
+		}
+
+		// Compares two pure expressions. The types in the tree are not compared, they depend on where the value is used
+		// while the assembler calculates it in the declared types of the variables
+		bool is_same_expression(ExpressionST* lhs, ExpressionST* rhs) {
+			if (lhs->type != rhs->type) return false;
+			switch (lhs->type) {
+			case AstType::CONSTANT:
+				return !static_cast<ConstantST*>(lhs)->constant.compare(static_cast<ConstantST*>(rhs)->constant);
+			case AstType::VAR_VALUE:
+				return is_same_variable(lhs, rhs);
+			case AstType::LENGTH:
+				return !static_cast<LengthST*>(lhs)->identifier.compare(static_cast<LengthST*>(rhs)->identifier);
+			case AstType::OPERATION:
+			{
+				OperationST* lhs_op = static_cast<OperationST*>(lhs);
+				OperationST* rhs_op = static_cast<OperationST*>(rhs);
+				return lhs_op->op == rhs_op->op && is_same_expression(lhs_op->lhs, rhs_op->lhs) && is_same_expression(lhs_op->rhs, rhs_op->rhs);
+			}
+			default:
+				return false;
+			}
+		}
+
+		// An expression can be calculated in front of the loop if none of the variables it reads change in the loop.
+		// It may be calculated even if the loop never gets to it, so it must not be able to fault (no division by a variable)
+		bool is_invariant(ExpressionST* expression, const std::map<std::string, uint32_t>& writes) {
+			switch (expression->type) {
+			case AstType::CONSTANT:
+				return true;
+			case AstType::VAR_VALUE:
+				return !writes.count(static_cast<VariableValST*>(expression)->identifier);
+			case AstType::LENGTH:
+				return !writes.count(static_cast<LengthST*>(expression)->identifier);
+			case AstType::OPERATION:
+			{
+				OperationST* op_st = static_cast<OperationST*>(expression);
+				int64_t divisor;
+				switch (op_st->op) {
+				case Operation::ADD: case Operation::SUB: case Operation::MUL: case Operation::AND: case Operation::OR:
+					break;
+				case Operation::DIV: case Operation::MOD:
+					if (!get_constant_value(op_st->rhs, divisor) || divisor == 0) return false;
+					break;
+				default:
+					return false;
+				}
+				return is_invariant(op_st->lhs, writes) && is_invariant(op_st->rhs, writes);
+			}
+			default:
+				return false;
+			}
+		}
+
+		TypeMap collect_variable_types(FunctionDefST* function) {
+			TypeMap types;
+			for (ParameterDef& parameter : function->parameters) types[parameter.identifier] = parameter.type;
+			ExpressionST* body = function->statement;
+			for_each_slot(body, [&](ExpressionST*& slot) {
+				if (slot->type == AstType::VAR_DECLARATION) types[static_cast<VariableDeclarationST*>(slot)->identifier] = static_cast<VariableDeclarationST*>(slot)->var_type;
+				return false;
+			});
+			return types;
+		}
+
+		// Type the assembler calculates an expression in, constants take the type of the other side
+		Type get_expression_type(ExpressionST* expression, TypeMap& types) {
+			switch (expression->type) {
+			case AstType::VAR_VALUE:
+				return types[static_cast<VariableValST*>(expression)->identifier];
+			case AstType::INDEX:
+				return static_cast<IndexST*>(expression)->element_type;
+			case AstType::LENGTH:
+				return Type::UINT32;
+			case AstType::OPERATION:
+			{
+				OperationST* op_st = static_cast<OperationST*>(expression);
+				if (op_st->lhs->type == AstType::CONSTANT) return get_op_result_type(op_st->op, get_expression_type(op_st->rhs, types), get_expression_type(op_st->rhs, types));
+				if (op_st->rhs->type == AstType::CONSTANT) return get_op_result_type(op_st->op, get_expression_type(op_st->lhs, types), get_expression_type(op_st->lhs, types));
+				return get_op_result_type(op_st->op, get_expression_type(op_st->lhs, types), get_expression_type(op_st->rhs, types));
+			}
+			default:
+				return expression->return_type;
+			}
+		}
+
+		VariableAssignST* make_add_assign(const std::string& name, Type t, Operation op, ExpressionST* step) {
+			OperationST* value = new OperationST(op, new VariableValST(name, t), step);
+			value->return_type = t;
+			return new VariableAssignST(name, t, value);
+		}
+
+		bool is_variable(ExpressionST* expression, const std::string& name) {
+			return expression->type == AstType::VAR_VALUE && !static_cast<VariableValST*>(expression)->identifier.compare(name);
+		}
+
+		// An induction variable is counted up or down by a constant once per iteration: i = i + c or i = i - c,
+		// directly in the body of the loop (not behind a condition) and nowhere else in the loop.
+		// Returns the counter as it is read in the step, or NULL
+		VariableValST* get_induction_step(ExpressionST* statement, const std::map<std::string, uint32_t>& writes, int64_t& step) {
+			if (statement->type != AstType::VAR_ASSIGNMENT) return NULL;
+			VariableAssignST* var_st = static_cast<VariableAssignST*>(statement);
+			if (writes.at(var_st->identifier) != 1 || var_st->value->type != AstType::OPERATION) return NULL;
+			OperationST* op_st = static_cast<OperationST*>(var_st->value);
+			if (op_st->op == Operation::ADD) {
+				if (is_variable(op_st->lhs, var_st->identifier) && get_constant_value(op_st->rhs, step)) return static_cast<VariableValST*>(op_st->lhs);
+				if (is_variable(op_st->rhs, var_st->identifier) && get_constant_value(op_st->lhs, step)) return static_cast<VariableValST*>(op_st->rhs);
+			}
+			if (op_st->op == Operation::SUB && is_variable(op_st->lhs, var_st->identifier) && get_constant_value(op_st->rhs, step)) {
+				step = -step;
+				return static_cast<VariableValST*>(op_st->lhs);
+			}
+			return NULL;
+		}
+
+		// Replaces i * k (k constant or invariant) by a variable that starts at i * k in front of the loop and is increased by c * k
+		// right after every i = i + c. Adds the initializations to preheader
+		void reduce_induction_variables(LoopST* loop_st, std::vector<ExpressionST*>& preheader, LoopContext& context) {
+			if (loop_st->body->type != AstType::BLOCK) return;
+			BlockST* body = static_cast<BlockST*>(loop_st->body);
+			std::map<std::string, uint32_t> writes;
+			count_writes(loop_st->condition, writes);
+			count_writes(body, writes);
+
+			for (uint32_t s = 0; s < body->num_children; s++) {
+				int64_t step;
+				VariableValST* counter_st = get_induction_step(body->children[s], writes, step);
+				if (!counter_st) continue;
+				ExpressionST* step_st = body->children[s];
+				const std::string& counter = counter_st->identifier;
+				Type counter_type = context.types[counter];
+
+				// The derived variables for every factor the counter is multiplied with
+				std::vector<std::pair<ExpressionST*, std::string>> derived;
+				std::vector<ExpressionST*> updates;
+				auto reduce = [&](ExpressionST*& slot) {
+					if (slot == step_st || slot->type != AstType::OPERATION) return slot == step_st;
+					OperationST* op_st = static_cast<OperationST*>(slot);
+					if (op_st->op != Operation::MUL || get_expression_type(op_st, context.types) != counter_type) return false;
+					ExpressionST* factor;
+					if (is_variable(op_st->lhs, counter)) factor = op_st->rhs;
+					else if (is_variable(op_st->rhs, counter)) factor = op_st->lhs;
+					else return false;
+					if (factor->type != AstType::CONSTANT && !(factor->type == AstType::VAR_VALUE && is_invariant(factor, writes))) return false;
+
+					std::string name;
+					for (auto& d : derived) {
+						if (is_same_expression(d.first, factor)) name = d.second;
+					}
+					if (name.empty()) {
+						name = "__iv" + std::to_string(loop_name_counter++);
+						derived.push_back({ factor, name });
+						RenameMap renames;
+						preheader.push_back(new VariableDeclarationST(name, counter_type, clone_expression(op_st, renames, "")));
+						context.types[name] = counter_type;
+						// The derived variable moves by step * k every time the counter moves by step
+						int64_t factor_value;
+						Operation update_op = Operation::ADD;
+						ExpressionST* derived_step;
+						if (get_constant_value(factor, factor_value)) {
+							derived_step = make_constant(counter_type, step * factor_value);
+						}
+						else if (step == 1 || step == -1) {
+							// i = i + 1 moves the derived variable by k itself
+							derived_step = new VariableValST(static_cast<VariableValST*>(factor)->identifier, context.types[static_cast<VariableValST*>(factor)->identifier]);
+							if (step == -1) update_op = Operation::SUB;
+						}
+						else {
+							std::string step_name = name + "_step";
+							OperationST* step_value = new OperationST(Operation::MUL, new VariableValST(static_cast<VariableValST*>(factor)->identifier, factor->return_type), make_constant(counter_type, step));
+							step_value->return_type = counter_type;
+							preheader.push_back(new VariableDeclarationST(step_name, counter_type, step_value));
+							context.types[step_name] = counter_type;
+							derived_step = new VariableValST(step_name, counter_type);
+						}
+						updates.push_back(make_add_assign(name, counter_type, update_op, derived_step));
+					}
+					slot = new VariableValST(name, counter_type);
+					context.reduced++;
+					return true;
+				};
+				for_each_slot(loop_st->condition, reduce);
+				for_each_slot(loop_st->body, reduce);
+				if (updates.empty()) continue;
+
+				// The updates go right after the step, so the derived variables always match the counter
+				ExpressionST** children = new ExpressionST*[body->num_children + updates.size()];
+				uint32_t num_children = 0;
+				for (uint32_t i = 0; i < body->num_children; i++) {
+					children[num_children++] = body->children[i];
+					if (i == s) {
+						for (ExpressionST* update : updates) children[num_children++] = update;
+					}
+				}
+				body->children = children;
+				body->num_children = num_children;
+				s += updates.size();
+			}
+		}
+
+		// Moves the invariant operations of a loop into variables that are calculated in front of it
+		void hoist_invariants(LoopST* loop_st, std::vector<ExpressionST*>& preheader, LoopContext& context) {
+			std::map<std::string, uint32_t> writes;
+			count_writes(loop_st->condition, writes);
+			count_writes(loop_st->body, writes);
+
+			std::vector<std::pair<ExpressionST*, std::string>> hoisted;
+			auto hoist = [&](ExpressionST*& slot) {
+				if (slot->type != AstType::OPERATION || !is_invariant(slot, writes)) return false;
+				Type t = get_expression_type(slot, context.types);
+				if (t == Type::VOID) return false;
+				std::string name;
+				for (auto& h : hoisted) {
+					if (is_same_expression(h.first, slot)) name = h.second;
+				}
+				if (name.empty()) {
+					name = "__licm" + std::to_string(loop_name_counter++);
+					hoisted.push_back({ slot, name });
+					preheader.push_back(new VariableDeclarationST(name, t, slot));
+					context.types[name] = t;
+				}
+				slot = new VariableValST(name, t);
+				context.hoisted++;
+				return true;
+			};
+			for_each_slot(loop_st->condition, hoist);
+			for_each_slot(loop_st->body, hoist);
+		}
+
+		// Removes the steps of induction variables that nothing reads anymore, except the step itself. The preheader
+		// may still read them, it is not part of the function yet. In a loop inside another loop the preheader runs again
+		// after the loop, so it would see the counter not moving
+		void remove_unused_counters(LoopST* loop_st, ExpressionST* function_body, LoopContext& context) {
+			if (context.depth || loop_st->body->type != AstType::BLOCK) return;
+			BlockST* body = static_cast<BlockST*>(loop_st->body);
+			std::map<std::string, uint32_t> writes;
+			count_writes(loop_st->condition, writes);
+			count_writes(body, writes);
+
+			uint32_t num_children = 0;
+			for (uint32_t i = 0; i < body->num_children; i++) {
+				int64_t step;
+				ExpressionST* child = body->children[i];
+				if (get_induction_step(child, writes, step)) {
+					VariableAssignST* var_st = static_cast<VariableAssignST*>(child);
+					if (count_reads(function_body, var_st->identifier) == count_reads(var_st->value, var_st->identifier)) {
+						context.counters++;
+						continue;
+					}
+				}
+				body->children[num_children++] = child;
+			}
+			body->num_children = num_children;
+		}
+
+		ExpressionST* optimize_loops(ExpressionST* expression, ExpressionST* function_body, LoopContext& context);
+
+		// Optimizes a loop and returns what replaces it: the loop itself, or a block of the preheader and the loop
+		ExpressionST* optimize_loop(LoopST* loop_st, ExpressionST* function_body, LoopContext& context) {
+			// Inner loops first, their preheaders are then part of this loop
+			context.depth++;
+			loop_st->body = optimize_loops(loop_st->body, function_body, context);
+			context.depth--;
+
+			std::vector<ExpressionST*> preheader;
+			reduce_induction_variables(loop_st, preheader, context);
+			hoist_invariants(loop_st, preheader, context);
+			remove_unused_counters(loop_st, function_body, context);
+			if (preheader.empty()) return loop_st;
+
+			preheader.push_back(loop_st);
+			ExpressionST** children = new ExpressionST*[preheader.size()];
+			for (size_t i = 0; i < preheader.size(); i++) children[i] = preheader[i];
+			return new BlockST(Type::VOID, children, preheader.size());
+		}
+
+		ExpressionST* optimize_loops(ExpressionST* expression, ExpressionST* function_body, LoopContext& context) {
+			if (!expression) return NULL;
+			switch (expression->type) {
+			case AstType::LOOP:
+				return optimize_loop(static_cast<LoopST*>(expression), function_body, context);
+			case AstType::BLOCK:
+			{
+				// A loop directly in a block gets its preheader put into the block instead of a block of its own
+				BlockST* block_st = static_cast<BlockST*>(expression);
+				std::vector<ExpressionST*> children;
+				for (uint32_t i = 0; i < block_st->num_children; i++) {
+					ExpressionST* child = block_st->children[i];
+					ExpressionST* optimized = optimize_loops(child, function_body, context);
+					if (child->type == AstType::LOOP && optimized != child) {
+						BlockST* preheader = static_cast<BlockST*>(optimized);
+						for (uint32_t j = 0; j < preheader->num_children; j++) children.push_back(preheader->children[j]);
+					}
+					else children.push_back(optimized);
+				}
+				if (children.size() != block_st->num_children) {
+					block_st->children = new ExpressionST*[children.size()];
+					block_st->num_children = children.size();
+				}
+				for (size_t i = 0; i < children.size(); i++) block_st->children[i] = children[i];
+				return block_st;
+			}
+			case AstType::IF:
+			{
+				IfST* if_st = static_cast<IfST*>(expression);
+				if_st->then_body = optimize_loops(if_st->then_body, function_body, context);
+				if (if_st->has_else) if_st->else_body = optimize_loops(if_st->else_body, function_body, context);
+				return if_st;
+			}
+			case AstType::MATCH:
+			{
+				MatchST* match_st = static_cast<MatchST*>(expression);
+				for (MatchArm& arm : match_st->arms) arm.body = optimize_loops(arm.body, function_body, context);
+				match_st->default_body = optimize_loops(match_st->default_body, function_body, context);
+				return match_st;
+			}
+			case AstType::RETURN:
+				static_cast<ReturnST*>(expression)->expression = optimize_loops(static_cast<ReturnST*>(expression)->expression, function_body, context);
+				return expression;
+			case AstType::VAR_ASSIGNMENT:
+				static_cast<VariableAssignST*>(expression)->value = optimize_loops(static_cast<VariableAssignST*>(expression)->value, function_body, context);
+				return expression;
+			case AstType::VAR_DECLARATION:
+				static_cast<VariableDeclarationST*>(expression)->value = optimize_loops(static_cast<VariableDeclarationST*>(expression)->value, function_body, context);
+				return expression;
+			default:
+				return expression;
+			}
+		}
+
+		// Loop invariant code motion and strength reduction of induction variables
+		LoopContext optimize_loops(FunctionDefST* function) {
+			LoopContext context;
+			context.types = collect_variable_types(function);
+			optimize_loops(function->statement, function->statement, context);
+			return context;
+		}
+	}
+}
@@ -0,0 +1,380 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include <cstdint>
+
+#include "optimizer/loops.h"
+#include "optimizer/bounds.h"
+#include "assembler/vector.h"
+#include "profile/profile.h"
+#include "utils/report.h"
+#include "ast.h"
+
+namespace Bonfire {
+	namespace Optimizer {
+
+		// Instructions the vectorizer generates code for (--vectorize=). SSE2 is part of every x86_64 CPU
+		enum class VectorIsa { NONE, SSE2, AVX2 };
+		VectorIsa vector_isa = VectorIsa::NONE;
+
+		struct VectorizeContext {
+			std::string function;
+			TypeMap types;
+			std::map<std::string, uint32_t> lengths;
+			uint32_t vectorized = 0;
+			uint32_t rejected = 0;
+		};
+
+		// The loop that is being checked, and why it can't be vectorized
+		struct VectorCandidate {
+			LoopST* loop;
+			VectorLoop* plan;
+			std::map<std::string, uint32_t> writes;
+			bool has_element_type = false;
+			std::vector<std::string> stored;	// Arrays the loop writes
+			std::string reason;
+
+			bool reject(const std::string& why) {
+				reason = why;
+				return false;
+			}
+		};
+
+		// All values of a vectorized loop have one type, so every operation works on the same elements
+		bool check_element_type(Type t, VectorCandidate& candidate) {
+			if (!is_integer_type(t)) return candidate.reject("it uses a value that isn't an integer");
+			if (!candidate.has_element_type) {
+				candidate.plan->element_type = t;
+				candidate.has_element_type = true;
+				return true;
+			}
+			if (t != candidate.plan->element_type) {
+				return candidate.reject(std::string("it mixes ") + get_type_name(candidate.plan->element_type) + " and " + get_type_name(t) + " values");
+			}
+			return true;
+		}
+
+		bool is_counter_index(ExpressionST* index, VectorCandidate& candidate) {
+			return is_variable(index, candidate.plan->counter);
+		}
+
+		void add_array(const std::string& name, VectorCandidate& candidate) {
+			for (const std::string& array : candidate.plan->arrays) {
+				if (!array.compare(name)) return;
+			}
+			candidate.plan->arrays.push_back(name);
+		}
+
+		// Checks a value that is calculated for every element: a[i], values that don't change in the loop and +, - and *
+		// of them. Invariant parts are recorded, they are broadcast in front of the loop
+		bool check_vector_value(ExpressionST* value, VectorCandidate& candidate, VectorizeContext& context) {
+			VectorLoop* plan = candidate.plan;
+			if (value->type != AstType::INDEX && is_invariant(value, candidate.writes)) {
+				bool typed = true;
+				ExpressionST* slot = value;
+				for_each_slot(slot, [&](ExpressionST*& part) {
+					if (part->type == AstType::VAR_VALUE) typed = typed && check_element_type(context.types[static_cast<VariableValST*>(part)->identifier], candidate);
+					if (part->type == AstType::LENGTH) typed = typed && check_element_type(Type::UINT32, candidate);
+					return false;
+				});
+				if (!typed) return false;
+				for (size_t i = 0; i < plan->invariants.size(); i++) {
+					if (is_same_expression(plan->invariants[i], value)) {
+						plan->broadcasts[value] = (uint8_t)i;
+						return true;
+					}
+				}
+				plan->broadcasts[value] = (uint8_t)plan->invariants.size();
+				plan->invariants.push_back(value);
+				return true;
+			}
+			switch (value->type) {
+			case AstType::INDEX:
+			{
+				IndexST* index_st = static_cast<IndexST*>(value);
+				if (!is_counter_index(index_st->index, candidate)) return candidate.reject(index_st->identifier + "[...] isn't indexed by " + plan->counter);
+				add_array(index_st->identifier, candidate);
+				return check_element_type(index_st->element_type, candidate);
+			}
+			case AstType::VAR_VALUE:
+			{
+				const std::string& name = static_cast<VariableValST*>(value)->identifier;
+				if (!name.compare(plan->counter)) return candidate.reject("it uses the counter " + name + " as a value");
+				return candidate.reject("it reads " + name + ", which changes in the loop");
+			}
+			case AstType::OPERATION:
+			{
+				OperationST* op_st = static_cast<OperationST*>(value);
+				if (op_st->op != Operation::ADD && op_st->op != Operation::SUB && op_st->op != Operation::MUL) {
+					return candidate.reject("an operation other than +, - and * has no packed instruction");
+				}
+				if (!check_vector_value(op_st->lhs, candidate, context) || !check_vector_value(op_st->rhs, candidate, context)) return false;
+				if (op_st->op == Operation::MUL && !has_vector_multiply(plan->element_type, vector_isa == VectorIsa::AVX2)) {
+					if (get_type_size(plan->element_type) == 4) return candidate.reject("multiplying 32-bit elements needs --vectorize=avx2");
+					return candidate.reject(std::string("there is no packed multiplication of ") + get_type_name(plan->element_type));
+				}
+				return true;
+			}
+			default:
+				return candidate.reject("it calls a function or has a statement inside of a value");
+			}
+		}
+
+		// The vector registers a value needs, the way the assembler calculates it: invariants are used where they are,
+		// an operation keeps its lhs in one register while the rhs is calculated in the next ones
+		uint32_t get_vector_registers(ExpressionST* value, VectorLoop* plan) {
+			if (plan->broadcasts.count(value)) return 0;
+			if (value->type != AstType::OPERATION) return 1;
+			OperationST* op_st = static_cast<OperationST*>(value);
+			ExpressionST* lhs = op_st->lhs;
+			ExpressionST* rhs = op_st->rhs;
+			if (plan->broadcasts.count(lhs) && op_st->op != Operation::SUB) std::swap(lhs, rhs);
+			uint32_t lhs_registers = get_vector_registers(lhs, plan);
+			uint32_t rhs_registers = 1 + get_vector_registers(rhs, plan);
+			if (lhs_registers < 1) lhs_registers = 1;
+			return lhs_registers > rhs_registers ? lhs_registers : rhs_registers;
+		}
+
+		// The reduction variable of a statement can only be used by it: the loop can't see its value before the end
+		bool check_reduction_variable(const std::string& name, VectorCandidate& candidate, VectorizeContext& context) {
+			if (!name.compare(candidate.plan->counter)) return candidate.reject("it changes the counter " + name + " in the body");
+			if (candidate.writes[name] != 1) return candidate.reject(name + " is changed more than once");
+			if (count_reads(candidate.loop->body, name) != 1 || count_reads(candidate.loop->condition, name)) {
+				return candidate.reject(name + " is used by more than its own reduction");
+			}
+			return check_element_type(context.types[name], candidate);
+		}
+
+		// ?(a[i] < m) { m = a[i] } is a minimum, ?(a[i] > m) { m = a[i] } a maximum (and the same with <=, >= or swapped sides)
+		bool check_min_max(IfST* if_st, VectorCandidate& candidate, VectorizeContext& context) {
+			if (if_st->has_else || if_st->condition->type != AstType::OPERATION) return candidate.reject("it has an if that isn't a minimum or maximum");
+			ExpressionST* then_body = if_st->then_body;
+			if (then_body->type == AstType::BLOCK && static_cast<BlockST*>(then_body)->num_children == 1) then_body = static_cast<BlockST*>(then_body)->children[0];
+			if (then_body->type != AstType::VAR_ASSIGNMENT) return candidate.reject("it has an if that isn't a minimum or maximum");
+			VariableAssignST* assign_st = static_cast<VariableAssignST*>(then_body);
+			OperationST* op_st = static_cast<OperationST*>(if_st->condition);
+			ExpressionST* element = assign_st->value;
+			if (element->type != AstType::INDEX || !is_counter_index(static_cast<IndexST*>(element)->index, candidate)) {
+				return candidate.reject("only the minimum or maximum of a[i] is vectorized");
+			}
+			const std::string& array = static_cast<IndexST*>(element)->identifier;
+			auto is_element = [&](ExpressionST* side) {
+				return side->type == AstType::INDEX && !static_cast<IndexST*>(side)->identifier.compare(array) && is_counter_index(static_cast<IndexST*>(side)->index, candidate);
+			};
+			Operation op = op_st->op;
+			if (is_variable(op_st->lhs, assign_st->identifier) && is_element(op_st->rhs)) op = mirror_comparison(op);
+			else if (!is_element(op_st->lhs) || !is_variable(op_st->rhs, assign_st->identifier)) return candidate.reject("it has an if that isn't a minimum or maximum");
+			// Now the element is on the left: a[i] < m
+			VectorReduction reduction;
+			if (op == Operation::LT || op == Operation::LTE) reduction = VectorReduction::MIN;
+			else if (op == Operation::GT || op == Operation::GTE) reduction = VectorReduction::MAX;
+			else return candidate.reject("it has an if that isn't a minimum or maximum");
+			if (!check_reduction_variable(assign_st->identifier, candidate, context)) return false;
+			if (!check_vector_value(element, candidate, context)) return false;
+			Type t = candidate.plan->element_type;
+			if (get_type_size(t) == 8) return candidate.reject("there is no packed minimum or maximum of 64-bit elements");
+			if (!has_vector_min_max(t, vector_isa == VectorIsa::AVX2) && !can_select_min_max(t)) {
+				return candidate.reject(std::string("the minimum or maximum of ") + get_type_name(t) + " needs --vectorize=avx2");
+			}
+			candidate.plan->statements.push_back({ assign_st->identifier, reduction, element });
+			return true;
+		}
+
+		bool check_statement(ExpressionST* statement, VectorCandidate& candidate, VectorizeContext& context) {
+			switch (statement->type) {
+			case AstType::INDEX_ASSIGNMENT:
+			{
+				IndexAssignST* index_st = static_cast<IndexAssignST*>(statement);
+				if (!is_counter_index(index_st->index, candidate)) return candidate.reject(index_st->identifier + "[...] isn't indexed by " + candidate.plan->counter);
+				add_array(index_st->identifier, candidate);
+				candidate.stored.push_back(index_st->identifier);
+				if (!check_element_type(index_st->element_type, candidate) || !check_vector_value(index_st->value, candidate, context)) return false;
+				candidate.plan->statements.push_back({ index_st->identifier, VectorReduction::NONE, index_st->value });
+				return true;
+			}
+			case AstType::VAR_ASSIGNMENT:
+			{
+				// s = s + value, s = value + s or s = s - value
+				VariableAssignST* var_st = static_cast<VariableAssignST*>(statement);
+				const std::string& name = var_st->identifier;
+				if (var_st->value->type != AstType::OPERATION) return candidate.reject(name + " is assigned something that isn't a sum");
+				OperationST* op_st = static_cast<OperationST*>(var_st->value);
+				ExpressionST* value;
+				VectorReduction reduction = op_st->op == Operation::SUB ? VectorReduction::SUB : VectorReduction::ADD;
+				if ((op_st->op == Operation::ADD || op_st->op == Operation::SUB) && is_variable(op_st->lhs, name)) value = op_st->rhs;
+				else if (op_st->op == Operation::ADD && is_variable(op_st->rhs, name)) value = op_st->lhs;
+				else return candidate.reject(name + " is assigned something that isn't a sum");
+				if (!check_reduction_variable(name, candidate, context) || !check_vector_value(value, candidate, context)) return false;
+				candidate.plan->statements.push_back({ name, reduction, value });
+				return true;
+			}
+			case AstType::IF:
+				return check_min_max(static_cast<IfST*>(statement), candidate, context);
+			case AstType::LOOP:
+				return candidate.reject("it isn't an innermost loop");
+			default:
+				return candidate.reject("it has a statement that isn't a[i] = ..., a sum, a minimum or a maximum");
+			}
+		}
+
+		// |(i < bound) { statements, i = i + 1 }, where bound doesn't change in the loop
+		bool check_loop_shape(VectorCandidate& candidate, VectorizeContext& context) {
+			LoopST* loop_st = candidate.loop;
+			VectorLoop* plan = candidate.plan;
+			if (!loop_st->condition || loop_st->body->type != AstType::BLOCK) return candidate.reject("it isn't a counted loop");
+			BlockST* body = static_cast<BlockST*>(loop_st->body);
+			for (uint32_t i = 0; i < body->num_children; i++) {
+				if (body->children[i]->type == AstType::LOOP) return candidate.reject("it isn't an innermost loop");
+			}
+			if (loop_st->condition->type != AstType::OPERATION) return candidate.reject("its condition isn't i < bound");
+			OperationST* op_st = static_cast<OperationST*>(loop_st->condition);
+			ExpressionST* counter;
+			if (op_st->op == Operation::LT) { counter = op_st->lhs; plan->bound = op_st->rhs; }
+			else if (op_st->op == Operation::GT) { counter = op_st->rhs; plan->bound = op_st->lhs; }
+			else return candidate.reject("its condition isn't i < bound");
+			if (counter->type != AstType::VAR_VALUE) return candidate.reject("its condition isn't i < bound");
+			plan->counter = static_cast<VariableValST*>(counter)->identifier;
+
+			int64_t step = 0;
+			VariableValST* step_st = body->num_children ? get_induction_step(body->children[body->num_children - 1], candidate.writes, step) : NULL;
+			if (!step_st || step_st->identifier.compare(plan->counter) || step != 1) return candidate.reject("it doesn't end with " + plan->counter + " = " + plan->counter + " + 1");
+			if (body->num_children == 1) return candidate.reject("it only counts");
+
+			Type counter_type = context.types[plan->counter];
+			if (get_type_size(counter_type) < 4) return candidate.reject("its counter " + plan->counter + " is smaller than 32 bits");
+			ExpressionST* bound = plan->bound;
+			int64_t constant;
+			if (bound->type == AstType::LENGTH) {
+				if (!is_unsigned_integer_type(counter_type)) return candidate.reject("the signed counter " + plan->counter + " is compared with a length");
+			}
+			else if (bound->type == AstType::VAR_VALUE) {
+				const std::string& name = static_cast<VariableValST*>(bound)->identifier;
+				if (candidate.writes.count(name)) return candidate.reject("its bound " + name + " changes in the loop");
+				if (context.types[name] != counter_type) return candidate.reject("its bound " + name + " has another type than " + plan->counter);
+			}
+			else if (!get_constant_value(bound, constant)) return candidate.reject("its bound isn't a length, a variable or a constant");
+			else if (constant < 0 || constant > INT32_MAX) return candidate.reject("its bound " + std::to_string(constant) + " is out of range");
+			return true;
+		}
+
+		// Everything the vector loop does before it runs: the arrays that are too short for the bound run the scalar loop,
+		// so do arrays that overlap partly with one that is written
+		void check_arrays(VectorCandidate& candidate, VectorizeContext& context) {
+			VectorLoop* plan = candidate.plan;
+			int64_t constant = -1;
+			get_constant_value(plan->bound, constant);
+			for (const std::string& array : plan->arrays) {
+				if (plan->bound->type == AstType::LENGTH && !static_cast<LengthST*>(plan->bound)->identifier.compare(array)) continue;
+				auto length = context.lengths.find(array);
+				if (constant >= 0 && length != context.lengths.end() && constant <= length->second) continue;
+				plan->checked_lengths.push_back(array);
+			}
+			auto is_stored = [&](const std::string& array) {
+				for (const std::string& stored : candidate.stored) {
+					if (!stored.compare(array)) return true;
+				}
+				return false;
+			};
+			for (size_t i = 0; i < plan->arrays.size(); i++) {
+				for (size_t j = i + 1; j < plan->arrays.size(); j++) {
+					const std::string& lhs = plan->arrays[i];
+					const std::string& rhs = plan->arrays[j];
+					if (!is_stored(lhs) && !is_stored(rhs)) continue;
+					// Two arrays that aren't slices are never in the same memory
+					if (context.lengths.count(lhs) && context.lengths.count(rhs)) continue;
+					plan->overlaps.push_back(std::make_pair(lhs, rhs));
+				}
+			}
+		}
+
+		// Decides if a loop is vectorized. Returns NULL and sets reason if it isn't
+		VectorLoop* plan_vector_loop(LoopST* loop_st, VectorizeContext& context, std::string& reason) {
+			if (Profile::generate) {
+				reason = "--profile-generate counts its iterations";
+				return NULL;
+			}
+			if (vector_isa == VectorIsa::NONE) {
+				reason = "vectorization is off (--vectorize=none)";
+				return NULL;
+			}
+			VectorCandidate candidate;
+			candidate.loop = loop_st;
+			candidate.plan = new VectorLoop();
+			count_writes(loop_st->condition, candidate.writes);
+			count_writes(loop_st->body, candidate.writes);
+			bool vectorizable = check_loop_shape(candidate, context);
+			if (vectorizable) {
+				BlockST* body = static_cast<BlockST*>(loop_st->body);
+				for (uint32_t i = 0; vectorizable && i + 1 < body->num_children; i++) vectorizable = check_statement(body->children[i], candidate, context);
+			}
+			VectorLoop* plan = candidate.plan;
+			if (vectorizable && plan->arrays.empty()) vectorizable = candidate.reject("it doesn't access an array");
+			if (vectorizable) {
+				// Accumulators, broadcast invariants, then what the statements calculate. Minimum and maximum without the
+				// instruction need another register to select, the final reductions one to shift
+				bool avx2 = vector_isa == VectorIsa::AVX2;
+				uint32_t accumulators = 0;
+				uint32_t temporaries = 0;
+				for (VectorStatement& statement : plan->statements) {
+					uint32_t registers = get_vector_registers(statement.value, plan);
+					if (statement.reduction != VectorReduction::NONE) {
+						++accumulators;
+						uint32_t final_registers = 1;
+						if (statement.reduction == VectorReduction::MIN || statement.reduction == VectorReduction::MAX) {
+							if (!has_vector_min_max(plan->element_type, avx2)) ++registers;
+							if (!has_vector_min_max(plan->element_type, avx2)) ++final_registers;
+						}
+						if (final_registers > registers) registers = final_registers;
+					}
+					if (registers > temporaries) temporaries = registers;
+				}
+				uint32_t registers = accumulators + plan->invariants.size() + temporaries;
+				if (registers > NUM_VECTOR_REGISTERS) {
+					vectorizable = candidate.reject("it needs " + std::to_string(registers) + " vector registers, there are " + std::to_string(NUM_VECTOR_REGISTERS));
+				}
+			}
+			if (!vectorizable) {
+				reason = candidate.reason;
+				delete plan;
+				return NULL;
+			}
+			plan->width = vector_isa == VectorIsa::AVX2 ? 32 : 16;
+			check_arrays(candidate, context);
+			return plan;
+		}
+
+		void vectorize_loops(ExpressionST* expression, VectorizeContext& context) {
+			for_each_slot(expression, [&](ExpressionST*& slot) {
+				if (slot->type != AstType::LOOP) return false;
+				LoopST* loop_st = static_cast<LoopST*>(slot);
+				std::string where = "loop in " + context.function + " at line " + std::to_string(loop_st->line);
+				std::string reason;
+				loop_st->vector = plan_vector_loop(loop_st, context, reason);
+				if (loop_st->vector) {
+					VectorLoop* plan = loop_st->vector;
+					++context.vectorized;
+					Report::add_line("vectorize", "vectorized " + where + ", " + std::to_string(plan->width / get_type_size(plan->element_type)) + " x "
+						+ get_type_name(plan->element_type) + (plan->width == 32 ? " with avx2" : " with sse2"));
+				}
+				else {
+					++context.rejected;
+					Report::add_line("vectorize", "not vectorized " + where + ": " + reason);
+				}
+				return false;
+			});
+		}
+
+		// Finds the innermost counted loops over arrays that can run several elements at a time: element wise a[i] = ...,
+		// sums and minimums or maximums. Runs after the other passes, the assembler generates the vector code
+		VectorizeContext vectorize_loops(FunctionDefST* function) {
+			VectorizeContext context;
+			context.function = function->name;
+			context.types = collect_variable_types(function);
+			context.lengths = collect_array_lengths(function);
+			ExpressionST* body = function->statement;
+			vectorize_loops(body, context);
+			return context;
+		}
+	}
+}
@@ -1,6 +1,7 @@
 #pragma once
 #include <vector>
 #include <set>
+#include <map>
 
 #include "lexer/lexer.h"
 #include "lexer/token.h"
@@ -48,6 +49,34 @@ namespace Bonfire {
 
 		ExpressionST* parse_expression(std::vector<Token>& tokens, uint64_t& cursor, Type return_type);
 
+		// Functions of the program. Their signatures are parsed before any body, so a call can refer to a function defined further down
+		std::vector<FunctionDefST*> functions;
+
+		FunctionDefST* find_function(const std::string& name) {
+			for (FunctionDefST* function : functions) {
+				if (!function->name.compare(name)) return function;
+			}
+			return NULL;
+		}
+
+		// Arrays and slices of the function that is parsed, by name. Their element type is needed to parse a[i]
+		struct ArrayInfo {
+			Type element_type;
+			uint32_t length;	// 0 for slices
+		};
+		std::map<std::string, ArrayInfo> arrays;
+
+		// Types of the variables of the function that is parsed, by name. A variable reads as the type the parser expects
+		// where it is used, the balancing of operation trees needs the type it really has. Type::VOID if the name is
+		// declared more than once with different sizes
+		std::map<std::string, Type> variables;
+
+		void declare_variable(const std::string& name, Type type) {
+			auto variable = variables.find(name);
+			if (variable == variables.end()) variables[name] = type;
+			else if (get_type_size(variable->second) != get_type_size(type)) variable->second = Type::VOID;
+		}
+
 		Operation parse_operation(std::vector<Token>& tokens, uint64_t& cursor) {
 			++cursor;
 			// If the token at the cursor is an operation, it is only one token: We use a switch
@@ -62,17 +91,235 @@ namespace Bonfire {
 			case TokenType::POW: return Operation::POW;
 			case TokenType::EQUALS2: return Operation::EQ;
 			case TokenType::NEQUALS: return Operation::NEQ;
+			case TokenType::LT: return Operation::LT;
+			case TokenType::LTE: return Operation::LTE;
+			case TokenType::GT: return Operation::GT;
+			case TokenType::GTE: return Operation::GTE;
 			default:
 				--cursor;
 				return Operation::NONE;
 			}
 		}
 
+		// Binding strength of a binary operation, higher binds tighter
+		uint8_t get_precedence(Operation op) {
+			switch (op) {
+			case Operation::ORL:	return 1;
+			case Operation::ANDL:	return 2;
+			case Operation::EQ:
+			case Operation::NEQ:	return 3;
+			case Operation::LT:
+			case Operation::LTE:
+			case Operation::GT:
+			case Operation::GTE:	return 4;
+			case Operation::ADD:
+			case Operation::SUB:	return 5;
+			case Operation::MUL:
+			case Operation::DIV:
+			case Operation::MOD:	return 6;
+			case Operation::POW:	return 7;
+			default: return 0;
+			}
+		}
+
+		// a ^ b ^ c is a ^ (b ^ c), everything else groups from the left
+		bool is_right_associative(Operation op) {
+			return op == Operation::POW;
+		}
+
+		// Rebuilds the run of nodes (all with the same operation) over leaves[begin, end) as a balanced tree
+		ExpressionST* build_balanced(std::vector<OperationST*>& nodes, size_t& next_node, std::vector<ExpressionST*>& leaves, size_t begin, size_t end) {
+			if (end - begin == 1) return leaves[begin];
+			size_t middle = begin + (end - begin) / 2;
+			OperationST* node = nodes[next_node];
+			++next_node;
+			node->lhs = build_balanced(nodes, next_node, leaves, begin, middle);
+			node->rhs = build_balanced(nodes, next_node, leaves, middle, end);
+			node->return_type = get_op_result_type(node->op, node->lhs->return_type, node->rhs->return_type);
+			return node;
+		}
+
+		// Rebuilds a run of additions and subtractions over leaves[begin, end) as a balanced tree. negative[i] is true if
+		// leaves[i] is subtracted, flip negates all of them, the first leaf is added after the flip.
+		// a - b - c - d becomes (a - b) - (c + d): a subtracted right half adds what it subtracted before
+		ExpressionST* build_balanced_sum(std::vector<OperationST*>& nodes, size_t& next_node, std::vector<ExpressionST*>& leaves, std::vector<bool>& negative, size_t begin, size_t end, bool flip) {
+			if (end - begin == 1) return leaves[begin];
+			size_t middle = begin + (end - begin) / 2;
+			OperationST* node = nodes[next_node];
+			++next_node;
+			bool subtract = negative[middle] != flip;
+			node->op = subtract ? Operation::SUB : Operation::ADD;
+			node->lhs = build_balanced_sum(nodes, next_node, leaves, negative, begin, middle, flip);
+			node->rhs = build_balanced_sum(nodes, next_node, leaves, negative, middle, end, flip != subtract);
+			node->return_type = get_op_result_type(node->op, node->lhs->return_type, node->rhs->return_type);
+			return node;
+		}
+
+		// Size of the register the value of an integer type is calculated in, 0 if it isn't known
+		uint32_t get_register_size(Type type) {
+			if (!is_integer_type(type)) return 0;
+			return get_type_size(type) == 8 ? 8 : 4;
+		}
+
+		// Size of the register the value of an expression ends up in: operations are calculated as wide as their widest
+		// operand. 0 if it isn't known
+		uint32_t get_register_size(ExpressionST* expression) {
+			uint32_t size = 4;
+			std::vector<ExpressionST*> pending = { expression };
+			while (!pending.empty()) {
+				ExpressionST* e = pending.back();
+				pending.pop_back();
+				uint32_t e_size = 0;
+				switch (e->type) {
+				case AstType::OPERATION: {
+					OperationST* op_st = static_cast<OperationST*>(e);
+					// Comparisons and logical operations are 0 or 1
+					if (is_comparison(op_st->op) || op_st->op == Operation::ANDL || op_st->op == Operation::ORL) continue;
+					pending.push_back(op_st->lhs);
+					pending.push_back(op_st->rhs);
+					continue;
+				}
+				case AstType::VAR_VALUE: {
+					auto variable = variables.find(static_cast<VariableValST*>(e)->identifier);
+					if (variable != variables.end()) e_size = get_register_size(variable->second);
+					break;
+				}
+				case AstType::INDEX: e_size = get_register_size(static_cast<IndexST*>(e)->element_type); break;
+				case AstType::LENGTH: e_size = 4; break;
+				case AstType::FUNCTION_CALL: e_size = get_register_size(static_cast<FunctionCallST*>(e)->function->return_type); break;
+				case AstType::CONSTANT:
+				case AstType::BLOCK:
+				case AstType::IF:
+				case AstType::MATCH: e_size = get_register_size(e->return_type); break;
+				default: break;
+				}
+				if (!e_size) return 0;
+				if (e_size > size) size = e_size;
+			}
+			return size;
+		}
+
+		// Regrouping changes which operands are calculated together. That only keeps the value if every operand is
+		// calculated in a register of the same size, otherwise a + b could be cut to 32 bits where it was 64 before
+		bool same_register_size(std::vector<ExpressionST*>& leaves) {
+			uint32_t size = get_register_size(leaves[0]);
+			if (!size) return false;
+			for (ExpressionST* leaf : leaves) {
+				if (get_register_size(leaf) != size) return false;
+			}
+			return true;
+		}
+
+		// Regroups runs of the same associative operation (a + b + c + d) into balanced trees ((a + b) + (c + d)),
+		// so the depth of an operation tree grows with log n instead of n. Runs of additions and subtractions are
+		// regrouped too (a - b - c - d as (a - b) - (c + d)), the operands keep their order. The nodes are reused in place
+		void balance_op_tree(ExpressionST* root) {
+			std::vector<OperationST*> work;
+			if (root->type == AstType::OPERATION) work.push_back(static_cast<OperationST*>(root));
+
+			while (!work.empty()) {
+				OperationST* chain = work.back();
+				work.pop_back();
+				bool sum = chain->op == Operation::ADD || chain->op == Operation::SUB;
+
+				// Collect the leaves of the run from left to right, and for sums if they are subtracted
+				std::vector<OperationST*> nodes;
+				std::vector<ExpressionST*> leaves;
+				std::vector<bool> negative;
+				std::vector<std::pair<ExpressionST*, bool>> pending = { { chain, false } };
+				while (!pending.empty()) {
+					ExpressionST* e = pending.back().first;
+					bool subtracted = pending.back().second;
+					pending.pop_back();
+					OperationST* op_st = static_cast<OperationST*>(e);
+					bool in_run = e->type == AstType::OPERATION && (op_st == chain
+						|| (sum && (op_st->op == Operation::ADD || op_st->op == Operation::SUB))
+						|| (op_st->op == chain->op && is_associative(chain->op)));
+					if (in_run) {
+						nodes.push_back(op_st);
+						pending.push_back({ op_st->rhs, subtracted != (op_st->op == Operation::SUB) });
+						pending.push_back({ op_st->lhs, subtracted });
+					}
+					else {
+						leaves.push_back(e);
+						negative.push_back(subtracted);
+					}
+				}
+
+				// Logical operations are 0 or 1 whatever their operands are
+				bool arithmetic = chain->op != Operation::ANDL && chain->op != Operation::ORL;
+				if (leaves.size() > 2 && (!arithmetic || same_register_size(leaves))) {
+					size_t next_node = 0;
+					if (sum) build_balanced_sum(nodes, next_node, leaves, negative, 0, leaves.size(), false);
+					else build_balanced(nodes, next_node, leaves, 0, leaves.size());
+				}
+
+				for (ExpressionST* leaf : leaves) {
+					if (leaf->type == AstType::OPERATION) work.push_back(static_cast<OperationST*>(leaf));
+				}
+			}
+		}
+
+		ExpressionST* parse_operand(std::vector<Token>& tokens, uint64_t& cursor, Type expected_type);
+
 		// Looks through the whole operation sequence (expression, operator, expression, operator etc.)
-		// Returns an ordered Operation tree
-		// TODO: Implement with ()
-		OperationST* parse_op_sequence(std::vector<Token>& tokens, uint64_t& cursor, Type expected_type) {
-			return NULL;
+		// Returns an ordered Operation tree, or the single operand if there is no operation
+		// Works with explicit stacks (precedence climbing), so long sequences don't use up the native stack
+		ExpressionST* parse_op_sequence(std::vector<Token>& tokens, uint64_t& cursor, Type expected_type) {
+			std::vector<ExpressionST*> operands;
+			std::vector<Operation> operators; // Operation::NONE marks an open parenthesis
+			uint32_t open_pars = 0;
+
+			// Combine the top two operands with the top operator
+			auto reduce = [&]() {
+				ExpressionST* rhs = operands.back();
+				operands.pop_back();
+				ExpressionST* lhs = operands.back();
+				operands.pop_back();
+				OperationST* op_st = new OperationST(operators.back(), lhs, rhs);
+				op_st->line = lhs->line;
+				operands.push_back(op_st);
+				operators.pop_back();
+			};
+
+			while (1) {
+				// Operand: any number of '(' followed by one expression
+				while (cursor < tokens.size() && tokens[cursor].type == TokenType::PAR_OPEN) {
+					operators.push_back(Operation::NONE);
+					++open_pars;
+					++cursor;
+				}
+				if (cursor >= tokens.size()) throw unexpected_token(tokens.size() - 1);
+				// A '}' is only allowed where a whole expression could start
+				if ((!operands.empty() || open_pars > 0) && tokens[cursor].type == TokenType::BRACE_CLOSE) throw unexpected_token(cursor);
+				operands.push_back(parse_operand(tokens, cursor, expected_type));
+
+				// Close the parentheses that were opened inside this sequence. Any other ')' belongs to the parent (e.g. ?(...))
+				while (open_pars > 0 && cursor < tokens.size() && tokens[cursor].type == TokenType::PAR_CLOSE) {
+					while (operators.back() != Operation::NONE) reduce();
+					operators.pop_back();
+					--open_pars;
+					++cursor;
+				}
+
+				if (cursor >= tokens.size()) break;
+				Operation op = parse_operation(tokens, cursor);
+				if (op == Operation::NONE) break;
+
+				// Everything on the stack that binds at least as tight as op has to be combined first
+				uint8_t precedence = get_precedence(op);
+				while (!operators.empty() && operators.back() != Operation::NONE) {
+					uint8_t top_precedence = get_precedence(operators.back());
+					if (top_precedence < precedence || (top_precedence == precedence && is_right_associative(op))) break;
+					reduce();
+				}
+				operators.push_back(op);
+			}
+			if (open_pars > 0) throw unexpected_token(cursor < tokens.size() ? cursor : tokens.size() - 1);
+
+			while (!operators.empty()) reduce();
+			balance_op_tree(operands.back());
+			return operands.back();
 		}
 
 		ConstantST* parse_constant(std::vector<Token>& tokens, uint64_t& cursor, Type expected_type) {
@@ -128,6 +375,89 @@ namespace Bonfire {
 			throw parse_exception();
 		}
 
+		// a or a[begin..end], where a slice of the elements of a is expected
+		SliceST* parse_slice(std::vector<Token>& tokens, uint64_t& cursor, Type element_type) {
+			if (cursor + 1 >= tokens.size() || tokens[cursor].type != TokenType::IDENTIFIER) throw unexpected_token(cursor < tokens.size() ? cursor : tokens.size() - 1);
+			auto array = arrays.find(tokens[cursor].value);
+			if (array == arrays.end() || array->second.element_type != element_type) throw unexpected_token(cursor);
+			std::string identifier = tokens[cursor].value;
+			uint32_t line = tokens[cursor].line;
+			++cursor;
+			SliceST* slice_st;
+			if (tokens[cursor].type != TokenType::BRACKET_OPEN) {
+				// The whole array
+				slice_st = new SliceST(identifier, element_type, new ConstantST(Type::INT32, "0"), new LengthST(identifier, Type::UINT32));
+				slice_st->line = line;
+				return slice_st;
+			}
+			++cursor;
+			ExpressionST* begin = parse_expression(tokens, cursor, Type::INT32);
+			if (cursor + 1 >= tokens.size() || tokens[cursor].type != TokenType::DOT2) throw unexpected_token(cursor < tokens.size() ? cursor : tokens.size() - 1);
+			++cursor;
+			ExpressionST* end = parse_expression(tokens, cursor, Type::INT32);
+			if (cursor >= tokens.size() || tokens[cursor].type != TokenType::BRACKET_CLOSE) throw unexpected_token(cursor < tokens.size() ? cursor : tokens.size() - 1);
+			++cursor;
+			slice_st = new SliceST(identifier, element_type, begin, end);
+			slice_st->line = line;
+			return slice_st;
+		}
+
+		// a[index] or a[index] = value
+		ExpressionST* parse_index(std::vector<Token>& tokens, uint64_t& cursor, Type expected_type) {
+			if (cursor + 3 >= tokens.size() || tokens[cursor].type != TokenType::IDENTIFIER || tokens[cursor + 1].type != TokenType::BRACKET_OPEN) throw parse_exception();
+			auto array = arrays.find(tokens[cursor].value);
+			if (array == arrays.end()) throw unexpected_token(cursor);
+			std::string identifier = tokens[cursor].value;
+			Type element_type = array->second.element_type;
+			cursor += 2;
+			ExpressionST* index = parse_expression(tokens, cursor, Type::INT32);
+			if (cursor >= tokens.size() || tokens[cursor].type != TokenType::BRACKET_CLOSE) throw unexpected_token(cursor < tokens.size() ? cursor : tokens.size() - 1);
+			++cursor;
+			if (cursor + 1 < tokens.size() && tokens[cursor].type == TokenType::EQUALS) {
+				++cursor;
+				return new IndexAssignST(identifier, element_type, index, parse_expression(tokens, cursor, element_type));
+			}
+			return new IndexST(identifier, element_type, index, expected_type);
+		}
+
+		// len(a), unless the program has a function called len
+		LengthST* parse_length(std::vector<Token>& tokens, uint64_t& cursor, Type expected_type) {
+			if (cursor + 3 >= tokens.size() || tokens[cursor].type != TokenType::IDENTIFIER || tokens[cursor].value.compare("len")
+				|| tokens[cursor + 1].type != TokenType::PAR_OPEN || find_function("len")) throw parse_exception();
+			if (tokens[cursor + 2].type != TokenType::IDENTIFIER || !arrays.count(tokens[cursor + 2].value)) throw unexpected_token(cursor + 2);
+			if (tokens[cursor + 3].type != TokenType::PAR_CLOSE) throw unexpected_token(cursor + 3);
+			LengthST* length_st = new LengthST(tokens[cursor + 2].value, expected_type);
+			cursor += 4;
+			return length_st;
+		}
+
+		// name(argument, argument, ...)
+		FunctionCallST* parse_function_call(std::vector<Token>& tokens, uint64_t& cursor) {
+			if (cursor + 2 >= tokens.size()) throw parse_exception();
+			if (tokens[cursor].type == TokenType::IDENTIFIER && tokens[cursor + 1].type == TokenType::PAR_OPEN) {
+				uint64_t name_cursor = cursor;
+				FunctionDefST* function = find_function(tokens[cursor].value);
+				if (!function) throw unexpected_token(name_cursor);
+				cursor += 2;
+
+				std::vector<ExpressionST*> arguments;
+				while (tokens[cursor].type != TokenType::PAR_CLOSE) {
+					if (arguments.size() == function->parameters.size()) throw unexpected_token(cursor);
+					const ParameterDef& parameter = function->parameters[arguments.size()];
+					// Arguments are calculated in the type of their parameter
+					if (parameter.slice) arguments.push_back(parse_slice(tokens, cursor, parameter.type));
+					else arguments.push_back(parse_expression(tokens, cursor, parameter.type));
+					if (cursor >= tokens.size()) throw unexpected_token(tokens.size() - 1);
+					if (tokens[cursor].type == TokenType::COMMA) ++cursor;
+					else if (tokens[cursor].type != TokenType::PAR_CLOSE) throw unexpected_token(cursor);
+				}
+				++cursor;
+				if (arguments.size() != function->parameters.size()) throw unexpected_token(name_cursor);
+				return new FunctionCallST(function, arguments, function->return_type);
+			}
+			throw parse_exception();
+		}
+
 		LoopST* parse_loop(std::vector<Token>& tokens, uint64_t& cursor, Type expected_type) {
 			if (cursor + 3 >= tokens.size()) throw parse_exception();
 			if (tokens[cursor].type == TokenType::OR) { // | TODO: Change name
@@ -142,6 +472,11 @@ namespace Bonfire {
 						return loop_st;
 					}
 				}
+				else {
+					// Loop without condition: | { ... } runs until something returns
+					ExpressionST* body = parse_expression(tokens, cursor, Type::VOID);
+					return new LoopST(NULL, body);
+				}
 			}
 			throw parse_exception();
 		}
@@ -173,6 +508,58 @@ namespace Bonfire {
 			throw parse_exception();
 		}
 
+		// ??(value) { 1 -> expression, 2 | 3 -> expression, : expression }
+		// The values of the arms are integer constants that fit into 32 bits, every value can only be in one arm.
+		// The default after : is optional for matches without a type
+		MatchST* parse_match(std::vector<Token>& tokens, uint64_t& cursor, Type expected_type) {
+			if (cursor + 3 >= tokens.size() || tokens[cursor].type != TokenType::MATCH) throw parse_exception();
+			uint64_t match_cursor = cursor;
+			++cursor;
+			if (tokens[cursor].type != TokenType::PAR_OPEN) throw unexpected_token(cursor);
+			++cursor;
+			ExpressionST* value = parse_expression(tokens, cursor, Type::INT32);
+			if (cursor + 1 >= tokens.size() || tokens[cursor].type != TokenType::PAR_CLOSE) throw unexpected_token(cursor);
+			++cursor;
+			if (tokens[cursor].type != TokenType::BRACE_OPEN) throw unexpected_token(cursor);
+			++cursor;
+
+			std::vector<MatchArm> arms;
+			std::set<int64_t> seen;
+			ExpressionST* default_body = NULL;
+			while (cursor < tokens.size() && tokens[cursor].type != TokenType::BRACE_CLOSE) {
+				if (tokens[cursor].type == TokenType::COLON) {
+					if (default_body) throw unexpected_token(cursor);
+					++cursor;
+					default_body = parse_expression(tokens, cursor, expected_type);
+				}
+				else {
+					std::vector<int64_t> values;
+					while (1) {
+						bool negative = cursor + 1 < tokens.size() && tokens[cursor].type == TokenType::MINUS;
+						if (negative) ++cursor;
+						if (cursor >= tokens.size() || tokens[cursor].type != TokenType::CONSTANT) throw unexpected_token(cursor < tokens.size() ? cursor : tokens.size() - 1);
+						int64_t case_value = strtoll(tokens[cursor].value.c_str(), NULL, 10);
+						if (negative) case_value = -case_value;
+						if (case_value < INT32_MIN || case_value > INT32_MAX || !seen.insert(case_value).second) throw unexpected_token(cursor);
+						values.push_back(case_value);
+						++cursor;
+						if (cursor >= tokens.size() || tokens[cursor].type != TokenType::OR) break;
+						++cursor;
+					}
+					if (cursor >= tokens.size() || tokens[cursor].type != TokenType::RETURN_TYPE) throw unexpected_token(cursor < tokens.size() ? cursor : tokens.size() - 1);
+					++cursor;
+					arms.push_back(MatchArm(values, parse_expression(tokens, cursor, expected_type)));
+				}
+				if (cursor < tokens.size() && tokens[cursor].type == TokenType::COMMA) ++cursor;
+				else if (cursor < tokens.size() && tokens[cursor].type != TokenType::BRACE_CLOSE) throw unexpected_token(cursor);
+			}
+			if (cursor >= tokens.size()) throw unexpected_token(tokens.size() - 1);
+			++cursor;
+			// A match with a value needs one in every case
+			if (expected_type != Type::VOID && !default_body) throw unexpected_token(match_cursor);
+			return new MatchST(value, arms, default_body, expected_type);
+		}
+
 		VariableDeclarationST* parse_variable_declaration(std::vector<Token>& tokens, uint64_t& cursor) {
 			if (cursor + 4 >= tokens.size()) throw parse_exception();
 			if (tokens[cursor].type == TokenType::IDENTIFIER) {
@@ -186,11 +573,16 @@ namespace Bonfire {
 						++cursor;
 						if (tokens[cursor].type == TokenType::EQUALS) {
 							++cursor;
+							uint64_t expression_cursor = cursor;
 							// This is the expression, we have to assign the variable to
 							ExpressionST* expression = parse_expression(tokens, cursor, var_type);
-							if (expression->return_type != var_type) { throw parse_exception(); }
+							// Integers of other types (calls, blocks) are extended or cut to the variable when they are stored,
+							// like variables of other types are
+							bool integers = is_integer_type(var_type) && is_integer_type(expression->return_type);
+							if (expression->return_type != var_type && !integers) throw unexpected_token(expression_cursor);
 
 							VariableDeclarationST* var_st = new VariableDeclarationST(var_name, var_type, expression);
+							declare_variable(var_name, var_type);
 							return var_st;
 						}
 					}
@@ -199,10 +591,50 @@ namespace Bonfire {
 			throw parse_exception();
 		}
 
+		// a: [T; N] (stack), a: static [T; N] (data of the program, keeps its elements between calls) or s: [T] = a[begin..end]
+		ArrayDeclarationST* parse_array_declaration(std::vector<Token>& tokens, uint64_t& cursor) {
+			if (cursor + 5 >= tokens.size() || tokens[cursor].type != TokenType::IDENTIFIER || tokens[cursor + 1].type != TokenType::COLON) throw parse_exception();
+			std::string var_name = tokens[cursor].value;
+			cursor += 2;
+			bool is_static = tokens[cursor].type == TokenType::IDENTIFIER && !tokens[cursor].value.compare("static");
+			if (is_static) ++cursor;
+			if (tokens[cursor].type != TokenType::BRACKET_OPEN) {
+				if (is_static) throw unexpected_token(cursor);
+				throw parse_exception();
+			}
+			++cursor;
+			if (cursor + 2 >= tokens.size() || tokens[cursor].type != TokenType::IDENTIFIER) throw unexpected_token(cursor);
+			Type element_type = parse_type(tokens[cursor].value);
+			if (element_type == Type::VOID) throw unexpected_token(cursor);
+			++cursor;
+
+			ArrayDeclarationST* array_st;
+			if (tokens[cursor].type == TokenType::SEMICOLON) {
+				++cursor;
+				if (cursor + 1 >= tokens.size() || tokens[cursor].type != TokenType::CONSTANT) throw unexpected_token(cursor);
+				// The elements are addressed with 32-bit displacements
+				uint64_t length = strtoull(tokens[cursor].value.c_str(), NULL, 10);
+				if (!length || length > INT32_MAX / get_type_size(element_type)) throw unexpected_token(cursor);
+				++cursor;
+				if (tokens[cursor].type != TokenType::BRACKET_CLOSE) throw unexpected_token(cursor);
+				++cursor;
+				array_st = new ArrayDeclarationST(var_name, element_type, (uint32_t)length, is_static);
+			}
+			else {
+				if (is_static || tokens[cursor].type != TokenType::BRACKET_CLOSE) throw unexpected_token(cursor);
+				++cursor;
+				if (cursor + 1 >= tokens.size() || tokens[cursor].type != TokenType::EQUALS) throw unexpected_token(cursor);
+				++cursor;
+				array_st = new ArrayDeclarationST(var_name, element_type, parse_slice(tokens, cursor, element_type));
+			}
+			arrays[var_name] = { element_type, array_st->length };
+			return array_st;
+		}
+
 		BlockST* parse_code_block(std::vector<Token>& tokens, uint64_t& cursor, Type return_type);
 
-		// Parses exactly one ST
-		ExpressionST* parse_expression(std::vector<Token>& tokens, uint64_t& cursor, Type return_type) {
+		// Parses exactly one ST, without operations
+		ExpressionST* parse_operand(std::vector<Token>& tokens, uint64_t& cursor, Type return_type) {
 			uint64_t start_cursor = cursor; // We have to reset the cursor everytime the parser fails to parse
 			ExpressionST* expression;
 			try {
@@ -221,22 +653,52 @@ namespace Bonfire {
 					catch (const parse_exception) {
 						cursor = start_cursor;
 						try {
-							expression = parse_loop(tokens, cursor, return_type);
+							try {
+								expression = parse_match(tokens, cursor, return_type);
+							}
+							catch (const parse_exception) {
+								cursor = start_cursor;
+								expression = parse_loop(tokens, cursor, return_type);
+							}
 						}
 						catch (const parse_exception) {
 							cursor = start_cursor;
 							try {
-								expression = parse_variable_declaration(tokens, cursor);
+								try {
+									expression = parse_variable_declaration(tokens, cursor);
+								}
+								catch (const parse_exception) {
+									cursor = start_cursor;
+									expression = parse_array_declaration(tokens, cursor);
+								}
 							}
 							catch (const parse_exception) {
 								cursor = start_cursor;
 								try {
-									expression = parse_variable_assignment(tokens, cursor, return_type);
+									try {
+										expression = parse_length(tokens, cursor, return_type);
+									}
+									catch (const parse_exception) {
+										cursor = start_cursor;
+										try {
+											expression = parse_function_call(tokens, cursor);
+										}
+										catch (const parse_exception) {
+											cursor = start_cursor;
+											expression = parse_variable_assignment(tokens, cursor, return_type);
+										}
+									}
 								}
 								catch (const parse_exception) {
 									cursor = start_cursor;
 									try {
-										expression = parse_variable_value(tokens, cursor, return_type);
+										try {
+											expression = parse_index(tokens, cursor, return_type);
+										}
+										catch (const parse_exception) {
+											cursor = start_cursor;
+											expression = parse_variable_value(tokens, cursor, return_type);
+										}
 									}
 									catch (const parse_exception) {
 										cursor = start_cursor;
@@ -257,18 +719,16 @@ namespace Bonfire {
 					}
 				}
 			}
-			// Check for operations
-			Operation op = parse_operation(tokens, cursor);
-			if (op != Operation::NONE) {
-				// There is an operation. expression is lhs
-				ExpressionST* expression_rhs = parse_expression(tokens, cursor, return_type);
-				OperationST* operation = new OperationST(op, expression, expression_rhs);
-				return operation;
-			}
-			// There is no operation, return expression
+			// Statements and values start at their first token
+			if (!expression->line) expression->line = tokens[start_cursor].line;
 			return expression;
 		}
 
+		// Parses exactly one ST, including the operations that follow it
+		ExpressionST* parse_expression(std::vector<Token>& tokens, uint64_t& cursor, Type return_type) {
+			return parse_op_sequence(tokens, cursor, return_type);
+		}
+
 		BlockST* parse_code_block(std::vector<Token>& tokens, uint64_t& cursor, Type return_type) {
 			Type block_type = return_type;
 			if (tokens[cursor].type == TokenType::RETURN_TYPE) {
@@ -328,27 +788,99 @@ namespace Bonfire {
 			throw parse_exception();
 		}
 
-		FunctionDefST* parse_function(std::vector<Token>& tokens, uint64_t& cursor) {
-			if (tokens[cursor].type == TokenType::IDENTIFIER) {
+		// name(parameter: type, ...) followed by the body. The cursor is left at the body
+		FunctionDefST* parse_function_signature(std::vector<Token>& tokens, uint64_t& cursor) {
+			if (cursor + 2 < tokens.size() && tokens[cursor].type == TokenType::IDENTIFIER) {
+				uint64_t name_cursor = cursor;
 				std::string name = tokens[cursor].value;
 				++cursor;
 				if (tokens[cursor].type == TokenType::PAR_OPEN) {
 					++cursor;
-					if (tokens[cursor].type == TokenType::PAR_CLOSE) {
+					std::vector<ParameterDef> parameters;
+					while (cursor + 3 < tokens.size() && tokens[cursor].type != TokenType::PAR_CLOSE) {
+						if (tokens[cursor].type != TokenType::IDENTIFIER || tokens[cursor + 1].type != TokenType::COLON) throw unexpected_token(cursor);
+						// xs: [T]
+						if (tokens[cursor + 2].type == TokenType::BRACKET_OPEN) {
+							if (cursor + 5 >= tokens.size() || tokens[cursor + 3].type != TokenType::IDENTIFIER || tokens[cursor + 4].type != TokenType::BRACKET_CLOSE) {
+								throw unexpected_token(cursor + 2);
+							}
+							Type element_type = parse_type(tokens[cursor + 3].value);
+							if (element_type == Type::VOID) throw unexpected_token(cursor + 3);
+							parameters.push_back(ParameterDef(tokens[cursor].value, element_type, true));
+							cursor += 5;
+							if (tokens[cursor].type == TokenType::COMMA) ++cursor;
+							else if (tokens[cursor].type != TokenType::PAR_CLOSE) throw unexpected_token(cursor);
+							continue;
+						}
+						if (tokens[cursor + 2].type != TokenType::IDENTIFIER) throw unexpected_token(cursor);
+						Type type = parse_type(tokens[cursor + 2].value);
+						if (type == Type::VOID) throw unexpected_token(cursor + 2);
+						parameters.push_back(ParameterDef(tokens[cursor].value, type));
+						cursor += 3;
+						if (tokens[cursor].type == TokenType::COMMA) ++cursor;
+						else if (tokens[cursor].type != TokenType::PAR_CLOSE) throw unexpected_token(cursor);
+					}
+					if (cursor + 1 < tokens.size() && tokens[cursor].type == TokenType::PAR_CLOSE) {
 						++cursor;
-						// Token at cursor is now '{', the beginning of the code, parse the code block
-						return new FunctionDefST(name, parse_code_block(tokens, cursor));
+						// -> type, the body is parsed from here on (see parse_code_block)
+						Type return_type = Type::VOID;
+						if (tokens[cursor].type == TokenType::RETURN_TYPE && cursor + 1 < tokens.size()) {
+							return_type = parse_type(tokens[cursor + 1].value);
+						}
+						FunctionDefST* function = new FunctionDefST(name, parameters, return_type);
+						function->line = tokens[name_cursor].line;
+						return function;
 					}
 				}
 			}
-			throw unexpected_token(cursor);
+			throw unexpected_token(cursor < tokens.size() ? cursor : tokens.size() - 1);
+		}
+
+		// Moves the cursor behind the body of a function, without parsing it
+		void skip_function_body(std::vector<Token>& tokens, uint64_t& cursor) {
+			while (cursor < tokens.size() && tokens[cursor].type != TokenType::BRACE_OPEN) ++cursor;
+			uint32_t depth = 0;
+			while (cursor < tokens.size()) {
+				if (tokens[cursor].type == TokenType::BRACE_OPEN) ++depth;
+				else if (tokens[cursor].type == TokenType::BRACE_CLOSE && --depth == 0) {
+					++cursor;
+					return;
+				}
+				++cursor;
+			}
+			throw unexpected_token(tokens.size() - 1);
 		}
 
 		static ProgramST* parse(std::vector<Token>& tokens) {
+			functions.clear();
+
+			// First, get the signature of every function
+			std::vector<uint64_t> body_cursors;
 			uint64_t cursor = 0;
+			while (cursor < tokens.size()) {
+				uint64_t name_cursor = cursor;
+				FunctionDefST* function = parse_function_signature(tokens, cursor);
+				if (find_function(function->name)) throw unexpected_token(name_cursor);
+				functions.push_back(function);
+				body_cursors.push_back(cursor);
+				skip_function_body(tokens, cursor);
+			}
 
-			// First thing we expect is a function
-			return new ProgramST(parse_function(tokens, cursor));
+			// Then parse the bodies
+			FunctionDefST* main = NULL;
+			for (size_t i = 0; i < functions.size(); i++) {
+				cursor = body_cursors[i];
+				arrays.clear();
+				variables.clear();
+				for (ParameterDef& parameter : functions[i]->parameters) {
+					if (parameter.slice) arrays[parameter.identifier] = { parameter.type, 0 };
+					else declare_variable(parameter.identifier, parameter.type);
+				}
+				functions[i]->statement = parse_code_block(tokens, cursor);
+				if (!functions[i]->name.compare("main")) main = functions[i];
+			}
+			if (!main) throw unexpected_token(tokens.size() - 1);
+			return new ProgramST(functions, main);
 		}
 	}
 }
\ No newline at end of file
@@ -14,7 +14,7 @@ namespace Bonfire {
 			for (std::string line; std::getline(iss, line);) {
 				size_t c_pos = line.find("//");
 				if (c_pos != std::string::npos) {
-					line.erase(c_pos, line.size() - 1);
+					line.erase(c_pos);
 				}
 				result += line;
 				result += "\n";
@@ -0,0 +1,121 @@
+#pragma once
+#include <string>
+#include <sstream>
+#include <vector>
+
+#include "profile/runtime.h"
+#include "ast.h"
+
+namespace Bonfire {
+	namespace Profile {
+
+		// --instrument=functions: every function calls a hook after setting up its frame and before closing it
+		bool instrument_functions = false;
+
+		// The hooks keep every register, so they can run between any two instructions. They change the flags
+		std::string get_enter_hook(const std::string& function) {
+			return "__bonfire_enter_" + function;
+		}
+
+		std::string get_exit_hook(const std::string& function) {
+			return "__bonfire_exit_" + function;
+		}
+
+		// Timing with rdtsc and the table printed at exit. Recursive calls only count once into the inclusive cycles,
+		// the cycles of a call go to the exclusive cycles of the function minus what its callees took
+		const char* const INSTRUMENT_RUNTIME_CODE = R"(
+struct __bonfire_frame { uint64_t start; uint64_t callees; };
+static struct __bonfire_frame __bonfire_frames[__BONFIRE_MAX_FRAMES];
+static unsigned __bonfire_depth;
+
+/* The hooks only use general registers, so they don't have to save the vector registers either */
+#define __BONFIRE_HOOK __attribute__((no_caller_saved_registers, target("general-regs-only"), used))
+#define __BONFIRE_INLINE static inline __attribute__((always_inline, target("general-regs-only")))
+
+__BONFIRE_INLINE void __bonfire_enter(unsigned function) {
+	struct __bonfire_function_stats* stats = &__bonfire_stats[function];
+	++stats->calls;
+	if (++stats->depth > stats->max_depth) stats->max_depth = stats->depth;
+	/* Deeper calls are counted, but their cycles go to the deepest frame that is timed */
+	if (__bonfire_depth++ < __BONFIRE_MAX_FRAMES) {
+		struct __bonfire_frame* frame = &__bonfire_frames[__bonfire_depth - 1];
+		frame->callees = 0;
+		frame->start = __rdtsc();
+	}
+}
+
+__BONFIRE_INLINE void __bonfire_exit(unsigned function) {
+	uint64_t end = __rdtsc();
+	struct __bonfire_function_stats* stats = &__bonfire_stats[function];
+	--stats->depth;
+	if (--__bonfire_depth >= __BONFIRE_MAX_FRAMES) return;
+	struct __bonfire_frame* frame = &__bonfire_frames[__bonfire_depth];
+	uint64_t cycles = end - frame->start;
+	stats->exclusive += cycles - frame->callees;
+	if (!stats->depth) stats->inclusive += cycles;
+	if (__bonfire_depth) __bonfire_frames[__bonfire_depth - 1].callees += cycles;
+}
+
+static int __bonfire_compare_stats(const void* a, const void* b) {
+	uint64_t lhs = ((const struct __bonfire_function_stats*)a)->exclusive;
+	uint64_t rhs = ((const struct __bonfire_function_stats*)b)->exclusive;
+	return lhs < rhs ? 1 : lhs > rhs ? -1 : 0;
+}
+
+/* Sorted by exclusive cycles. BONFIRE_INSTRUMENT=<file> writes CSV into the file instead of the table on stderr */
+__attribute__((destructor)) static void __bonfire_write_stats(void) {
+	struct __bonfire_function_stats sorted[__BONFIRE_NUM_FUNCTIONS];
+	uint64_t total = 0;
+	memcpy(sorted, __bonfire_stats, sizeof(sorted));
+	qsort(sorted, __BONFIRE_NUM_FUNCTIONS, sizeof(sorted[0]), __bonfire_compare_stats);
+	for (unsigned i = 0; i < __BONFIRE_NUM_FUNCTIONS; i++) total += sorted[i].exclusive;
+
+	const char* path = getenv("BONFIRE_INSTRUMENT");
+	if (path && *path) {
+		FILE* file = fopen(path, "w");
+		if (!file) {
+			fprintf(stderr, "Can't write the function statistics %s\n", path);
+			return;
+		}
+		fprintf(file, "function,calls,inclusive_cycles,exclusive_cycles,max_depth\n");
+		for (unsigned i = 0; i < __BONFIRE_NUM_FUNCTIONS; i++) {
+			fprintf(file, "%s,%llu,%llu,%llu,%u\n", sorted[i].name, (unsigned long long)sorted[i].calls,
+				(unsigned long long)sorted[i].inclusive, (unsigned long long)sorted[i].exclusive, sorted[i].max_depth);
+		}
+		fclose(file);
+		return;
+	}
+	fprintf(stderr, "%-24s %12s %18s %18s %7s %9s\n", "function", "calls", "inclusive cycles", "exclusive cycles", "excl %", "max depth");
+	for (unsigned i = 0; i < __BONFIRE_NUM_FUNCTIONS; i++) {
+		if (!sorted[i].calls) continue;
+		fprintf(stderr, "%-24s %12llu %18llu %18llu %6.1f%% %9u\n", sorted[i].name, (unsigned long long)sorted[i].calls,
+			(unsigned long long)sorted[i].inclusive, (unsigned long long)sorted[i].exclusive,
+			total ? 100.0 * sorted[i].exclusive / total : 0.0, sorted[i].max_depth);
+	}
+}
+)";
+
+		// C source of the hooks for the functions of the program, after inlining. Calls that were inlined count into their caller
+		std::string generate_instrument_runtime(ProgramST* program) {
+			std::stringstream stream;
+			stream << "/* Function instrumentation generated by bonfirec --instrument=functions */\n";
+			stream << "#include <stdio.h>\n#include <stdlib.h>\n#include <string.h>\n#include <stdint.h>\n#include <x86intrin.h>\n\n";
+			stream << "#define __BONFIRE_NUM_FUNCTIONS " << program->functions.size() << "u\n";
+			// Deeper recursion is still counted, only not timed
+			stream << "#define __BONFIRE_MAX_FRAMES 4096u\n\n";
+
+			stream << "struct __bonfire_function_stats { const char* name; uint64_t calls; uint64_t inclusive; uint64_t exclusive; unsigned depth; unsigned max_depth; };\n";
+			stream << "static struct __bonfire_function_stats __bonfire_stats[] = {\n";
+			for (FunctionDefST* function : program->functions) stream << "\t{ " << quote_c_string(function->name) << " },\n";
+			stream << "};\n";
+
+			stream << INSTRUMENT_RUNTIME_CODE << "\n";
+			for (size_t i = 0; i < program->functions.size(); i++) {
+				const std::string& name = program->functions[i]->name;
+				stream << "__BONFIRE_HOOK void " << get_enter_hook(name) << "(void) { __bonfire_enter(" << i << "); }\n";
+				stream << "__BONFIRE_HOOK void " << get_exit_hook(name) << "(void) { __bonfire_exit(" << i << "); }\n";
+			}
+			return stream.str();
+		}
+	}
+}
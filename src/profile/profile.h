@@ -0,0 +1,234 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <cstdint>
+
+#include "utils/report.h"
+#include "ast.h"
+
+namespace Bonfire {
+	namespace Profile {
+
+		// Profile files start with this line. The format only changes with the version:
+		//   bonfire-profile 1
+		//   function <name> <checksum>
+		//   <if|loop|call> <function> <ordinal> <line> <count>...
+		// A probe is found by its kind, function and ordinal (the position of the probe in the function), the line is only
+		// there for people reading it. Counts of the same probe from several runs are added up
+		const char* const FILE_HEADER = "bonfire-profile 1";
+
+		enum class ProbeKind { IF, LOOP, CALL };
+
+		// A place in the source the instrumented program counts:
+		//   if:   executions, executions of the then arm
+		//   loop: entries, iterations of the body
+		//   call: executions
+		struct Probe {
+			ProbeKind kind;
+			std::string function;
+			uint32_t ordinal;
+			uint32_t line;
+			uint32_t first_counter;	// Index of its first counter in the counter array of the program
+			uint32_t num_counters;
+			std::vector<uint64_t> counts;	// From --profile-use, empty if the profile doesn't have it
+		};
+
+		struct FunctionChecksum {
+			std::string name;
+			uint32_t checksum;
+		};
+
+		// Every probe of the program, AbstractSyntaxTree::probe is the index. Inlined copies keep the probe of the original
+		std::vector<Probe> probes;
+		std::vector<FunctionChecksum> functions;
+		uint32_t num_counters = 0;
+
+		bool generate = false;		// --profile-generate: the program counts its probes
+		bool loaded = false;		// --profile-use: the counts of a profile are known
+		// Counts from here on are hot. 1% of the biggest count in the profile
+		uint64_t hot_threshold = 1;
+
+		const char* get_kind_name(ProbeKind kind) {
+			switch (kind) {
+			case ProbeKind::IF: return "if";
+			case ProbeKind::LOOP: return "loop";
+			default: return "call";
+			}
+		}
+
+		// Changes whenever the probes of a function change, so a profile of an older version of it isn't used
+		uint32_t update_checksum(uint32_t checksum, const std::string& data) {
+			// FNV-1a
+			for (char c : data) {
+				checksum ^= (uint8_t)c;
+				checksum *= 16777619;
+			}
+			return checksum;
+		}
+
+		void add_probe(AbstractSyntaxTree* node, ProbeKind kind, const std::string& function, uint32_t num_counters_of_probe) {
+			Probe probe = { kind, function, 0, node->line, num_counters, num_counters_of_probe, {} };
+			for (const Probe& other : probes) {
+				if (!other.function.compare(function)) ++probe.ordinal;
+			}
+			node->probe = probes.size();
+			probes.push_back(probe);
+			num_counters += num_counters_of_probe;
+		}
+
+		// Gives the ifs, loops and calls of an expression their probes, in the order they appear in the source
+		void assign_probes(ExpressionST* expression, const std::string& function, uint32_t& checksum) {
+			if (!expression) return;
+			switch (expression->type) {
+			case AstType::BLOCK:
+			{
+				BlockST* block_st = static_cast<BlockST*>(expression);
+				for (uint32_t i = 0; i < block_st->num_children; i++) assign_probes(block_st->children[i], function, checksum);
+				return;
+			}
+			case AstType::IF:
+			{
+				IfST* if_st = static_cast<IfST*>(expression);
+				add_probe(if_st, ProbeKind::IF, function, 2);
+				checksum = update_checksum(checksum, if_st->has_else ? "if-else" : "if");
+				assign_probes(if_st->condition, function, checksum);
+				assign_probes(if_st->then_body, function, checksum);
+				if (if_st->has_else) assign_probes(if_st->else_body, function, checksum);
+				return;
+			}
+			case AstType::LOOP:
+			{
+				LoopST* loop_st = static_cast<LoopST*>(expression);
+				add_probe(loop_st, ProbeKind::LOOP, function, 2);
+				checksum = update_checksum(checksum, "loop");
+				assign_probes(loop_st->condition, function, checksum);
+				assign_probes(loop_st->body, function, checksum);
+				return;
+			}
+			case AstType::MATCH:
+			{
+				// The arms are not counted, only what is inside of them
+				MatchST* match_st = static_cast<MatchST*>(expression);
+				checksum = update_checksum(checksum, "match " + std::to_string(match_st->arms.size()));
+				assign_probes(match_st->value, function, checksum);
+				for (MatchArm& arm : match_st->arms) assign_probes(arm.body, function, checksum);
+				assign_probes(match_st->default_body, function, checksum);
+				return;
+			}
+			case AstType::FUNCTION_CALL:
+			{
+				FunctionCallST* call_st = static_cast<FunctionCallST*>(expression);
+				add_probe(call_st, ProbeKind::CALL, function, 1);
+				checksum = update_checksum(checksum, "call " + call_st->function->name);
+				for (ExpressionST* argument : call_st->arguments) assign_probes(argument, function, checksum);
+				return;
+			}
+			case AstType::RETURN:
+				assign_probes(static_cast<ReturnST*>(expression)->expression, function, checksum);
+				return;
+			case AstType::VAR_ASSIGNMENT:
+				assign_probes(static_cast<VariableAssignST*>(expression)->value, function, checksum);
+				return;
+			case AstType::VAR_DECLARATION:
+				assign_probes(static_cast<VariableDeclarationST*>(expression)->value, function, checksum);
+				return;
+			case AstType::OPERATION:
+				assign_probes(static_cast<OperationST*>(expression)->lhs, function, checksum);
+				assign_probes(static_cast<OperationST*>(expression)->rhs, function, checksum);
+				return;
+			case AstType::ARRAY_DECLARATION:
+				assign_probes(static_cast<ArrayDeclarationST*>(expression)->value, function, checksum);
+				return;
+			case AstType::SLICE:
+				assign_probes(static_cast<SliceST*>(expression)->begin, function, checksum);
+				assign_probes(static_cast<SliceST*>(expression)->end, function, checksum);
+				return;
+			case AstType::INDEX:
+				assign_probes(static_cast<IndexST*>(expression)->index, function, checksum);
+				return;
+			case AstType::INDEX_ASSIGNMENT:
+				assign_probes(static_cast<IndexAssignST*>(expression)->index, function, checksum);
+				assign_probes(static_cast<IndexAssignST*>(expression)->value, function, checksum);
+				return;
+			default:
+				return;
+			}
+		}
+
+		// Probes are assigned right after parsing, before any optimization changes the tree. Instrumented and optimized
+		// builds of the same source get the same probes
+		void assign_probes(ProgramST* program) {
+			probes.clear();
+			functions.clear();
+			num_counters = 0;
+			for (FunctionDefST* function : program->functions) {
+				uint32_t checksum = 2166136261u;
+				assign_probes(function->statement, function->name, checksum);
+				functions.push_back({ function->name, checksum });
+			}
+		}
+
+		// Reads the counts of a profile written by a program built with --profile-generate. Functions that changed since
+		// are ignored. Returns false if the file can't be read
+		bool load(const std::string& path) {
+			std::ifstream file(path);
+			std::string line;
+			if (!file || !std::getline(file, line) || line.compare(FILE_HEADER)) return false;
+
+			std::map<std::string, uint32_t> checksums;
+			for (const FunctionChecksum& function : functions) checksums[function.name] = function.checksum;
+			std::map<std::string, Probe*> by_key;
+			for (Probe& probe : probes) {
+				by_key[std::string(get_kind_name(probe.kind)) + " " + probe.function + " " + std::to_string(probe.ordinal)] = &probe;
+			}
+
+			bool function_matches = false;
+			uint64_t max_count = 0;
+			while (std::getline(file, line)) {
+				std::istringstream stream(line);
+				std::string kind, function;
+				stream >> kind >> function;
+				if (!kind.compare("function")) {
+					uint32_t checksum = 0;
+					stream >> checksum;
+					function_matches = checksums.count(function) && checksums[function] == checksum;
+					if (!function_matches) std::cerr << "Profile of " << function << " doesn't match the source, it is ignored" << std::endl;
+					continue;
+				}
+				if (!function_matches) continue;
+				uint32_t ordinal, source_line;
+				stream >> ordinal >> source_line;
+				auto it = by_key.find(kind + " " + function + " " + std::to_string(ordinal));
+				if (it == by_key.end()) continue;
+				Probe* probe = it->second;
+				probe->counts.assign(probe->num_counters, 0);
+				for (uint32_t i = 0; i < probe->num_counters && stream >> probe->counts[i]; i++) {
+					if (probe->counts[i] > max_count) max_count = probe->counts[i];
+				}
+			}
+			hot_threshold = max_count / 100 > 1 ? max_count / 100 : 1;
+			loaded = true;
+			return true;
+		}
+
+		// The counts of the probe of a node, NULL if the profile doesn't have them
+		const std::vector<uint64_t>* get_counts(const AbstractSyntaxTree* node) {
+			if (!loaded || node->probe < 0 || probes[node->probe].counts.empty()) return NULL;
+			return &probes[node->probe].counts;
+		}
+
+		bool is_hot(uint64_t count) {
+			return count >= hot_threshold;
+		}
+
+		// Where a decision based on the profile was made, for --report=profile
+		std::string describe(const AbstractSyntaxTree* node) {
+			const Probe& probe = probes[node->probe];
+			return std::string(get_kind_name(probe.kind)) + " in " + probe.function + " at line " + std::to_string(probe.line);
+		}
+	}
+}
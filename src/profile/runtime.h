@@ -0,0 +1,129 @@
+#pragma once
+#include <string>
+#include <sstream>
+
+#include "profile/profile.h"
+
+namespace Bonfire {
+	namespace Profile {
+
+		// The counters and the code that writes them into the profile file at exit. An instrumented program is linked with it
+		const char* const RUNTIME_CODE = R"(
+static int __bonfire_find_function(const char* name, unsigned checksum) {
+	for (unsigned i = 0; i < __BONFIRE_NUM_FUNCTIONS; i++) {
+		if (!strcmp(__bonfire_functions[i].name, name)) return __bonfire_functions[i].checksum == checksum;
+	}
+	return 0;
+}
+
+static const struct __bonfire_probe* __bonfire_find_probe(const char* kind, const char* function, unsigned ordinal) {
+	for (unsigned i = 0; i < __BONFIRE_NUM_PROBES; i++) {
+		const struct __bonfire_probe* probe = &__bonfire_probes[i];
+		if (probe->ordinal == ordinal && !strcmp(probe->kind, kind) && !strcmp(probe->function, function)) return probe;
+	}
+	return 0;
+}
+
+/* Adds the counts of earlier runs to the counters. Functions that changed since are dropped */
+static void __bonfire_merge(FILE* file) {
+	char line[4096], kind[64], function[1024];
+	int matches = 0;
+	if (!fgets(line, sizeof(line), file) || strncmp(line, __BONFIRE_PROFILE_HEADER, strlen(__BONFIRE_PROFILE_HEADER))) return;
+	while (fgets(line, sizeof(line), file)) {
+		unsigned ordinal, source_line;
+		int offset;
+		if (sscanf(line, "%63s %1023s%n", kind, function, &offset) != 2) continue;
+		if (!strcmp(kind, "function")) {
+			unsigned checksum;
+			matches = sscanf(line + offset, "%u", &checksum) == 1 && __bonfire_find_function(function, checksum);
+			continue;
+		}
+		if (!matches) continue;
+		const char* cursor = line + offset;
+		int read;
+		if (sscanf(cursor, "%u %u%n", &ordinal, &source_line, &read) != 2) continue;
+		cursor += read;
+		const struct __bonfire_probe* probe = __bonfire_find_probe(kind, function, ordinal);
+		if (!probe) continue;
+		for (unsigned i = 0; i < probe->num_counters; i++) {
+			unsigned long long count;
+			if (sscanf(cursor, "%llu%n", &count, &read) != 1) break;
+			cursor += read;
+			__bonfire_counters[probe->first_counter + i] += count;
+		}
+	}
+}
+
+__attribute__((destructor)) static void __bonfire_write_profile(void) {
+	const char* path = getenv("BONFIRE_PROFILE");
+	if (!path || !*path) path = __BONFIRE_PROFILE_PATH;
+	FILE* file = fopen(path, "r");
+	if (file) {
+		__bonfire_merge(file);
+		fclose(file);
+	}
+	file = fopen(path, "w");
+	if (!file) {
+		fprintf(stderr, "Can't write the profile %s\n", path);
+		return;
+	}
+	fprintf(file, "%s\n", __BONFIRE_PROFILE_HEADER);
+	for (unsigned i = 0; i < __BONFIRE_NUM_FUNCTIONS; i++) {
+		fprintf(file, "function %s %u\n", __bonfire_functions[i].name, __bonfire_functions[i].checksum);
+		for (unsigned j = 0; j < __BONFIRE_NUM_PROBES; j++) {
+			const struct __bonfire_probe* probe = &__bonfire_probes[j];
+			if (strcmp(probe->function, __bonfire_functions[i].name)) continue;
+			fprintf(file, "%s %s %u %u", probe->kind, probe->function, probe->ordinal, probe->line);
+			for (unsigned k = 0; k < probe->num_counters; k++) fprintf(file, " %llu", (unsigned long long)__bonfire_counters[probe->first_counter + k]);
+			fprintf(file, "\n");
+		}
+	}
+	fclose(file);
+}
+)";
+
+		// Quotes a string for C source
+		std::string quote_c_string(const std::string& text) {
+			std::string quoted = "\"";
+			for (char c : text) {
+				if (c == '"' || c == '\\') quoted += '\\';
+				quoted += c;
+			}
+			return quoted + "\"";
+		}
+
+		// C source of the profile runtime for the probes of the program. BONFIRE_PROFILE in the environment
+		// overrides the path of the profile file
+		std::string generate_runtime(const std::string& profile_path) {
+			std::stringstream stream;
+			stream << "/* Profile runtime generated by bonfirec --profile-generate */\n";
+			stream << "#include <stdio.h>\n#include <stdlib.h>\n#include <string.h>\n#include <stdint.h>\n\n";
+			stream << "#define __BONFIRE_PROFILE_HEADER " << quote_c_string(FILE_HEADER) << "\n";
+			stream << "#define __BONFIRE_PROFILE_PATH " << quote_c_string(profile_path) << "\n";
+			stream << "#define __BONFIRE_NUM_FUNCTIONS " << functions.size() << "u\n";
+			stream << "#define __BONFIRE_NUM_PROBES " << probes.size() << "u\n\n";
+			// Arrays can't be empty in C
+			stream << "uint64_t __bonfire_counters[" << (num_counters ? num_counters : 1) << "];\n\n";
+
+			stream << "struct __bonfire_function { const char* name; unsigned checksum; };\n";
+			stream << "static const struct __bonfire_function __bonfire_functions[] = {\n";
+			for (const FunctionChecksum& function : functions) {
+				stream << "\t{ " << quote_c_string(function.name) << ", " << function.checksum << "u },\n";
+			}
+			if (functions.empty()) stream << "\t{ \"\", 0 },\n";
+			stream << "};\n\n";
+
+			stream << "struct __bonfire_probe { const char* kind; const char* function; unsigned ordinal; unsigned line; unsigned first_counter; unsigned num_counters; };\n";
+			stream << "static const struct __bonfire_probe __bonfire_probes[] = {\n";
+			for (const Probe& probe : probes) {
+				stream << "\t{ \"" << get_kind_name(probe.kind) << "\", " << quote_c_string(probe.function) << ", " << probe.ordinal << ", "
+					<< probe.line << ", " << probe.first_counter << ", " << probe.num_counters << " },\n";
+			}
+			if (probes.empty()) stream << "\t{ \"\", \"\", 0, 0, 0, 0 },\n";
+			stream << "};\n";
+
+			stream << RUNTIME_CODE;
+			return stream.str();
+		}
+	}
+}
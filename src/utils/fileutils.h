@@ -34,7 +34,8 @@ namespace Bonfire {
 		FileError write_file(const char* path, std::string data) {
 			FILE* f = fopen(path, "wb");
 
-			fprintf(f, "%s", data.c_str());
+			// Object files contain zeros, so the whole string is written
+			fwrite(data.data(), sizeof(char), data.size(), f);
 			fclose(f);
 
 			return OK;
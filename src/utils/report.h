@@ -0,0 +1,92 @@
+#pragma once
+#include <iostream>
+#include <string>
+#include <vector>
+#include <set>
+#include <map>
+#include <chrono>
+
+namespace Bonfire {
+	namespace Report {
+		// Reports that were turned on with --report=<kind>[,<kind>...]
+		std::set<std::string> enabled;
+		// Lines of every report, in the order they were added
+		std::map<std::string, std::vector<std::string>> lines;
+
+		void enable(std::string kinds) {
+			size_t start = 0;
+			while (start <= kinds.size()) {
+				size_t end = kinds.find(',', start);
+				if (end == std::string::npos) end = kinds.size();
+				if (end > start) enabled.insert(kinds.substr(start, end - start));
+				start = end + 1;
+			}
+		}
+
+		bool is_enabled(const std::string& kind) {
+			return enabled.count(kind) != 0;
+		}
+
+		void add_line(const std::string& kind, const std::string& line) {
+			if (is_enabled(kind)) lines[kind].push_back(line);
+		}
+
+		// Time/size report (--report=size)
+		struct FunctionSize {
+			std::string name;
+			uint32_t instructions = 0;
+			int32_t eliminated = 0;	// Instructions removed by dead code elimination
+		};
+
+		std::vector<std::pair<std::string, double>> phase_times;
+		std::vector<FunctionSize> function_sizes;
+
+		FunctionSize& get_function_size(const std::string& name) {
+			for (FunctionSize& size : function_sizes) {
+				if (!size.name.compare(name)) return size;
+			}
+			function_sizes.push_back(FunctionSize());
+			function_sizes.back().name = name;
+			return function_sizes.back();
+		}
+
+		// Measures the time of one compiler phase, from construction until stop()
+		class PhaseTimer {
+			std::string name;
+			std::chrono::steady_clock::time_point start;
+		public:
+			PhaseTimer(std::string name) {
+				this->name = name;
+				start = std::chrono::steady_clock::now();
+			}
+
+			void stop() {
+				std::chrono::duration<double, std::milli> time = std::chrono::steady_clock::now() - start;
+				phase_times.push_back(std::make_pair(name, time.count()));
+			}
+		};
+
+		void print(std::ostream& stream) {
+			if (is_enabled("size")) {
+				char buf[256];
+				stream << "Time/size report" << std::endl;
+				for (auto& phase : phase_times) {
+					sprintf(buf, "  %-16s %10.3f ms", phase.first.c_str(), phase.second);
+					stream << buf << std::endl;
+				}
+				sprintf(buf, "  %-16s %12s %10s", "function", "instructions", "eliminated");
+				stream << buf << std::endl;
+				for (FunctionSize& size : function_sizes) {
+					sprintf(buf, "  %-16s %12u %10d", size.name.c_str(), size.instructions, size.eliminated);
+					stream << buf << std::endl;
+				}
+			}
+			for (auto& report : lines) {
+				stream << "Report: " << report.first << std::endl;
+				for (std::string& line : report.second) {
+					stream << "  " << line << std::endl;
+				}
+			}
+		}
+	}
+}